@@ -0,0 +1,68 @@
+#ifndef AsyncTelnetCommand_h
+#define AsyncTelnetCommand_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <cstring>
+#include <functional>
+#include <strings.h>
+#include <vector>
+
+// Line tokenizer and command table of the telnet server. Nothing here touches the network or the RTOS, so the
+// same code also builds under [env:native] for the host benchmark.
+
+#define ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS  10
+
+class AsyncClient;
+class AsyncTelnetSession;
+class AsyncTelnetArgs;
+
+typedef std::function<void(AsyncClient* client, String* parameter)> telnet_callback_t;
+typedef std::function<void(AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args)> telnet_args_callback_t;
+
+// Parameters of a command line, tokenized in place: each entry points into the session line buffer and is only
+// valid for the duration of the callback. Missing parameters read as "".
+class AsyncTelnetArgs {
+    public:
+        uint8_t Count = 0;
+        const char* Value[ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS] = {};
+
+        inline const char* operator[](uint8_t index) const { return index < Count ? Value[index] : ""; }
+        inline bool Empty(uint8_t index) const { return index >= Count; }
+        inline bool Is(uint8_t index, const char* value) const { return strcasecmp((*this)[index], value) == 0; }
+
+        // Strips the spaces around the line in place and returns where it now starts
+        static char* Trim(char* line);
+
+        // Splits a trimmed line into NUL terminated tokens inside the buffer and returns the command; tokens past
+        // the last parameter are ignored
+        char* Split(char* line);
+};
+
+class AsyncTelnetCommand {
+    public:
+        String Command;
+        String HelpMessage;
+        telnet_callback_t Callback;
+        bool Admin;
+        telnet_args_callback_t ArgsCallback;
+        bool Worker;
+};
+
+// Kept sorted by command name and looked up with a binary search. A name registered twice keeps its first entry.
+class AsyncTelnetCommandList {
+    private:
+        std::vector<AsyncTelnetCommand*> mList;
+    public:
+        void Add(AsyncTelnetCommand* command);
+        AsyncTelnetCommand* Find(const char* command) const;
+
+        inline void Clear() { mList.clear(); }
+        inline size_t size() const { return mList.size(); }
+        inline AsyncTelnetCommand* operator[](size_t index) const { return mList[index]; }
+        inline std::vector<AsyncTelnetCommand*>::const_iterator begin() const { return mList.begin(); }
+        inline std::vector<AsyncTelnetCommand*>::const_iterator end() const { return mList.end(); }
+};
+
+#endif
@@ -6,9 +6,21 @@
 #include <Arduino.h>
 #include <AsyncTCP.h>
 #include <vector>
+#include <deque>
+#include <atomic>
 #include <functional>
-
-#define ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS  10
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#include "AsyncTelnetCommand.h"
+
+#define ASYNCTELNETSERVER_MAXLINE               256
+#define ASYNCTELNETSERVER_OUTPUTCHUNK           512
+#define ASYNCTELNETSERVER_OUTPUTLOWWATER        1024
+#define ASYNCTELNETSERVER_WORKERSTACK           6144
+#define ASYNCTELNETSERVER_WORKERPRIORITY        1
+#define ASYNCTELNETSERVER_WORKERQUEUE           4
 #define ASYNCTELNETSERVER_HELPCOMMANDSPERLINE   6
 #define ASYNCTELNETSERVER_DEFAULTPROMPT         "> "
 #define ASYNCTELNETSERVER_CMD_CLEAR             "clear"
@@ -26,12 +38,11 @@
 #define ASYNCTELNETSERVER_DEFAULTWELCOMEMESSAGE "Async Telnet Server - Welcome"
 #define ASYNCTELNETSERVER_INVALIDCOMMAND        "Invalid command."
 #define ASYNCTELNETSERVER_PERMISSIONDENIED      "Permission denied."
+#define ASYNCTELNETSERVER_WORKERBUSY            "Too many commands running - try again."
 #define ASYNCTELNETSERVER_GUESTUSER             "guest"
 
-class AsyncTelnetSession;
-
-typedef std::function<void(AsyncClient* client, String* parameter)> telnet_callback_t;
 typedef std::function<void(AsyncClient* client, AsyncTelnetSession* session)> telnet_session_callback_t;
+typedef std::function<bool(AsyncTelnetSession* session)> telnet_stream_t;
 
 enum AsyncTelnetMode {
     ASYNCTELNETMODE_CHAR,
@@ -57,22 +68,70 @@ static struct protcmd {
     const uint8_t IAC  = 255;
 } PROTCMD;
 
-class AsyncTelnetCommand {
-    public:
-        String Command;
-        String HelpMessage;
-        telnet_callback_t Callback;
-        bool Admin;
-};
+// A session is also the Print its commands write to. Output is queued in small chunks and handed to the client only
+// as fast as its send window allows; onAck and onPoll resume it. Long outputs should be produced by a stream
+// generator, which is called for more only while less than ASYNCTELNETSERVER_OUTPUTLOWWATER bytes are waiting.
+// Commands on the worker task only queue their output; the AsyncTCP task is the only one that talks to the client.
+class AsyncTelnetSession : public Print {
+    friend class AsyncTelnetServer;
+
+    private:
+        SemaphoreHandle_t mLock = nullptr;
+        std::deque<String> mOutput;
+        size_t mOutputHead = 0;
+        size_t mOutputBytes = 0;
+        bool mPumping = false;
+
+        // Only the task that holds mPumping runs, installs or clears mStream. Stream() and Cancel() leave a parked
+        // generator and a cancel request under mLock, and Pump() takes them over, so a generator never runs on two
+        // tasks or is destroyed while it runs. A worker command's generator stays parked until the job is finished.
+        telnet_stream_t mStream = nullptr;
+        telnet_stream_t mPendingStream = nullptr;
+        bool mStreamCancel = false;
+        std::atomic<bool> mStreaming{false};
+
+        std::atomic<bool> mBusy{false};
+        std::atomic<bool> mCancelled{false};
+        bool mDetached = false;
+        AsyncTelnetArgs mArgs;
+
+        bool detach();
+        bool finish();
+        void queue(const uint8_t* buffer, size_t size);
+        void queuePrompt();
 
-class AsyncTelnetSession {
     public:
+        AsyncTelnetSession();
+        ~AsyncTelnetSession();
+
+        AsyncClient* Client = nullptr;
         IPAddress RemoteIP;
-        uint16_t RemotePort;
+        uint16_t RemotePort = 0;
         String User;
-        String InputBuffer;
-        String LastInput;
-        bool Admin;
+        bool Admin = false;
+        bool Closing = false;
+
+        char Line[ASYNCTELNETSERVER_MAXLINE + 1] = {};
+        uint16_t LineLength = 0;
+        char LastLine[ASYNCTELNETSERVER_MAXLINE + 1] = {};
+
+        // Reused by commands registered with a String* callback, so their parameters only allocate when they outgrow the previous ones
+        String Parameter[ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS];
+
+        using Print::write;
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t* buffer, size_t size) override;
+
+        // The generator writes its next piece to the session and returns false once it is done; the prompt follows it
+        void Stream(telnet_stream_t generator);
+        bool Cancel();
+        void Pump();
+        void Prompt();
+
+        [[nodiscard]] bool Streaming() const noexcept { return mStreaming; }
+        [[nodiscard]] bool Busy() const noexcept { return mBusy; }
+        [[nodiscard]] bool Cancelled() const noexcept { return mCancelled; }
+        [[nodiscard]] size_t Pending() const noexcept { return mOutputBytes; }
 };
 
 class AsyncTelnetServer {
@@ -81,14 +140,30 @@ class AsyncTelnetServer {
         AsyncTelnetMode mMode = ASYNCTELNETMODE_LINE;
         uint16_t mPort;
 
-        std::vector<AsyncTelnetCommand*> mCommandList;
+        AsyncTelnetCommandList mCommandList;
         std::vector<AsyncTelnetSession*> mSessions;
         std::vector<String> mUsers;
+        uint32_t mCommands = 0;
+
+        struct job_t {
+            AsyncClient* Client;
+            AsyncTelnetSession* Session;
+            AsyncTelnetCommand* Command;
+        };
+
+        QueueHandle_t mJobs = nullptr;
+        TaskHandle_t mWorker = nullptr;
+        AsyncTelnetSession* mJobSession = nullptr;
+
+        static void Worker(void* arg);
+        bool Dispatch(AsyncClient* client, AsyncTelnetSession* session, AsyncTelnetCommand* cmd, const AsyncTelnetArgs& args);
 
         AsyncTelnetSession* FindSession(AsyncClient* client);
+        void AddCommand(AsyncTelnetCommand* command);
         void RemoveSession(AsyncClient* client);
         void HandleNegotiation(AsyncClient* client, const uint8_t* data, size_t len, size_t& index);
-        void ProcessLine(AsyncClient* client, const String& line);
+        void ProcessLine(AsyncClient* client, AsyncTelnetSession* session);
+        void WriteSession(AsyncTelnetSession* output, AsyncTelnetSession* session);
 
     public:
         AsyncTelnetServer(uint16_t port);
@@ -100,12 +175,38 @@ class AsyncTelnetServer {
         telnet_session_callback_t onSessionEnd = nullptr;
 
         inline uint16_t Port() { return mPort; }
+        inline size_t Sessions() { return mSessions.size(); }
+        inline uint32_t Commands() { return mCommands; }
 
         AsyncTelnetSession* CurrentSession(AsyncClient* client);
         uint8_t SessionID(AsyncClient* client);
 
+        // Queues text on the client's session, for commands that only have the client at hand
+        size_t Write(AsyncClient* client, const char* text);
+
+        // For commands on the worker: Cancelled() turns true on Ctrl-C or disconnect, Wait() sleeps unless it does
+        bool Cancelled(AsyncClient* client);
+        bool Wait(AsyncClient* client, uint32_t ms);
+
+        // Compatibility path for external callers, the built-in commands all use onCommandArgs: every dispatch
+        // copies the tokens into the session's String slots, which may allocate
         inline void onCommand(String command, String helpmessage, telnet_callback_t callback, bool admin = false) {
-            mCommandList.push_back(new AsyncTelnetCommand({command, helpmessage, callback, admin}));
+            AddCommand(new AsyncTelnetCommand({command, helpmessage, callback, admin, nullptr, false}));
+        }
+
+        // Zero-copy variant: the callback gets the session and the in-place tokens instead of a String array
+        inline void onCommandArgs(String command, String helpmessage, telnet_args_callback_t callback, bool admin = false) {
+            AddCommand(new AsyncTelnetCommand({command, helpmessage, nullptr, admin, callback, false}));
+        }
+
+        // For commands that block (network I/O, delays): they run on the worker task, one at a time, so the AsyncTCP
+        // task keeps serving every other connection meanwhile
+        inline void onWorkerCommand(String command, String helpmessage, telnet_callback_t callback, bool admin = false) {
+            AddCommand(new AsyncTelnetCommand({command, helpmessage, callback, admin, nullptr, true}));
+        }
+
+        inline void onWorkerCommandArgs(String command, String helpmessage, telnet_args_callback_t callback, bool admin = false) {
+            AddCommand(new AsyncTelnetCommand({command, helpmessage, nullptr, admin, callback, true}));
         }
 
         inline void begin() {
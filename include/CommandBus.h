@@ -0,0 +1,109 @@
+#ifndef CommandBus_h
+#define CommandBus_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <DevIQ_Components.h>
+#include <atomic>
+#include <functional>
+
+#include "Stats.h"
+
+using namespace DeviceIQ_Components;
+
+// Slots in the command ring; must be a power of two
+#define COMMANDBUS_DEPTH    32
+
+enum CommandOps : uint8_t {
+    COMMAND_RELAY_STATE,        // Value: 0 off, 1 on
+    COMMAND_RELAY_INVERT,
+    COMMAND_BLINDS_POSITION,    // Value: 0..100
+    COMMAND_BLINDS_SYNC,        // Value: 0..100, sets the current position without moving
+    COMMAND_BLINDS_OPEN,
+    COMMAND_BLINDS_CLOSE,
+    COMMAND_BLINDS_STOP,
+    COMMAND_BUTTON_DO,          // Value: ClickTypes
+    COMMAND_SAVE_SETTINGS,
+    COMMAND_COMPONENTS          // Job: adds or removes components; starts a new layout
+};
+
+enum CommandSources : uint8_t { COMMANDSOURCE_WEB, COMMANDSOURCE_MQTT, COMMANDSOURCE_TELNET, COMMANDSOURCE_ORCHESTRATOR, COMMANDSOURCE_COUNT };
+
+// Runs on the loop task and returns whether it succeeded
+using command_job_t = std::function<bool()>;
+
+struct command_t {
+    Generic* Target;
+    int32_t Value;
+    uint32_t Layout;        // Layout the target was looked up in; a command from an older layout is rejected
+    command_job_t* Job;     // COMMAND_COMPONENTS only, freed once it ran
+    uint32_t Submitted;     // micros()
+    CommandOps Op;
+    CommandSources Source;
+};
+
+// Single way into the control loop for anything that actuates components or persists settings from another task
+// (AsyncTCP, AsyncUDP, the telnet worker, MQTT). Producers claim a slot of a bounded ring with one compare-and-swap
+// and never block; loop() drains the ring between control ticks, so components are only ever touched from one task.
+// Every command gets a ticket; a producer that needs the outcome (e.g. to reply with the new state) waits on it.
+class commandbus {
+    private:
+        struct cell_t {
+            std::atomic<uint32_t> Sequence;
+            command_t Command;
+        };
+
+        cell_t pCells[COMMANDBUS_DEPTH];
+        std::atomic<uint32_t> pTail{0};
+        uint32_t pHead = 0;
+        std::atomic<uint32_t> pApplied{0};
+        std::atomic<uint32_t> pLayout{0};
+        bool pSavePending = false;
+
+        std::atomic<uint32_t> pSubmitted{0};
+        std::atomic<uint32_t> pFull{0};
+        uint32_t pExecuted = 0;
+        uint32_t pRejected = 0;
+        uint32_t pSaves = 0;
+        uint32_t pMaxDepth = 0;
+        uint32_t pBySource[COMMANDSOURCE_COUNT] = {};
+        LatencyStats pLatency;
+
+        uint32_t push(const command_t& cmd);
+        bool apply(const command_t& cmd);
+    public:
+        commandbus();
+
+        // Any task. Components are only added or removed by COMMAND_COMPONENTS jobs on the loop task, and each one
+        // starts a new layout. A producer reads Layout() before it looks a component up and passes it along, so a
+        // command never reaches a component that replaced a removed one at the same address.
+        [[nodiscard]] uint32_t Layout() const noexcept { return pLayout.load(std::memory_order_acquire); }
+
+        // Any task. Returns the command's ticket, or 0 when the ring is full
+        uint32_t Submit(CommandOps op, Generic* target, int32_t value, CommandSources source, uint32_t layout);
+        uint32_t SaveSettings(CommandSources source) { return Submit(COMMAND_SAVE_SETTINGS, nullptr, 0, source, 0); }
+        uint32_t Components(command_job_t job, CommandSources source);
+
+        // Any task but loop(): returns once the command with this ticket, and everything before it, was applied
+        bool Wait(uint32_t ticket, uint32_t timeoutms) const;
+
+        // loop() only
+        size_t Drain();
+
+        [[nodiscard]] uint32_t Submitted() const noexcept { return pSubmitted; }
+        [[nodiscard]] uint32_t Full() const noexcept { return pFull; }
+        [[nodiscard]] uint32_t Executed() const noexcept { return pExecuted; }
+        [[nodiscard]] uint32_t Rejected() const noexcept { return pRejected; }
+        [[nodiscard]] uint32_t Saves() const noexcept { return pSaves; }
+        [[nodiscard]] uint32_t Depth() const noexcept { return pTail.load() - pHead; }
+        [[nodiscard]] uint32_t MaxDepth() const noexcept { return pMaxDepth; }
+        [[nodiscard]] uint32_t BySource(CommandSources source) const noexcept { return source < COMMANDSOURCE_COUNT ? pBySource[source] : 0; }
+        [[nodiscard]] const LatencyStats& Latency() const noexcept { return pLatency; }
+
+        static const char* SourceName(CommandSources source);
+};
+
+extern commandbus CommandBus;
+
+#endif
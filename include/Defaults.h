@@ -25,7 +25,26 @@ struct defaults_t {
         const uint8_t Level = 0b11111111; // All
         const char* SyslogServer = "syslog.svr";
         const uint16_t SyslogPort = 514;
+        const char* SyslogTransport = "UDP";
+        const size_t SyslogBacklog = 8192;
+        const size_t SyslogDatagram = 1200; // Longest record, and the most one TCP write carries; stays under a typical WLAN MTU
+        const int32_t SyslogConnectTimeoutMs = 2000;
+        const uint32_t SyslogRetryMinMs = 1000;
+        const uint32_t SyslogRetryMaxMs = 60000;
         const uint16_t ShowMaxLines = 20;
+        const size_t RingSize = 8192;
+        const size_t PageSize = 2048;
+        const uint32_t FlushIntervalMs = 1000;
+        const size_t SegmentSize = 16384; // Capped at 64 KiB by the 16-bit index offsets
+        const uint8_t MaxSegments = 32;
+        const size_t MaxStoreSize = 131072; // Stored (mostly compressed) bytes across all segments
+        const uint16_t RateLimit = 10; // Messages per second for each module and level
+        const uint16_t RateBurst = 30;
+        const uint32_t RepeatReportMs = 10000;
+        const uint32_t TaskStack = 6144; // Name resolution and TCP writes for syslog run on the log task
+        const uint8_t TaskPriority = 1;
+        const size_t TailSize = 4096; // RAM kept for "log follow"
+        const uint8_t FollowBacklog = 10; // Records shown when a follower attaches
     } Log;
     struct network_t {
         const bool DHCPClient = true;
@@ -61,11 +80,31 @@ struct defaults_t {
         const char* ServerID = "";
         const char* IP_Address = "";
         const uint16_t Port = 30030;
+        const uint32_t RequestTimeoutMs = 1000; // First wait for a UDP reply, doubled on every retry
+        const uint32_t RequestTimeoutMaxMs = 8000;
+        const uint8_t RequestAttempts = 4;
+        const uint8_t MaxRequests = 4; // In flight at once
+        const uint8_t MaxInbox = 8; // Replies waiting for Control()
+        const uint16_t SessionPort = 30031; // Framed TCP session; the server's Port keeps taking one connection per message
+        const uint32_t ConnectTimeoutMs = 5000;
+        const uint32_t HandshakeTimeoutMs = 3000;
+        const uint32_t KeepaliveMs = 15000; // Ping when idle, drop after three intervals of silence
+        const uint32_t ReconnectMinMs = 2000;
+        const uint32_t ReconnectMaxMs = 120000;
+        const size_t MaxFrame = 16384;
+        const uint8_t MaxQueued = 16; // Frames waiting for the socket
+        const uint8_t MaxCommands = 4; // Session commands waiting for the worker
+        const uint32_t WorkerStack = 8192; // Session commands run on their own task: they wait on the bus and stream files
+        const uint8_t WorkerPriority = 1;
     } Orchestrator;
     struct webserver_t {
         const uint16_t Port = 80;
         const bool Enabled = true;
         const char* WebHooksToken = "default_token";
+        const uint8_t EventQueueDepth = 16;
+        const uint8_t EventMaxInFlight = 4;
+        const uint16_t BatchMaxBody = 8192;
+        const uint16_t BatchMaxAction = 512;
     } WebServer;
     struct telnetserver_t {
         const uint16_t Port = 23;
@@ -77,6 +116,13 @@ struct defaults_t {
         const uint16_t Port = 1883;
         const char* User = "";
         const char* Password = "";
+        const uint32_t ReconnectMinMs = 1000;
+        const uint32_t ReconnectMaxMs = 60000;
+        const uint32_t ConnectStack = 4096; // The blocking connect runs on its own short-lived task
+        const uint8_t ConnectPriority = 1;
+        const uint8_t BenchSlice = 16; // Bench publishes per loop() pass
+        const bool TopicAliases = false;
+        const bool CompactPayload = false;
     } MQTT;
     struct components_t {
         const bool Enabled = true;
@@ -87,8 +133,18 @@ struct defaults_t {
             const uint8_t CalibrationMultiplier = 3;
         } Blinds;
     } Components;
+    struct commandbus_t {
+        const uint32_t ReplyWaitMs = 100; // How long a request handler waits for loop() to apply its command
+        const uint32_t SaveWaitMs = 2000; // For callers that read the config file back right after saving
+    } CommandBus;
+    struct perf_t {
+        const uint32_t WindowMs = 1000; // Loop stage statistics and rates cover the last closed window
+        const uint32_t RefreshMs = 1000; // top
+    } Perf;
     const char* ConfigFileName = "/config.json";
     const char* LogFileName = "/device.log";
+    const char* LogDirectory = "/logs";
+    const char* AssetManifestFileName = "/assets.json";
     const uint32_t InitialTimeAndDate = 1708136755;
 };
 
@@ -0,0 +1,35 @@
+#ifndef FileFrames_h
+#define FileFrames_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+
+// Binary framed file transfer, sent for GetLog and Pull when the server asks for "Transfer": "binary":
+//   uint32 header length | JSON header | { uint32 chunk length | chunk }* | uint32 0 | uint32 size | uint32 CRC32
+// All integers are big-endian. Size and CRC32 are taken while the chunks go out, so the source is read once.
+// Nothing here touches the socket, so [env:native] builds it for the host benchmark.
+
+// One chunk plus its length prefix fills the socket's send buffer, so each write is a single lwIP call
+#ifdef CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+#define FILEFRAMES_CHUNK        (CONFIG_LWIP_TCP_SND_BUF_DEFAULT - 4)
+#else
+#define FILEFRAMES_CHUNK        (4096 - 4)
+#endif
+
+uint32_t CRC32_Update(uint32_t crc, const uint8_t* data, size_t len);
+
+class FileFrames {
+    public:
+        using reader_t = std::function<size_t(uint8_t* buffer, size_t len)>;
+        using writer_t = std::function<bool(const uint8_t* data, size_t len)>;
+
+        static void PutBE32(uint8_t* out, uint32_t value);
+        static uint32_t GetBE32(const uint8_t* in);
+
+        // Writes the whole stream; chunks are filled completely before they go out. False as soon as a write fails.
+        static bool Write(const String& header, const reader_t& read, const writer_t& write, size_t& fileSize, uint32_t& crc32, size_t chunk = FILEFRAMES_CHUNK);
+};
+
+#endif
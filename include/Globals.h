@@ -24,6 +24,10 @@
 
 #include "AsyncTelnetServer.h"
 #include "Orchestrator.h"
+#include "MQTTLink.h"
+#include "CommandBus.h"
+#include "Profiler.h"
+#include "LogPipeline.h"
 #include "Version.h"
 #include "Tools.h"
 
@@ -39,7 +43,7 @@ using namespace DeviceIQ_Update;
 
 extern FileSystem *devFileSystem;
 extern Clock *devClock;
-extern Log *devLog;
+extern LogPipeline *devLog;
 extern MQTT *devMQTT;
 extern Network *devNetwork;
 extern AsyncWebServer *devWebServer;
@@ -49,4 +53,7 @@ extern UpdateClient *devUpdateClient;
 extern Timer *devSaveState;
 
 extern settings_t Settings;
-extern orchestrator Orchestrator;
\ No newline at end of file
+extern orchestrator Orchestrator;
+extern mqttlink MQTTLink;
+extern commandbus CommandBus;
+extern profiler Profiler;
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef LogCodec_h
+#define LogCodec_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <memory>
+
+// LZSS container used for closed log segments:
+//   "LZS1" | uint32 original size (LE) | groups of one flag byte (MSB first, 1 = literal) and up to eight tokens.
+// A match token is two bytes: 11-bit distance - 1 and 5-bit length - 3, over a 2 KiB window.
+#define LOGCODEC_MAGIC          "LZS1"
+#define LOGCODEC_HEADERSIZE     8
+#define LOGCODEC_WINDOWBITS     11
+#define LOGCODEC_WINDOW         (1 << LOGCODEC_WINDOWBITS)
+#define LOGCODEC_MINMATCH       3
+#define LOGCODEC_MAXMATCH       (LOGCODEC_MINMATCH + 31)
+
+class LogCodec {
+    public:
+        using writer_t = std::function<bool(const uint8_t* data, size_t len)>;
+
+        // Whole-buffer encoder (segments are small and bounded); output, header included, goes through write
+        static bool Compress(const uint8_t* data, size_t len, const writer_t& write);
+
+        // Compresses a closed segment file into another file; returns the compressed size or 0 on failure
+        static size_t CompressFile(const String& from, const String& to);
+};
+
+// Streaming decoder; only the window and a small read buffer are held in RAM
+class LogDecoder {
+    private:
+        File pSource;
+        std::unique_ptr<uint8_t[]> pWindow;
+        size_t pHead = 0;
+        size_t pRemaining = 0;
+        size_t pSize = 0;
+        uint8_t pFlags = 0;
+        uint8_t pFlagBits = 0;
+        uint16_t pDistance = 0;
+        uint8_t pPending = 0;
+
+        uint8_t pBuffer[128];
+        size_t pBufferPos = 0;
+        size_t pBufferLen = 0;
+
+        int next();
+        void put(uint8_t c, uint8_t* out, size_t& n);
+    public:
+        explicit LogDecoder(File source) : pSource(source) {}
+
+        bool Begin();
+        size_t Read(uint8_t* out, size_t len);
+        size_t Skip(size_t len);
+
+        [[nodiscard]] size_t Size() const noexcept { return pSize; }
+};
+
+#endif
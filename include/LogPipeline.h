@@ -0,0 +1,173 @@
+#ifndef LogPipeline_h
+#define LogPipeline_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <DevIQ_Log.h>
+#include <DevIQ_FileSystem.h>
+#include <DevIQ_DateTime.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/ringbuf.h>
+#include <freertos/semphr.h>
+#include <atomic>
+
+#include "Stats.h"
+#include "LogStore.h"
+#include "LogTail.h"
+#include "SyslogTransport.h"
+
+using namespace DeviceIQ_FileSystem;
+using namespace DeviceIQ_Log;
+using namespace DeviceIQ_DateTime;
+
+// Endpoint bits as stored in Settings.Log.Endpoint()
+#define LOGENDPOINT_SERIAL  0x01
+#define LOGENDPOINT_SYSLOG  0x02
+#define LOGENDPOINT_FILE    0x04
+
+// Compile-time filter ranks for the LOG_x macros. A module may define LOG_MIN_RANK before its first include to
+// strip its more verbose calls entirely (e.g. -DLOG_MIN_RANK=LOGRANK_INFO removes every LOG_D in release builds).
+#define LOGRANK_ERROR       1
+#define LOGRANK_WARNING     2
+#define LOGRANK_INFO        3
+#define LOGRANK_DEBUG       4
+
+#ifndef LOG_MIN_RANK
+#define LOG_MIN_RANK        LOGRANK_DEBUG
+#endif
+
+// Arguments are only evaluated, and the message only formatted, when the level passes both filters
+#define LOG_AT(rank, level, fmt, ...) do { if ((rank) <= LOG_MIN_RANK && devLog != nullptr && devLog->Enabled(level)) devLog->Writef(level, fmt, ##__VA_ARGS__); } while (0)
+
+#define LOG_E(fmt, ...) LOG_AT(LOGRANK_ERROR, LOGLEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_W(fmt, ...) LOG_AT(LOGRANK_WARNING, LOGLEVEL_WARNING, fmt, ##__VA_ARGS__)
+#define LOG_I(fmt, ...) LOG_AT(LOGRANK_INFO, LOGLEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_D(fmt, ...) LOG_AT(LOGRANK_DEBUG, LOGLEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+// Slots for the per module/level token buckets; the least recently used one is recycled when they are all taken
+#define LOG_RATEBUCKETS     16
+
+struct log_bucket_t {
+    uint32_t Key;
+    uint32_t Tokens; // Thousandths of a message
+    uint32_t Refilled;
+    uint32_t Suppressed; // Since the last report
+    uint32_t Total;
+    uint8_t Level;
+    char Module[16];
+};
+
+// Front end for the device log: Write() only copies the message into a RAM ring and returns. A low priority task
+// drains the ring, hands page-sized batches of lines to the segmented LogStore, batches syslog records through
+// SyslogTransport, keeps the newest records in a LogTail for live followers and forwards serial output to the DevIQ Log. Before anything is queued, repeats of the previous message are collapsed into a count and each
+// module ("Module: text") and level below ERROR is held to a token bucket, so a flood can never saturate flash or syslog.
+class LogPipeline {
+    private:
+        struct record_t {
+            uint32_t Queued;
+            uint32_t Epoch;
+            uint8_t Level;
+        } __attribute__((packed));
+
+        // One per Flush() call, carried in its marker; whichever side lets go last frees it, so a caller that timed
+        // out never leaves the log task signalling freed memory
+        struct flush_waiter_t {
+            SemaphoreHandle_t Done;
+            std::atomic<uint8_t> Refs;
+        };
+
+        static void release(flush_waiter_t* waiter);
+
+        Log* pSink = nullptr;
+        String pFileName;
+        uint8_t pEndpoint = LOGENDPOINT_SERIAL | LOGENDPOINT_FILE;
+        uint8_t pLevelMask = 0xFF;
+
+        RingbufHandle_t pRing = nullptr;
+        TaskHandle_t pTask = nullptr;
+
+        LogStore pStore;
+        LogTail pTail;
+        SyslogTransport pSyslog;
+        char* pPage = nullptr;
+        size_t pPageUsed = 0;
+        uint32_t pPageOldest = 0;
+        LogStore::index_t* pPageIndex = nullptr;
+        size_t pPageLines = 0;
+        size_t pPageMaxLines = 0;
+
+        portMUX_TYPE pGuardLock = portMUX_INITIALIZER_UNLOCKED;
+        log_bucket_t pBuckets[LOG_RATEBUCKETS] = {};
+        uint32_t pLastHash = 0;
+        uint8_t pLastLevel = 0;
+        uint32_t pRepeats = 0;
+        uint32_t pRepeatSince = 0;
+        uint32_t pCollapsed = 0;
+        uint32_t pSuppressed = 0;
+
+        // Bumped by every logging task on both cores
+        std::atomic<uint32_t> pQueued{0};
+        std::atomic<uint32_t> pDropped{0};
+        uint32_t pWritten = 0;
+        uint32_t pFlushes = 0;
+        uint32_t pFlushErrors = 0;
+        uint32_t pBytesWritten = 0;
+        LatencyStats pFlushLatency;
+
+        static void task(void* arg);
+        void drain(TickType_t wait);
+        void submit(uint8_t level, const char* msg, size_t len);
+        bool admit(uint8_t level, uint32_t hash, uint32_t key, const char* module, size_t mlen, uint32_t& repeated, uint8_t& repeatedLevel, log_bucket_t& released);
+        void report();
+        void summarize(uint32_t repeated, uint8_t repeatedLevel, const log_bucket_t& released);
+        void push(uint8_t level, const char* msg, size_t len);
+        void append(const record_t& rec, const char* msg, size_t len);
+        void flush();
+    public:
+        LogPipeline(FileSystem* fs, Clock* clock);
+
+        bool Begin();
+
+        void Write(const String& message, uint8_t level);
+        void Writef(uint8_t level, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+        [[nodiscard]] bool Enabled(uint8_t level) const noexcept { return pEndpoint != 0 && (pLevelMask & (1 << level)); }
+        bool Clear();
+        bool Flush(uint32_t timeoutms = 1000);
+
+        void SerialPort(HardwareSerial* port) { pSink->SerialPort(port); }
+        void LogFileName(const String& filename) { pFileName = filename; pSink->LogFileName(filename); }
+        void Endpoint(uint8_t value);
+        void LogLevel(uint8_t value) { pLevelMask = value; pSink->LogLevel(value); }
+        void SyslogServerHost(const String& value) { pSyslog.Host(value); }
+        void SyslogServerPort(uint16_t value) { pSyslog.Port(value); }
+        void SyslogTransportMode(SyslogTransports value) { pSyslog.Mode(value); }
+        void SyslogIdentity(const String& hostname, const String& appname) { pSyslog.Identity(hostname, appname); }
+
+        [[nodiscard]] uint8_t Endpoint() const noexcept { return pEndpoint; }
+        [[nodiscard]] Log* Sink() const noexcept { return pSink; }
+        [[nodiscard]] LogStore& Store() noexcept { return pStore; }
+        [[nodiscard]] LogTail& Tail() noexcept { return pTail; }
+        [[nodiscard]] SyslogTransport& Syslog() noexcept { return pSyslog; }
+
+        [[nodiscard]] uint32_t Queued() const noexcept { return pQueued.load(std::memory_order_relaxed); }
+        [[nodiscard]] uint32_t Dropped() const noexcept { return pDropped.load(std::memory_order_relaxed); }
+        [[nodiscard]] uint32_t Written() const noexcept { return pWritten; }
+        [[nodiscard]] uint32_t Flushes() const noexcept { return pFlushes; }
+        [[nodiscard]] uint32_t FlushErrors() const noexcept { return pFlushErrors; }
+        [[nodiscard]] uint32_t BytesWritten() const noexcept { return pBytesWritten; }
+        [[nodiscard]] size_t RingFree() const noexcept { return pRing ? xRingbufferGetCurFreeSize(pRing) : 0; }
+        [[nodiscard]] const LatencyStats& FlushLatency() const noexcept { return pFlushLatency; }
+        [[nodiscard]] uint32_t Collapsed() const noexcept { return pCollapsed; }
+        [[nodiscard]] uint32_t Suppressed() const noexcept { return pSuppressed; }
+
+        // Copies the buckets that have suppressed anything since boot; returns how many were copied
+        size_t SuppressedBy(log_bucket_t* out, size_t max);
+
+        static char LevelChar(uint8_t level);
+};
+
+extern LogPipeline *devLog;
+
+#endif
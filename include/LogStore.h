@@ -0,0 +1,120 @@
+#ifndef LogStore_h
+#define LogStore_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <functional>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include "LogCodec.h"
+
+// Segmented on-flash log. Lines are appended to numbered segment files (<dir>/<seq>.log) of bounded size, and each
+// segment has a sidecar (<seq>.idx) with one fixed-size entry per line, so tail, level and time queries read the
+// index instead of scanning text. Closed segments are compacted to LZSS (<seq>.lz) in the background; index offsets
+// always refer to the uncompressed text. The oldest segments are pruned to stay within MaxSegments/MaxStoreSize.
+class LogStore {
+    public:
+        struct index_t {
+            uint32_t Epoch;
+            uint16_t Offset;
+            uint16_t Length; // Without the trailing newline
+            char Level;
+        } __attribute__((packed));
+
+        struct segment_t {
+            uint32_t Sequence;
+            size_t Size; // Stored bytes
+            bool Compressed;
+        };
+
+        // Sequential reader over the segments present when it was created, oldest first. Plain readers return the
+        // log text; packed readers return one LZSS container per segment, compressing uncompacted ones on the fly.
+        // While a reader exists its segments are neither compacted nor pruned.
+        class Reader {
+            private:
+                LogStore& pStore;
+                std::vector<segment_t> pSegments;
+                bool pPacked;
+                size_t pCurrent = 0;
+                size_t pOffset = 0;
+                File pFile;
+                std::unique_ptr<LogDecoder> pDecoder;
+                std::vector<uint8_t> pPackedData;
+
+                bool open();
+                void close();
+            public:
+                Reader(LogStore& store, bool packed = false);
+                ~Reader();
+
+                size_t Read(uint8_t* buffer, size_t len);
+                void Rewind();
+
+                [[nodiscard]] size_t Segments() const noexcept { return pSegments.size(); }
+        };
+
+        using line_callback_t = std::function<void(const String& line)>;
+
+        bool Begin(const String& directory, const String& legacy);
+
+        // Appends one page of complete lines; index offsets are relative to data and are rebased in place
+        bool Append(const char* data, size_t len, index_t* index, size_t count);
+        bool Clear();
+
+        // Compresses the oldest closed, uncompacted segment; run from the log task when it is otherwise idle
+        bool Compact();
+        [[nodiscard]] bool Pending() const noexcept { return pCompactNext < pLast && pPinned.load() == 0; }
+
+        // Both pin the segments they list and read them outside the lock, so appends carry on meanwhile
+        size_t Tail(size_t n, char level, const line_callback_t& each);
+        size_t Range(uint32_t from, uint32_t to, char level, size_t limit, const line_callback_t& each);
+        std::vector<segment_t> Snapshot();
+
+        String Path(uint32_t sequence, const char* extension) const;
+
+        [[nodiscard]] uint32_t Segments() const noexcept { return pLast == 0 ? 0 : pLast - pFirst + 1; }
+        [[nodiscard]] uint32_t First() const noexcept { return pFirst; }
+        [[nodiscard]] uint32_t Last() const noexcept { return pLast; }
+        [[nodiscard]] size_t Bytes() const noexcept { return pBytes; } // Text, containers and indexes
+        [[nodiscard]] uint32_t Rolls() const noexcept { return pRolls; }
+        [[nodiscard]] uint32_t Pruned() const noexcept { return pPruned; }
+        [[nodiscard]] uint32_t Compressed() const noexcept { return pCompressed; }
+        [[nodiscard]] uint32_t Compactions() const noexcept { return pCompactions; }
+        [[nodiscard]] size_t Saved() const noexcept { return pSaved; }
+    private:
+        struct hit_t {
+            uint32_t Sequence;
+            index_t Index;
+        };
+
+        String pDirectory;
+        SemaphoreHandle_t pLock = nullptr;
+
+        uint32_t pFirst = 0;
+        uint32_t pLast = 0;
+        size_t pActiveSize = 0;
+        size_t pBytes = 0;
+        uint32_t pRolls = 0;
+        uint32_t pPruned = 0;
+
+        uint32_t pCompactNext = 0;
+        uint32_t pCompressed = 0;
+        uint32_t pCompactions = 0;
+        size_t pSaved = 0;
+        std::atomic<uint32_t> pPinned{0};
+
+        size_t storedSize(uint32_t sequence, bool& compressed) const;
+        size_t indexSize(uint32_t sequence) const;
+        void roll();
+        void prune();
+        bool readIndex(uint32_t sequence, std::vector<index_t>& index) const;
+        void emit(const std::vector<hit_t>& hits, const line_callback_t& each) const;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef LogTail_h
+#define LogTail_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Longest message text kept per record; anything longer is cut
+#define LOGTAIL_MAXMESSAGE  256
+
+// In-RAM ring of the most recent log records, fed by the log task and read by any number of followers. Records are
+// variable length and numbered; every reader keeps its own cursor, so a slow reader never holds up the writer or the
+// other readers: once the writer laps it, the records it missed are counted and it resumes at the oldest one left.
+class LogTail {
+    public:
+        struct cursor_t {
+            uint32_t Sequence;
+            size_t Offset;
+        };
+
+        struct record_t {
+            uint32_t Sequence;
+            uint32_t Epoch;
+            uint8_t Level;
+            size_t Length;
+            char Message[LOGTAIL_MAXMESSAGE + 1];
+        };
+    private:
+        struct header_t {
+            uint32_t Sequence;
+            uint32_t Epoch;
+            uint16_t Length;
+            uint8_t Level;
+        } __attribute__((packed));
+
+        SemaphoreHandle_t pLock = nullptr;
+        uint8_t* pBuffer = nullptr;
+        size_t pSize = 0;
+        size_t pHead = 0; // Offset of the oldest record
+        size_t pUsed = 0;
+        uint32_t pFirst = 0; // Sequence of the oldest record
+        uint32_t pNext = 0;
+        uint32_t pEvicted = 0;
+
+        void copyIn(size_t offset, const void* data, size_t len);
+        void copyOut(size_t offset, void* data, size_t len) const;
+        void evict();
+    public:
+        bool Begin(size_t size);
+
+        // Log task only
+        void Append(uint32_t epoch, uint8_t level, const char* msg, size_t len);
+
+        // A cursor positioned so the next reads return at most the newest backlog records
+        cursor_t Start(size_t backlog);
+
+        // Copies the record at the cursor and advances it. skipped is set to the number of records that were
+        // overwritten before this reader got to them. Returns false once the reader has caught up.
+        bool Read(cursor_t& cursor, record_t& out, uint32_t& skipped);
+
+        [[nodiscard]] uint32_t Records() const noexcept { return pNext - pFirst; }
+        [[nodiscard]] size_t Used() const noexcept { return pUsed; }
+        [[nodiscard]] size_t Size() const noexcept { return pSize; }
+        [[nodiscard]] uint32_t Evicted() const noexcept { return pEvicted; }
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef MQTTLink_h
+#define MQTTLink_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <DevIQ_MQTT.h>
+#include <atomic>
+
+#include "MQTTTopics.h"
+#include "Stats.h"
+
+using namespace DeviceIQ_MQTT;
+
+enum MQTTLinkState { MQTTLINK_IDLE, MQTTLINK_WAITING, MQTTLINK_CONNECTING, MQTTLINK_CONNECTED };
+enum MQTTBenchState { MQTTBENCH_IDLE, MQTTBENCH_REQUESTED, MQTTBENCH_RUNNING, MQTTBENCH_DONE };
+
+class mqttlink {
+    private:
+        MQTTLinkState pState = MQTTLINK_IDLE;
+        uint32_t pBackoffMs = 0;
+        uint32_t pNextAttempt = 0;
+        uint32_t pConnectedSince = 0;
+        bool pAliasesActive = false;
+
+        // Set by the connect task, observed by Control(); the client is not touched by loop() while it runs
+        std::atomic<bool> pConnectRunning{false};
+        std::atomic<bool> pConnectResult{false};
+
+        uint32_t pConnects = 0;
+        uint32_t pConnectFailures = 0;
+        uint32_t pDisconnects = 0;
+        uint32_t pPublishes = 0;
+        uint32_t pPublishFailures = 0;
+        uint32_t pPublishedBytes = 0;
+        uint32_t pAliasSavedBytes = 0;
+        uint32_t pReceived = 0;
+        uint32_t pStatsSince = 0;
+
+        LatencyStats pPublishLatency;
+        LatencyStats pSetLatency;
+
+        // Requested from any task, run by Control() a slice per pass; results are only read once it is done
+        std::atomic<MQTTBenchState> pBench{MQTTBENCH_IDLE};
+        uint16_t pBenchCount = 0;
+        uint16_t pBenchSize = 0;
+        uint16_t pBenchSent = 0;
+        uint32_t pBenchStart = 0;
+        uint32_t pBenchElapsed = 0;
+        String pBenchPayload;
+        LatencyStats pBenchLatency;
+
+        mqtttopics pTopics;
+
+        void attempt();
+        void connected();
+        void scheduleRetry();
+        static void connectTask(void* arg);
+        void announceAliases();
+        void benchmark();
+    public:
+        void Begin();
+        void End();
+        void Control();
+
+        bool Publish(const String& topic, const String& payload, bool retained = false);
+        bool Publish(uint16_t alias, const String& payload);
+        bool PublishNumber(uint16_t alias, float value);
+
+        uint16_t RegisterTopic(const String& topic);
+        void ClearTopics();
+        [[nodiscard]] size_t TopicCount() const noexcept { return pTopics.Count(); }
+
+        [[nodiscard]] MQTTLinkState State() const noexcept { return pState; }
+        [[nodiscard]] bool Connected() const noexcept { return pState == MQTTLINK_CONNECTED; }
+        [[nodiscard]] uint32_t ConnectedSince() const noexcept { return pConnectedSince; }
+        [[nodiscard]] uint32_t RetryIn() const noexcept;
+
+        [[nodiscard]] uint32_t Connects() const noexcept { return pConnects; }
+        [[nodiscard]] uint32_t ConnectFailures() const noexcept { return pConnectFailures; }
+        [[nodiscard]] uint32_t Disconnects() const noexcept { return pDisconnects; }
+        [[nodiscard]] uint32_t Publishes() const noexcept { return pPublishes; }
+        [[nodiscard]] uint32_t PublishFailures() const noexcept { return pPublishFailures; }
+        [[nodiscard]] uint32_t PublishedBytes() const noexcept { return pPublishedBytes; }
+        [[nodiscard]] uint32_t AliasSavedBytes() const noexcept { return pAliasSavedBytes; }
+        [[nodiscard]] uint32_t Received() const noexcept { return pReceived; }
+        [[nodiscard]] uint32_t StatsSince() const noexcept { return pStatsSince; }
+
+        [[nodiscard]] const LatencyStats& PublishLatency() const noexcept { return pPublishLatency; }
+        [[nodiscard]] LatencyStats& SetLatency() noexcept { return pSetLatency; }
+        void NoteReceived() noexcept { pReceived++; }
+        void ResetStats() noexcept;
+
+        // Any task. False while another run is in progress
+        bool StartBenchmark(uint16_t count, uint16_t size);
+        [[nodiscard]] bool BenchmarkDone() const noexcept { return pBench.load(std::memory_order_acquire) == MQTTBENCH_DONE; }
+        [[nodiscard]] uint32_t BenchmarkElapsed() const noexcept { return pBenchElapsed; }
+        [[nodiscard]] uint16_t BenchmarkSize() const noexcept { return pBenchSize; }
+        [[nodiscard]] const LatencyStats& BenchmarkLatency() const noexcept { return pBenchLatency; }
+
+        static const char* StateToString(MQTTLinkState state);
+};
+
+extern mqttlink MQTTLink;
+
+#endif
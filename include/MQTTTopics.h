@@ -0,0 +1,40 @@
+#ifndef MQTTTopics_h
+#define MQTTTopics_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+// The parts of the MQTT link that only shape topics and payloads. Nothing here touches the client, the settings or
+// the RTOS, so the same code also builds under [env:native] for the host benchmark.
+
+// <hostname>/Set/<Class>:<Name>:<Property>, trimmed; Property and Payload are lower case
+struct mqtt_set_t {
+    String Class;
+    String Name;
+    String Property;
+    String Payload;
+};
+
+class mqtttopics {
+    private:
+        std::vector<String> pTopics;
+        std::vector<String> pAliasTopics;
+    public:
+        // Returns the topic's 1-based alias; a topic registered twice keeps its first alias
+        uint16_t Register(const String& topic, const String& hostname);
+        void Clear();
+
+        [[nodiscard]] size_t Count() const noexcept { return pTopics.size(); }
+        [[nodiscard]] bool Valid(uint16_t alias) const noexcept { return alias != 0 && alias <= pTopics.size(); }
+
+        // Valid() aliases only
+        [[nodiscard]] const String& Topic(uint16_t alias) const noexcept { return pTopics[alias - 1]; }
+        [[nodiscard]] const String& AliasTopic(uint16_t alias) const noexcept { return pAliasTopics[alias - 1]; }
+
+        static bool ParseSet(const String& topic, const String& prefix, const String& payload, mqtt_set_t& set);
+        static String CompactNumber(float value);
+};
+
+#endif
@@ -13,8 +13,16 @@
 #include <WiFiUdp.h>
 #include <AsyncUDP.h>
 #include <WiFiClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <functional>
+#include <deque>
+#include <vector>
 
 #include "Settings.h"
+#include "OrchestratorLink.h"
 
 using namespace DeviceIQ_Log;
 using namespace DeviceIQ_DateTime;
@@ -25,13 +33,56 @@ enum DiscoveryMode { DISCOVERY_NONE, DISCOVERY_ALL, DISCOVERY_UNMANAGED, DISCOVE
 
 class orchestrator {
     private:
+        // One outstanding UDP request; resent with a doubling interval until answered or out of attempts
+        struct request_t {
+            uint32_t ID;
+            IPAddress Target;
+            uint16_t Port;
+            String Payload;
+            uint8_t Attempts;
+            uint32_t NextSend;
+            uint32_t Interval;
+            orchestrator_reply_t Callback;
+        };
+
+        struct reply_t {
+            IPAddress From;
+            String Payload;
+        };
+
         void handleUdpPacket(AsyncUDPPacket& packet);
+        void handleReply(const reply_t& reply);
+        void dispatch(const JsonObjectConst& doc);
+        void queueCommand(const JsonObjectConst& doc);
+        static void worker(void* arg);
+        bool sendReply(const JsonDocument& reply);
+        bool applyDiscovery(const JsonObjectConst& reply);
         bool connectAndExchangeJson(IPAddress remoteIp, uint16_t port, std::function<void(WiFiClient&)> exchange);
         bool isManaged(const JsonObjectConst &cmd);
 
         AsyncUDP udp;
+        uint32_t pReceived = 0;
+
+        // Requests live on the loop task; replies arrive on the UDP task and wait in the inbox for Control()
+        AsyncUDP pRequestUdp;
+        std::vector<request_t> pRequests;
+        uint32_t pNextID = 1;
+        uint32_t pDiscoveryID = 0;
+        std::deque<reply_t> pInbox;
+        SemaphoreHandle_t pInboxLock = nullptr;
+        uint32_t pTimeouts = 0;
+        uint32_t pUnmatched = 0;
+
+        // Persistent framed session; replies fall back to a connection each while it is down
+        OrchestratorLink pLink;
+
+        // Commands pushed over the session arrive on the loop task and are handed to the worker as serialized JSON
+        QueueHandle_t pCommands = nullptr;
+        TaskHandle_t pWorker = nullptr;
+        uint32_t pCommandsDropped = 0;
     public:
         void Begin();
+        void Control();
 
         bool ClearLog(const JsonVariantConst& cmd);
         bool Discover(const JsonVariantConst& cmd);
@@ -45,9 +96,20 @@ class orchestrator {
         bool Restore(const JsonVariantConst& cmd);
         bool Update(const JsonVariantConst& cmd);
         
-        const JsonObjectConst SendUDP(const String &target, const uint16_t port, const JsonObjectConst &payload);
+        // Loop task only. Never blocks: returns the request ID (0 if it could not be queued); the callback gets the outcome
+        uint32_t SendRequest(const String& target, uint16_t port, const JsonObjectConst& payload, orchestrator_reply_t callback);
+        void CancelRequest(uint32_t id);
 
+        // Starts a broadcast discovery unless one is already running; the result is applied from Control()
         bool FindOrchestratorServer();
+
+        [[nodiscard]] uint32_t Received() const noexcept { return pReceived; }
+        [[nodiscard]] size_t Pending() const noexcept { return pRequests.size(); }
+        [[nodiscard]] bool Discovering() const noexcept { return pDiscoveryID != 0; }
+        [[nodiscard]] uint32_t Timeouts() const noexcept { return pTimeouts; }
+        [[nodiscard]] uint32_t Unmatched() const noexcept { return pUnmatched; }
+        [[nodiscard]] uint32_t CommandsDropped() const noexcept { return pCommandsDropped; }
+        [[nodiscard]] OrchestratorLink& Link() noexcept { return pLink; }
 };
 
 extern orchestrator Orchestrator;
@@ -0,0 +1,100 @@
+#ifndef OrchestratorLink_h
+#define OrchestratorLink_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <AsyncTCP.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Called on the loop task with the reply, or with ok == false on timeout or when the link went down
+typedef std::function<void(bool ok, const JsonObjectConst& reply, const IPAddress& from)> orchestrator_reply_t;
+typedef std::function<void(const JsonObjectConst& cmd)> orchestrator_command_t;
+typedef std::function<void(JsonDocument& hello)> orchestrator_hello_t;
+
+enum OrchestratorLinkState { ORCHLINK_IDLE, ORCHLINK_WAITING, ORCHLINK_CONNECTING, ORCHLINK_HANDSHAKE, ORCHLINK_UP };
+
+// Long-lived TCP session to the Orchestrator server. Every message is one JSON object behind a 4 byte big-endian
+// length. Requests carry a "Request ID" that the server echoes in its reply, so any number can be outstanding; frames
+// that answer nothing but carry a "Command" are server pushes. Idle sessions exchange Ping frames, a silent one is
+// dropped and reconnected with backoff. Socket callbacks only move bytes; frames are parsed and delivered by Control().
+class OrchestratorLink {
+    private:
+        struct pending_t {
+            uint32_t ID;
+            uint32_t Deadline;
+            orchestrator_reply_t Callback;
+        };
+
+        // Written by the loop task, read by any task that sends
+        std::atomic<OrchestratorLinkState> pState{ORCHLINK_IDLE};
+
+        // Guarded by pLock. A dropped client is only forgotten here; it closes itself from its own poll callback and is
+        // deleted in its disconnect callback, both on the AsyncTCP task, so it is never freed under a running callback
+        AsyncClient* pClient = nullptr;
+        SemaphoreHandle_t pLock = nullptr;
+        std::atomic<bool> pConnected{false};
+        std::atomic<bool> pDropped{false};
+
+        IPAddress pHost;
+        uint16_t pPort = 0;
+        uint32_t pBackoffMs = 0;
+        uint32_t pNextAttempt = 0;
+        uint32_t pStateSince = 0;
+        uint32_t pLastRx = 0;
+        uint32_t pLastTx = 0;
+
+        // Guarded by pLock: written by the AsyncTCP task, drained by Control()
+        std::string pRx;
+        std::deque<String> pInbox;
+        std::deque<std::string> pTx;
+        size_t pTxHead = 0;
+
+        std::vector<pending_t> pPending;
+        uint32_t pNextID = 1;
+        orchestrator_command_t pOnCommand = nullptr;
+        orchestrator_hello_t pHello = nullptr;
+
+        uint32_t pConnects = 0;
+        uint32_t pFailures = 0;
+        uint32_t pFramesIn = 0;
+        uint32_t pFramesOut = 0;
+        uint32_t pOverflows = 0;
+
+        void connect();
+        void drop(const char* reason);
+        void receive(AsyncClient* client, const uint8_t* data, size_t len);
+        void deliver(const String& frame);
+        void pump();
+        bool enqueue(const JsonDocument& doc);
+    public:
+        void Begin(orchestrator_command_t onCommand, orchestrator_hello_t hello);
+        void Target(const IPAddress& host, uint16_t port);
+        void Control();
+
+        // Any task. Queue a frame; false when the session is not up
+        bool Send(const JsonDocument& doc);
+
+        // Loop task only. Returns the request ID, 0 when the session is not up
+        uint32_t Request(JsonDocument& doc, orchestrator_reply_t callback, uint32_t timeoutms);
+
+        // Waits until everything queued was handed to the socket, e.g. before a restart
+        bool Flush(uint32_t timeoutms);
+
+        [[nodiscard]] bool Up() const noexcept { return pState == ORCHLINK_UP; }
+        [[nodiscard]] OrchestratorLinkState State() const noexcept { return pState.load(); }
+        [[nodiscard]] uint32_t Connects() const noexcept { return pConnects; }
+        [[nodiscard]] uint32_t Failures() const noexcept { return pFailures; }
+        [[nodiscard]] uint32_t FramesIn() const noexcept { return pFramesIn; }
+        [[nodiscard]] uint32_t FramesOut() const noexcept { return pFramesOut; }
+        [[nodiscard]] uint32_t Overflows() const noexcept { return pOverflows; }
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef Profiler_h
+#define Profiler_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include "Stats.h"
+
+// Tasks tracked between two samples; any beyond this are still listed, without a CPU share
+#define PROFILER_MAXTASKS   24
+
+enum ProfileStages : uint8_t { PROFILESTAGE_CLOCK, PROFILESTAGE_NETWORK, PROFILESTAGE_MQTT, PROFILESTAGE_COMMANDS, PROFILESTAGE_COMPONENTS, PROFILESTAGE_WEBAPI, PROFILESTAGE_LOOP, PROFILESTAGE_COUNT };
+
+enum ProfileInterfaces : uint8_t { PROFILEIF_WEB, PROFILEIF_MQTT, PROFILEIF_TELNET, PROFILEIF_ORCHESTRATOR, PROFILEIF_LOG, PROFILEIF_COUNT };
+
+// Per second over the last window
+struct profile_rate_t {
+    uint32_t In;        // Requests, packets or lines received
+    uint32_t Out;       // Events, publishes or lines sent
+    uint32_t Commands;  // Component commands submitted to the command bus
+};
+
+struct profile_task_t {
+    char Name[configMAX_TASK_NAME_LEN];
+    uint32_t StackFree;     // Bytes never touched since the task started
+    uint16_t Share;         // Permille of both cores since the previous sample, PROFILE_NOSHARE when unknown
+    uint8_t Priority;
+    char State;
+};
+
+#define PROFILE_NOSHARE     UINT16_MAX
+
+// Where loop() spends its time and how busy the interfaces are. loop() feeds one LatencyStats per stage and closes a
+// window every Defaults.Perf.WindowMs; readers on other tasks only ever see the last closed window, copied under a
+// spinlock. Task CPU shares are sampled on demand, so nothing is paid for them unless someone is looking.
+class profiler {
+    private:
+        portMUX_TYPE pLock = portMUX_INITIALIZER_UNLOCKED;
+        SemaphoreHandle_t pTaskLock = nullptr;
+
+        LatencyStats pCurrent[PROFILESTAGE_COUNT];
+        LatencyStats pLast[PROFILESTAGE_COUNT];
+        uint32_t pWindowStart = 0;
+        uint32_t pWindowMs = 0;
+
+        uint32_t pCounters[PROFILEIF_COUNT][3] = {};
+        profile_rate_t pRates[PROFILEIF_COUNT] = {};
+
+        struct runtime_t {
+            uint32_t Number;
+            uint32_t RunTime;
+        };
+
+        runtime_t pRunTimes[PROFILER_MAXTASKS] = {};
+        size_t pRunTimeCount = 0;
+
+        void sample(uint32_t counters[PROFILEIF_COUNT][3]);
+        void close(uint32_t now);
+    public:
+        void Begin();
+
+        // loop() only
+        [[nodiscard]] LatencyStats& Stage(ProfileStages stage) noexcept { return pCurrent[stage]; }
+        void Tick(uint32_t loopus);
+
+        // Any task
+        void Stages(LatencyStats* out);
+        void Rates(profile_rate_t* out);
+        size_t Tasks(profile_task_t* out, size_t max);
+
+        [[nodiscard]] uint32_t WindowMs() const noexcept { return pWindowMs; }
+
+        static const char* StageName(ProfileStages stage);
+        static const char* InterfaceName(ProfileInterfaces iface);
+};
+
+extern profiler Profiler;
+
+#endif
@@ -16,13 +16,15 @@
 #include <mbedtls/entropy.h>
 #include <mbedtls/ctr_drbg.h>
 
+#include "LogPipeline.h"
+
 using namespace DeviceIQ_FileSystem;
 using namespace DeviceIQ_Log;
 using namespace DeviceIQ_MQTT;
 using namespace DeviceIQ_Components;
 
 extern FileSystem *devFileSystem;
-extern Log *devLog;
+extern LogPipeline *devLog;
 extern MQTT *devMQTT;
 
 #include "Defaults.h"
@@ -88,6 +90,7 @@ class settings_t {
                 uint8_t pLogLevel;
                 String pSyslogServerHost;
                 uint16_t pSyslogServerPort;
+                SyslogTransports pSyslogTransport;
             public:
                 [[nodiscard]] uint8_t Endpoint() const noexcept { return pEndpoint; }
                 void Endpoint(uint8_t value) noexcept { pEndpoint = value; }
@@ -100,6 +103,10 @@ class settings_t {
                 
                 [[nodiscard]] uint16_t SyslogServerPort() const noexcept { return pSyslogServerPort; }
                 void SyslogServerPort(uint16_t value) { pSyslogServerPort = (value == 0) ? 514 : value; }
+
+                [[nodiscard]] SyslogTransports SyslogTransport() const noexcept { return pSyslogTransport; }
+                void SyslogTransport(SyslogTransports value) noexcept { pSyslogTransport = value; }
+                void SyslogTransport(const String& value) noexcept { pSyslogTransport = value.equalsIgnoreCase("TCP") ? SYSLOG_TCP : SYSLOG_UDP; }
         } Log;
         class network_t {
             private:
@@ -255,6 +262,8 @@ class settings_t {
                 uint16_t pPort{};
                 String pUser;
                 String pPassword;
+                bool pTopicAliases{};
+                bool pCompactPayload{};
             public:
                 [[nodiscard]] bool Enabled() const noexcept { return pEnabled; }
                 void Enabled(bool value) noexcept { pEnabled = value; }
@@ -270,6 +279,12 @@ class settings_t {
 
                 [[nodiscard]] const String& Password() const noexcept { return pPassword; }
                 void Password(String value) noexcept;
+
+                [[nodiscard]] bool TopicAliases() const noexcept { return pTopicAliases; }
+                void TopicAliases(bool value) noexcept { pTopicAliases = value; }
+
+                [[nodiscard]] bool CompactPayload() const noexcept { return pCompactPayload; }
+                void CompactPayload(bool value) noexcept { pCompactPayload = value; }
         } MQTT;
 
         [[nodiscard]] bool FirstRun() const noexcept { return pFirstRun; }
@@ -0,0 +1,69 @@
+#ifndef Stats_h
+#define Stats_h
+
+#pragma once
+
+#include <Arduino.h>
+
+// Fixed-size latency histogram: one bucket per power of two microseconds, no allocation, safe to
+// feed from any hot path. Percentiles report the upper bound of the bucket they fall in.
+class LatencyStats {
+    private:
+        static constexpr uint8_t Buckets = 32;
+
+        uint32_t pBucket[Buckets] = {};
+        uint32_t pCount = 0;
+        uint32_t pMin = UINT32_MAX;
+        uint32_t pMax = 0;
+        uint64_t pSum = 0;
+    public:
+        void Add(uint32_t us) noexcept {
+            uint8_t b = (us == 0) ? 0 : (uint8_t)(32 - __builtin_clz(us));
+            if (b >= Buckets) b = Buckets - 1;
+
+            pBucket[b]++;
+            pCount++;
+            pSum += us;
+            if (us < pMin) pMin = us;
+            if (us > pMax) pMax = us;
+        }
+
+        void Reset() noexcept { *this = LatencyStats(); }
+
+        [[nodiscard]] uint32_t Count() const noexcept { return pCount; }
+        [[nodiscard]] uint32_t Min() const noexcept { return pCount ? pMin : 0; }
+        [[nodiscard]] uint32_t Max() const noexcept { return pMax; }
+        [[nodiscard]] uint32_t Avg() const noexcept { return pCount ? (uint32_t)(pSum / pCount) : 0; }
+
+        [[nodiscard]] uint32_t Percentile(uint8_t p) const noexcept {
+            if (pCount == 0) return 0;
+
+            uint32_t rank = (uint32_t)(((uint64_t)pCount * p + 99) / 100);
+            uint32_t seen = 0;
+
+            for (uint8_t b = 0; b < Buckets; b++) {
+                seen += pBucket[b];
+                if (seen >= rank) return min<uint32_t>((b == 0) ? 0 : (uint32_t)((1ULL << b) - 1), pMax);
+            }
+            return pMax;
+        }
+
+        [[nodiscard]] String ToString() const {
+            return "n=" + String(pCount) + " min=" + String(Min()) + " avg=" + String(Avg()) + " p50=" + String(Percentile(50)) + " p99=" + String(Percentile(99)) + " max=" + String(Max()) + " us";
+        }
+};
+
+// Records the lifetime of the enclosing scope into a LatencyStats
+class ScopedLatency {
+    private:
+        LatencyStats& pStats;
+        uint32_t pStart;
+    public:
+        explicit ScopedLatency(LatencyStats& stats) noexcept : pStats(stats), pStart(micros()) {}
+        ~ScopedLatency() { pStats.Add(micros() - pStart); }
+
+        ScopedLatency(const ScopedLatency&) = delete;
+        ScopedLatency& operator=(const ScopedLatency&) = delete;
+};
+
+#endif
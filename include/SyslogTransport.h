@@ -0,0 +1,85 @@
+#ifndef SyslogTransport_h
+#define SyslogTransport_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <WiFiClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <deque>
+
+enum SyslogTransports { SYSLOG_UDP, SYSLOG_TCP };
+
+// Syslog sender driven by the log task. Records are formatted as RFC 5424 and kept in a bounded backlog that drops
+// its oldest entries first. Over UDP every record is its own datagram (RFC 5426); over TCP each pass packs as many
+// records as fit into one write on a persistent stream with RFC 6587 octet-counting framing. Failed sends are retried
+// with backoff.
+class SyslogTransport {
+    private:
+        SemaphoreHandle_t pLock = nullptr;
+        bool pChanged = true;
+
+        String pHost;
+        uint16_t pPort = 514;
+        SyslogTransports pMode = SYSLOG_UDP;
+        String pHostname = "-";
+        String pAppName = "-";
+
+        // Copies used by the log task; only refreshed from the fields above when pChanged is set
+        String pActiveHost;
+        uint16_t pActivePort = 514;
+        SyslogTransports pActiveMode = SYSLOG_UDP;
+
+        IPAddress pAddress;
+        bool pResolved = false;
+        WiFiUDP pUdp;
+        WiFiClient pClient;
+
+        std::deque<String> pBacklog;
+        size_t pBacklogBytes = 0;
+
+        uint32_t pBackoffMs = 0;
+        uint32_t pNextAttempt = 0;
+
+        uint32_t pQueued = 0;
+        uint32_t pSent = 0;
+        uint32_t pDropped = 0;
+        uint32_t pBatches = 0;
+        uint32_t pErrors = 0;
+        uint32_t pConnects = 0;
+
+        void apply();
+        bool resolve();
+        void fail();
+        size_t batch(String& out);
+        void commit(size_t count);
+        void sendUdp();
+        void sendTcp();
+    public:
+        void Begin();
+
+        void Host(const String& value);
+        void Port(uint16_t value);
+        void Mode(SyslogTransports value);
+        void Identity(const String& hostname, const String& appname);
+
+        void Enqueue(uint32_t epoch, uint8_t level, const char* msg, size_t len);
+        void Pump();
+
+        [[nodiscard]] SyslogTransports Mode() const noexcept { return pMode; }
+        [[nodiscard]] bool Connected() noexcept { return pActiveMode == SYSLOG_TCP && pClient.connected(); }
+        [[nodiscard]] uint32_t Queued() const noexcept { return pQueued; }
+        [[nodiscard]] size_t BacklogBytes() const noexcept { return pBacklogBytes; }
+        [[nodiscard]] uint32_t Sent() const noexcept { return pSent; }
+        [[nodiscard]] uint32_t Dropped() const noexcept { return pDropped; }
+        [[nodiscard]] uint32_t Batches() const noexcept { return pBatches; }
+        [[nodiscard]] uint32_t Errors() const noexcept { return pErrors; }
+        [[nodiscard]] uint32_t Connects() const noexcept { return pConnects; }
+
+        static const char* ModeName(SyslogTransports mode) { return mode == SYSLOG_TCP ? "TCP" : "UDP"; }
+};
+
+#endif
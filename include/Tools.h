@@ -11,7 +11,10 @@
 #include <DevIQ_FileSystem.h>
 #include <DevIQ_Log.h>
 #include <vector>
+#include <map>
+#include <functional>
 
+#include "FileFrames.h"
 #include "Settings.h"
 
 using namespace DeviceIQ_Log;
@@ -43,38 +46,19 @@ String LimitString(String text, uint16_t sz, bool fill);
 
 bool hasValidHeaderToken(AsyncWebServerRequest *request, String api_token);
 
-template<typename TComponent, typename FillFunc>
-void registerEndpoint(AsyncWebServer* server, TComponent component, const char* className, FillFunc fillJson, String token, Log* devLog) {
-    server->on(String("/" + component->Name()).c_str(), HTTP_GET, [=](AsyncWebServerRequest *request) {
-        JsonDocument reply;
-        String json;
-
-        if (hasValidHeaderToken(request, token)) {
-            reply["Class"] = className;
-            reply["Name"] = component->Name();
-            fillJson(reply, component);
-            serializeJson(reply, json);
-
-            request->send(200, "application/json", json.c_str());
-            devLog->Write("Granted HTTP request from " + request->client()->remoteIP().toString() + " to /" + component->Name(), LOGLEVEL_INFO);
-        } else {
-            reply["Error"] = "Unauthorized";
-            serializeJson(reply, json);
-
-            request->send(401, "application/json", json.c_str());
-            devLog->Write("Unauthorized HTTP request from " + request->client()->remoteIP().toString() + " to /" + component->Name(), LOGLEVEL_WARNING);
-        }
-    });
-}
-
-bool StreamFileAsBase64Json(String fileName, String macAddress, String command, WiFiClient &client, File &f, size_t fileSize, uint32_t crc32);
-uint32_t CRC32_Update(uint32_t crc, const uint8_t* data, size_t len);
+// One JSON object with the data base64-encoded. "Size" and "Checksum" follow "Data" so both are taken on the same
+// pass; they used to come before "Encoding", so an Orchestrator that reads them before it reaches "Data" must change.
+bool StreamFileAsBase64Json(String fileName, String macAddress, String command, WiFiClient &client, File &f, size_t& fileSize, uint32_t& crc32);
+bool StreamFileAsBase64Json(String fileName, String macAddress, String command, WiFiClient &client, const std::function<size_t(uint8_t*, size_t)>& read, size_t& fileSize, uint32_t& crc32, const char* encoding = "base64");
+// FileFrames stream with the device's header; single pass
+bool StreamFileAsBinaryFrames(String fileName, String macAddress, String command, WiFiClient &client, const std::function<size_t(uint8_t*, size_t)>& read, size_t& fileSize, uint32_t& crc32, const char* encoding = "binary");
 uint32_t CRC32_File(File& f);
 
 void Web_Content(String content, String mimetype, AsyncWebServerRequest *request, bool requires_authentication, bool static_content = false);
+size_t Web_LoadAssetManifest(const String& manifestfilename = Defaults.AssetManifestFileName);
 String urlEncode(const String &str);
 
-inline void DeviceRestart() { esp_sleep_enable_timer_wakeup(200 * 1000); esp_deep_sleep_start(); }
+inline void DeviceRestart() { if (devLog) devLog->Flush(); esp_sleep_enable_timer_wakeup(200 * 1000); esp_deep_sleep_start(); }
 
 inline String ClassToString(Classes value) {for (const auto& m : AvailableComponentClasses) { if (m.second == value) return m.first; } return ""; }
 inline String BusToString(Buses value) {for (const auto& m : AvailableComponentBuses) { if (m.second == value) return m.first; } return ""; }
@@ -0,0 +1,56 @@
+#ifndef WebTemplate_h
+#define WebTemplate_h
+
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <memory>
+#include <vector>
+#include <map>
+
+enum TemplateVariables { TEMPLATEVAR_UNKNOWN, TEMPLATEVAR_VERSION, TEMPLATEVAR_PRODUCTFAMILY, TEMPLATEVAR_PRODUCTNAME, TEMPLATEVAR_HOSTNAME, TEMPLATEVAR_MACADDRESS, TEMPLATEVAR_COUNT };
+
+// A %VAR% page parsed once into literal chunks and variable slots. The rendered page is kept in RAM
+// and only rebuilt when one of the values it binds changes.
+class WebTemplate {
+    private:
+        struct chunk_t {
+            uint16_t Offset;
+            uint16_t Length;
+            TemplateVariables Variable;
+        };
+
+        String pFileName;
+        String pSource;
+        std::vector<chunk_t> pChunks;
+        uint8_t pUsed = 0;
+
+        std::shared_ptr<String> pRendered;
+        uint32_t pBindings = 0;
+
+        uint32_t pRenders = 0;
+        uint32_t pHits = 0;
+
+        static std::map<String, WebTemplate*> pTemplates;
+
+        bool parse();
+        static TemplateVariables lookup(const char* name, size_t len);
+        static String resolve(TemplateVariables var);
+    public:
+        explicit WebTemplate(const String& filename) : pFileName(filename) {}
+
+        bool Load();
+        std::shared_ptr<String> Render();
+        bool Send(AsyncWebServerRequest* request, const String& mimetype);
+
+        [[nodiscard]] const String& FileName() const noexcept { return pFileName; }
+        [[nodiscard]] size_t Chunks() const noexcept { return pChunks.size(); }
+        [[nodiscard]] uint32_t Renders() const noexcept { return pRenders; }
+        [[nodiscard]] uint32_t Hits() const noexcept { return pHits; }
+
+        static WebTemplate* Get(const String& filename);
+        static const std::map<String, WebTemplate*>& Templates() noexcept { return pTemplates; }
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+#pragma once
+
+// [env:native] only: just enough of the Arduino core for the modules that do not touch hardware, so their host
+// benchmarks run the device code unchanged. String mirrors the Arduino API on top of std::string.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using std::min;
+using std::max;
+
+inline uint32_t micros() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline uint32_t millis() { return micros() / 1000; }
+
+class String {
+    private:
+        std::string pValue;
+
+        template <typename T> static std::string format(const char* fmt, T value) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), fmt, value);
+            return buf;
+        }
+
+        static std::string fixed(double value, unsigned char decimals) {
+            char buf[48];
+            snprintf(buf, sizeof(buf), "%.*f", (int)decimals, value);
+            return buf;
+        }
+    public:
+        String() = default;
+        String(const char* value) : pValue(value != nullptr ? value : "") {}
+        String(const std::string& value) : pValue(value) {}
+        explicit String(char value) : pValue(1, value) {}
+        explicit String(int value) : pValue(format("%d", value)) {}
+        explicit String(unsigned int value) : pValue(format("%u", value)) {}
+        explicit String(long value) : pValue(format("%ld", value)) {}
+        explicit String(unsigned long value) : pValue(format("%lu", value)) {}
+        explicit String(float value, unsigned char decimals = 2) : pValue(fixed(value, decimals)) {}
+        explicit String(double value, unsigned char decimals = 2) : pValue(fixed(value, decimals)) {}
+
+        [[nodiscard]] const char* c_str() const noexcept { return pValue.c_str(); }
+        [[nodiscard]] unsigned int length() const noexcept { return (unsigned int)pValue.length(); }
+        [[nodiscard]] bool isEmpty() const noexcept { return pValue.empty(); }
+        bool reserve(unsigned int size) { pValue.reserve(size); return true; }
+
+        [[nodiscard]] char charAt(unsigned int index) const noexcept { return index < pValue.length() ? pValue[index] : 0; }
+        char operator[](unsigned int index) const noexcept { return charAt(index); }
+
+        String& operator+=(const String& rhs) { pValue += rhs.pValue; return *this; }
+        String& operator+=(const char* rhs) { pValue += rhs; return *this; }
+        String& operator+=(char rhs) { pValue += rhs; return *this; }
+
+        friend String operator+(String lhs, const String& rhs) { lhs += rhs; return lhs; }
+        friend String operator+(String lhs, const char* rhs) { lhs += rhs; return lhs; }
+        friend String operator+(const char* lhs, const String& rhs) { return String(lhs) += rhs; }
+        friend String operator+(String lhs, char rhs) { lhs += rhs; return lhs; }
+
+        bool operator==(const String& rhs) const noexcept { return pValue == rhs.pValue; }
+        bool operator==(const char* rhs) const noexcept { return pValue == rhs; }
+        bool operator!=(const String& rhs) const noexcept { return pValue != rhs.pValue; }
+        bool operator!=(const char* rhs) const noexcept { return pValue != rhs; }
+        bool operator<(const String& rhs) const noexcept { return pValue < rhs.pValue; }
+
+        [[nodiscard]] bool equals(const String& rhs) const noexcept { return pValue == rhs.pValue; }
+        [[nodiscard]] bool equalsIgnoreCase(const String& rhs) const noexcept {
+            if (pValue.length() != rhs.pValue.length()) return false;
+            for (size_t i = 0; i < pValue.length(); i++) {
+                if (tolower((unsigned char)pValue[i]) != tolower((unsigned char)rhs.pValue[i])) return false;
+            }
+            return true;
+        }
+
+        [[nodiscard]] bool startsWith(const String& prefix) const noexcept { return pValue.compare(0, prefix.pValue.length(), prefix.pValue) == 0; }
+        [[nodiscard]] bool endsWith(const String& suffix) const noexcept {
+            return pValue.length() >= suffix.pValue.length() && pValue.compare(pValue.length() - suffix.pValue.length(), suffix.pValue.length(), suffix.pValue) == 0;
+        }
+
+        [[nodiscard]] int indexOf(char c, unsigned int from = 0) const noexcept {
+            size_t at = pValue.find(c, from);
+            return at == std::string::npos ? -1 : (int)at;
+        }
+        [[nodiscard]] int indexOf(const String& s, unsigned int from = 0) const noexcept {
+            size_t at = pValue.find(s.pValue, from);
+            return at == std::string::npos ? -1 : (int)at;
+        }
+
+        [[nodiscard]] String substring(unsigned int from) const { return from < pValue.length() ? String(pValue.substr(from)) : String(); }
+        [[nodiscard]] String substring(unsigned int from, unsigned int to) const {
+            if (from > to) std::swap(from, to);
+            if (from >= pValue.length()) return String();
+            return String(pValue.substr(from, to - from));
+        }
+
+        void trim() {
+            size_t first = 0, last = pValue.length();
+            while (first < last && isspace((unsigned char)pValue[first])) first++;
+            while (last > first && isspace((unsigned char)pValue[last - 1])) last--;
+            pValue = pValue.substr(first, last - first);
+        }
+        void toLowerCase() { for (auto& c : pValue) c = (char)tolower((unsigned char)c); }
+        void toUpperCase() { for (auto& c : pValue) c = (char)toupper((unsigned char)c); }
+
+        [[nodiscard]] long toInt() const noexcept { return strtol(pValue.c_str(), nullptr, 10); }
+        [[nodiscard]] float toFloat() const noexcept { return strtof(pValue.c_str(), nullptr); }
+};
+
+#endif
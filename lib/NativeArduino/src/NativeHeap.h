@@ -0,0 +1,72 @@
+#ifndef NativeHeap_h
+#define NativeHeap_h
+
+#pragma once
+
+// [env:native] only: counts heap traffic for the host benchmarks by replacing the global operator new/delete.
+// Replacement allocation functions may only be defined once per program, so include this from exactly one file
+// of a test.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+struct native_heap_t {
+    size_t Current = 0;
+    size_t Peak = 0;
+    uint32_t Allocations = 0;
+
+    // Starts a new window: the peak is measured from what is live right now
+    void Mark() noexcept {
+        Peak = Current;
+        Allocations = 0;
+    }
+};
+
+inline native_heap_t NativeHeap;
+
+namespace nativeheap {
+    // The block size rides in front of the block, keeping max_align_t alignment for the caller
+    constexpr size_t Header = alignof(std::max_align_t);
+
+    // Out of line, or GCC pairs the inlined malloc/free against new/delete and warns
+    [[gnu::noinline]] inline void* allocate(size_t size) noexcept {
+        unsigned char* block = static_cast<unsigned char*>(malloc(size + Header));
+        if (block == nullptr) return nullptr;
+
+        *reinterpret_cast<size_t*>(block) = size;
+        NativeHeap.Current += size;
+        NativeHeap.Allocations++;
+        if (NativeHeap.Current > NativeHeap.Peak) NativeHeap.Peak = NativeHeap.Current;
+
+        return block + Header;
+    }
+
+    [[gnu::noinline]] inline void release(void* ptr) noexcept {
+        if (ptr == nullptr) return;
+
+        unsigned char* block = static_cast<unsigned char*>(ptr) - Header;
+        NativeHeap.Current -= *reinterpret_cast<size_t*>(block);
+        free(block);
+    }
+}
+
+void* operator new(size_t size) {
+    void* ptr = nativeheap::allocate(size);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return nativeheap::allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return nativeheap::allocate(size); }
+
+void operator delete(void* ptr) noexcept { nativeheap::release(ptr); }
+void operator delete[](void* ptr) noexcept { nativeheap::release(ptr); }
+void operator delete(void* ptr, size_t) noexcept { nativeheap::release(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { nativeheap::release(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { nativeheap::release(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { nativeheap::release(ptr); }
+
+#endif
@@ -0,0 +1,47 @@
+#include "AsyncTelnetCommand.h"
+
+#include <algorithm>
+
+char* AsyncTelnetArgs::Trim(char* line) {
+    while (*line == ' ') line++;
+
+    size_t length = strlen(line);
+    while (length > 0 && line[length - 1] == ' ') line[--length] = '\0';
+
+    return line;
+}
+
+char* AsyncTelnetArgs::Split(char* line) {
+    Count = 0;
+
+    char* p = strchr(line, ' ');
+    while (p != nullptr) {
+        *p++ = '\0';
+        while (*p == ' ') p++;
+        if (*p == '\0' || Count == ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS) break;
+
+        Value[Count++] = p;
+        p = strchr(p, ' ');
+    }
+
+    return line;
+}
+
+void AsyncTelnetCommandList::Add(AsyncTelnetCommand* command) {
+    // Inserted after any equal name, so the first registration of a command keeps winning
+    auto it = std::upper_bound(mList.begin(), mList.end(), command, [](const AsyncTelnetCommand* a, const AsyncTelnetCommand* b) {
+        return strcmp(a->Command.c_str(), b->Command.c_str()) < 0;
+    });
+
+    mList.insert(it, command);
+}
+
+AsyncTelnetCommand* AsyncTelnetCommandList::Find(const char* command) const {
+    auto it = std::lower_bound(mList.begin(), mList.end(), command, [](const AsyncTelnetCommand* cmd, const char* name) {
+        return strcmp(cmd->Command.c_str(), name) < 0;
+    });
+
+    if (it == mList.end() || strcmp((*it)->Command.c_str(), command) != 0) return nullptr;
+
+    return *it;
+}
@@ -1,92 +1,81 @@
 #include "AsyncTelnetServer.h"
 
 AsyncTelnetServer::AsyncTelnetServer(uint16_t port) : mPort(port) {
-    onCommand(ASYNCTELNETSERVER_CMD_CLEAR, ASYNCTELNETSERVER_HLP_CLEAR, [&](AsyncClient* client, String* parameter) {
-        client->write("\x1B[2J\x1B[H");
+    onCommandArgs(ASYNCTELNETSERVER_CMD_CLEAR, ASYNCTELNETSERVER_HLP_CLEAR, [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
+        session->print("\x1B[2J\x1B[H");
     });
 
-    onCommand(ASYNCTELNETSERVER_CMD_EXIT, ASYNCTELNETSERVER_HLP_EXIT, [&](AsyncClient* client, String* parameter) {
-        client->write("Session closed.\r\n\r\n");
-        RemoveSession(client);
-        client->stop();
+    onCommandArgs(ASYNCTELNETSERVER_CMD_EXIT, ASYNCTELNETSERVER_HLP_EXIT, [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
+        session->print("Session closed.\r\n\r\n");
+
+        // Closing releases the session, so onData does it once it is done with the line
+        session->Closing = true;
     });
 
-    onCommand(ASYNCTELNETSERVER_CMD_SESSIONS, ASYNCTELNETSERVER_HLP_SESSIONS, [&](AsyncClient* client, String* parameter) {
-        client->write("Current sessions:\r\n\r\n");
-        for (AsyncTelnetSession* session : mSessions) {
-            client->write(String(session->User + "@" + session->RemoteIP.toString() + ":" + String(session->RemotePort) + String(session->Admin ? " - Admin" : "") + "\r\n").c_str());
-        }
+    onCommandArgs(ASYNCTELNETSERVER_CMD_SESSIONS, ASYNCTELNETSERVER_HLP_SESSIONS, [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
+        session->print("Current sessions:\r\n\r\n");
+        for (AsyncTelnetSession* other : mSessions) WriteSession(session, other);
     });
 
-    onCommand(ASYNCTELNETSERVER_CMD_WHOAMI, ASYNCTELNETSERVER_HLP_WHOAMI, [&](AsyncClient* client, String* parameter) {
-        AsyncTelnetSession* session = CurrentSession(client);
-        if (session != nullptr) {
-            client->write(String(session->User + "@" + session->RemoteIP.toString() + ":" + String(session->RemotePort) + String(session->Admin ? " - Admin" : "") + "\r\n").c_str());
-        } else {
-            client->write("Unknown session\r\n");
-        }
+    onCommandArgs(ASYNCTELNETSERVER_CMD_WHOAMI, ASYNCTELNETSERVER_HLP_WHOAMI, [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
+        WriteSession(session, session);
     });
 
-    onCommand(ASYNCTELNETSERVER_CMD_HELP, ASYNCTELNETSERVER_HLP_HELP, [&](AsyncClient* client, String* parameter) {
-        if (parameter[0].isEmpty()) {
-            client->write(String("Available commands:\r\n\r\n").c_str());
+    onCommandArgs(ASYNCTELNETSERVER_CMD_HELP, ASYNCTELNETSERVER_HLP_HELP, [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
+        if (args.Empty(0)) {
+            session->print("Available commands:\r\n\r\n");
 
-            String out;
             size_t maxLen = 0;
             for (AsyncTelnetCommand* cmd : mCommandList) if (cmd->Command.length() > maxLen) maxLen = cmd->Command.length();
 
-            size_t colWidth = maxLen + 4;
-            uint16_t colCount = ASYNCTELNETSERVER_HELPCOMMANDSPERLINE;
-            uint16_t currentCol = 0;
+            // One row of the listing per call
+            const int colWidth = (int)maxLen + 4;
+            size_t next = 0;
 
-            for (AsyncTelnetCommand* cmd : mCommandList) {
-                out = cmd->Command;
+            session->Stream([this, colWidth, next](AsyncTelnetSession* session) mutable -> bool {
+                if (next >= mCommandList.size()) {
+                    session->print("\r\n\r\nUse . to repeat last command.\r\n");
+                    return false;
+                }
 
-                while (out.length() < colWidth) out += ' ';
-                client->write(out.c_str());
+                for (uint16_t col = 0; col < ASYNCTELNETSERVER_HELPCOMMANDSPERLINE && next < mCommandList.size(); col++) {
+                    session->printf("%-*s", colWidth, mCommandList[next++]->Command.c_str());
+                }
 
-                currentCol++;
+                if (next % ASYNCTELNETSERVER_HELPCOMMANDSPERLINE == 0) session->print("\r\n");
 
-                if (currentCol >= colCount) {
-                    client->write("\r\n");
-                    currentCol = 0;
-                }
-            }
-            
-            out = "\r\n\r\nUse . to repeat last command.\r\n";
-            client->write(out.c_str());
+                return true;
+            });
         } else {
-            bool ValidCommand = false;
-            for (AsyncTelnetCommand* cmd : mCommandList) {
-                if (parameter[0] == cmd->Command) {
-                    client->write(String(cmd->HelpMessage + "\r\n").c_str());
-                    ValidCommand = true;
-                    break;
-                }
-            }
+            AsyncTelnetCommand* cmd = mCommandList.Find(args[0]);
 
-            if (!ValidCommand) client->write(String(parameter[0] + " - Invalid command.\r\n").c_str());
+            if (cmd != nullptr) {
+                session->print(cmd->HelpMessage);
+                session->print("\r\n");
+            } else {
+                session->print(args[0]);
+                session->print(" - Invalid command.\r\n");
+            }
         }
     });
 
-    onCommand(ASYNCTELNETSERVER_CMD_ECHO, ASYNCTELNETSERVER_HLP_ECHO, [&](AsyncClient* client, String* parameter) {
-        String Text;
-        for (uint8_t n = 0; n < ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS; n++)
-            if (!parameter[n].isEmpty()) Text += (Text.isEmpty() ? "" : " ") + parameter[n];
+    onCommandArgs(ASYNCTELNETSERVER_CMD_ECHO, ASYNCTELNETSERVER_HLP_ECHO, [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
+        for (uint8_t n = 0; n < args.Count; n++) {
+            if (n > 0) session->print(" ");
+            session->print(args[n]);
+        }
 
-        client->write(String(Text + "\r\n").c_str());
+        session->print("\r\n");
     });
 
     mAsyncServer = new AsyncServer(mPort);
 
     mAsyncServer->onClient([&](void* arg, AsyncClient* client) {
-        AsyncTelnetSession* session = new AsyncTelnetSession{
-            client->remoteIP(),
-            client->remotePort(),
-            ASYNCTELNETSERVER_GUESTUSER,
-            "",
-            ""
-        };
+        AsyncTelnetSession* session = new AsyncTelnetSession();
+        session->Client = client;
+        session->RemoteIP = client->remoteIP();
+        session->RemotePort = client->remotePort();
+        session->User = ASYNCTELNETSERVER_GUESTUSER;
 
         mSessions.push_back(session);
 
@@ -94,10 +83,13 @@ AsyncTelnetServer::AsyncTelnetServer(uint16_t port) : mPort(port) {
             onSessionBegin(client, session);
         }
 
-        client->write(String("\r\n" + WelcomeMessage + "\r\n\r\n" + ASYNCTELNETSERVER_GUESTUSER + " " + ASYNCTELNETSERVER_DEFAULTPROMPT).c_str());
+        session->print("\r\n" + WelcomeMessage + "\r\n\r\n");
+        session->Prompt();
+        session->Pump();
 
+        // The session rides along as the callback argument; it lives until onDisconnect, which is the last callback of a client
         client->onData([&](void* arg, AsyncClient* client, void* data, size_t len) {
-            AsyncTelnetSession* session = FindSession(client);
+            AsyncTelnetSession* session = static_cast<AsyncTelnetSession*>(arg);
             if (session == nullptr || data == nullptr || len == 0) return;
 
             const uint8_t* bytes = static_cast<const uint8_t*>(data);
@@ -106,26 +98,45 @@ AsyncTelnetServer::AsyncTelnetServer(uint16_t port) : mPort(port) {
                 uint8_t b = bytes[i];
 
                 if (b == PROTCMD.IAC) {
-                    HandleNegotiation(client, bytes, len, i);
+                    // Line mode clients send Ctrl-C as IAC IP
+                    if (i + 1 < len && bytes[i + 1] == PROTCMD.IP) {
+                        b = 3;
+                        i++;
+                    } else {
+                        HandleNegotiation(client, bytes, len, i);
+                        continue;
+                    }
+                }
+
+                if (b == 3) {
+                    if (!session->Cancel()) {
+                        session->LineLength = 0;
+                        session->print("^C\r\n");
+                        session->Prompt();
+                        session->Pump();
+                    }
                     continue;
                 }
 
+                // Nothing is read ahead while a command is still running or streaming its output
+                if (session->Busy() || session->Streaming()) continue;
+
                 if (b == 8 || b == 127) {
-                    if (session->InputBuffer.length() > 0) {
-                        session->InputBuffer.remove(session->InputBuffer.length() - 1);
-                    }
+                    if (session->LineLength > 0) session->LineLength--;
                     continue;
                 }
 
                 if (b == '\r' || b == '\n') {
-                    if (session->InputBuffer.length() > 0) {
-                        client->write("\r\n");
-                        String line = session->InputBuffer;
-                        session->InputBuffer.clear();
-                        ProcessLine(client, line);
-                    } else {
-                        client->write("\r\n");
-                        client->write(String(session->User + " " + ASYNCTELNETSERVER_DEFAULTPROMPT).c_str());
+                    session->print("\r\n");
+
+                    session->Line[session->LineLength] = '\0';
+                    ProcessLine(client, session);
+                    session->LineLength = 0;
+
+                    if (session->Closing) {
+                        session->Pump();
+                        client->close();
+                        return;
                     }
 
                     if (b == '\r' && (i + 1 < len) && bytes[i + 1] == '\n') {
@@ -135,11 +146,20 @@ AsyncTelnetServer::AsyncTelnetServer(uint16_t port) : mPort(port) {
                     continue;
                 }
 
-                if (b >= 32 && b <= 126) {
-                    session->InputBuffer += static_cast<char>(b);
+                // Anything past the line buffer is dropped, as a terminal would on a full input line
+                if (b >= 32 && b <= 126 && session->LineLength < ASYNCTELNETSERVER_MAXLINE) {
+                    session->Line[session->LineLength++] = static_cast<char>(b);
                 }
             }
-        }, nullptr);
+        }, session);
+
+        client->onAck([&](void* arg, AsyncClient* client, size_t len, uint32_t time) {
+            static_cast<AsyncTelnetSession*>(arg)->Pump();
+        }, session);
+
+        client->onPoll([&](void* arg, AsyncClient* client) {
+            static_cast<AsyncTelnetSession*>(arg)->Pump();
+        }, session);
 
         client->onDisconnect([&](void* arg, AsyncClient* client) {
             RemoveSession(client);
@@ -163,10 +183,20 @@ AsyncTelnetServer::~AsyncTelnetServer() {
         mAsyncServer = nullptr;
     }
 
+    if (mWorker != nullptr) {
+        vTaskDelete(mWorker);
+        mWorker = nullptr;
+    }
+
+    if (mJobs != nullptr) {
+        vQueueDelete(mJobs);
+        mJobs = nullptr;
+    }
+
     for (AsyncTelnetCommand* cmd : mCommandList) {
         delete cmd;
     }
-    mCommandList.clear();
+    mCommandList.Clear();
 
     for (AsyncTelnetSession* session : mSessions) {
         delete session;
@@ -178,39 +208,75 @@ AsyncTelnetSession* AsyncTelnetServer::FindSession(AsyncClient* client) {
     if (client == nullptr) return nullptr;
 
     for (AsyncTelnetSession* session : mSessions) {
-        if ((session->RemoteIP == client->remoteIP()) &&
-            (session->RemotePort == client->remotePort())) {
-            return session;
-        }
+        if (session->Client == client) return session;
     }
 
     return nullptr;
 }
 
 AsyncTelnetSession* AsyncTelnetServer::CurrentSession(AsyncClient* client) {
+    // The session list belongs to the AsyncTCP task; on the worker, the running job's session is the only one in reach
+    if (mWorker != nullptr && xTaskGetCurrentTaskHandle() == mWorker) {
+        return (mJobSession != nullptr && mJobSession->Client == client) ? mJobSession : nullptr;
+    }
+
     return FindSession(client);
 }
 
+size_t AsyncTelnetServer::Write(AsyncClient* client, const char* text) {
+    AsyncTelnetSession* session = CurrentSession(client);
+    return (session != nullptr) ? session->print(text) : 0;
+}
+
+bool AsyncTelnetServer::Cancelled(AsyncClient* client) {
+    AsyncTelnetSession* session = CurrentSession(client);
+    return (session == nullptr) || session->Cancelled();
+}
+
+bool AsyncTelnetServer::Wait(AsyncClient* client, uint32_t ms) {
+    const uint32_t start = millis();
+
+    while (millis() - start < ms) {
+        if (Cancelled(client)) return false;
+        delay(min<uint32_t>(50, ms - (millis() - start)));
+    }
+
+    return !Cancelled(client);
+}
+
+void AsyncTelnetServer::AddCommand(AsyncTelnetCommand* command) {
+    mCommandList.Add(command);
+
+    if (command->Worker && mJobs == nullptr) {
+        mJobs = xQueueCreate(ASYNCTELNETSERVER_WORKERQUEUE, sizeof(job_t));
+        if (mJobs != nullptr) xTaskCreate(Worker, "TelnetWorker", ASYNCTELNETSERVER_WORKERSTACK, this, ASYNCTELNETSERVER_WORKERPRIORITY, &mWorker);
+    }
+}
+
 void AsyncTelnetServer::RemoveSession(AsyncClient* client) {
     if (client == nullptr) return;
 
     for (auto it = mSessions.begin(); it != mSessions.end(); ++it) {
         AsyncTelnetSession* session = *it;
 
-        if ((session->RemoteIP == client->remoteIP()) &&
-            (session->RemotePort == client->remotePort())) {
-
+        if (session->Client == client) {
             if (onSessionEnd != nullptr) {
                 onSessionEnd(client, session);
             }
 
-            delete session;
             mSessions.erase(it);
+
+            // A command still running on the worker is cancelled, and the worker deletes the session when it returns
+            if (!session->detach()) delete session;
             break;
         }
     }
 }
 
+void AsyncTelnetServer::WriteSession(AsyncTelnetSession* output, AsyncTelnetSession* session) {
+    output->printf("%s@%s:%u%s\r\n", session->User.c_str(), session->RemoteIP.toString().c_str(), (unsigned)session->RemotePort, session->Admin ? " - Admin" : "");
+}
+
 void AsyncTelnetServer::HandleNegotiation(AsyncClient* client, const uint8_t* data, size_t len, size_t& index) {
     if (client == nullptr || data == nullptr) return;
     if (index + 1 >= len) return;
@@ -257,86 +323,116 @@ void AsyncTelnetServer::HandleNegotiation(AsyncClient* client, const uint8_t* da
     index += 1;
 }
 
-void AsyncTelnetServer::ProcessLine(AsyncClient* client, const String& line) {
-    AsyncTelnetSession* session = FindSession(client);
-    if (session == nullptr) return;
-
-    String incomeData = line;
-    incomeData.trim();
+void AsyncTelnetServer::ProcessLine(AsyncClient* client, AsyncTelnetSession* session) {
+    char* line = AsyncTelnetArgs::Trim(session->Line);
 
-    if (incomeData.equals(".")) {
-        incomeData = session->LastInput;
-    } else if (incomeData.length() > 0) {
-        session->LastInput = incomeData;
+    if (strcmp(line, ".") == 0) {
+        memcpy(session->Line, session->LastLine, sizeof(session->Line));
+        line = session->Line;
+    } else if (*line != '\0') {
+        memcpy(session->LastLine, line, strlen(line) + 1);
     }
 
-    if (incomeData.isEmpty()) {
-        client->write(String(session->User + " " + ASYNCTELNETSERVER_DEFAULTPROMPT).c_str());
+    if (*line == '\0') {
+        session->Prompt();
+        session->Pump();
         return;
     }
 
-    String command;
-    String parameters;
-    String parameter[ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS];
+    AsyncTelnetArgs args;
+    char* command = args.Split(line);
+
+    AsyncTelnetCommand* cmd = mCommandList.Find(command);
+
+    if (cmd == nullptr) {
+        session->print(command);
+        session->print(" - " ASYNCTELNETSERVER_INVALIDCOMMAND "\r\n\r\n");
+    } else if (cmd->Admin && !session->Admin) {
+        session->print(ASYNCTELNETSERVER_PERMISSIONDENIED "\r\n\r\n");
+    } else if (args.Is(0, "-h") || args.Is(0, "-?") || args.Is(0, "--help")) {
+        session->print(cmd->HelpMessage);
+        session->print("\r\n\r\n");
+    } else if (cmd->Worker) {
+        mCommands++;
+
+        if (Dispatch(client, session, cmd, args)) {
+            session->Pump();
+            return;
+        }
 
-    int firstSpace = incomeData.indexOf(' ');
-    if (firstSpace < 0) {
-        command = incomeData;
-        parameters = "";
+        session->print(ASYNCTELNETSERVER_WORKERBUSY "\r\n\r\n");
     } else {
-        command = incomeData.substring(0, firstSpace);
-        parameters = incomeData.substring(firstSpace + 1);
-        parameters.trim();
-    }
+        mCommands++;
 
-    for (uint8_t i = 0; i < ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS; i++) {
-        if (parameters.isEmpty()) {
-            parameter[i] = "";
-            continue;
+        if (cmd->ArgsCallback) {
+            cmd->ArgsCallback(client, session, args);
+        } else {
+            // Compatibility path for String* callbacks: the session's String slots keep their capacity between lines
+            for (uint8_t i = 0; i < ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS; i++) session->Parameter[i] = args[i];
+            cmd->Callback(client, session->Parameter);
         }
 
-        int nextSpace = parameters.indexOf(' ');
-        if (nextSpace < 0) {
-            parameter[i] = parameters;
-            parameters = "";
-        } else {
-            parameter[i] = parameters.substring(0, nextSpace);
-            parameters = parameters.substring(nextSpace + 1);
-            parameters.trim();
+        if (session->Closing) return;
+
+        // A streaming command gets its line break and prompt once the generator is done
+        if (session->Streaming()) {
+            session->Pump();
+            return;
+        }
+
+        if (cmd->Command != ASYNCTELNETSERVER_CMD_CLEAR) {
+            session->print("\r\n");
         }
     }
 
-    bool validCommand = false;
+    session->Prompt();
+    session->Pump();
+}
 
-    for (AsyncTelnetCommand* cmd : mCommandList) {
-        if (command == cmd->Command) {
-            validCommand = true;
+bool AsyncTelnetServer::Dispatch(AsyncClient* client, AsyncTelnetSession* session, AsyncTelnetCommand* cmd, const AsyncTelnetArgs& args) {
+    if (mJobs == nullptr) return false;
 
-            AsyncTelnetSession* session = CurrentSession(client);
+    // Tokens keep pointing into the line buffer, which no input touches while the session is busy
+    session->mArgs = args;
+    if (!cmd->ArgsCallback) {
+        for (uint8_t i = 0; i < ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS; i++) session->Parameter[i] = args[i];
+    }
 
-            if (cmd->Admin && session && !session->Admin) {
-                client->write(String(String(ASYNCTELNETSERVER_PERMISSIONDENIED) + "\r\n\r\n").c_str());
-                break;
-            }
+    session->mCancelled = false;
+    session->mBusy = true;
+
+    job_t job = { client, session, cmd };
+    if (xQueueSend(mJobs, &job, 0) != pdTRUE) {
+        session->mBusy = false;
+        return false;
+    }
+
+    return true;
+}
+
+void AsyncTelnetServer::Worker(void* arg) {
+    AsyncTelnetServer* server = static_cast<AsyncTelnetServer*>(arg);
+    job_t job;
 
-            if (parameter[0].equalsIgnoreCase("-h") || parameter[0].equalsIgnoreCase("-?") || parameter[0].equalsIgnoreCase("--help")) {
-                client->write(String(cmd->HelpMessage + "\r\n\r\n").c_str());
+    for (;;) {
+        if (xQueueReceive(server->mJobs, &job, portMAX_DELAY) != pdTRUE) continue;
+
+        AsyncTelnetSession* session = job.Session;
+        server->mJobSession = session;
+
+        if (!session->Cancelled()) {
+            if (job.Command->ArgsCallback) {
+                job.Command->ArgsCallback(job.Client, session, session->mArgs);
             } else {
-                cmd->Callback(client, parameter);
-                if (cmd->Command != ASYNCTELNETSERVER_CMD_CLEAR) {
-                    client->write("\r\n");
-                }
+                job.Command->Callback(job.Client, session->Parameter);
             }
-
-            break;
         }
-    }
 
-    if (!validCommand) {
-        client->write(String(command + " - " + ASYNCTELNETSERVER_INVALIDCOMMAND + "\r\n\r\n").c_str());
-    }
+        server->mJobSession = nullptr;
 
-    client->write(String(session->User + " " + ASYNCTELNETSERVER_DEFAULTPROMPT).c_str());
+        // Hands over the parked stream or queues the prompt; the AsyncTCP task sends either on the next ack or poll
+        if (session->finish()) delete session;
+    }
 }
 
 uint8_t AsyncTelnetServer::SessionID(AsyncClient* client) {
@@ -345,11 +441,220 @@ uint8_t AsyncTelnetServer::SessionID(AsyncClient* client) {
     uint8_t ret = 0;
     for (AsyncTelnetSession* session : mSessions) {
         ret++;
-        if ((session->RemoteIP == client->remoteIP()) &&
-            (session->RemotePort == client->remotePort())) {
-            return ret;
-        }
+        if (session->Client == client) return ret;
     }
 
     return 0;
 }
+
+AsyncTelnetSession::AsyncTelnetSession() {
+    mLock = xSemaphoreCreateMutex();
+}
+
+AsyncTelnetSession::~AsyncTelnetSession() {
+    if (mLock != nullptr) vSemaphoreDelete(mLock);
+}
+
+bool AsyncTelnetSession::detach() {
+    xSemaphoreTake(mLock, portMAX_DELAY);
+    const bool busy = mBusy;
+    if (busy) {
+        mDetached = true;
+        mCancelled = true;
+    }
+    xSemaphoreGive(mLock);
+
+    return busy;
+}
+
+bool AsyncTelnetSession::finish() {
+    xSemaphoreTake(mLock, portMAX_DELAY);
+
+    // The one place a worker command's prompt is decided: a stream it started (and was not cancelled) prints it when done
+    if (!mDetached && (mCancelled || mPendingStream == nullptr)) {
+        mPendingStream = nullptr;
+        mStreaming = false;
+
+        queue(reinterpret_cast<const uint8_t*>("\r\n"), 2);
+        queuePrompt();
+    }
+
+    mBusy = false;
+    const bool detached = mDetached;
+    xSemaphoreGive(mLock);
+
+    return detached;
+}
+
+size_t AsyncTelnetSession::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t AsyncTelnetSession::write(const uint8_t* buffer, size_t size) {
+    xSemaphoreTake(mLock, portMAX_DELAY);
+
+    queue(buffer, size);
+
+    const bool drain = !mPumping && !mBusy && mOutputBytes >= ASYNCTELNETSERVER_OUTPUTCHUNK;
+    xSemaphoreGive(mLock);
+
+    // Commands that print a lot in one go start draining before they return; worker output waits for the AsyncTCP task
+    if (drain) Pump();
+
+    return size;
+}
+
+// Callers hold mLock
+void AsyncTelnetSession::queue(const uint8_t* buffer, size_t size) {
+    size_t left = size;
+
+    while (left > 0) {
+        if (mOutput.empty() || mOutput.back().length() >= ASYNCTELNETSERVER_OUTPUTCHUNK) {
+            mOutput.emplace_back();
+            mOutput.back().reserve(ASYNCTELNETSERVER_OUTPUTCHUNK);
+        }
+
+        String& chunk = mOutput.back();
+        size_t n = min<size_t>(left, ASYNCTELNETSERVER_OUTPUTCHUNK - chunk.length());
+        chunk.concat(reinterpret_cast<const char*>(buffer), n);
+
+        buffer += n;
+        left -= n;
+        mOutputBytes += n;
+    }
+}
+
+// Callers hold mLock
+void AsyncTelnetSession::queuePrompt() {
+    queue(reinterpret_cast<const uint8_t*>(User.c_str()), User.length());
+    queue(reinterpret_cast<const uint8_t*>(" " ASYNCTELNETSERVER_DEFAULTPROMPT), sizeof(" " ASYNCTELNETSERVER_DEFAULTPROMPT) - 1);
+}
+
+void AsyncTelnetSession::Stream(telnet_stream_t generator) {
+    // Parked for the next Pump(), which starts it once no worker job is running on this session
+    xSemaphoreTake(mLock, portMAX_DELAY);
+    mPendingStream = generator;
+    mStreaming = (mPendingStream != nullptr || mStream != nullptr);
+    xSemaphoreGive(mLock);
+}
+
+bool AsyncTelnetSession::Cancel() {
+    if (mBusy) {
+        if (!mCancelled) {
+            mCancelled = true;
+            print("^C\r\n");
+            Pump();
+        }
+        return true;
+    }
+
+    xSemaphoreTake(mLock, portMAX_DELAY);
+    const bool streaming = mStreaming;
+    if (streaming) mStreamCancel = true;
+    xSemaphoreGive(mLock);
+
+    if (!streaming) return false;
+
+    // Whichever task is pumping drops the stream and prints the prompt
+    Pump();
+
+    return true;
+}
+
+void AsyncTelnetSession::Prompt() {
+    print(User);
+    print(" " ASYNCTELNETSERVER_DEFAULTPROMPT);
+}
+
+void AsyncTelnetSession::Pump() {
+    if (Client == nullptr) return;
+
+    xSemaphoreTake(mLock, portMAX_DELAY);
+    if (mPumping) {
+        xSemaphoreGive(mLock);
+        return;
+    }
+    mPumping = true;
+
+    for (;;) {
+        bool sent = false;
+
+        while (!mOutput.empty()) {
+            String& chunk = mOutput.front();
+
+            size_t room = Client->space();
+            if (room == 0) break;
+
+            size_t n = Client->add(chunk.c_str() + mOutputHead, min<size_t>(room, chunk.length() - mOutputHead));
+            if (n == 0) break;
+
+            sent = true;
+            mOutputHead += n;
+            mOutputBytes -= n;
+
+            if (mOutputHead == chunk.length()) {
+                mOutput.pop_front();
+                mOutputHead = 0;
+            }
+        }
+
+        if (sent) Client->send();
+
+        // Take over a parked generator, or drop the running one on Ctrl-C
+        if (mStream == nullptr && mPendingStream != nullptr && !mBusy) {
+            mStream = std::move(mPendingStream);
+            mPendingStream = nullptr;
+        }
+
+        if (mStreamCancel) {
+            mStreamCancel = false;
+
+            if (mStream != nullptr || mPendingStream != nullptr) {
+                mStream = nullptr;
+                mPendingStream = nullptr;
+                mStreaming = false;
+
+                queue(reinterpret_cast<const uint8_t*>("^C\r\n\r\n"), 6);
+                queuePrompt();
+                continue;
+            }
+        }
+
+        if (mStream == nullptr || mOutputBytes >= ASYNCTELNETSERVER_OUTPUTLOWWATER) break;
+
+        // The generator prints through write(), which takes the lock itself
+        xSemaphoreGive(mLock);
+
+        // A generator with nothing to say yet is asked again on the next ack or poll
+        const size_t before = mOutputBytes;
+        bool done = false;
+
+        while (!done && mOutputBytes < ASYNCTELNETSERVER_OUTPUTLOWWATER) {
+            const size_t queued = mOutputBytes;
+
+            if (!mStream(this)) {
+                done = true;
+            } else if (mOutputBytes == queued) {
+                break;
+            }
+        }
+
+        xSemaphoreTake(mLock, portMAX_DELAY);
+
+        if (done) {
+            mStream = nullptr;
+            mStreamCancel = false;
+            mStreaming = (mPendingStream != nullptr);
+
+            queue(reinterpret_cast<const uint8_t*>("\r\n"), 2);
+            queuePrompt();
+            continue;
+        }
+
+        if (mStreamCancel) continue;
+        if (mOutputBytes == before || Client->space() == 0) break;
+    }
+
+    mPumping = false;
+    xSemaphoreGive(mLock);
+}
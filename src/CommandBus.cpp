@@ -0,0 +1,169 @@
+#include "CommandBus.h"
+
+#include <new>
+
+#include "Settings.h"
+#include "LogPipeline.h"
+
+extern settings_t Settings;
+
+static_assert((COMMANDBUS_DEPTH & (COMMANDBUS_DEPTH - 1)) == 0, "COMMANDBUS_DEPTH must be a power of two");
+
+commandbus::commandbus() {
+    for (uint32_t i = 0; i < COMMANDBUS_DEPTH; i++) pCells[i].Sequence.store(i, std::memory_order_relaxed);
+}
+
+uint32_t commandbus::Submit(CommandOps op, Generic* target, int32_t value, CommandSources source, uint32_t layout) {
+    return push({ target, value, layout, nullptr, 0, op, source });
+}
+
+uint32_t commandbus::Components(command_job_t job, CommandSources source) {
+    command_job_t* owned = new (std::nothrow) command_job_t(std::move(job));
+    if (owned == nullptr) return 0;
+
+    const uint32_t ticket = push({ nullptr, 0, 0, owned, 0, COMMAND_COMPONENTS, source });
+    if (ticket == 0) delete owned;
+
+    return ticket;
+}
+
+uint32_t commandbus::push(const command_t& cmd) {
+    uint32_t pos = pTail.load(std::memory_order_relaxed);
+    cell_t* cell;
+
+    // A cell is free for position pos when its sequence equals pos; the producer that moves the tail past it owns it
+    for (;;) {
+        cell = &pCells[pos & (COMMANDBUS_DEPTH - 1)];
+        const int32_t diff = (int32_t)(cell->Sequence.load(std::memory_order_acquire) - pos);
+
+        if (diff == 0) {
+            if (pTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            pFull++;
+            return 0;
+        } else {
+            pos = pTail.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->Command = cmd;
+    cell->Command.Submitted = micros();
+    cell->Sequence.store(pos + 1, std::memory_order_release);
+
+    pSubmitted++;
+    return pos + 1;
+}
+
+bool commandbus::Wait(uint32_t ticket, uint32_t timeoutms) const {
+    if (ticket == 0) return false;
+
+    const uint32_t start = millis();
+
+    while ((int32_t)(pApplied.load(std::memory_order_acquire) - ticket) < 0) {
+        if (millis() - start >= timeoutms) return false;
+        delay(1);
+    }
+
+    return true;
+}
+
+size_t commandbus::Drain() {
+    size_t count = 0;
+
+    const uint32_t depth = pTail.load(std::memory_order_relaxed) - pHead;
+    if (depth > pMaxDepth) pMaxDepth = depth;
+
+    // Bounded per call, so a burst cannot stretch one loop() pass
+    while (count < COMMANDBUS_DEPTH) {
+        cell_t& cell = pCells[pHead & (COMMANDBUS_DEPTH - 1)];
+        if ((int32_t)(cell.Sequence.load(std::memory_order_acquire) - (pHead + 1)) < 0) break;
+
+        const command_t cmd = cell.Command;
+        cell.Sequence.store(pHead + COMMANDBUS_DEPTH, std::memory_order_release);
+        pHead++;
+
+        if (apply(cmd)) pExecuted++; else pRejected++;
+        if (cmd.Source < COMMANDSOURCE_COUNT) pBySource[cmd.Source]++;
+        pLatency.Add(micros() - cmd.Submitted);
+
+        count++;
+    }
+
+    // Any number of queued saves costs one write
+    if (pSavePending) {
+        pSavePending = false;
+        pSaves++;
+        if (!Settings.Save()) LOG_E("Command Bus: Failed to save settings");
+    }
+
+    if (count > 0) pApplied.store(pHead, std::memory_order_release);
+
+    return count;
+}
+
+bool commandbus::apply(const command_t& cmd) {
+    if (cmd.Op == COMMAND_SAVE_SETTINGS) {
+        pSavePending = true;
+        return true;
+    }
+
+    if (cmd.Op == COMMAND_COMPONENTS) {
+        const bool ok = (*cmd.Job)();
+        delete cmd.Job;
+
+        // Even a failed job may have changed something; commands looked up before it must not be trusted
+        pLayout.fetch_add(1, std::memory_order_release);
+        return ok;
+    }
+
+    // Components may have been removed, and their addresses reused, since the target was looked up
+    if (cmd.Target == nullptr || cmd.Layout != pLayout.load(std::memory_order_relaxed)) return false;
+
+    switch (cmd.Op) {
+        case COMMAND_RELAY_STATE:
+        case COMMAND_RELAY_INVERT: {
+            if (cmd.Target->Class() != CLASS_RELAY) return false;
+
+            if (cmd.Op == COMMAND_RELAY_INVERT) cmd.Target->as<Relay>()->Invert();
+            else cmd.Target->as<Relay>()->State(cmd.Value != 0);
+        } break;
+
+        case COMMAND_BLINDS_POSITION:
+        case COMMAND_BLINDS_SYNC:
+        case COMMAND_BLINDS_OPEN:
+        case COMMAND_BLINDS_CLOSE:
+        case COMMAND_BLINDS_STOP: {
+            if (cmd.Target->Class() != CLASS_BLINDS) return false;
+
+            Blinds* blinds = cmd.Target->as<Blinds>();
+
+            switch (cmd.Op) {
+                case COMMAND_BLINDS_POSITION: blinds->Position(constrain(cmd.Value, 0, 100)); break;
+                case COMMAND_BLINDS_SYNC: blinds->Position(constrain(cmd.Value, 0, 100), true); break;
+                case COMMAND_BLINDS_OPEN: blinds->Open(); break;
+                case COMMAND_BLINDS_CLOSE: blinds->Close(); break;
+                default: blinds->Stop(); break;
+            }
+        } break;
+
+        case COMMAND_BUTTON_DO: {
+            if (cmd.Target->Class() != CLASS_BUTTON) return false;
+            cmd.Target->as<Button>()->Do((ClickTypes)cmd.Value);
+        } break;
+
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+const char* commandbus::SourceName(CommandSources source) {
+    switch (source) {
+        case COMMANDSOURCE_WEB: return "Web";
+        case COMMANDSOURCE_MQTT: return "MQTT";
+        case COMMANDSOURCE_TELNET: return "Telnet";
+        case COMMANDSOURCE_ORCHESTRATOR: return "Orchestrator";
+        default: return "Unknown";
+    }
+}
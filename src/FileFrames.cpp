@@ -0,0 +1,58 @@
+#include "FileFrames.h"
+
+#include <memory>
+#include <new>
+
+uint32_t CRC32_Update(uint32_t crc, const uint8_t* data, size_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        for (int k = 0; k < 8; k++) crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320UL : (crc >> 1);
+    }
+    return ~crc;
+}
+
+void FileFrames::PutBE32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+uint32_t FileFrames::GetBE32(const uint8_t* in) {
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | (uint32_t)in[3];
+}
+
+bool FileFrames::Write(const String& header, const reader_t& read, const writer_t& write, size_t& fileSize, uint32_t& crc32, size_t chunk) {
+    fileSize = 0;
+    crc32 = 0;
+
+    std::unique_ptr<uint8_t[]> buf(new (std::nothrow) uint8_t[4 + chunk]);
+    if (!buf) return false;
+
+    PutBE32(buf.get(), header.length());
+    if (!write(buf.get(), 4) || !write((const uint8_t*)header.c_str(), header.length())) return false;
+
+    for (;;) {
+        size_t n = 0;
+        while (n < chunk) {
+            size_t r = read(buf.get() + 4 + n, chunk - n);
+            if (r == 0) break;
+            n += r;
+        }
+        if (n == 0) break;
+
+        crc32 = CRC32_Update(crc32, buf.get() + 4, n);
+        fileSize += n;
+
+        PutBE32(buf.get(), n);
+        if (!write(buf.get(), 4 + n)) return false;
+    }
+
+    // Empty frame ends the data, then the trailer: total size and CRC32
+    uint8_t trailer[12];
+    PutBE32(trailer, 0);
+    PutBE32(trailer + 4, fileSize);
+    PutBE32(trailer + 8, crc32);
+    return write(trailer, sizeof(trailer));
+}
@@ -2,7 +2,7 @@
 
 FileSystem *devFileSystem;
 Clock *devClock;
-Log *devLog;
+LogPipeline *devLog;
 MQTT *devMQTT;
 Network *devNetwork;
 AsyncWebServer *devWebServer;
@@ -13,5 +13,8 @@ Timer *devSaveState;
 
 settings_t Settings;
 orchestrator Orchestrator;
+mqttlink MQTTLink;
+commandbus CommandBus;
+profiler Profiler;
 
 volatile bool g_cmdCheckNow = false;
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "LogCodec.h"
+
+#include <LittleFS.h>
+
+static constexpr size_t LogCodecHashBits = 10;
+static constexpr size_t LogCodecHashSize = 1 << LogCodecHashBits;
+static constexpr uint16_t LogCodecNone = 0xFFFF;
+
+// Longest hash chain followed per position; log text finds its matches within the first few candidates
+static constexpr uint8_t LogCodecMaxChain = 16;
+
+static inline size_t logCodecHash(const uint8_t* p) {
+    return ((p[0] << 6) ^ (p[1] << 3) ^ p[2]) & (LogCodecHashSize - 1);
+}
+
+bool LogCodec::Compress(const uint8_t* data, size_t len, const writer_t& write) {
+    // Positions are kept in 16 bits, with 0xFFFF reserved for "none"
+    if (len >= LogCodecNone) return false;
+
+    std::unique_ptr<uint16_t[]> head(new (std::nothrow) uint16_t[LogCodecHashSize]);
+    std::unique_ptr<uint16_t[]> prev(new (std::nothrow) uint16_t[LOGCODEC_WINDOW]);
+    if (!head || !prev) return false;
+
+    for (size_t i = 0; i < LogCodecHashSize; i++) head[i] = LogCodecNone;
+
+    uint8_t header[LOGCODEC_HEADERSIZE] = { 'L', 'Z', 'S', '1', (uint8_t)len, (uint8_t)(len >> 8), (uint8_t)(len >> 16), (uint8_t)(len >> 24) };
+    if (!write(header, sizeof(header))) return false;
+
+    auto insert = [&](size_t pos) {
+        if (pos + LOGCODEC_MINMATCH > len) return;
+        size_t h = logCodecHash(data + pos);
+        prev[pos & (LOGCODEC_WINDOW - 1)] = head[h];
+        head[h] = (uint16_t)pos;
+    };
+
+    uint8_t group[1 + 8 * 2];
+    size_t groupLen = 1;
+    uint8_t tokens = 0;
+    group[0] = 0;
+
+    size_t i = 0;
+    while (i < len) {
+        size_t bestLen = 0;
+        size_t bestDistance = 0;
+
+        if (i + LOGCODEC_MINMATCH <= len) {
+            const size_t limit = min<size_t>(LOGCODEC_MAXMATCH, len - i);
+            uint16_t candidate = head[logCodecHash(data + i)];
+
+            for (uint8_t depth = 0; candidate != LogCodecNone && depth < LogCodecMaxChain; depth++) {
+                const size_t distance = i - candidate;
+                if (distance == 0 || distance > LOGCODEC_WINDOW) break;
+
+                size_t l = 0;
+                while (l < limit && data[candidate + l] == data[i + l]) l++;
+
+                if (l > bestLen) {
+                    bestLen = l;
+                    bestDistance = distance;
+                    if (l == limit) break;
+                }
+
+                uint16_t older = prev[candidate & (LOGCODEC_WINDOW - 1)];
+                if (older == LogCodecNone || older >= candidate) break;
+                candidate = older;
+            }
+        }
+
+        if (bestLen >= LOGCODEC_MINMATCH) {
+            const uint16_t d = (uint16_t)(bestDistance - 1);
+            group[groupLen++] = (uint8_t)(d >> 3);
+            group[groupLen++] = (uint8_t)(((d & 0x07) << 5) | (bestLen - LOGCODEC_MINMATCH));
+
+            for (size_t k = 0; k < bestLen; k++) insert(i + k);
+            i += bestLen;
+        } else {
+            group[0] |= (0x80 >> tokens);
+            group[groupLen++] = data[i];
+
+            insert(i);
+            i++;
+        }
+
+        if (++tokens == 8) {
+            if (!write(group, groupLen)) return false;
+            group[0] = 0;
+            groupLen = 1;
+            tokens = 0;
+        }
+    }
+
+    return tokens == 0 || write(group, groupLen);
+}
+
+size_t LogCodec::CompressFile(const String& from, const String& to) {
+    File in = LittleFS.open(from, "r");
+    if (!in) return 0;
+
+    const size_t len = in.size();
+    std::unique_ptr<uint8_t[]> data(new (std::nothrow) uint8_t[len]);
+    bool ok = data && in.read(data.get(), len) == len;
+    in.close();
+
+    if (!ok) return 0;
+
+    File out = LittleFS.open(to, "w");
+    if (!out) return 0;
+
+    // Tokens come out a couple of bytes at a time; stage them so LittleFS sees fewer, larger writes
+    uint8_t stage[256];
+    size_t staged = 0;
+    size_t total = 0;
+
+    ok = Compress(data.get(), len, [&](const uint8_t* chunk, size_t n) -> bool {
+        if (staged + n > sizeof(stage)) {
+            if (out.write(stage, staged) != staged) return false;
+            staged = 0;
+        }
+        memcpy(stage + staged, chunk, n);
+        staged += n;
+        total += n;
+        return true;
+    });
+
+    if (ok && staged > 0) ok = out.write(stage, staged) == staged;
+    out.close();
+
+    if (!ok) {
+        LittleFS.remove(to);
+        return 0;
+    }
+
+    return total;
+}
+
+bool LogDecoder::Begin() {
+    uint8_t header[LOGCODEC_HEADERSIZE];
+    if (!pSource || pSource.read(header, sizeof(header)) != sizeof(header) || memcmp(header, LOGCODEC_MAGIC, 4) != 0) return false;
+
+    pWindow.reset(new (std::nothrow) uint8_t[LOGCODEC_WINDOW]);
+    if (!pWindow) return false;
+
+    pSize = header[4] | (header[5] << 8) | (header[6] << 16) | ((size_t)header[7] << 24);
+    pRemaining = pSize;
+
+    return true;
+}
+
+int LogDecoder::next() {
+    if (pBufferPos == pBufferLen) {
+        pBufferLen = pSource.read(pBuffer, sizeof(pBuffer));
+        pBufferPos = 0;
+        if (pBufferLen == 0) return -1;
+    }
+    return pBuffer[pBufferPos++];
+}
+
+void LogDecoder::put(uint8_t c, uint8_t* out, size_t& n) {
+    pWindow[pHead & (LOGCODEC_WINDOW - 1)] = c;
+    pHead++;
+    pRemaining--;
+    if (out != nullptr) out[n] = c;
+    n++;
+}
+
+size_t LogDecoder::Read(uint8_t* out, size_t len) {
+    size_t n = 0;
+
+    while (n < len && pRemaining > 0) {
+        if (pPending > 0) {
+            put(pWindow[(pHead - pDistance) & (LOGCODEC_WINDOW - 1)], out, n);
+            pPending--;
+            continue;
+        }
+
+        if (pFlagBits == 0) {
+            int flags = next();
+            if (flags < 0) break;
+            pFlags = (uint8_t)flags;
+            pFlagBits = 8;
+        }
+
+        const bool literal = pFlags & 0x80;
+        pFlags <<= 1;
+        pFlagBits--;
+
+        if (literal) {
+            int c = next();
+            if (c < 0) break;
+            put((uint8_t)c, out, n);
+        } else {
+            int hi = next();
+            int lo = next();
+            if (hi < 0 || lo < 0) break;
+            pDistance = (uint16_t)(((hi << 3) | (lo >> 5)) + 1);
+            pPending = (uint8_t)((lo & 0x1F) + LOGCODEC_MINMATCH);
+        }
+    }
+
+    return n;
+}
+
+size_t LogDecoder::Skip(size_t len) {
+    return Read(nullptr, len);
+}
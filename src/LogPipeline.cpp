@@ -0,0 +1,403 @@
+#include "LogPipeline.h"
+
+#include <time.h>
+#include <stdarg.h>
+#include <new>
+
+#include "Defaults.h"
+
+// Queued by Flush() with its waiter: tells the task to write out its page and signal that caller back
+static constexpr uint8_t LogFlushMarker = 0xFF;
+
+// Longest message kept; also keeps every record well under the ring's maximum item size
+static constexpr size_t LogMaxMessage = 512;
+
+LogPipeline::LogPipeline(FileSystem* fs, Clock* clock) {
+    pSink = new Log(fs, clock);
+    pFileName = Defaults.LogFileName;
+
+    // Created here so the syslog setters work before Begin()
+    pSyslog.Begin();
+}
+
+bool LogPipeline::Begin() {
+    if (pRing != nullptr) return true;
+
+    // Shortest possible line is "[L] " + timestamp + " " + "\n"
+    pPageMaxLines = Defaults.Log.PageSize / 25 + 1;
+
+    pPage = (char*)malloc(Defaults.Log.PageSize);
+    pPageIndex = (LogStore::index_t*)malloc(pPageMaxLines * sizeof(LogStore::index_t));
+
+    if (pPage == nullptr || pPageIndex == nullptr || !pStore.Begin(Defaults.LogDirectory, pFileName) || !pTail.Begin(Defaults.Log.TailSize)) return false;
+
+    pRing = xRingbufferCreate(Defaults.Log.RingSize, RINGBUF_TYPE_NOSPLIT);
+    if (pRing == nullptr) return false;
+
+    return xTaskCreate(task, "LogPipeline", Defaults.Log.TaskStack, this, Defaults.Log.TaskPriority, &pTask) == pdPASS;
+}
+
+void LogPipeline::Endpoint(uint8_t value) {
+    pEndpoint = value;
+
+    // File and syslog are handled here; the DevIQ Log only keeps the serial leg
+    pSink->Endpoint((uint8_t)(value & LOGENDPOINT_SERIAL));
+}
+
+char LogPipeline::LevelChar(uint8_t level) {
+    switch (level) {
+        case LOGLEVEL_ERROR: return 'E';
+        case LOGLEVEL_WARNING: return 'W';
+        case LOGLEVEL_INFO: return 'I';
+        default: return 'D';
+    }
+}
+
+void LogPipeline::Write(const String& message, uint8_t level) {
+    if (!Enabled(level)) return;
+
+    submit(level, message.c_str(), message.length());
+}
+
+void LogPipeline::Writef(uint8_t level, const char* format, ...) {
+    if (!Enabled(level)) return;
+
+    // Most messages fit the stack buffer; longer ones are formatted once more into a heap buffer
+    char buf[160];
+    va_list args;
+
+    va_start(args, format);
+    int n = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    if (n < 0) return;
+
+    if ((size_t)n < sizeof(buf)) {
+        submit(level, buf, n);
+        return;
+    }
+
+    size_t len = min<size_t>(n, LogMaxMessage);
+    char* heap = (char*)malloc(len + 1);
+    if (heap == nullptr) {
+        submit(level, buf, sizeof(buf) - 1);
+        return;
+    }
+
+    va_start(args, format);
+    vsnprintf(heap, len + 1, format, args);
+    va_end(args);
+
+    submit(level, heap, len);
+    free(heap);
+}
+
+static uint32_t logHash(const char* data, size_t len) {
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+// Called with pGuardLock held: only compares and updates state, the hashing is done by the caller
+bool LogPipeline::admit(uint8_t level, uint32_t hash, uint32_t key, const char* module, size_t mlen, uint32_t& repeated, uint8_t& repeatedLevel, log_bucket_t& released) {
+    const uint32_t now = millis();
+
+    // An exact repeat of the previous message only bumps a counter
+    if (hash == pLastHash && level == pLastLevel) {
+        if (pRepeats++ == 0) pRepeatSince = now;
+        pCollapsed++;
+        return false;
+    }
+
+    if (pRepeats > 0) {
+        repeated = pRepeats;
+        repeatedLevel = pLastLevel;
+        pRepeats = 0;
+    }
+    pLastHash = hash;
+    pLastLevel = level;
+
+    // Errors are never rate limited: the one that explains a failure must not be the one that gets dropped
+    if (level == LOGLEVEL_ERROR) return true;
+
+    log_bucket_t* bucket = nullptr;
+    log_bucket_t* victim = &pBuckets[0];
+
+    for (auto& b : pBuckets) {
+        if (b.Key == key && b.Level == level) {
+            bucket = &b;
+            break;
+        }
+        if (victim->Key != 0 && (b.Key == 0 || now - b.Refilled > now - victim->Refilled)) victim = &b;
+    }
+
+    if (bucket == nullptr) {
+        bucket = victim;
+        *bucket = {};
+        bucket->Key = key;
+        bucket->Level = level;
+        bucket->Tokens = Defaults.Log.RateBurst * 1000UL;
+        bucket->Refilled = now;
+        memcpy(bucket->Module, module, mlen);
+    }
+
+    // Refill in thousandths of a message; a long idle bucket is simply full
+    const uint32_t elapsed = min<uint32_t>(now - bucket->Refilled, 60000);
+    bucket->Tokens = min<uint32_t>(Defaults.Log.RateBurst * 1000UL, bucket->Tokens + elapsed * Defaults.Log.RateLimit);
+    bucket->Refilled = now;
+
+    if (bucket->Tokens >= 1000) {
+        bucket->Tokens -= 1000;
+
+        if (bucket->Suppressed > 0) {
+            released = *bucket;
+            bucket->Suppressed = 0;
+        }
+        return true;
+    }
+
+    bucket->Suppressed++;
+    bucket->Total++;
+    pSuppressed++;
+
+    return false;
+}
+
+void LogPipeline::summarize(uint32_t repeated, uint8_t repeatedLevel, const log_bucket_t& released) {
+    char note[64];
+    int n;
+
+    if (repeated > 0) {
+        n = snprintf(note, sizeof(note), "Last message repeated %lu time(s)", (unsigned long)repeated);
+        push(repeatedLevel, note, min<size_t>(n, sizeof(note) - 1));
+    }
+
+    if (released.Suppressed > 0) {
+        n = snprintf(note, sizeof(note), "%s: %lu message(s) suppressed by rate limit", released.Module[0] ? released.Module : "Log", (unsigned long)released.Suppressed);
+        push(released.Level, note, min<size_t>(n, sizeof(note) - 1));
+    }
+}
+
+void LogPipeline::submit(uint8_t level, const char* msg, size_t len) {
+    uint32_t repeated = 0;
+    uint8_t repeatedLevel = 0;
+    log_bucket_t released = {};
+
+    // The module is the "Module: " prefix, when the message has one that fits
+    size_t mlen = 0;
+    const char* colon = (const char*)memchr(msg, ':', min<size_t>(len, sizeof(log_bucket_t::Module)));
+    if (colon != nullptr && (size_t)(colon - msg) + 1 < len && colon[1] == ' ') mlen = colon - msg;
+
+    // Hashed before the spinlock is taken; interrupts on this core stay masked only for the bookkeeping
+    const uint32_t hash = logHash(msg, len);
+    const uint32_t key = logHash(msg, mlen) | 1;
+
+    portENTER_CRITICAL(&pGuardLock);
+    const bool pass = admit(level, hash, key, msg, mlen, repeated, repeatedLevel, released);
+    portEXIT_CRITICAL(&pGuardLock);
+
+    // Summaries go out ahead of the message that triggered them and are never limited themselves
+    summarize(repeated, repeatedLevel, released);
+    if (pass) push(level, msg, len);
+}
+
+void LogPipeline::report() {
+    const uint32_t now = millis();
+    uint32_t repeated = 0;
+    uint8_t repeatedLevel = 0;
+    log_bucket_t released = {};
+
+    portENTER_CRITICAL(&pGuardLock);
+
+    // A long run of one message is summarized periodically, not only once something else is logged
+    if (pRepeats > 0 && now - pRepeatSince >= Defaults.Log.RepeatReportMs) {
+        repeated = pRepeats;
+        repeatedLevel = pLastLevel;
+        pRepeats = 0;
+    }
+
+    // A module that went quiet while limited still gets its count reported, one bucket per pass
+    for (auto& b : pBuckets) {
+        if (b.Suppressed > 0 && now - b.Refilled >= Defaults.Log.RepeatReportMs) {
+            released = b;
+            b.Suppressed = 0;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&pGuardLock);
+
+    summarize(repeated, repeatedLevel, released);
+}
+
+size_t LogPipeline::SuppressedBy(log_bucket_t* out, size_t max) {
+    size_t n = 0;
+
+    portENTER_CRITICAL(&pGuardLock);
+    for (const auto& b : pBuckets) {
+        if (n < max && b.Total > 0) out[n++] = b;
+    }
+    portEXIT_CRITICAL(&pGuardLock);
+
+    return n;
+}
+
+void LogPipeline::push(uint8_t level, const char* msg, size_t len) {
+    // Until the task runs (early boot) behave like the plain DevIQ Log
+    if (pRing == nullptr) {
+        pSink->Write(String(msg, len), (decltype(LOGLEVEL_INFO))level);
+        return;
+    }
+
+    record_t rec = { micros(), (uint32_t)time(nullptr), level };
+    size_t mlen = min<size_t>(len, LogMaxMessage);
+
+    // Never blocks: a full ring costs the record, not the caller
+    void* slot = nullptr;
+    if (xRingbufferSendAcquire(pRing, &slot, sizeof(rec) + mlen, 0) != pdTRUE || slot == nullptr) {
+        pDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    memcpy(slot, &rec, sizeof(rec));
+    memcpy((uint8_t*)slot + sizeof(rec), msg, mlen);
+    xRingbufferSendComplete(pRing, slot);
+
+    pQueued.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LogPipeline::append(const record_t& rec, const char* msg, size_t len) {
+    char stamp[24];
+    time_t t = rec.Epoch;
+    struct tm tmv;
+    localtime_r(&t, &tmv);
+    size_t slen = strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tmv);
+
+    // "[L] YYYY-MM-DD HH:MM:SS message\n"
+    size_t need = 4 + slen + 1 + len + 1;
+    if (pPageUsed + need > Defaults.Log.PageSize || pPageLines == pPageMaxLines) flush();
+    if (need > Defaults.Log.PageSize) len = Defaults.Log.PageSize - (4 + slen + 2);
+
+    if (pPageUsed == 0) pPageOldest = rec.Queued;
+
+    pPageIndex[pPageLines++] = { rec.Epoch, (uint16_t)pPageUsed, (uint16_t)(5 + slen + len), LevelChar(rec.Level) };
+
+    char* p = pPage + pPageUsed;
+    p[0] = '['; p[1] = LevelChar(rec.Level); p[2] = ']'; p[3] = ' ';
+    memcpy(p + 4, stamp, slen);
+    p[4 + slen] = ' ';
+    memcpy(p + 5 + slen, msg, len);
+    p[5 + slen + len] = '\n';
+
+    pPageUsed += 6 + slen + len;
+    pWritten++;
+}
+
+void LogPipeline::flush() {
+    if (pPageUsed == 0) return;
+
+    if (pStore.Append(pPage, pPageUsed, pPageIndex, pPageLines)) {
+        pFlushes++;
+        pBytesWritten += pPageUsed;
+        pFlushLatency.Add(micros() - pPageOldest);
+    } else {
+        pFlushErrors++;
+    }
+
+    pPageUsed = 0;
+    pPageLines = 0;
+}
+
+void LogPipeline::drain(TickType_t wait) {
+    size_t size = 0;
+    void* item = xRingbufferReceive(pRing, &size, wait);
+
+    while (item != nullptr) {
+        const record_t* rec = (const record_t*)item;
+        const char* msg = (const char*)item + sizeof(record_t);
+        size_t len = size - sizeof(record_t);
+
+        if (rec->Level == LogFlushMarker) {
+            flush_waiter_t* waiter;
+            memcpy(&waiter, msg, sizeof(waiter));
+
+            flush();
+            xSemaphoreGive(waiter->Done);
+            release(waiter);
+        } else {
+            // Followers see every record that passed the filters, whichever endpoints are enabled
+            pTail.Append(rec->Epoch, rec->Level, msg, len);
+
+            if (pEndpoint & LOGENDPOINT_FILE) append(*rec, msg, len);
+            if (pEndpoint & LOGENDPOINT_SYSLOG) pSyslog.Enqueue(rec->Epoch, rec->Level, msg, len);
+            if (pEndpoint & LOGENDPOINT_SERIAL) pSink->Write(String(msg, len), (decltype(LOGLEVEL_INFO))rec->Level);
+        }
+
+        vRingbufferReturnItem(pRing, item);
+        item = xRingbufferReceive(pRing, &size, 0);
+    }
+}
+
+void LogPipeline::task(void* arg) {
+    LogPipeline* self = (LogPipeline*)arg;
+
+    for (;;) {
+        self->drain(pdMS_TO_TICKS(Defaults.Log.FlushIntervalMs));
+
+        // Flush on a full page (inside append) or once the oldest buffered record is FlushIntervalMs old
+        if (self->pPageUsed > 0 && (micros() - self->pPageOldest) >= Defaults.Log.FlushIntervalMs * 1000UL) self->flush();
+
+        self->report();
+
+        // Everything drained above goes out in as few datagrams/writes as possible
+        if (self->pEndpoint & LOGENDPOINT_SYSLOG) self->pSyslog.Pump();
+
+        // One closed segment per pass, so records arriving meanwhile wait at most one compaction
+        if (self->pStore.Pending()) self->pStore.Compact();
+    }
+}
+
+bool LogPipeline::Flush(uint32_t timeoutms) {
+    if (pRing == nullptr || xTaskGetCurrentTaskHandle() == pTask) return false;
+
+    flush_waiter_t* waiter = new (std::nothrow) flush_waiter_t{ xSemaphoreCreateBinary(), { 2 } };
+    if (waiter == nullptr) return false;
+
+    if (waiter->Done == nullptr) {
+        delete waiter;
+        return false;
+    }
+
+    // The marker is queued behind everything written so far, so once it is seen all earlier records are on flash
+    uint8_t item[sizeof(record_t) + sizeof(waiter)];
+    record_t rec = { micros(), 0, LogFlushMarker };
+    memcpy(item, &rec, sizeof(rec));
+    memcpy(item + sizeof(rec), &waiter, sizeof(waiter));
+
+    if (xRingbufferSend(pRing, item, sizeof(item), pdMS_TO_TICKS(timeoutms)) != pdTRUE) {
+        release(waiter);
+        release(waiter);
+        return false;
+    }
+
+    const bool done = xSemaphoreTake(waiter->Done, pdMS_TO_TICKS(timeoutms)) == pdTRUE;
+    release(waiter);
+
+    return done;
+}
+
+void LogPipeline::release(flush_waiter_t* waiter) {
+    if (waiter->Refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    vSemaphoreDelete(waiter->Done);
+    delete waiter;
+}
+
+bool LogPipeline::Clear() {
+    if (pRing == nullptr) return pSink->Clear();
+
+    return pStore.Clear();
+}
@@ -0,0 +1,506 @@
+#include "LogStore.h"
+
+#include <LittleFS.h>
+#include <algorithm>
+#include <memory>
+
+#include "Defaults.h"
+
+// Lines closer together than this are fetched with a single read and split in memory
+static constexpr size_t LogStoreBlockMax = 4096;
+
+// Index offsets are 16 bits wide
+static size_t segmentLimit() { return min<size_t>(Defaults.Log.SegmentSize, UINT16_MAX); }
+
+String LogStore::Path(uint32_t sequence, const char* extension) const {
+    char name[24];
+    snprintf(name, sizeof(name), "/%08lu.%s", (unsigned long)sequence, extension);
+    return pDirectory + name;
+}
+
+bool LogStore::Begin(const String& directory, const String& legacy) {
+    pDirectory = directory;
+
+    if (pLock == nullptr) pLock = xSemaphoreCreateMutex();
+    if (pLock == nullptr) return false;
+
+    if (!LittleFS.exists(pDirectory) && !LittleFS.mkdir(pDirectory)) return false;
+
+    // The single unbounded file used before segments is not carried over
+    if (!legacy.isEmpty()) {
+        if (LittleFS.exists(legacy)) LittleFS.remove(legacy);
+        if (LittleFS.exists(legacy + ".1")) LittleFS.remove(legacy + ".1");
+    }
+
+    pFirst = 0;
+    pLast = 0;
+    pActiveSize = 0;
+    pBytes = 0;
+    pCompressed = 0;
+
+    File dir = LittleFS.open(pDirectory);
+    if (!dir) return false;
+
+    std::vector<uint32_t> stale;
+
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+        const char* name = f.name();
+        const char* slash = strrchr(name, '/');
+        if (slash != nullptr) name = slash + 1;
+
+        char* end = nullptr;
+        uint32_t sequence = strtoul(name, &end, 10);
+
+        if (sequence != 0 && (strcmp(end, ".log") == 0 || strcmp(end, ".lz") == 0)) {
+            if (pFirst == 0 || sequence < pFirst) pFirst = sequence;
+            if (sequence > pLast) pLast = sequence;
+        } else if (sequence != 0 && strcmp(end, ".lz~") == 0) {
+            stale.push_back(sequence);
+        }
+
+        f.close();
+    }
+    dir.close();
+
+    // Leftovers of a compaction interrupted before its rename
+    for (uint32_t sequence : stale) LittleFS.remove(Path(sequence, "lz~"));
+
+    if (pLast == 0) {
+        pFirst = 1;
+        pLast = 1;
+    } else {
+        for (uint32_t sequence = pFirst; sequence <= pLast; sequence++) {
+            // Interrupted after the rename: the container is complete, the text is redundant
+            if (LittleFS.exists(Path(sequence, "lz")) && LittleFS.exists(Path(sequence, "log"))) LittleFS.remove(Path(sequence, "log"));
+
+            bool compressed = false;
+            pBytes += storedSize(sequence, compressed) + indexSize(sequence);
+            if (compressed) pCompressed++;
+        }
+
+        // Never append to a compacted segment
+        if (LittleFS.exists(Path(pLast, "lz"))) pLast++;
+
+        bool compressed = false;
+        pActiveSize = storedSize(pLast, compressed);
+    }
+
+    pCompactNext = pFirst;
+
+    prune();
+
+    return true;
+}
+
+size_t LogStore::indexSize(uint32_t sequence) const {
+    File f = LittleFS.open(Path(sequence, "idx"), "r");
+    if (!f) return 0;
+
+    size_t size = f.size();
+    f.close();
+
+    return size;
+}
+
+size_t LogStore::storedSize(uint32_t sequence, bool& compressed) const {
+    compressed = LittleFS.exists(Path(sequence, "lz"));
+
+    File f = LittleFS.open(Path(sequence, compressed ? "lz" : "log"), "r");
+    if (!f) return 0;
+
+    size_t size = f.size();
+    f.close();
+
+    return size;
+}
+
+void LogStore::roll() {
+    pLast++;
+    pActiveSize = 0;
+    pRolls++;
+
+    prune();
+}
+
+void LogStore::prune() {
+    // Segments being exported stay until the reader is done; the next roll catches up
+    if (pPinned.load() > 0) return;
+
+    const uint32_t keep = max<uint32_t>(1, Defaults.Log.MaxSegments);
+
+    while (Segments() > 1 && (Segments() > keep || pBytes > Defaults.Log.MaxStoreSize)) {
+        bool compressed = false;
+        pBytes -= min(pBytes, storedSize(pFirst, compressed) + indexSize(pFirst));
+        if (compressed && pCompressed > 0) pCompressed--;
+
+        LittleFS.remove(Path(pFirst, compressed ? "lz" : "log"));
+        LittleFS.remove(Path(pFirst, "idx"));
+
+        pFirst++;
+        pPruned++;
+    }
+
+    if (pCompactNext < pFirst) pCompactNext = pFirst;
+}
+
+bool LogStore::Append(const char* data, size_t len, index_t* index, size_t count) {
+    if (pLock == nullptr || len == 0) return pLock != nullptr;
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+
+    if (pActiveSize > 0 && pActiveSize + len > segmentLimit()) roll();
+
+    for (size_t i = 0; i < count; i++) index[i].Offset += pActiveSize;
+
+    // Text first: a line that made it to the index is always readable
+    File f = LittleFS.open(Path(pLast, "log"), "a");
+    bool ok = f && f.write((const uint8_t*)data, len) == len;
+    if (f) f.close();
+
+    if (ok) {
+        File x = LittleFS.open(Path(pLast, "idx"), "a");
+        ok = x && x.write((const uint8_t*)index, count * sizeof(index_t)) == count * sizeof(index_t);
+        if (x) x.close();
+
+        pActiveSize += len;
+        pBytes += len + count * sizeof(index_t);
+
+        if (pBytes > Defaults.Log.MaxStoreSize) prune();
+    }
+
+    xSemaphoreGive(pLock);
+
+    return ok;
+}
+
+bool LogStore::Clear() {
+    if (pLock == nullptr) return false;
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+
+    bool ok = true;
+    for (uint32_t sequence = pFirst; sequence <= pLast; sequence++) {
+        if (LittleFS.exists(Path(sequence, "log")) && !LittleFS.remove(Path(sequence, "log"))) ok = false;
+        if (LittleFS.exists(Path(sequence, "lz")) && !LittleFS.remove(Path(sequence, "lz"))) ok = false;
+        if (LittleFS.exists(Path(sequence, "idx"))) LittleFS.remove(Path(sequence, "idx"));
+    }
+
+    pFirst = 1;
+    pLast = 1;
+    pActiveSize = 0;
+    pBytes = 0;
+    pCompressed = 0;
+    pCompactNext = 1;
+
+    xSemaphoreGive(pLock);
+
+    return ok;
+}
+
+bool LogStore::Compact() {
+    if (pLock == nullptr) return false;
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    while (pCompactNext < pLast && !LittleFS.exists(Path(pCompactNext, "log"))) pCompactNext++;
+    const uint32_t sequence = pCompactNext;
+    const bool pending = sequence < pLast && pPinned.load() == 0;
+    xSemaphoreGive(pLock);
+
+    if (!pending) return false;
+
+    // Closed segments never change, so the (slow) compression runs without the lock; the swap re-checks everything
+    const String text = Path(sequence, "log");
+    const String temp = Path(sequence, "lz~");
+
+    bool compressed = false;
+    const size_t raw = storedSize(sequence, compressed);
+    const size_t packed = raw > 0 ? LogCodec::CompressFile(text, temp) : 0;
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+
+    bool swapped = false;
+    bool done = packed > 0 && packed >= raw;
+
+    if (packed > 0 && packed < raw && sequence >= pFirst && pPinned.load() == 0 && LittleFS.exists(text) && LittleFS.rename(temp, Path(sequence, "lz"))) {
+        LittleFS.remove(text);
+
+        pBytes -= min(pBytes, raw);
+        pBytes += packed;
+        pCompressed++;
+        pCompactions++;
+        pSaved += raw - packed;
+
+        swapped = true;
+        done = true;
+    } else if (packed > 0) {
+        LittleFS.remove(temp);
+    }
+
+    // Incompressible segments stay as text; anything else that failed is retried on a later pass
+    if (done && pCompactNext == sequence) pCompactNext++;
+
+    xSemaphoreGive(pLock);
+
+    return swapped;
+}
+
+bool LogStore::readIndex(uint32_t sequence, std::vector<index_t>& index) const {
+    index.clear();
+
+    File f = LittleFS.open(Path(sequence, "idx"), "r");
+    if (!f) return false;
+
+    const size_t count = f.size() / sizeof(index_t);
+    index.resize(count);
+
+    bool ok = f.read((uint8_t*)index.data(), count * sizeof(index_t)) == count * sizeof(index_t);
+    f.close();
+
+    if (!ok) index.clear();
+    return ok;
+}
+
+void LogStore::emit(const std::vector<hit_t>& hits, const line_callback_t& each) const {
+    size_t i = 0;
+
+    while (i < hits.size()) {
+        const uint32_t sequence = hits[i].Sequence;
+        size_t j = i;
+        while (j < hits.size() && hits[j].Sequence == sequence) j++;
+
+        uint16_t longest = 0;
+        for (size_t k = i; k < j; k++) if (hits[k].Index.Length > longest) longest = hits[k].Index.Length;
+
+        if (LittleFS.exists(Path(sequence, "lz"))) {
+            // Compacted segment: decode forward once, skipping the text between the wanted lines
+            LogDecoder decoder(LittleFS.open(Path(sequence, "lz"), "r"));
+            std::unique_ptr<char[]> line(new (std::nothrow) char[longest + 1]);
+            size_t pos = 0;
+
+            if (line && decoder.Begin()) {
+                for (size_t k = i; k < j; k++) {
+                    const size_t offset = hits[k].Index.Offset;
+                    const size_t length = hits[k].Index.Length;
+
+                    if (offset < pos || decoder.Skip(offset - pos) != offset - pos) break;
+                    if (decoder.Read((uint8_t*)line.get(), length) != length) break;
+
+                    pos = offset + length;
+                    each(String(line.get(), length));
+                }
+            }
+        } else {
+            File f = LittleFS.open(Path(sequence, "log"), "r");
+            if (f) {
+                const size_t start = hits[i].Index.Offset;
+                const size_t end = hits[j - 1].Index.Offset + hits[j - 1].Index.Length;
+
+                if (end >= start && end - start <= LogStoreBlockMax) {
+                    // Consecutive lines (an unfiltered tail, or a dense filtered one) cost one seek and one read
+                    std::unique_ptr<char[]> block(new (std::nothrow) char[end - start]);
+
+                    if (block && f.seek(start) && f.read((uint8_t*)block.get(), end - start) == end - start) {
+                        for (size_t k = i; k < j; k++) each(String(block.get() + (hits[k].Index.Offset - start), hits[k].Index.Length));
+                    }
+                } else {
+                    std::unique_ptr<char[]> line(new (std::nothrow) char[longest + 1]);
+
+                    for (size_t k = i; line && k < j; k++) {
+                        if (!f.seek(hits[k].Index.Offset)) break;
+                        if (f.read((uint8_t*)line.get(), hits[k].Index.Length) != hits[k].Index.Length) break;
+                        each(String(line.get(), hits[k].Index.Length));
+                    }
+                }
+
+                f.close();
+            }
+        }
+
+        i = j;
+    }
+}
+
+size_t LogStore::Tail(size_t n, char level, const line_callback_t& each) {
+    if (pLock == nullptr || n == 0) return 0;
+
+    // Pinned like a Reader, so only the segment range is taken under the lock; indexes are read and segments decoded
+    // without it and the log task's Append never waits behind flash reads
+    pPinned++;
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    const uint32_t first = pFirst;
+    const uint32_t last = pLast;
+    xSemaphoreGive(pLock);
+
+    std::vector<hit_t> hits;
+    hits.reserve(n);
+    std::vector<index_t> index;
+
+    // Newest segment first, newest line first, until enough lines matched
+    for (uint32_t sequence = last; sequence >= first && hits.size() < n; sequence--) {
+        if (!readIndex(sequence, index)) continue;
+
+        for (size_t k = index.size(); k-- > 0 && hits.size() < n; ) {
+            if (level == '\0' || index[k].Level == level) hits.push_back({ sequence, index[k] });
+        }
+    }
+
+    std::reverse(hits.begin(), hits.end());
+    emit(hits, each);
+
+    pPinned--;
+
+    return hits.size();
+}
+
+size_t LogStore::Range(uint32_t from, uint32_t to, char level, size_t limit, const line_callback_t& each) {
+    if (pLock == nullptr || limit == 0) return 0;
+
+    // Same pinning as Tail
+    pPinned++;
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    const uint32_t first = pFirst;
+    const uint32_t last = pLast;
+    xSemaphoreGive(pLock);
+
+    std::vector<hit_t> hits;
+    std::vector<index_t> index;
+
+    // The clock can step backwards (NTP, reboot before sync), so every index entry is checked rather than bisected
+    for (uint32_t sequence = first; sequence <= last && hits.size() < limit; sequence++) {
+        if (!readIndex(sequence, index)) continue;
+
+        for (size_t k = 0; k < index.size() && hits.size() < limit; k++) {
+            if (index[k].Epoch < from || index[k].Epoch > to) continue;
+            if (level == '\0' || index[k].Level == level) hits.push_back({ sequence, index[k] });
+        }
+    }
+
+    emit(hits, each);
+
+    pPinned--;
+
+    return hits.size();
+}
+
+std::vector<LogStore::segment_t> LogStore::Snapshot() {
+    std::vector<segment_t> segments;
+    if (pLock == nullptr) return segments;
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+
+    for (uint32_t sequence = pFirst; sequence <= pLast; sequence++) {
+        if (sequence == pLast) {
+            if (pActiveSize > 0) segments.push_back({ sequence, pActiveSize, false });
+            continue;
+        }
+
+        bool compressed = false;
+        size_t size = storedSize(sequence, compressed);
+        if (size > 0) segments.push_back({ sequence, size, compressed });
+    }
+
+    xSemaphoreGive(pLock);
+
+    return segments;
+}
+
+LogStore::Reader::Reader(LogStore& store, bool packed) : pStore(store), pPacked(packed) {
+    // Pinned before the snapshot, so nothing it lists is compacted or pruned underneath
+    pStore.pPinned++;
+    pSegments = pStore.Snapshot();
+}
+
+LogStore::Reader::~Reader() {
+    close();
+    pStore.pPinned--;
+}
+
+bool LogStore::Reader::open() {
+    const segment_t& segment = pSegments[pCurrent];
+    pOffset = 0;
+
+    if (pPacked && !segment.Compressed) {
+        // Text segment (normally the active one): compress the snapshot length into RAM
+        File f = LittleFS.open(pStore.Path(segment.Sequence, "log"), "r");
+        if (!f) return false;
+
+        std::unique_ptr<uint8_t[]> data(new (std::nothrow) uint8_t[segment.Size]);
+        bool ok = data && f.read(data.get(), segment.Size) == segment.Size;
+        f.close();
+
+        return ok && LogCodec::Compress(data.get(), segment.Size, [this](const uint8_t* chunk, size_t n) -> bool {
+            pPackedData.insert(pPackedData.end(), chunk, chunk + n);
+            return true;
+        });
+    }
+
+    pFile = LittleFS.open(pStore.Path(segment.Sequence, segment.Compressed ? "lz" : "log"), "r");
+    if (!pFile) return false;
+
+    if (segment.Compressed && !pPacked) {
+        pDecoder.reset(new (std::nothrow) LogDecoder(pFile));
+        return pDecoder && pDecoder->Begin();
+    }
+
+    return true;
+}
+
+void LogStore::Reader::close() {
+    pDecoder.reset();
+    if (pFile) pFile.close();
+    std::vector<uint8_t>().swap(pPackedData);
+}
+
+void LogStore::Reader::Rewind() {
+    close();
+    pCurrent = 0;
+    pOffset = 0;
+}
+
+size_t LogStore::Reader::Read(uint8_t* buffer, size_t len) {
+    size_t total = 0;
+
+    while (total < len && pCurrent < pSegments.size()) {
+        const segment_t& segment = pSegments[pCurrent];
+
+        if (!pFile && pPackedData.empty() && !open()) {
+            close();
+            pCurrent = pSegments.size();
+            break;
+        }
+
+        size_t n = 0;
+        bool done = false;
+
+        if (pDecoder) {
+            n = pDecoder->Read(buffer + total, len - total);
+            done = n < len - total;
+        } else if (!pPackedData.empty()) {
+            n = min(len - total, pPackedData.size() - pOffset);
+            memcpy(buffer + total, pPackedData.data() + pOffset, n);
+            done = pOffset + n >= pPackedData.size();
+        } else {
+            // Never past the snapshot size, so lines appended since then are left for the next export
+            const size_t want = min(len - total, segment.Size - pOffset);
+            n = pFile.read(buffer + total, want);
+            done = pOffset + n >= segment.Size;
+
+            if (n < want) {
+                close();
+                pCurrent = pSegments.size();
+                total += n;
+                break;
+            }
+        }
+
+        total += n;
+        pOffset += n;
+
+        if (done) {
+            close();
+            pCurrent++;
+        }
+    }
+
+    return total;
+}
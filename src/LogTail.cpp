@@ -0,0 +1,112 @@
+#include "LogTail.h"
+
+bool LogTail::Begin(size_t size) {
+    if (pBuffer != nullptr) return true;
+
+    pLock = xSemaphoreCreateMutex();
+    pBuffer = (uint8_t*)malloc(size);
+    if (pLock == nullptr || pBuffer == nullptr) return false;
+
+    pSize = size;
+    return true;
+}
+
+void LogTail::copyIn(size_t offset, const void* data, size_t len) {
+    const size_t first = min<size_t>(len, pSize - offset);
+
+    memcpy(pBuffer + offset, data, first);
+    if (first < len) memcpy(pBuffer, (const uint8_t*)data + first, len - first);
+}
+
+void LogTail::copyOut(size_t offset, void* data, size_t len) const {
+    const size_t first = min<size_t>(len, pSize - offset);
+
+    memcpy(data, pBuffer + offset, first);
+    if (first < len) memcpy((uint8_t*)data + first, pBuffer, len - first);
+}
+
+void LogTail::evict() {
+    header_t h;
+    copyOut(pHead, &h, sizeof(h));
+
+    const size_t total = sizeof(h) + h.Length;
+    pHead = (pHead + total) % pSize;
+    pUsed -= total;
+    pFirst++;
+    pEvicted++;
+}
+
+void LogTail::Append(uint32_t epoch, uint8_t level, const char* msg, size_t len) {
+    if (pBuffer == nullptr) return;
+
+    header_t h = { 0, epoch, (uint16_t)min<size_t>(len, LOGTAIL_MAXMESSAGE), level };
+    const size_t total = sizeof(h) + h.Length;
+    if (total > pSize) return;
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+
+    while (pUsed + total > pSize) evict();
+
+    h.Sequence = pNext;
+    const size_t offset = (pHead + pUsed) % pSize;
+    copyIn(offset, &h, sizeof(h));
+    copyIn((offset + sizeof(h)) % pSize, msg, h.Length);
+
+    pUsed += total;
+    pNext++;
+
+    xSemaphoreGive(pLock);
+}
+
+LogTail::cursor_t LogTail::Start(size_t backlog) {
+    if (pBuffer == nullptr) return { 0, 0 };
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+
+    cursor_t cursor = { pFirst, pHead };
+
+    for (uint32_t remaining = pNext - pFirst; remaining > backlog; remaining--) {
+        header_t h;
+        copyOut(cursor.Offset, &h, sizeof(h));
+
+        cursor.Offset = (cursor.Offset + sizeof(h) + h.Length) % pSize;
+        cursor.Sequence++;
+    }
+
+    xSemaphoreGive(pLock);
+    return cursor;
+}
+
+bool LogTail::Read(cursor_t& cursor, record_t& out, uint32_t& skipped) {
+    skipped = 0;
+    if (pBuffer == nullptr) return false;
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+
+    if ((int32_t)(cursor.Sequence - pNext) >= 0) {
+        xSemaphoreGive(pLock);
+        return false;
+    }
+
+    // Lapped by the writer: the offset is stale, resume at the oldest record left
+    if ((int32_t)(cursor.Sequence - pFirst) < 0) {
+        skipped = pFirst - cursor.Sequence;
+        cursor = { pFirst, pHead };
+    }
+
+    header_t h;
+    copyOut(cursor.Offset, &h, sizeof(h));
+    copyOut((cursor.Offset + sizeof(h)) % pSize, out.Message, h.Length);
+
+    out.Sequence = h.Sequence;
+    out.Epoch = h.Epoch;
+    out.Level = h.Level;
+    out.Length = h.Length;
+    out.Message[h.Length] = '\0';
+
+    cursor.Offset = (cursor.Offset + sizeof(h) + h.Length) % pSize;
+    cursor.Sequence++;
+
+    xSemaphoreGive(pLock);
+    return true;
+}
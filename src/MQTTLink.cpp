@@ -0,0 +1,245 @@
+#include "MQTTLink.h"
+
+#include <ArduinoJson.h>
+
+#include "Settings.h"
+
+extern settings_t Settings;
+
+extern LogPipeline* devLog;
+extern MQTT* devMQTT;
+
+void mqttlink::Begin() {
+    pBackoffMs = 0;
+    pNextAttempt = millis();
+    pState = MQTTLINK_WAITING;
+    pStatsSince = millis();
+
+    LOG_I("MQTT: Connecting to %s@%s:%u", Settings.MQTT.User().c_str(), Settings.MQTT.Broker().c_str(), (unsigned)Settings.MQTT.Port());
+}
+
+void mqttlink::End() {
+    pState = MQTTLINK_IDLE;
+}
+
+void mqttlink::Control() {
+    benchmark();
+
+    switch (pState) {
+        case MQTTLINK_IDLE: {
+        } break;
+
+        case MQTTLINK_WAITING: {
+            if ((int32_t)(millis() - pNextAttempt) >= 0) attempt();
+        } break;
+
+        case MQTTLINK_CONNECTING: {
+            if (pConnectRunning.load(std::memory_order_acquire)) break;
+
+            if (pConnectResult.load(std::memory_order_relaxed)) {
+                connected();
+                break;
+            }
+
+            pConnectFailures++;
+
+            // Only the first failure of a streak is an error, retries would flood the log
+            if (pBackoffMs == 0) {
+                LOG_E("MQTT: Unable to connect to %s@%s:%u - retrying in background", Settings.MQTT.User().c_str(), Settings.MQTT.Broker().c_str(), (unsigned)Settings.MQTT.Port());
+            }
+
+            scheduleRetry();
+        } break;
+
+        case MQTTLINK_CONNECTED: {
+            devMQTT->Control();
+
+            if (!devMQTT->Connected()) {
+                pDisconnects++;
+                LOG_W("MQTT: Connection to %s:%u lost", Settings.MQTT.Broker().c_str(), (unsigned)Settings.MQTT.Port());
+                scheduleRetry();
+            }
+        } break;
+    }
+}
+
+void mqttlink::connectTask(void* arg) {
+    mqttlink* link = static_cast<mqttlink*>(arg);
+
+    link->pConnectResult.store(devMQTT->Connect(), std::memory_order_relaxed);
+    link->pConnectRunning.store(false, std::memory_order_release);
+
+    vTaskDelete(nullptr);
+}
+
+void mqttlink::attempt() {
+    // A connect left over from before End() still owns the client
+    if (pConnectRunning.load(std::memory_order_acquire)) return;
+
+    // The connect blocks for up to the client timeout while the broker is down; loop() only watches for the outcome
+    pConnectResult.store(false, std::memory_order_relaxed);
+    pConnectRunning.store(true, std::memory_order_release);
+
+    if (xTaskCreate(connectTask, "MQTTConnect", Defaults.MQTT.ConnectStack, this, Defaults.MQTT.ConnectPriority, nullptr) != pdPASS) {
+        pConnectRunning.store(false, std::memory_order_release);
+        pConnectFailures++;
+        scheduleRetry();
+        return;
+    }
+
+    pState = MQTTLINK_CONNECTING;
+}
+
+void mqttlink::connected() {
+    pState = MQTTLINK_CONNECTED;
+    pConnects++;
+    pBackoffMs = 0;
+    pConnectedSince = millis();
+
+    LOG_I("MQTT: Connected on %s@%s:%u", Settings.MQTT.User().c_str(), Settings.MQTT.Broker().c_str(), (unsigned)Settings.MQTT.Port());
+
+    // Alias mode is latched per session so subscribers never see an unannounced alias
+    pAliasesActive = Settings.MQTT.TopicAliases();
+    if (pAliasesActive) announceAliases();
+
+    // Broker may have missed changes while we were away
+    for (auto m : Settings.Components) { m->Refresh(); }
+}
+
+void mqttlink::scheduleRetry() {
+    pBackoffMs = (pBackoffMs == 0) ? Defaults.MQTT.ReconnectMinMs : min<uint32_t>(pBackoffMs * 2, Defaults.MQTT.ReconnectMaxMs);
+
+    // Full backoff +/- 25% so a fleet of devices does not reconnect in lockstep after a broker restart
+    uint32_t jitter = esp_random() % (pBackoffMs / 2 + 1);
+    pNextAttempt = millis() + (pBackoffMs - pBackoffMs / 4) + jitter;
+    pState = MQTTLINK_WAITING;
+}
+
+uint32_t mqttlink::RetryIn() const noexcept {
+    if (pState != MQTTLINK_WAITING) return 0;
+
+    int32_t remaining = (int32_t)(pNextAttempt - millis());
+    return (remaining > 0) ? (uint32_t)remaining : 0;
+}
+
+bool mqttlink::Publish(const String& topic, const String& payload, bool retained) {
+    if (devMQTT == nullptr || pState == MQTTLINK_IDLE) return false;
+
+    if (pState != MQTTLINK_CONNECTED) {
+        pPublishFailures++;
+        return false;
+    }
+
+    uint32_t start = micros();
+    bool sent = devMQTT->Publish(topic, payload, retained);
+    pPublishLatency.Add(micros() - start);
+
+    if (!sent) {
+        pPublishFailures++;
+        return false;
+    }
+
+    pPublishes++;
+    pPublishedBytes += topic.length() + payload.length();
+    return true;
+}
+
+bool mqttlink::Publish(uint16_t alias, const String& payload) {
+    if (!pTopics.Valid(alias)) return false;
+
+    if (!pAliasesActive) return Publish(pTopics.Topic(alias), payload);
+
+    if (!Publish(pTopics.AliasTopic(alias), payload)) return false;
+
+    // Topic bytes the alias kept off the air, so the saving can be read from "mqtt stats"
+    pAliasSavedBytes += pTopics.Topic(alias).length() - pTopics.AliasTopic(alias).length();
+    return true;
+}
+
+bool mqttlink::PublishNumber(uint16_t alias, float value) {
+    return Publish(alias, Settings.MQTT.CompactPayload() ? mqtttopics::CompactNumber(value) : String(value));
+}
+
+uint16_t mqttlink::RegisterTopic(const String& topic) {
+    return pTopics.Register(topic, Settings.Network.Hostname());
+}
+
+void mqttlink::ClearTopics() {
+    pTopics.Clear();
+}
+
+void mqttlink::announceAliases() {
+    // One retained document, so subscribers that connect later still resolve <hostname>/A/<n> from the broker
+    JsonDocument map;
+    for (uint16_t i = 1; i <= pTopics.Count(); i++) map[String(i)] = pTopics.Topic(i);
+
+    String json;
+    serializeJson(map, json);
+
+    if (!Publish(Settings.Network.Hostname() + "/Aliases", json, true)) {
+        LOG_W("MQTT: Unable to publish the topic alias map (%u topics)", (unsigned)pTopics.Count());
+    }
+}
+
+void mqttlink::ResetStats() noexcept {
+    pPublishes = 0;
+    pPublishFailures = 0;
+    pPublishedBytes = 0;
+    pAliasSavedBytes = 0;
+    pReceived = 0;
+    pPublishLatency.Reset();
+    pSetLatency.Reset();
+    pStatsSince = millis();
+}
+
+bool mqttlink::StartBenchmark(uint16_t count, uint16_t size) {
+    MQTTBenchState state = pBench.load(std::memory_order_acquire);
+    if (state != MQTTBENCH_IDLE && state != MQTTBENCH_DONE) return false;
+
+    pBenchCount = count;
+    pBenchSize = size;
+
+    return pBench.compare_exchange_strong(state, MQTTBENCH_REQUESTED, std::memory_order_release);
+}
+
+void mqttlink::benchmark() {
+    const MQTTBenchState state = pBench.load(std::memory_order_acquire);
+    if (state != MQTTBENCH_REQUESTED && state != MQTTBENCH_RUNNING) return;
+
+    if (state == MQTTBENCH_REQUESTED) {
+        pBenchPayload = "";
+        pBenchPayload.reserve(pBenchSize);
+        for (uint16_t i = 0; i < pBenchSize; i++) pBenchPayload += (char)('a' + (i % 26));
+
+        pBenchLatency.Reset();
+        pBenchSent = 0;
+        pBenchStart = millis();
+        pBench.store(MQTTBENCH_RUNNING, std::memory_order_relaxed);
+    }
+
+    // One slice per pass; the client drains its socket in Control() between slices, so this is the sustained rate
+    const String topic = Settings.Network.Hostname() + "/Bench";
+
+    for (uint8_t i = 0; i < Defaults.MQTT.BenchSlice && pBenchSent < pBenchCount && Connected(); i++) {
+        uint32_t t0 = micros();
+        Publish(topic, pBenchPayload);
+        pBenchLatency.Add(micros() - t0);
+        pBenchSent++;
+    }
+
+    if (pBenchSent < pBenchCount && Connected()) return;
+
+    pBenchElapsed = max<uint32_t>(millis() - pBenchStart, 1);
+    pBenchPayload = "";
+    pBench.store(MQTTBENCH_DONE, std::memory_order_release);
+}
+
+const char* mqttlink::StateToString(MQTTLinkState state) {
+    switch (state) {
+        case MQTTLINK_IDLE: return "Idle";
+        case MQTTLINK_WAITING: return "Waiting";
+        case MQTTLINK_CONNECTING: return "Connecting";
+        case MQTTLINK_CONNECTED: return "Connected";
+    }
+    return "?";
+}
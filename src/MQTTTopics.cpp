@@ -0,0 +1,62 @@
+#include "MQTTTopics.h"
+
+uint16_t mqtttopics::Register(const String& topic, const String& hostname) {
+    for (size_t i = 0; i < pTopics.size(); i++) {
+        if (pTopics[i] == topic) return (uint16_t)(i + 1);
+    }
+
+    pTopics.push_back(topic);
+    pAliasTopics.push_back(hostname + "/A/" + String((unsigned)pTopics.size()));
+
+    return (uint16_t)pTopics.size();
+}
+
+void mqtttopics::Clear() {
+    pTopics.clear();
+    pAliasTopics.clear();
+}
+
+bool mqtttopics::ParseSet(const String& topic, const String& prefix, const String& payload, mqtt_set_t& set) {
+    if (!topic.startsWith(prefix)) return false;
+
+    String rest = topic.substring(prefix.length());
+
+    int slash = rest.indexOf('/');
+    if (slash >= 0) rest = rest.substring(0, slash);
+
+    int colon1 = rest.indexOf(':');
+    int colon2 = rest.indexOf(':', colon1 + 1);
+
+    if (colon1 <= 0 || colon2 <= colon1 + 1 || colon2 >= (int)rest.length() - 1) return false;
+
+    set.Class    = rest.substring(0, colon1);
+    set.Name     = rest.substring(colon1 + 1, colon2);
+    set.Property = rest.substring(colon2 + 1);
+    set.Payload  = payload;
+
+    set.Class.trim();
+    set.Name.trim();
+    set.Property.trim();
+    set.Payload.trim();
+
+    set.Property.toLowerCase();
+    set.Payload.toLowerCase();
+
+    return true;
+}
+
+String mqtttopics::CompactNumber(float value) {
+    // Shortest text that still parses back to the same 2-decimal value: 21.50 -> 21.5, 20.00 -> 20
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%.2f", value);
+
+    char* dot = strchr(buf, '.');
+    if (dot != nullptr) {
+        char* end = buf + strlen(buf) - 1;
+        while (end > dot && *end == '0') *end-- = '\0';
+        if (end == dot) *end = '\0';
+    }
+
+    if (strcmp(buf, "-0") == 0) return String("0");
+    return String(buf);
+}
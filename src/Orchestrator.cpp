@@ -1,11 +1,12 @@
 #include "Orchestrator.h"
 
 #include "Tools.h"
+#include "CommandBus.h"
 #include "Version.h"
 
 extern settings_t Settings;
 
-extern Log* devLog;
+extern LogPipeline* devLog;
 extern FileSystem* devFileSystem;
 extern Network* devNetwork;
 extern Clock *devClock;
@@ -13,79 +14,149 @@ extern bool g_cmdCheckNow;
 
 // orchestrator& orchestrator::getInstance() { static orchestrator instance; return instance; }
 
-const JsonObjectConst orchestrator::SendUDP(const String &target, const uint16_t port, const JsonObjectConst &payload) {
-    static JsonDocument s_doc;
-    static AsyncUDP s_udp;
-    static SemaphoreHandle_t s_sem;
-    static String s_rx;
-    static IPAddress s_rip;
-
-    s_doc.clear();
-
-    if (WiFi.status() != WL_CONNECTED) return JsonObjectConst(); // vazio
-
-    if (s_sem == nullptr) {
-        s_sem = xSemaphoreCreateBinary();
-        if (!s_sem) return JsonObjectConst();
-    }
+uint32_t orchestrator::SendRequest(const String& target, uint16_t port, const JsonObjectConst& payload, orchestrator_reply_t callback) {
+    if (pInboxLock == nullptr || WiFi.status() != WL_CONNECTED || pRequests.size() >= Defaults.Orchestrator.MaxRequests) return 0;
 
+    // Name resolution would block the loop; targets are addresses or "broadcast"
     IPAddress ip;
     if (target.equalsIgnoreCase("broadcast")) {
         ip = IPAddress(255, 255, 255, 255);
     } else if (!ip.fromString(target)) {
-        if (!WiFi.hostByName(target.c_str(), ip)) return JsonObjectConst();
+        return 0;
     }
 
-    s_udp.close();
-    if (!s_udp.listen(0)) return JsonObjectConst();
+    if (!pRequestUdp.connected()) {
+        if (!pRequestUdp.listen(0)) return 0;
+        pRequestUdp.onPacket([this](AsyncUDPPacket packet) { this->handleUdpPacket(packet); });
+    }
 
-    s_rx = "";
-    s_rip = IPAddress();
+    const uint32_t id = pNextID++;
+    if (pNextID == 0) pNextID = 1;
 
-    s_udp.onPacket([](AsyncUDPPacket p) {
-        if (s_rx.isEmpty()) {
-            s_rip = p.remoteIP();
-            s_rx  = String((const char*)p.data(), p.length());
-            xSemaphoreGive(s_sem);
+    // Replies are matched on the echoed ID
+    JsonDocument doc;
+    doc.set(payload);
+    doc["Request ID"] = id;
+
+    request_t request = { id, ip, port, "", 0, millis(), Defaults.Orchestrator.RequestTimeoutMs, callback };
+    serializeJson(doc, request.Payload);
+    pRequests.push_back(std::move(request));
+
+    return id;
+}
+
+void orchestrator::CancelRequest(uint32_t id) {
+    for (auto it = pRequests.begin(); it != pRequests.end(); ++it) {
+        if (it->ID == id) {
+            pRequests.erase(it);
+            return;
         }
-    });
+    }
+}
 
-    String out;
-    serializeJson(payload, out);
+void orchestrator::handleReply(const reply_t& reply) {
+    JsonDocument doc;
 
-    if (s_udp.writeTo((const uint8_t*)out.c_str(), out.length(), ip, port) == 0) {
-        s_udp.close();
-        return JsonObjectConst();
+    if (deserializeJson(doc, reply.Payload.c_str(), reply.Payload.length())) {
+        // Not JSON: handed over as is
+        doc.clear();
+        doc["Payload"] = reply.Payload;
+        doc["Size"] = (size_t)reply.Payload.length();
+        doc["From"] = reply.From.toString();
     }
 
-    const uint32_t timeout_ms = 1000;
-    if (xSemaphoreTake(s_sem, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
-        s_udp.close();
-        return JsonObjectConst();
+    // Servers that do not echo the ID answer the oldest request
+    auto match = pRequests.end();
+    if (doc["Request ID"].is<uint32_t>()) {
+        const uint32_t id = doc["Request ID"].as<uint32_t>();
+        for (auto it = pRequests.begin(); it != pRequests.end(); ++it) {
+            if (it->ID == id) { match = it; break; }
+        }
+    } else if (!pRequests.empty()) {
+        match = pRequests.begin();
     }
 
-    DeserializationError err = deserializeJson(s_doc, s_rx.c_str(), s_rx.length());
-    if (!err) {
-        s_udp.close();
-        return s_doc.as<JsonObjectConst>();
+    if (match == pRequests.end()) {
+        pUnmatched++;
+        return;
     }
 
-    s_doc.clear();
-    {
-        JsonObject root = s_doc.to<JsonObject>();
-        root["Payload"] = s_rx;
-        root["Size"]    = (size_t)s_rx.length();
+    // Taken out first, so the callback may queue new requests
+    orchestrator_reply_t callback = std::move(match->Callback);
+    pRequests.erase(match);
+
+    if (callback) callback(true, doc.as<JsonObjectConst>(), reply.From);
+}
+
+void orchestrator::Control() {
+    if (pInboxLock == nullptr) return;
+
+    pLink.Target(Settings.Orchestrator.Assigned() ? Settings.Orchestrator.IP_Address() : IPAddress(), Defaults.Orchestrator.SessionPort);
+    pLink.Control();
 
-        char ipstr[16];
-        snprintf(ipstr, sizeof(ipstr), "%u.%u.%u.%u", s_rip[0], s_rip[1], s_rip[2], s_rip[3]);
-        root["From"] = ipstr;
+    for (;;) {
+        reply_t reply;
+
+        xSemaphoreTake(pInboxLock, portMAX_DELAY);
+        if (pInbox.empty()) {
+            xSemaphoreGive(pInboxLock);
+            break;
+        }
+        reply = std::move(pInbox.front());
+        pInbox.pop_front();
+        xSemaphoreGive(pInboxLock);
+
+        handleReply(reply);
     }
 
-    s_udp.close();
-    return s_doc.as<JsonObjectConst>();
+    const uint32_t now = millis();
+
+    for (size_t i = 0; i < pRequests.size();) {
+        request_t& request = pRequests[i];
+
+        if ((int32_t)(now - request.NextSend) < 0) {
+            i++;
+            continue;
+        }
+
+        if (request.Attempts >= Defaults.Orchestrator.RequestAttempts) {
+            orchestrator_reply_t callback = std::move(request.Callback);
+            pRequests.erase(pRequests.begin() + i);
+            pTimeouts++;
+
+            if (callback) callback(false, JsonObjectConst(), IPAddress());
+            continue;
+        }
+
+        pRequestUdp.writeTo((const uint8_t*)request.Payload.c_str(), request.Payload.length(), request.Target, request.Port);
+
+        request.Attempts++;
+        request.NextSend = now + request.Interval;
+        request.Interval = min<uint32_t>(request.Interval * 2, Defaults.Orchestrator.RequestTimeoutMaxMs);
+        i++;
+    }
 }
 
 void orchestrator::Begin() {
+    if (pInboxLock == nullptr) pInboxLock = xSemaphoreCreateMutex();
+
+    if (pCommands == nullptr) {
+        pCommands = xQueueCreate(Defaults.Orchestrator.MaxCommands, sizeof(String*));
+
+        if (pCommands == nullptr || xTaskCreate(worker, "Orchestrator", Defaults.Orchestrator.WorkerStack, this, Defaults.Orchestrator.WorkerPriority, &pWorker) != pdPASS) {
+            LOG_E("Orchestrator: Unable to start the command worker - session commands will be ignored");
+        }
+    }
+
+    pLink.Begin([this](const JsonObjectConst& cmd) { queueCommand(cmd); }, [](JsonDocument& hello) {
+        hello["Provider"] = Defaults.Orchestrator.Provider;
+        hello["Hostname"] = devNetwork->Hostname();
+        hello["MAC Address"] = devNetwork->MAC_Address();
+        hello["Server ID"] = Settings.Orchestrator.ServerID();
+        hello["Version"] = Version.Software.Info();
+    });
+
+    // Non-blocking: the answer is picked up by Control()
     FindOrchestratorServer();
 
     if (!udp.listen(Defaults.Orchestrator.Port)) {
@@ -97,6 +168,18 @@ void orchestrator::Begin() {
 }
 
 void orchestrator::handleUdpPacket(AsyncUDPPacket& packet) {
+    pReceived++;
+
+    // Replies to our own requests come back on the request socket's port
+    if (packet.localPort() != Defaults.Orchestrator.Port) {
+        if (pInboxLock == nullptr) return;
+
+        xSemaphoreTake(pInboxLock, portMAX_DELAY);
+        if (pInbox.size() < Defaults.Orchestrator.MaxInbox) pInbox.push_back({ packet.remoteIP(), String((const char*)packet.data(), packet.length()) });
+        xSemaphoreGive(pInboxLock);
+        return;
+    }
+
     // Debug - print whatever arrives
     // Serial.printf("\r\n---\r\n"); Serial.println((char*)packet.data()); Serial.printf("---\r\n");
 
@@ -105,8 +188,41 @@ void orchestrator::handleUdpPacket(AsyncUDPPacket& packet) {
         return;
     }
 
+    dispatch(doc.as<JsonObjectConst>());
+}
+
+// Called by the link on the loop task, which must never run a handler: they wait on the CommandBus, which only
+// drains on the loop task, and open their own connections to stream files
+void orchestrator::queueCommand(const JsonObjectConst& doc) {
+    if (pWorker == nullptr) return;
+
+    String* frame = new String();
+    serializeJson(doc, *frame);
+
+    if (xQueueSend(pCommands, &frame, 0) != pdTRUE) {
+        delete frame;
+        pCommandsDropped++;
+        LOG_W("Orchestrator: Command queue full, dropping [%s]", doc["Command"] | "");
+    }
+}
+
+void orchestrator::worker(void* arg) {
+    orchestrator* self = static_cast<orchestrator*>(arg);
+    String* frame = nullptr;
+
+    for (;;) {
+        if (xQueueReceive(self->pCommands, &frame, portMAX_DELAY) != pdTRUE) continue;
+
+        JsonDocument doc;
+        if (deserializeJson(doc, *frame) == DeserializationError::Ok) self->dispatch(doc.as<JsonObjectConst>());
+
+        delete frame;
+    }
+}
+
+// Commands arrive as UDP datagrams on the UDP task or pushed over the session and run on the worker, never on the loop task
+void orchestrator::dispatch(const JsonObjectConst& doc) {
     String request = doc["Command"] | "";
-    IPAddress senderIp = packet.remoteIP();
     
     if (request == "Discover") { Discover(doc); }
     else if (request == "Restart") { Restart(doc); }
@@ -119,17 +235,17 @@ void orchestrator::handleUdpPacket(AsyncUDPPacket& packet) {
     else if (request == "Push") { Push(doc); }
     else if (request == "GetLog") { GetLog(doc); }
     else if (request == "ClearLog") { ClearLog(doc); }
-    else { devLog->Write("Orchestrator: Unknown request [" + request + "]", LOGLEVEL_WARNING); }
+    else { LOG_W("Orchestrator: Unknown request [%s]", request.c_str()); }
 }
 
 bool orchestrator::isManaged(const JsonObjectConst &cmd) {
     if (!Settings.Orchestrator.Assigned()) {
-        devLog->Write("Orchestrator: Ignoring command - Device is not assigned", LOGLEVEL_WARNING);
+        LOG_W("Orchestrator: Ignoring command - Device is not assigned");
         return false;
     }
 
     if (!Settings.Orchestrator.ServerID().equals(cmd["Server ID"].as<String>())) {
-        devLog->Write("Orchestrator: Ignoring command - Server ID mismatch", LOGLEVEL_WARNING);
+        LOG_W("Orchestrator: Ignoring command - Server ID mismatch");
         return false;
     }
 
@@ -137,18 +253,29 @@ bool orchestrator::isManaged(const JsonObjectConst &cmd) {
 }
 
 bool orchestrator::FindOrchestratorServer() {
+    if (pDiscoveryID != 0) return true;
+
     JsonDocument out;
     out["Orchestrator"] = "Discover";
 
-    JsonVariantConst reply = SendUDP("255.255.255.255", Defaults.Orchestrator.Port, out.as<JsonObjectConst>());
-    if (reply.isNull()) {
-        devLog->Write("Orchestrator: Server not found in this network", LOGLEVEL_WARNING);
-        return false;
-    }
+    pDiscoveryID = SendRequest("broadcast", Defaults.Orchestrator.Port, out.as<JsonObjectConst>(), [this](bool ok, const JsonObjectConst& reply, const IPAddress& from) {
+        pDiscoveryID = 0;
 
+        if (!ok) {
+            LOG_W("Orchestrator: Server not found in this network");
+            return;
+        }
+
+        applyDiscovery(reply);
+    });
+
+    return pDiscoveryID != 0;
+}
+
+bool orchestrator::applyDiscovery(const JsonObjectConst& reply) {
     JsonObjectConst orch = reply["Orchestrator"];
     if (orch.isNull()) {
-        devLog->Write("Orchestrator: Invalid discovery reply (missing 'Orchestrator' object)", LOGLEVEL_WARNING);
+        LOG_W("Orchestrator: Invalid discovery reply (missing 'Orchestrator' object)");
         return false;
     }
 
@@ -157,13 +284,13 @@ bool orchestrator::FindOrchestratorServer() {
     const uint16_t port = (uint16_t)(orch["Port"] | Defaults.Orchestrator.Port);
 
     if (sid.isEmpty() || ipStr.isEmpty() || port == 0) {
-        devLog->Write("Orchestrator: Invalid discovery reply (missing fields)", LOGLEVEL_WARNING);
+        LOG_W("Orchestrator: Invalid discovery reply (missing fields)");
         return false;
     }
 
     IPAddress ip;
     if (!ip.fromString(ipStr)) {
-        devLog->Write("Orchestrator: Invalid IP address in discovery reply: " + ipStr, LOGLEVEL_WARNING);
+        LOG_W("Orchestrator: Invalid IP address in discovery reply: %s", ipStr.c_str());
         return false;
     }
 
@@ -172,7 +299,7 @@ bool orchestrator::FindOrchestratorServer() {
     if (Settings.Orchestrator.Assigned()) {
         const bool sidMatch = Settings.Orchestrator.ServerID().equalsIgnoreCase(sid);
         if (!sidMatch) {
-            devLog->Write("Orchestrator: Ignoring discovery from different Server ID [" + sid + "]", LOGLEVEL_WARNING);
+            LOG_W("Orchestrator: Ignoring discovery from different Server ID [%s]", sid.c_str());
             return false;
         }
 
@@ -186,8 +313,8 @@ bool orchestrator::FindOrchestratorServer() {
         }
 
         if (changed) {
-            Settings.Save();
-            devLog->Write("Orchestrator: Server endpoint updated to " + ip.toString() + ":" + String(port), LOGLEVEL_INFO);
+            CommandBus.SaveSettings(COMMANDSOURCE_ORCHESTRATOR);
+            LOG_I("Orchestrator: Server endpoint updated to %s:%u", ip.toString().c_str(), (unsigned)port);
         }
         return true;
     }
@@ -196,8 +323,8 @@ bool orchestrator::FindOrchestratorServer() {
         Settings.Orchestrator.ServerID(sid);
         Settings.Orchestrator.IP_Address(ipStr);
         Settings.Orchestrator.Port(port);
-        Settings.Save();
-        devLog->Write("Orchestrator: Found server " + sid + " at " + ip.toString() + ":" + String(port), LOGLEVEL_INFO);
+        CommandBus.SaveSettings(COMMANDSOURCE_ORCHESTRATOR);
+        LOG_I("Orchestrator: Found server %s at %s:%u", sid.c_str(), ip.toString().c_str(), (unsigned)port);
         return true;
     }
 
@@ -206,25 +333,21 @@ bool orchestrator::FindOrchestratorServer() {
 
 
 bool orchestrator::Discover(const JsonVariantConst& cmd) {
-    if (connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
-        JsonDocument reply;
-        reply["Provider"] = Defaults.Orchestrator.Provider;
-        reply["Command"] = "Discover";
-        reply["Hostname"] = devNetwork->Hostname();
-        reply["MAC Address"] = devNetwork->MAC_Address();
-        reply["Parameter"]["Server ID"] = Settings.Orchestrator.ServerID();
-        reply["Parameter"]["Product Name"] = Version.ProductName;
-        reply["Parameter"]["Hardware Model"] = Version.Hardware.Model;
-        reply["Parameter"]["Version"] = Version.Software.Info();
-        reply["Parameter"]["Hostname"] = devNetwork->Hostname();
-        reply["Parameter"]["MAC Address"] = devNetwork->MAC_Address();
-        reply["Parameter"]["IP Address"] = devNetwork->IP_Address();
-        reply["Parameter"]["Local Timestamp"] = devClock->CurrentDateTime();
-
-        String json;
-        serializeJson(reply, json);
-        client.print(json);
-    })) {
+    JsonDocument reply;
+    reply["Provider"] = Defaults.Orchestrator.Provider;
+    reply["Command"] = "Discover";
+    reply["Hostname"] = devNetwork->Hostname();
+    reply["MAC Address"] = devNetwork->MAC_Address();
+    reply["Parameter"]["Server ID"] = Settings.Orchestrator.ServerID();
+    reply["Parameter"]["Product Name"] = Version.ProductName;
+    reply["Parameter"]["Hardware Model"] = Version.Hardware.Model;
+    reply["Parameter"]["Version"] = Version.Software.Info();
+    reply["Parameter"]["Hostname"] = devNetwork->Hostname();
+    reply["Parameter"]["MAC Address"] = devNetwork->MAC_Address();
+    reply["Parameter"]["IP Address"] = devNetwork->IP_Address();
+    reply["Parameter"]["Local Timestamp"] = devClock->CurrentDateTime();
+
+    if (sendReply(reply)) {
         devLog->Write("Orchestrator: Sent updated device info to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
         return true;
     }
@@ -242,15 +365,40 @@ bool orchestrator::Refresh(const JsonVariantConst& cmd) {
 bool orchestrator::GetLog(const JsonVariantConst& cmd) {
     if (!isManaged(cmd)) return false;
 
-    if (devFileSystem->Exists(Defaults.LogFileName)) {
-        File f =  devFileSystem->OpenFile(Defaults.LogFileName, "r");
-        uint32_t crc = CRC32_File(f);
-        size_t fileSize = f.size();
+    devLog->Flush();
+
+    // Servers that understand it ask for "Compression": "lzss" and get one LZSS container per segment
+    const bool packed = cmd["Compression"] == "lzss";
+
+    LogStore::Reader reader(devLog->Store(), packed);
+
+    // Servers that ask for "Transfer": "binary" get raw chunks with the CRC in a trailer, read in a single pass
+    if (cmd["Transfer"] == "binary") {
+        size_t fileSize = 0;
+        uint32_t crc = 0;
+        bool sent = false;
 
         if (connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
-            StreamFileAsBase64Json(Defaults.LogFileName, devNetwork->MAC_Address(), "GetLog", client, f, fileSize, crc);
-        })) {
-            devLog->Write("Orchestrator: Sent device log file to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
+            sent = StreamFileAsBinaryFrames(Defaults.LogFileName, devNetwork->MAC_Address(), "GetLog", client, [&reader](uint8_t* buffer, size_t len) -> size_t { return reader.Read(buffer, len); }, fileSize, crc, packed ? "binary+lzss" : "binary");
+        }) && sent) {
+            devLog->Write("Orchestrator: Sent device log (" + String(reader.Segments()) + " segment(s), " + String(fileSize) + " bytes" + (packed ? " compressed" : "") + ", binary) to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
+            return true;
+        }
+
+        devLog->Write("Orchestrator: Error sending log file to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_ERROR);
+        return false;
+    }
+
+    // Size and CRC are taken while streaming, so the log is read only once
+    if (reader.Segments() > 0) {
+        size_t fileSize = 0;
+        uint32_t crc = 0;
+        bool sent = false;
+
+        if (connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
+            sent = StreamFileAsBase64Json(Defaults.LogFileName, devNetwork->MAC_Address(), "GetLog", client, [&reader](uint8_t* buffer, size_t len) -> size_t { return reader.Read(buffer, len); }, fileSize, crc, packed ? "base64+lzss" : "base64");
+        }) && sent) {
+            devLog->Write("Orchestrator: Sent device log (" + String(reader.Segments()) + " segment(s), " + String(fileSize) + " bytes" + (packed ? " compressed" : "") + ") to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
             return true;
         } else {
             devLog->Write("Orchestrator: Error sending log file to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_ERROR);
@@ -258,25 +406,21 @@ bool orchestrator::GetLog(const JsonVariantConst& cmd) {
         }
     }
     
-    devLog->Write("Orchestrator: File " + String(Defaults.LogFileName) + " not found", LOGLEVEL_ERROR);
+    devLog->Write("Orchestrator: Log " + String(Defaults.LogDirectory) + " is empty", LOGLEVEL_ERROR);
     return false;
 }
 
 bool orchestrator::ClearLog(const JsonVariantConst& cmd) {
     if (!isManaged(cmd)) return false;
 
-    if (connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
-        JsonDocument reply;
-        reply["Provider"] = Defaults.Orchestrator.Provider;
-        reply["Command"] = "ClearLog";
-        reply["Parameter"] = "ACK";
-        reply["Hostname"] = devNetwork->Hostname();
-        reply["MAC Address"] = devNetwork->MAC_Address();
+    JsonDocument reply;
+    reply["Provider"] = Defaults.Orchestrator.Provider;
+    reply["Command"] = "ClearLog";
+    reply["Parameter"] = "ACK";
+    reply["Hostname"] = devNetwork->Hostname();
+    reply["MAC Address"] = devNetwork->MAC_Address();
 
-        String json;
-        serializeJson(reply, json);
-        client.print(json);
-    })) {
+    if (sendReply(reply)) {
         devLog->Write("Orchestrator: Replied ClearLog command to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
     } else {
         devLog->Write("Orchestrator: Error sending ClearLog ACK to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_ERROR);
@@ -288,16 +432,35 @@ bool orchestrator::ClearLog(const JsonVariantConst& cmd) {
 bool orchestrator::Pull(const JsonVariantConst& cmd) {
     if (!isManaged(cmd)) return false;
 
-    Settings.Save();
+    // The pushed CRC must describe the settings as they are now
+    CommandBus.Wait(CommandBus.SaveSettings(COMMANDSOURCE_ORCHESTRATOR), Defaults.CommandBus.SaveWaitMs);
 
     if (devFileSystem->Exists(Defaults.ConfigFileName)) {
         File f =  devFileSystem->OpenFile(Defaults.ConfigFileName, "r");
-        uint32_t crc = CRC32_File(f);
-        size_t fileSize = f.size();
+
+        if (cmd["Transfer"] == "binary") {
+            size_t fileSize = 0;
+            uint32_t crc = 0;
+            bool sent = false;
+
+            if (connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
+                sent = StreamFileAsBinaryFrames(Defaults.ConfigFileName, devNetwork->MAC_Address(), "Pull", client, [&f](uint8_t* buffer, size_t len) -> size_t { return f.read(buffer, len); }, fileSize, crc);
+            }) && sent) {
+                devLog->Write("Orchestrator: Sent device config file (" + String(fileSize) + " bytes, binary) to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
+                return true;
+            }
+
+            devLog->Write("Orchestrator: Error sending config file to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_ERROR);
+            return false;
+        }
+
+        size_t fileSize = 0;
+        uint32_t crc = 0;
+        bool sent = false;
 
         if (connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
-            StreamFileAsBase64Json(Defaults.ConfigFileName, devNetwork->MAC_Address(), "Pull", client, f, fileSize, crc);
-        })) {
+            sent = StreamFileAsBase64Json(Defaults.ConfigFileName, devNetwork->MAC_Address(), "Pull", client, f, fileSize, crc);
+        }) && sent) {
             devLog->Write("Orchestrator: Sent device config file to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
             return true;
         } else {
@@ -403,27 +566,23 @@ bool orchestrator::Add(const JsonVariantConst& cmd) {
         return false;
     }
 
-    if (connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
-        JsonDocument reply;
-        reply["Provider"] = Defaults.Orchestrator.Provider;
-        reply["Command"] = "Add";
-        reply["Parameter"] = "ACK";
-        reply["MAC Address"] = devNetwork->MAC_Address();
-        reply["Hardware Model"] = Version.Hardware.Model;
-        reply["Hostname"] = devNetwork->Hostname();
-        reply["IP Address"] = devNetwork->IP_Address();
-        reply["Local Timestamp"] = devClock->CurrentDateTime();
-        reply["Product Name"] = Version.ProductName;
-        reply["Version"] = Version.Software.Info();
-
-        String json;
-        serializeJson(reply, json);
-        client.print(json);
-    })) {
+    JsonDocument reply;
+    reply["Provider"] = Defaults.Orchestrator.Provider;
+    reply["Command"] = "Add";
+    reply["Parameter"] = "ACK";
+    reply["MAC Address"] = devNetwork->MAC_Address();
+    reply["Hardware Model"] = Version.Hardware.Model;
+    reply["Hostname"] = devNetwork->Hostname();
+    reply["IP Address"] = devNetwork->IP_Address();
+    reply["Local Timestamp"] = devClock->CurrentDateTime();
+    reply["Product Name"] = Version.ProductName;
+    reply["Version"] = Version.Software.Info();
+
+    if (sendReply(reply)) {
         devLog->Write("Orchestrator: Replied Add command to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
         Settings.Orchestrator.Assigned(true);
         Settings.Orchestrator.ServerID(cmd["Server ID"]);
-        Settings.Save();
+        CommandBus.SaveSettings(COMMANDSOURCE_ORCHESTRATOR);
 
         devLog->Write("Orchestrator: Added assignment to server ID " + Settings.Orchestrator.ServerID(), LOGLEVEL_INFO);
         return true;
@@ -436,21 +595,17 @@ bool orchestrator::Add(const JsonVariantConst& cmd) {
 bool orchestrator::Restore(const JsonVariantConst& cmd) {
     if (!isManaged(cmd)) return false;
 
-    if (connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
-        JsonDocument reply;
-        reply["Provider"] = Defaults.Orchestrator.Provider;
-        reply["Command"] = "Restore";
-        reply["Parameter"] = "ACK";
-        reply["Hostname"] = devNetwork->Hostname();
-        reply["MAC Address"] = devNetwork->MAC_Address();
-
-        String json;
-        serializeJson(reply, json);
-        client.print(json);
+    JsonDocument reply;
+    reply["Provider"] = Defaults.Orchestrator.Provider;
+    reply["Command"] = "Restore";
+    reply["Parameter"] = "ACK";
+    reply["Hostname"] = devNetwork->Hostname();
+    reply["MAC Address"] = devNetwork->MAC_Address();
 
+    if (sendReply(reply)) {
         devLog->Write("Orchestrator: Replied Restore command to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
-    })) {
         devLog->Write("Orchestrator: Device is restoring to factory defaults", LOGLEVEL_INFO);
+        pLink.Flush(1000);
         Settings.RestoreToFactoryDefaults();
         return true;
     }
@@ -464,24 +619,19 @@ bool orchestrator::Remove(const JsonVariantConst& cmd) {
 
     String oldServer = Settings.Orchestrator.ServerID();
 
-    if (connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
-        JsonDocument reply;
-        reply["Provider"] = Defaults.Orchestrator.Provider;
-        reply["Command"] = "Remove";
-        reply["Parameter"] = "ACK";
-        reply["Hostname"] = devNetwork->Hostname();
-        reply["MAC Address"] = devNetwork->MAC_Address();
-
-        String json;
-        serializeJson(reply, json);
-        client.print(json);
+    JsonDocument reply;
+    reply["Provider"] = Defaults.Orchestrator.Provider;
+    reply["Command"] = "Remove";
+    reply["Parameter"] = "ACK";
+    reply["Hostname"] = devNetwork->Hostname();
+    reply["MAC Address"] = devNetwork->MAC_Address();
 
+    if (sendReply(reply)) {
         devLog->Write("Orchestrator: Replied Remove command to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
 
         Settings.Orchestrator.Assigned(false);
         Settings.Orchestrator.ServerID("");
-        Settings.Save();
-    })) {
+        CommandBus.SaveSettings(COMMANDSOURCE_ORCHESTRATOR);
         devLog->Write("Orchestrator: Removed assignment to server ID " + oldServer, LOGLEVEL_INFO);
         return true;
     }
@@ -493,23 +643,22 @@ bool orchestrator::Remove(const JsonVariantConst& cmd) {
 bool orchestrator::Restart(const JsonVariantConst& cmd) {
     // if (!isManaged(cmd)) return false;
 
-    if (connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
-        JsonDocument reply;
-        reply["Provider"] = Defaults.Orchestrator.Provider;
-        reply["Command"] = "Restart";
-        reply["Parameter"] = "ACK";
-        reply["Hostname"] = devNetwork->Hostname();
-        reply["MAC Address"] = devNetwork->MAC_Address();
+    JsonDocument reply;
+    reply["Provider"] = Defaults.Orchestrator.Provider;
+    reply["Command"] = "Restart";
+    reply["Parameter"] = "ACK";
+    reply["Hostname"] = devNetwork->Hostname();
+    reply["MAC Address"] = devNetwork->MAC_Address();
 
-        String json;
-        serializeJson(reply, json);
-        client.print(json);
-    })) {
+    if (sendReply(reply)) {
         devLog->Write("Orchestrator: Replied Restart command to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
     } else {
         devLog->Write("Orchestrator: Error sending Restart ACK to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_ERROR);
     }
 
+    // A reply queued on the session must reach the socket before the radio goes down
+    pLink.Flush(1000);
+
     esp_sleep_enable_timer_wakeup(200 * 1000);
     esp_deep_sleep_start();
 
@@ -519,18 +668,14 @@ bool orchestrator::Restart(const JsonVariantConst& cmd) {
 bool orchestrator::Update(const JsonVariantConst& cmd) {
     if (!isManaged(cmd)) return false;
 
-    if (connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
-        JsonDocument reply;
-        reply["Provider"] = Defaults.Orchestrator.Provider;
-        reply["Command"] = "Update";
-        reply["Parameter"] = "ACK";
-        reply["Hostname"] = devNetwork->Hostname();
-        reply["MAC Address"] = devNetwork->MAC_Address();
+    JsonDocument reply;
+    reply["Provider"] = Defaults.Orchestrator.Provider;
+    reply["Command"] = "Update";
+    reply["Parameter"] = "ACK";
+    reply["Hostname"] = devNetwork->Hostname();
+    reply["MAC Address"] = devNetwork->MAC_Address();
 
-        String json;
-        serializeJson(reply, json);
-        client.print(json);
-    })) {
+    if (sendReply(reply)) {
         devLog->Write("Orchestrator: Replied Update command to " + Settings.Orchestrator.IP_Address().toString() + ":" + String(Settings.Orchestrator.Port()), LOGLEVEL_INFO);
         g_cmdCheckNow = true;
 
@@ -541,6 +686,16 @@ bool orchestrator::Update(const JsonVariantConst& cmd) {
     return false;
 }
 
+bool orchestrator::sendReply(const JsonDocument& reply) {
+    if (pLink.Send(reply)) return true;
+
+    return connectAndExchangeJson(Settings.Orchestrator.IP_Address(), Settings.Orchestrator.Port(), [&](WiFiClient& client) {
+        String json;
+        serializeJson(reply, json);
+        client.print(json);
+    });
+}
+
 bool orchestrator::connectAndExchangeJson(IPAddress remoteIp, uint16_t port, std::function<void(WiFiClient&)> exchange) {
     WiFiClient client;
 
@@ -0,0 +1,364 @@
+#include "OrchestratorLink.h"
+
+#include <WiFi.h>
+
+#include "Defaults.h"
+#include "LogPipeline.h"
+
+void OrchestratorLink::Begin(orchestrator_command_t onCommand, orchestrator_hello_t hello) {
+    if (pLock == nullptr) pLock = xSemaphoreCreateMutex();
+
+    pOnCommand = onCommand;
+    pHello = hello;
+}
+
+void OrchestratorLink::Target(const IPAddress& host, uint16_t port) {
+    if (host == pHost && port == pPort) return;
+
+    // pClient may be cleared by the AsyncTCP task at any time, so the state decides
+    if (pState != ORCHLINK_IDLE && pState != ORCHLINK_WAITING) drop("server changed");
+
+    pHost = host;
+    pPort = port;
+    pBackoffMs = 0;
+    pNextAttempt = millis();
+    pState = (host == IPAddress() || port == 0) ? ORCHLINK_IDLE : ORCHLINK_WAITING;
+}
+
+void OrchestratorLink::connect() {
+    AsyncClient* client = new AsyncClient();
+    client->setNoDelay(true);
+
+    // Callbacks are set once and never swapped; each one checks whether its client is still the current one
+    client->onConnect([this](void* arg, AsyncClient* client) {
+        xSemaphoreTake(pLock, portMAX_DELAY);
+        if (client == pClient) pConnected = true;
+        xSemaphoreGive(pLock);
+    });
+    client->onDisconnect([this](void* arg, AsyncClient* client) {
+        xSemaphoreTake(pLock, portMAX_DELAY);
+        if (client == pClient) {
+            pClient = nullptr;
+            pDropped = true;
+        }
+        xSemaphoreGive(pLock);
+
+        // Also reached after an error; nothing else holds this client any more
+        delete client;
+    });
+    client->onPoll([this](void* arg, AsyncClient* client) {
+        xSemaphoreTake(pLock, portMAX_DELAY);
+        const bool dropped = (client != pClient);
+        xSemaphoreGive(pLock);
+
+        // Dropped by the loop task: closed here, so the disconnect callback that deletes it runs on this task too
+        if (dropped) client->close(true);
+    });
+    client->onData([this](void* arg, AsyncClient* client, void* data, size_t len) { receive(client, (const uint8_t*)data, len); });
+    client->onAck([this](void* arg, AsyncClient* client, size_t len, uint32_t time) { pump(); });
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    pClient = client;
+    xSemaphoreGive(pLock);
+
+    pState = ORCHLINK_CONNECTING;
+    pStateSince = millis();
+
+    if (!client->connect(pHost, pPort)) {
+        // No connection was set up, so no callback will ever run for it
+        xSemaphoreTake(pLock, portMAX_DELAY);
+        pClient = nullptr;
+        xSemaphoreGive(pLock);
+        delete client;
+
+        drop("unable to connect");
+    }
+}
+
+void OrchestratorLink::drop(const char* reason) {
+    const bool wasUp = (pState == ORCHLINK_UP);
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    pClient = nullptr;
+    pRx.clear();
+    pInbox.clear();
+    pTx.clear();
+    pTxHead = 0;
+    pConnected = false;
+    pDropped = false;
+    xSemaphoreGive(pLock);
+
+    if (wasUp) {
+        LOG_W("Orchestrator: Session to %s:%u lost (%s)", pHost.toString().c_str(), (unsigned)pPort, reason);
+    } else if (pBackoffMs == 0) {
+        // Only the first failure of a streak is logged; replies fall back to one connection each meanwhile
+        LOG_W("Orchestrator: No session with %s:%u (%s) - using per-message connections", pHost.toString().c_str(), (unsigned)pPort, reason);
+    }
+    pFailures++;
+
+    pBackoffMs = (pBackoffMs == 0) ? Defaults.Orchestrator.ReconnectMinMs : min<uint32_t>(pBackoffMs * 2, Defaults.Orchestrator.ReconnectMaxMs);
+    uint32_t jitter = esp_random() % (pBackoffMs / 2 + 1);
+    pNextAttempt = millis() + (pBackoffMs - pBackoffMs / 4) + jitter;
+    pState = ORCHLINK_WAITING;
+
+    // Taken out first: a callback may already queue the next request
+    std::vector<pending_t> pending;
+    pending.swap(pPending);
+    for (auto& p : pending) {
+        if (p.Callback) p.Callback(false, JsonObjectConst(), pHost);
+    }
+}
+
+void OrchestratorLink::receive(AsyncClient* client, const uint8_t* data, size_t len) {
+    xSemaphoreTake(pLock, portMAX_DELAY);
+
+    // Late data from a client that was already dropped
+    if (client != pClient) {
+        xSemaphoreGive(pLock);
+        return;
+    }
+
+    pLastRx = millis();
+    pRx.append((const char*)data, len);
+
+    while (pRx.size() >= 4) {
+        const uint8_t* p = (const uint8_t*)pRx.data();
+        const uint32_t size = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+
+        // Out of sync or hostile: nothing after this can be trusted
+        if (size > Defaults.Orchestrator.MaxFrame) {
+            pRx.clear();
+            pDropped = true;
+            break;
+        }
+
+        if (pRx.size() < 4 + size) break;
+
+        if (pInbox.size() < Defaults.Orchestrator.MaxInbox) {
+            String frame;
+            frame.concat(pRx.data() + 4, size);
+            pInbox.push_back(std::move(frame));
+            pFramesIn++;
+        } else {
+            pOverflows++;
+        }
+
+        pRx.erase(0, 4 + size);
+    }
+    xSemaphoreGive(pLock);
+}
+
+bool OrchestratorLink::enqueue(const JsonDocument& doc) {
+    const size_t size = measureJson(doc);
+
+    std::string frame;
+    frame.resize(4 + size);
+    frame[0] = (char)(size >> 24);
+    frame[1] = (char)(size >> 16);
+    frame[2] = (char)(size >> 8);
+    frame[3] = (char)size;
+    serializeJson(doc, &frame[4], size + 1);
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    const bool queued = pTx.size() < Defaults.Orchestrator.MaxQueued;
+    if (queued) {
+        pTx.push_back(std::move(frame));
+        pFramesOut++;
+        pLastTx = millis();
+    } else {
+        pOverflows++;
+    }
+    xSemaphoreGive(pLock);
+
+    return queued;
+}
+
+void OrchestratorLink::pump() {
+    xSemaphoreTake(pLock, portMAX_DELAY);
+
+    if (pClient != nullptr && pClient->connected()) {
+        bool sent = false;
+
+        while (!pTx.empty()) {
+            const std::string& frame = pTx.front();
+
+            size_t room = pClient->space();
+            if (room == 0) break;
+
+            size_t n = pClient->add(frame.data() + pTxHead, min<size_t>(room, frame.size() - pTxHead));
+            if (n == 0) break;
+
+            sent = true;
+            pTxHead += n;
+
+            if (pTxHead == frame.size()) {
+                pTx.pop_front();
+                pTxHead = 0;
+            }
+        }
+
+        if (sent) pClient->send();
+    }
+
+    xSemaphoreGive(pLock);
+}
+
+void OrchestratorLink::deliver(const String& frame) {
+    JsonDocument doc;
+
+    if (deserializeJson(doc, frame)) {
+        LOG_W("Orchestrator: Ignoring malformed session frame (%u bytes)", (unsigned)frame.length());
+        return;
+    }
+
+    if (doc["Request ID"].is<uint32_t>()) {
+        const uint32_t id = doc["Request ID"].as<uint32_t>();
+
+        for (auto it = pPending.begin(); it != pPending.end(); ++it) {
+            if (it->ID != id) continue;
+
+            orchestrator_reply_t callback = std::move(it->Callback);
+            pPending.erase(it);
+
+            if (callback) callback(true, doc.as<JsonObjectConst>(), pHost);
+            return;
+        }
+    }
+
+    const String command = doc["Command"] | "";
+
+    if (command == "Ping") {
+        JsonDocument pong;
+        pong["Command"] = "Pong";
+        if (!doc["Request ID"].isNull()) pong["Request ID"] = doc["Request ID"];
+        enqueue(pong);
+    } else if (command == "Pong" || command.isEmpty()) {
+        // Keepalive answer, or a late reply to a request that already timed out
+    } else if (pOnCommand) {
+        pOnCommand(doc.as<JsonObjectConst>());
+    }
+}
+
+void OrchestratorLink::Control() {
+    if (pLock == nullptr || pState == ORCHLINK_IDLE) return;
+
+    if (pDropped) {
+        drop("connection closed");
+        return;
+    }
+
+    const uint32_t now = millis();
+
+    switch (pState) {
+        case ORCHLINK_WAITING: {
+            if (WiFi.isConnected() && (int32_t)(now - pNextAttempt) >= 0) connect();
+            return;
+        }
+
+        case ORCHLINK_CONNECTING: {
+            if (pConnected) {
+                pState = ORCHLINK_HANDSHAKE;
+                pStateSince = now;
+                pLastRx = now;
+
+                // The server confirms it speaks the framed protocol by answering Hello
+                JsonDocument hello;
+                hello["Command"] = "Hello";
+                if (pHello) pHello(hello);
+
+                Request(hello, [this](bool ok, const JsonObjectConst& reply, const IPAddress& from) {
+                    if (!ok) return; // drop() already ran
+
+                    pState = ORCHLINK_UP;
+                    pConnects++;
+                    pBackoffMs = 0;
+                    LOG_I("Orchestrator: Session established with %s:%u", pHost.toString().c_str(), (unsigned)pPort);
+                }, Defaults.Orchestrator.HandshakeTimeoutMs);
+            } else if (now - pStateSince >= Defaults.Orchestrator.ConnectTimeoutMs) {
+                drop("connect timeout");
+                return;
+            }
+        } break;
+
+        default:
+            break;
+    }
+
+    // Frames are parsed here so callbacks and commands run on the loop task
+    std::deque<String> frames;
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    frames.swap(pInbox);
+    xSemaphoreGive(pLock);
+
+    for (const auto& frame : frames) {
+        deliver(frame);
+        if (pState == ORCHLINK_WAITING) return;
+    }
+
+    for (size_t i = 0; i < pPending.size();) {
+        if ((int32_t)(now - pPending[i].Deadline) < 0) {
+            i++;
+            continue;
+        }
+
+        // A handshake that is never answered means the server does not offer sessions
+        if (pState == ORCHLINK_HANDSHAKE) {
+            drop("no handshake reply");
+            return;
+        }
+
+        orchestrator_reply_t callback = std::move(pPending[i].Callback);
+        pPending.erase(pPending.begin() + i);
+        if (callback) callback(false, JsonObjectConst(), pHost);
+    }
+
+    if (pState == ORCHLINK_UP) {
+        if (now - pLastRx >= Defaults.Orchestrator.KeepaliveMs * 3) {
+            drop("keepalive timeout");
+            return;
+        }
+
+        if (now - pLastTx >= Defaults.Orchestrator.KeepaliveMs) {
+            JsonDocument ping;
+            ping["Command"] = "Ping";
+            enqueue(ping);
+        }
+    }
+
+    pump();
+}
+
+bool OrchestratorLink::Send(const JsonDocument& doc) {
+    if (pState != ORCHLINK_UP) return false;
+
+    return enqueue(doc);
+}
+
+uint32_t OrchestratorLink::Request(JsonDocument& doc, orchestrator_reply_t callback, uint32_t timeoutms) {
+    if (pState != ORCHLINK_HANDSHAKE && pState != ORCHLINK_UP) return 0;
+
+    const uint32_t id = pNextID++;
+    if (pNextID == 0) pNextID = 1;
+
+    doc["Request ID"] = id;
+    if (!enqueue(doc)) return 0;
+
+    pPending.push_back({ id, millis() + timeoutms, callback });
+    return id;
+}
+
+bool OrchestratorLink::Flush(uint32_t timeoutms) {
+    const uint32_t start = millis();
+
+    for (;;) {
+        xSemaphoreTake(pLock, portMAX_DELAY);
+        const bool empty = pTx.empty();
+        xSemaphoreGive(pLock);
+
+        if (empty) return true;
+        if (pState != ORCHLINK_UP || millis() - start >= timeoutms) return false;
+
+        pump();
+        delay(1);
+    }
+}
@@ -0,0 +1,181 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "Globals.h"
+#include "services/webapi.h"
+
+void profiler::Begin() {
+    if (pTaskLock == nullptr) pTaskLock = xSemaphoreCreateMutex();
+}
+
+void profiler::sample(uint32_t counters[PROFILEIF_COUNT][3]) {
+    counters[PROFILEIF_WEB][0] = WebAPI::Requests();
+    counters[PROFILEIF_WEB][1] = WebAPI::EventsSent();
+    counters[PROFILEIF_WEB][2] = CommandBus.BySource(COMMANDSOURCE_WEB);
+
+    counters[PROFILEIF_MQTT][0] = MQTTLink.Received();
+    counters[PROFILEIF_MQTT][1] = MQTTLink.Publishes();
+    counters[PROFILEIF_MQTT][2] = CommandBus.BySource(COMMANDSOURCE_MQTT);
+
+    counters[PROFILEIF_TELNET][0] = devTelnetServer ? devTelnetServer->Commands() : 0;
+    counters[PROFILEIF_TELNET][1] = 0;
+    counters[PROFILEIF_TELNET][2] = CommandBus.BySource(COMMANDSOURCE_TELNET);
+
+    counters[PROFILEIF_ORCHESTRATOR][0] = Orchestrator.Received();
+    counters[PROFILEIF_ORCHESTRATOR][1] = 0;
+    counters[PROFILEIF_ORCHESTRATOR][2] = CommandBus.BySource(COMMANDSOURCE_ORCHESTRATOR);
+
+    counters[PROFILEIF_LOG][0] = devLog ? devLog->Queued() : 0;
+    counters[PROFILEIF_LOG][1] = devLog ? devLog->Written() : 0;
+    counters[PROFILEIF_LOG][2] = 0;
+}
+
+void profiler::close(uint32_t now) {
+    const uint32_t elapsed = now - pWindowStart;
+
+    uint32_t counters[PROFILEIF_COUNT][3];
+    sample(counters);
+
+    profile_rate_t rates[PROFILEIF_COUNT];
+    for (uint8_t i = 0; i < PROFILEIF_COUNT; i++) {
+        rates[i].In = (uint32_t)((uint64_t)(counters[i][0] - pCounters[i][0]) * 1000 / elapsed);
+        rates[i].Out = (uint32_t)((uint64_t)(counters[i][1] - pCounters[i][1]) * 1000 / elapsed);
+        rates[i].Commands = (uint32_t)((uint64_t)(counters[i][2] - pCounters[i][2]) * 1000 / elapsed);
+    }
+
+    taskENTER_CRITICAL(&pLock);
+    for (uint8_t i = 0; i < PROFILESTAGE_COUNT; i++) pLast[i] = pCurrent[i];
+    memcpy(pRates, rates, sizeof(pRates));
+    pWindowMs = elapsed;
+    taskEXIT_CRITICAL(&pLock);
+
+    for (uint8_t i = 0; i < PROFILESTAGE_COUNT; i++) pCurrent[i].Reset();
+    memcpy(pCounters, counters, sizeof(pCounters));
+    pWindowStart = now;
+}
+
+void profiler::Tick(uint32_t loopus) {
+    pCurrent[PROFILESTAGE_LOOP].Add(loopus);
+
+    const uint32_t now = millis();
+
+    if (pWindowStart == 0) {
+        sample(pCounters);
+        pWindowStart = now;
+    } else if (now - pWindowStart >= Defaults.Perf.WindowMs) {
+        close(now);
+    }
+}
+
+void profiler::Stages(LatencyStats* out) {
+    taskENTER_CRITICAL(&pLock);
+    for (uint8_t i = 0; i < PROFILESTAGE_COUNT; i++) out[i] = pLast[i];
+    taskEXIT_CRITICAL(&pLock);
+}
+
+void profiler::Rates(profile_rate_t* out) {
+    taskENTER_CRITICAL(&pLock);
+    memcpy(out, pRates, sizeof(pRates));
+    taskEXIT_CRITICAL(&pLock);
+}
+
+static char taskStateChar(eTaskState state) {
+    switch (state) {
+        case eRunning: return 'X';
+        case eReady: return 'R';
+        case eBlocked: return 'B';
+        case eSuspended: return 'S';
+        default: return 'D';
+    }
+}
+
+size_t profiler::Tasks(profile_task_t* out, size_t max) {
+#if configUSE_TRACE_FACILITY
+    if (pTaskLock == nullptr || max == 0) return 0;
+
+    xSemaphoreTake(pTaskLock, portMAX_DELAY);
+
+    // A little headroom for tasks created between the two calls
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + 4;
+    std::unique_ptr<TaskStatus_t[]> status(new (std::nothrow) TaskStatus_t[capacity]);
+
+    if (!status) {
+        xSemaphoreGive(pTaskLock);
+        return 0;
+    }
+
+    const UBaseType_t count = uxTaskGetSystemState(status.get(), capacity, nullptr);
+    std::vector<uint32_t> delta(count, 0);
+    std::vector<bool> known(count, false);
+    uint64_t total = 0;
+
+#if configGENERATE_RUN_TIME_STATS
+    // Shares are relative to everything that ran since the previous call, idle tasks included. A task without a previous
+    // sample (new, or past PROFILER_MAXTASKS) only has its run time since boot, so it gets no share and stays out of total
+    for (UBaseType_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < pRunTimeCount; j++) {
+            if (pRunTimes[j].Number == status[i].xTaskNumber) {
+                delta[i] = status[i].ulRunTimeCounter - pRunTimes[j].RunTime;
+                known[i] = true;
+                break;
+            }
+        }
+
+        total += delta[i];
+    }
+
+    pRunTimeCount = min<size_t>(count, PROFILER_MAXTASKS);
+    for (size_t i = 0; i < pRunTimeCount; i++) pRunTimes[i] = { status[i].xTaskNumber, status[i].ulRunTimeCounter };
+#endif
+
+    const size_t n = min<size_t>(count, max);
+
+    // Busiest first, tasks without a share last
+    std::vector<UBaseType_t> order(count);
+    for (UBaseType_t i = 0; i < count; i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](UBaseType_t a, UBaseType_t b) { return (known[a] != known[b]) ? known[a] : delta[a] > delta[b]; });
+
+    for (size_t i = 0; i < n; i++) {
+        const TaskStatus_t& t = status[order[i]];
+
+        strlcpy(out[i].Name, t.pcTaskName, sizeof(out[i].Name));
+        out[i].StackFree = t.usStackHighWaterMark;
+        out[i].Share = (known[order[i]] && total > 0) ? (uint16_t)(delta[order[i]] * 1000ULL / total) : PROFILE_NOSHARE;
+        out[i].Priority = (uint8_t)t.uxCurrentPriority;
+        out[i].State = taskStateChar(t.eCurrentState);
+    }
+
+    xSemaphoreGive(pTaskLock);
+    return n;
+#else
+    return 0;
+#endif
+}
+
+const char* profiler::StageName(ProfileStages stage) {
+    switch (stage) {
+        case PROFILESTAGE_CLOCK: return "Clock";
+        case PROFILESTAGE_NETWORK: return "Network";
+        case PROFILESTAGE_MQTT: return "MQTT";
+        case PROFILESTAGE_COMMANDS: return "Commands";
+        case PROFILESTAGE_COMPONENTS: return "Components";
+        case PROFILESTAGE_WEBAPI: return "Web API";
+        case PROFILESTAGE_LOOP: return "Whole loop";
+        default: return "Unknown";
+    }
+}
+
+const char* profiler::InterfaceName(ProfileInterfaces iface) {
+    switch (iface) {
+        case PROFILEIF_WEB: return "Web";
+        case PROFILEIF_MQTT: return "MQTT";
+        case PROFILEIF_TELNET: return "Telnet";
+        case PROFILEIF_ORCHESTRATOR: return "Orchestrator";
+        case PROFILEIF_LOG: return "Log";
+        default: return "Unknown";
+    }
+}
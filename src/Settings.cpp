@@ -1,4 +1,5 @@
 #include "Settings.h"
+#include "MQTTLink.h"
 
 bool user_t::SetPassword(const String& password) {
     mbedtls_entropy_context entropy;
@@ -547,6 +548,7 @@ void settings_t::LoadDefaults() {
     Log.LogLevel(Defaults.Log.Level);
     Log.SyslogServerHost(Defaults.Log.SyslogServer);
     Log.SyslogServerPort(Defaults.Log.SyslogPort);
+    Log.SyslogTransport(String(Defaults.Log.SyslogTransport));
 
     // Network
     Network.DHCPClient(Defaults.Network.DHCPClient);
@@ -598,6 +600,8 @@ void settings_t::LoadDefaults() {
     MQTT.Port(Defaults.MQTT.Port);
     MQTT.User(Defaults.MQTT.User);
     MQTT.Password(Defaults.MQTT.Password);
+    MQTT.TopicAliases(Defaults.MQTT.TopicAliases);
+    MQTT.CompactPayload(Defaults.MQTT.CompactPayload);
 }
 
 bool settings_t::Load(const String& configfilename) noexcept {
@@ -627,6 +631,7 @@ bool settings_t::Load(const String& configfilename) noexcept {
         Log.LogLevel((uint8_t)(log["Level"] | Defaults.Log.Level));
         Log.SyslogServerHost(String(log["Syslog Server"] | Defaults.Log.SyslogServer));
         Log.SyslogServerPort((uint16_t)(log["Syslog Port"] | Defaults.Log.SyslogPort));
+        Log.SyslogTransport(String(log["Syslog Transport"] | Defaults.Log.SyslogTransport));
     }
 
     // Network
@@ -700,6 +705,8 @@ bool settings_t::Load(const String& configfilename) noexcept {
         MQTT.Port((uint16_t)(mq["Port"] | Defaults.MQTT.Port));
         MQTT.User(String(mq["User"] | Defaults.MQTT.User));
         MQTT.Password(String(mq["Password"] | Defaults.MQTT.Password));
+        MQTT.TopicAliases((bool)(mq["Topic Aliases"] | Defaults.MQTT.TopicAliases));
+        MQTT.CompactPayload((bool)(mq["Compact Payload"] | Defaults.MQTT.CompactPayload));
     }
 
     // Telnet
@@ -822,6 +829,7 @@ bool settings_t::InstallComponents(const String& configfilename) noexcept {
     }
 
     Components.Clear();
+    MQTTLink.ClearTopics();
 
     auto configureComponentEvents = [&](Generic* NewComponent, JsonObjectConst comp) {
         if (!NewComponent) return;
@@ -1001,13 +1009,17 @@ bool settings_t::InstallComponents(const String& configfilename) noexcept {
                             tmp_blinds->CalibrationMultiplier(comp["Calibration Multiplier"].as<uint8_t>() | Defaults.Components.Blinds.CalibrationMultiplier);
                             tmp_blinds->Position((comp["Position"].as<uint8_t>() | 0), true);
 
-                            tmp_blinds->Event["Changed"]([this, tmp_blinds] {
-                            if (devMQTT) {
-                                devMQTT->Publish(Network.Hostname() + "/Get/Blinds:" + tmp_blinds->Name() + ":Name", tmp_blinds->Name());
-                                devMQTT->Publish(Network.Hostname() + "/Get/Blinds:" + tmp_blinds->Name() + ":CurrentPosition", String(tmp_blinds->CurrentPosition()));
-                                devMQTT->Publish(Network.Hostname() + "/Get/Blinds:" + tmp_blinds->Name() + ":TargetPosition", String(tmp_blinds->TargetPosition()));
-                                devMQTT->Publish(Network.Hostname() + "/Get/Blinds:" + tmp_blinds->Name() + ":PositionState", String(tmp_blinds->PositionState()));
-                            }
+                            const String topic = Network.Hostname() + "/Get/Blinds:" + tmp_blinds->Name();
+                            uint16_t aName = MQTTLink.RegisterTopic(topic + ":Name");
+                            uint16_t aCurrent = MQTTLink.RegisterTopic(topic + ":CurrentPosition");
+                            uint16_t aTarget = MQTTLink.RegisterTopic(topic + ":TargetPosition");
+                            uint16_t aState = MQTTLink.RegisterTopic(topic + ":PositionState");
+
+                            tmp_blinds->Event["Changed"]([this, tmp_blinds, aName, aCurrent, aTarget, aState] {
+                            MQTTLink.Publish(aName, tmp_blinds->Name());
+                            MQTTLink.Publish(aCurrent, String(tmp_blinds->CurrentPosition()));
+                            MQTTLink.Publish(aTarget, String(tmp_blinds->TargetPosition()));
+                            MQTTLink.Publish(aState, String(tmp_blinds->PositionState()));
 
                             pSaveComponentsStateFlag = true;
                         });
@@ -1033,26 +1045,27 @@ bool settings_t::InstallComponents(const String& configfilename) noexcept {
 
                 if (NewComponent) {
                     auto* n = NewComponent->as<Button>();
+                    uint16_t alias = MQTTLink.RegisterTopic(Network.Hostname() + "/Get/Button:" + n->Name());
 
                     if (n->ReportMode() == ButtonReportModes::BUTTONREPORTMODE_CLICKSONLY) {
-                        n->Event["Clicked"]([this, n] {
-                            if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Button:" + n->Name(), "Clicked");
+                        n->Event["Clicked"]([alias] {
+                            MQTTLink.Publish(alias, "Clicked");
                         });
-                        n->Event["DoubleClicked"]([this, n] {
-                            if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Button:" + n->Name(), "DoubleClicked");
+                        n->Event["DoubleClicked"]([alias] {
+                            MQTTLink.Publish(alias, "DoubleClicked");
                         });
-                        n->Event["TripleClicked"]([this, n] {
-                            if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Button:" + n->Name(), "TripleClicked");
+                        n->Event["TripleClicked"]([alias] {
+                            MQTTLink.Publish(alias, "TripleClicked");
                         });
-                        n->Event["LongClicked"]([this, n] {
-                            if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Button:" + n->Name(), "LongClicked");
+                        n->Event["LongClicked"]([alias] {
+                            MQTTLink.Publish(alias, "LongClicked");
                         });
                     } else if (n->ReportMode() == ButtonReportModes::BUTTONREPORTMODE_EDGESONLY) {
-                        n->Event["Pressed"]([this, n] {
-                            if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Button:" + n->Name(), "Pressed");
+                        n->Event["Pressed"]([alias] {
+                            MQTTLink.Publish(alias, "Pressed");
                         });
-                        n->Event["Released"]([this, n] {
-                            if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Button:" + n->Name(), "Released");
+                        n->Event["Released"]([alias] {
+                            MQTTLink.Publish(alias, "Released");
                         });
                     }
                 }
@@ -1063,11 +1076,12 @@ bool settings_t::InstallComponents(const String& configfilename) noexcept {
 
                 if (NewComponent) {
                     auto* n = NewComponent->as<Currentmeter>();
-                    n->Event["Changed"]([this, n] {
-                        if (devMQTT) {
-                            devMQTT->Publish(Network.Hostname() + "/Get/Currentmeter:" + n->Name() + ":DC", String(n->CurrentDC()));
-                            devMQTT->Publish(Network.Hostname() + "/Get/Currentmeter:" + n->Name() + ":AC", String(n->CurrentAC()));
-                        }
+                    uint16_t aDC = MQTTLink.RegisterTopic(Network.Hostname() + "/Get/Currentmeter:" + n->Name() + ":DC");
+                    uint16_t aAC = MQTTLink.RegisterTopic(Network.Hostname() + "/Get/Currentmeter:" + n->Name() + ":AC");
+
+                    n->Event["Changed"]([n, aDC, aAC] {
+                        MQTTLink.PublishNumber(aDC, n->CurrentDC());
+                        MQTTLink.PublishNumber(aAC, n->CurrentAC());
                     });
                 }
             } break;
@@ -1078,9 +1092,10 @@ bool settings_t::InstallComponents(const String& configfilename) noexcept {
                 if (NewComponent) {
                     auto* n = NewComponent->as<Relay>();
                     n->State((bool)(comp["State"] | false));
+                    uint16_t alias = MQTTLink.RegisterTopic(Network.Hostname() + "/Get/Relay:" + n->Name() + ":State");
 
-                    n->Event["Changed"]([this, n] {
-                        if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Relay:" + n->Name() + ":State", n->State() ? "on" : "off");
+                    n->Event["Changed"]([this, n, alias] {
+                        MQTTLink.Publish(alias, n->State() ? "on" : "off");
                         pSaveComponentsStateFlag = true;
                     });
                 }
@@ -1092,12 +1107,13 @@ bool settings_t::InstallComponents(const String& configfilename) noexcept {
                 if (NewComponent) {
                     auto* n = NewComponent->as<PIR>();
                     n->DebounceTime((uint32_t)(comp["Debounce"] | 200));
+                    uint16_t alias = MQTTLink.RegisterTopic(Network.Hostname() + "/Get/PIR:" + n->Name());
 
-                    n->Event["MotionDetected"]([this, n] {
-                        if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/PIR:" + n->Name(), "M");
+                    n->Event["MotionDetected"]([alias] {
+                        MQTTLink.Publish(alias, "M");
                     });
-                    n->Event["MotionCleared"]([this, n] {
-                        if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/PIR:" + n->Name(), "C");
+                    n->Event["MotionCleared"]([alias] {
+                        MQTTLink.Publish(alias, "C");
                     });
                 }
             } break;
@@ -1108,15 +1124,16 @@ bool settings_t::InstallComponents(const String& configfilename) noexcept {
                 if (NewComponent) {
                     auto* n = NewComponent->as<Doorbell>();
                     n->Timeout((uint32_t)(comp["Timeout"] | 1000));
+                    uint16_t alias = MQTTLink.RegisterTopic(Network.Hostname() + "/Get/Doorbell:" + n->Name());
 
-                    n->Event["Ring"]([this, n] {
-                        if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Doorbell:" + n->Name(), "1");
+                    n->Event["Ring"]([alias] {
+                        MQTTLink.Publish(alias, "1");
                     });
-                    n->Event["DoubleRing"]([this, n] {
-                        if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Doorbell:" + n->Name(), "2");
+                    n->Event["DoubleRing"]([alias] {
+                        MQTTLink.Publish(alias, "2");
                     });
-                    n->Event["LongRing"]([this, n] {
-                        if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Doorbell:" + n->Name(), "L");
+                    n->Event["LongRing"]([alias] {
+                        MQTTLink.Publish(alias, "L");
                     });
                 }
             } break;
@@ -1126,11 +1143,13 @@ bool settings_t::InstallComponents(const String& configfilename) noexcept {
 
                 if (NewComponent) {
                     auto* n = NewComponent->as<ContactSensor>();
-                    n->Event["Opened"]([this, n] {
-                        if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/ContactSensor:" + n->Name(), "Opened");
+                    uint16_t alias = MQTTLink.RegisterTopic(Network.Hostname() + "/Get/ContactSensor:" + n->Name());
+
+                    n->Event["Opened"]([alias] {
+                        MQTTLink.Publish(alias, "Opened");
                     });
-                    n->Event["Closed"]([this, n] {
-                        if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/ContactSensor:" + n->Name(), "Closed");
+                    n->Event["Closed"]([alias] {
+                        MQTTLink.Publish(alias, "Closed");
                     });
                 }
             } break;
@@ -1143,17 +1162,18 @@ bool settings_t::InstallComponents(const String& configfilename) noexcept {
 
                 if (NewComponent) {
                     auto* n = NewComponent->as<Thermometer>();
-                    n->Event["TemperatureChanged"]([this, n] {
-                        if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Thermometer:" + n->Name() + ":Temperature", String(n->Temperature()));
+                    uint16_t aTemp = MQTTLink.RegisterTopic(Network.Hostname() + "/Get/Thermometer:" + n->Name() + ":Temperature");
+                    uint16_t aHum = MQTTLink.RegisterTopic(Network.Hostname() + "/Get/Thermometer:" + n->Name() + ":Humidity");
+
+                    n->Event["TemperatureChanged"]([n, aTemp] {
+                        MQTTLink.PublishNumber(aTemp, n->Temperature());
                     });
-                    n->Event["HumidityChanged"]([this, n] {
-                        if (devMQTT) devMQTT->Publish(Network.Hostname() + "/Get/Thermometer:" + n->Name() + ":Humidity", String(n->Humidity()));
+                    n->Event["HumidityChanged"]([n, aHum] {
+                        MQTTLink.PublishNumber(aHum, n->Humidity());
                     });
-                    n->Event["Changed"]([this, n] {
-                        if (devMQTT) {
-                            devMQTT->Publish(Network.Hostname() + "/Get/Thermometer:" + n->Name() + ":Temperature", String(n->Temperature()));
-                            devMQTT->Publish(Network.Hostname() + "/Get/Thermometer:" + n->Name() + ":Humidity", String(n->Humidity()));
-                        }
+                    n->Event["Changed"]([n, aTemp, aHum] {
+                        MQTTLink.PublishNumber(aTemp, n->Temperature());
+                        MQTTLink.PublishNumber(aHum, n->Humidity());
                     });
                 }
             } break;
@@ -1224,6 +1244,7 @@ bool settings_t::Save(const String& configfilename) const noexcept {
         log["Level"] = Log.LogLevel();
         log["Syslog Server"] = Log.SyslogServerHost();
         log["Syslog Port"] = Log.SyslogServerPort();
+        log["Syslog Transport"] = SyslogTransport::ModeName(Log.SyslogTransport());
     }
 
     // Network
@@ -1292,6 +1313,8 @@ bool settings_t::Save(const String& configfilename) const noexcept {
         mq["Port"] = MQTT.Port();
         mq["User"] = MQTT.User();
         mq["Password"] = MQTT.Password();
+        mq["Topic Aliases"] = MQTT.TopicAliases();
+        mq["Compact Payload"] = MQTT.CompactPayload();
     }
 
     // Telnet
@@ -0,0 +1,225 @@
+#include "SyslogTransport.h"
+
+#include <time.h>
+
+#include "Defaults.h"
+#include "LogPipeline.h"
+
+// local0
+static constexpr uint8_t SyslogFacility = 16;
+
+static uint8_t syslogSeverity(uint8_t level) {
+    switch (level) {
+        case LOGLEVEL_ERROR: return 3;
+        case LOGLEVEL_WARNING: return 4;
+        case LOGLEVEL_INFO: return 6;
+        default: return 7;
+    }
+}
+
+void SyslogTransport::Begin() {
+    if (pLock == nullptr) pLock = xSemaphoreCreateMutex();
+}
+
+void SyslogTransport::Host(const String& value) {
+    if (pLock == nullptr) return;
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    pHost = value;
+    pChanged = true;
+    xSemaphoreGive(pLock);
+}
+
+void SyslogTransport::Port(uint16_t value) {
+    if (pLock == nullptr) return;
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    pPort = value;
+    pChanged = true;
+    xSemaphoreGive(pLock);
+}
+
+void SyslogTransport::Mode(SyslogTransports value) {
+    if (pLock == nullptr) return;
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    pMode = value;
+    pChanged = true;
+    xSemaphoreGive(pLock);
+}
+
+void SyslogTransport::Identity(const String& hostname, const String& appname) {
+    if (pLock == nullptr) return;
+
+    // RFC 5424 header fields are printable ASCII without spaces
+    String host = hostname.isEmpty() ? "-" : hostname;
+    String app = appname.isEmpty() ? "-" : appname;
+    host.replace(' ', '-');
+    app.replace(' ', '-');
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    pHostname = host;
+    pAppName = app;
+    xSemaphoreGive(pLock);
+}
+
+void SyslogTransport::apply() {
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    if (pChanged) {
+        pActiveHost = pHost;
+        pActivePort = pPort;
+        pActiveMode = pMode;
+        pChanged = false;
+
+        if (pClient.connected()) pClient.stop();
+        pResolved = false;
+        pBackoffMs = 0;
+        pNextAttempt = millis();
+    }
+    xSemaphoreGive(pLock);
+}
+
+void SyslogTransport::Enqueue(uint32_t epoch, uint8_t level, const char* msg, size_t len) {
+    if (pLock == nullptr) return;
+
+    char stamp[24];
+    time_t t = epoch;
+    struct tm tmv;
+    gmtime_r(&t, &tmv);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", &tmv);
+
+    char pri[8];
+    snprintf(pri, sizeof(pri), "<%u>1 ", (unsigned)(SyslogFacility * 8 + syslogSeverity(level)));
+
+    xSemaphoreTake(pLock, portMAX_DELAY);
+    String line;
+    line.reserve(strlen(pri) + strlen(stamp) + pHostname.length() + pAppName.length() + len + 12);
+    line += pri;
+    line += stamp;
+    line += ' ';
+    line += pHostname;
+    line += ' ';
+    line += pAppName;
+    xSemaphoreGive(pLock);
+
+    line += " - - - ";
+
+    // One record must always fit a datagram on its own
+    const size_t room = Defaults.Log.SyslogDatagram > line.length() ? Defaults.Log.SyslogDatagram - line.length() : 0;
+    line.concat(msg, min(len, room));
+
+    pBacklog.push_back(std::move(line));
+    pBacklogBytes += pBacklog.back().length();
+
+    // Bounded: the oldest records go first
+    while (pBacklogBytes > Defaults.Log.SyslogBacklog && pBacklog.size() > 1) {
+        pBacklogBytes -= pBacklog.front().length();
+        pBacklog.pop_front();
+        pDropped++;
+    }
+
+    pQueued = pBacklog.size();
+}
+
+bool SyslogTransport::resolve() {
+    if (pResolved) return true;
+
+    pResolved = pAddress.fromString(pActiveHost) || WiFi.hostByName(pActiveHost.c_str(), pAddress) == 1;
+    return pResolved;
+}
+
+void SyslogTransport::fail() {
+    pErrors++;
+
+    // Only the first failure of a streak is logged; it travels through this same backlog
+    if (pBackoffMs == 0) LOG_W("Syslog: Unable to send to %s:%u over %s - retrying in background", pActiveHost.c_str(), (unsigned)pActivePort, ModeName(pActiveMode));
+
+    pBackoffMs = (pBackoffMs == 0) ? Defaults.Log.SyslogRetryMinMs : min<uint32_t>(pBackoffMs * 2, Defaults.Log.SyslogRetryMaxMs);
+    pNextAttempt = millis() + pBackoffMs;
+    pResolved = false;
+}
+
+// TCP only: octet-counted records up to one datagram's worth per write
+size_t SyslogTransport::batch(String& out) {
+    size_t count = 0;
+    out = "";
+
+    for (const auto& line : pBacklog) {
+        String frame = String(line.length()) + " " + line;
+
+        if (count > 0 && out.length() + frame.length() > Defaults.Log.SyslogDatagram) break;
+
+        out += frame;
+        count++;
+    }
+
+    return count;
+}
+
+void SyslogTransport::commit(size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        pBacklogBytes -= pBacklog.front().length();
+        pBacklog.pop_front();
+    }
+
+    pSent += count;
+    pBatches++;
+    pQueued = pBacklog.size();
+    pBackoffMs = 0;
+}
+
+void SyslogTransport::sendUdp() {
+    // Receivers take a whole datagram as one message, so records are never packed together here
+    while (!pBacklog.empty()) {
+        const String& record = pBacklog.front();
+
+        if (!pUdp.beginPacket(pAddress, pActivePort) || pUdp.write((const uint8_t*)record.c_str(), record.length()) != record.length() || !pUdp.endPacket()) {
+            fail();
+            return;
+        }
+
+        commit(1);
+    }
+}
+
+void SyslogTransport::sendTcp() {
+    if (!pClient.connected()) {
+        if (!pClient.connect(pAddress, pActivePort, Defaults.Log.SyslogConnectTimeoutMs)) {
+            fail();
+            return;
+        }
+        pConnects++;
+    }
+
+    String chunk;
+
+    while (!pBacklog.empty()) {
+        size_t count = batch(chunk);
+
+        // Records of a partly written chunk are sent again on the new connection: at least once, never lost silently
+        if (pClient.write((const uint8_t*)chunk.c_str(), chunk.length()) != chunk.length()) {
+            pClient.stop();
+            fail();
+            return;
+        }
+
+        commit(count);
+    }
+}
+
+void SyslogTransport::Pump() {
+    if (pLock == nullptr) return;
+
+    apply();
+
+    if (pBacklog.empty() || pActiveHost.isEmpty() || !WiFi.isConnected()) return;
+    if ((int32_t)(millis() - pNextAttempt) < 0) return;
+
+    if (!resolve()) {
+        fail();
+        return;
+    }
+
+    if (pActiveMode == SYSLOG_TCP) {
+        sendTcp();
+    } else {
+        sendUdp();
+    }
+}
@@ -2,12 +2,16 @@
 
 #include "Tools.h"
 #include "Version.h"
+#include "WebTemplate.h"
 
 extern settings_t Settings;
 
 extern FileSystem* devFileSystem;
 extern Network* devNetwork;
 
+// Fingerprints of the static assets packed by web_assets.py, keyed by request path
+static std::map<String, String> webAssetETags;
+
 String CharArrayPointerToString(char* Text, uint32_t length) {
     String tmpRet;
     for (uint32_t i = 0; i < length; i++) tmpRet += (char)Text[i];
@@ -92,7 +96,14 @@ bool hasValidHeaderToken(AsyncWebServerRequest *request, String api_token) {
     return false;
 }
 
-bool StreamFileAsBase64Json(String fileName, String macAddress, String command, WiFiClient &client, File &f, size_t fileSize, uint32_t crc32) {
+bool StreamFileAsBase64Json(String fileName, String macAddress, String command, WiFiClient &client, File &f, size_t& fileSize, uint32_t& crc32) {
+    return StreamFileAsBase64Json(fileName, macAddress, command, client, [&f](uint8_t* buffer, size_t len) -> size_t { return f.read(buffer, len); }, fileSize, crc32);
+}
+
+bool StreamFileAsBase64Json(String fileName, String macAddress, String command, WiFiClient &client, const std::function<size_t(uint8_t*, size_t)>& read, size_t& fileSize, uint32_t& crc32, const char* encoding) {
+    fileSize = 0;
+    crc32 = 0;
+
     client.setNoDelay(true);
 
     client.print(F("{\"Provider\":\"Orchestrator\",\"Command\":\""));
@@ -103,12 +114,8 @@ bool StreamFileAsBase64Json(String fileName, String macAddress, String command,
     client.print(F("\"Filename\":\""));
     client.print(fileName);
     client.print(F("\","));
-    client.print(F("\"Size\":"));
-    client.print(fileSize);
-    client.print(F(",\"Encoding\":\"base64\","));
-    client.print(F("\"Checksum\":\""));
-    char crcbuf[9]; snprintf(crcbuf, sizeof(crcbuf), "%08X", crc32);
-    client.print(crcbuf);
+    client.print(F("\"Encoding\":\""));
+    client.print(encoding);
     client.print(F("\",\"Data\":\""));
 
     // ======= ESSE helper é o que muda =======
@@ -153,9 +160,12 @@ bool StreamFileAsBase64Json(String fileName, String macAddress, String command,
 
     if (ok) {
         while (true) {
-            size_t n = f.read(inBuf.get(), IN_CHUNK);
+            size_t n = read(inBuf.get(), IN_CHUNK);
             if (n == 0) break;
 
+            crc32 = CRC32_Update(crc32, inBuf.get(), n);
+            fileSize += n;
+
             size_t olen = 0;
             int ret = mbedtls_base64_encode(outBuf.get(), OUT_CHUNK + 4, &olen, inBuf.get(), n);
             if (ret != 0) { ok = false; break; }
@@ -166,19 +176,37 @@ bool StreamFileAsBase64Json(String fileName, String macAddress, String command,
     }
 
     if (client.connected()) {
+        client.print(F("\",\"Size\":"));
+        client.print(fileSize);
+        client.print(F(",\"Checksum\":\""));
+        char crcbuf[9]; snprintf(crcbuf, sizeof(crcbuf), "%08X", crc32);
+        client.print(crcbuf);
         client.print(F("\"}}"));
     }
 
     return ok;
 }
 
-uint32_t CRC32_Update(uint32_t crc, const uint8_t* data, size_t len) {
-    crc = ~crc;
-    while (len--) {
-        crc ^= *data++;
-        for (int k = 0; k < 8; k++) crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320UL : (crc >> 1);
-    }
-    return ~crc;
+bool StreamFileAsBinaryFrames(String fileName, String macAddress, String command, WiFiClient &client, const std::function<size_t(uint8_t*, size_t)>& read, size_t& fileSize, uint32_t& crc32, const char* encoding) {
+    client.setNoDelay(true);
+
+    JsonDocument header;
+    header["Provider"] = "Orchestrator";
+    header["Command"] = command;
+    header["Parameter"]["MAC Address"] = macAddress;
+    header["Parameter"]["Filename"] = fileName;
+    header["Parameter"]["Encoding"] = encoding;
+    header["Parameter"]["Chunk"] = FILEFRAMES_CHUNK;
+
+    String json;
+    serializeJson(header, json);
+
+    // WiFiClient::write already waits for room up to the client timeout, a short count means the peer is gone
+    return FileFrames::Write(json, read, [&client](const uint8_t* data, size_t len) -> bool {
+        if (client.write(data, len) != len) return false;
+        yield();
+        return true;
+    }, fileSize, crc32);
 }
 
 uint32_t CRC32_File(File &f) {
@@ -198,37 +226,62 @@ void Web_Content(String content, String mimetype, AsyncWebServerRequest *request
     // if (requires_authentication) Web_HandleAuthentication(request);
 
     if (static_content) {
-        request->send(LittleFS, content, mimetype, false);
+        auto it = webAssetETags.find(content);
+
+        if (it == webAssetETags.end()) {
+            request->send(LittleFS, content, mimetype, false);
+            return;
+        }
+
+        // Fingerprinted URLs never change content, so browsers may keep them for a year without revalidating
+        const String etag = "\"" + it->second + "\"";
+
+        if (request->hasHeader("If-None-Match") && request->header("If-None-Match") == etag) {
+            AsyncWebServerResponse* response = request->beginResponse(304);
+            response->addHeader("ETag", etag);
+            response->addHeader("Cache-Control", "public, max-age=31536000, immutable");
+            request->send(response);
+            return;
+        }
+
+        // Serves content.gz with Content-Encoding: gzip when only the compressed variant is packed
+        AsyncWebServerResponse* response = request->beginResponse(LittleFS, content, mimetype, false);
+        response->addHeader("ETag", etag);
+        response->addHeader("Cache-Control", "public, max-age=31536000, immutable");
+        request->send(response);
+        return;
     } else {
-        request->send(LittleFS, content, mimetype, false, [&](const String &var) {
-            String tmp;
+        WebTemplate* page = WebTemplate::Get(content);
 
-            if (var.equalsIgnoreCase("VERSION")) {
-                return Version.Software.Info();
-            }
-            if (var.equalsIgnoreCase("PRODUCTFAMILY")) {
-                return Version.ProductFamily;
-            }
-            if (var.equalsIgnoreCase("PRODUCTNAME")) {
-                return Version.ProductName;
-            }
-            if (var.equalsIgnoreCase("HOSTNAME")) {
-                tmp = Settings.Network.Hostname();
-                tmp.toUpperCase();
+        if (page == nullptr) {
+            request->send(404);
+            return;
+        }
 
-                return tmp;
-            }
-            if (var.equalsIgnoreCase("MACADDRESS")) {
-                tmp = devNetwork->MAC_Address();
-                tmp.toUpperCase();
+        page->Send(request, mimetype);
+    }
 
-                return tmp;
-            }
-            return String();
-        });
+    LOG_I("HTTP Server: %s sent to %s", content.c_str(), request->client()->remoteIP().toString().c_str());
+}
+
+size_t Web_LoadAssetManifest(const String& manifestfilename) {
+    webAssetETags.clear();
+
+    File f = LittleFS.open(manifestfilename, "r");
+    if (!f) return 0;
+
+    JsonDocument doc;
+    DeserializationError err = deserializeJson(doc, f);
+    f.close();
+
+    if (err || !doc.is<JsonObjectConst>()) return 0;
+
+    for (JsonPairConst kv : doc.as<JsonObjectConst>()) {
+        const char* etag = kv.value()["ETag"] | "";
+        if (!IsEmpty(etag)) webAssetETags[String(kv.key().c_str())] = String(etag);
     }
 
-    devLog->Write("HTTP Server: " + content + " sent to " + request->client()->remoteIP().toString(), LOGLEVEL_INFO);
+    return webAssetETags.size();
 }
 
 String urlEncode(const String &str) {
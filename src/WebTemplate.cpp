@@ -0,0 +1,169 @@
+#include "WebTemplate.h"
+
+#include <LittleFS.h>
+#include <DevIQ_Network.h>
+
+#include "Settings.h"
+#include "Version.h"
+#include "Tools.h"
+
+using namespace DeviceIQ_Network;
+
+extern settings_t Settings;
+extern Network* devNetwork;
+
+std::map<String, WebTemplate*> WebTemplate::pTemplates;
+
+static const char* TemplateVariableNames[TEMPLATEVAR_COUNT] = { "", "VERSION", "PRODUCTFAMILY", "PRODUCTNAME", "HOSTNAME", "MACADDRESS" };
+
+// Same limit AsyncWebServer applies to placeholder names
+static constexpr size_t TemplateNameMax = 32;
+
+TemplateVariables WebTemplate::lookup(const char* name, size_t len) {
+    for (uint8_t v = 1; v < TEMPLATEVAR_COUNT; v++) {
+        if (strlen(TemplateVariableNames[v]) == len && strncasecmp(TemplateVariableNames[v], name, len) == 0) return (TemplateVariables)v;
+    }
+    return TEMPLATEVAR_UNKNOWN;
+}
+
+String WebTemplate::resolve(TemplateVariables var) {
+    String tmp;
+
+    switch (var) {
+        case TEMPLATEVAR_VERSION: return Version.Software.Info();
+        case TEMPLATEVAR_PRODUCTFAMILY: return Version.ProductFamily;
+        case TEMPLATEVAR_PRODUCTNAME: return Version.ProductName;
+        case TEMPLATEVAR_HOSTNAME: {
+            tmp = Settings.Network.Hostname();
+            tmp.toUpperCase();
+        } break;
+        case TEMPLATEVAR_MACADDRESS: {
+            tmp = devNetwork->MAC_Address();
+            tmp.toUpperCase();
+        } break;
+        default: break;
+    }
+
+    return tmp;
+}
+
+bool WebTemplate::Load() {
+    File f = LittleFS.open(pFileName, "r");
+    if (!f) return false;
+
+    pSource = f.readString();
+    f.close();
+
+    pRendered.reset();
+    return parse();
+}
+
+bool WebTemplate::parse() {
+    pChunks.clear();
+    pUsed = 0;
+
+    if (pSource.length() > UINT16_MAX) return false;
+
+    const char* src = pSource.c_str();
+    const size_t len = pSource.length();
+    size_t literal = 0;
+    size_t i = 0;
+
+    auto addLiteral = [&](size_t end) {
+        if (end > literal) pChunks.push_back({ (uint16_t)literal, (uint16_t)(end - literal), TEMPLATEVAR_UNKNOWN });
+    };
+
+    while (i < len) {
+        if (src[i] != '%') { i++; continue; }
+
+        // Placeholders are %NAME% with NAME made of letters, digits or underscore; anything else stays literal
+        size_t j = i + 1;
+        while (j < len && j - i - 1 < TemplateNameMax && (isalnum((unsigned char)src[j]) || src[j] == '_')) j++;
+
+        if (j < len && src[j] == '%' && j > i + 1) {
+            addLiteral(i);
+
+            TemplateVariables var = lookup(src + i + 1, j - i - 1);
+            if (var != TEMPLATEVAR_UNKNOWN) {
+                pChunks.push_back({ 0, 0, var });
+                pUsed |= (1 << var);
+            }
+
+            i = j + 1;
+            literal = i;
+        } else {
+            i++;
+        }
+    }
+    addLiteral(len);
+
+    return true;
+}
+
+std::shared_ptr<String> WebTemplate::Render() {
+    // Hash the current value of every bound variable; an unchanged hash means the cached page is still valid
+    String values[TEMPLATEVAR_COUNT];
+    uint32_t bindings = 0;
+
+    for (uint8_t v = 1; v < TEMPLATEVAR_COUNT; v++) {
+        if (!(pUsed & (1 << v))) continue;
+
+        values[v] = resolve((TemplateVariables)v);
+        bindings = CRC32_Update(bindings, (const uint8_t*)values[v].c_str(), values[v].length() + 1);
+    }
+
+    if (pRendered && bindings == pBindings) {
+        pHits++;
+        return pRendered;
+    }
+
+    size_t total = 0;
+    for (const auto& c : pChunks) total += (c.Variable == TEMPLATEVAR_UNKNOWN) ? c.Length : values[c.Variable].length();
+
+    auto page = std::make_shared<String>();
+    page->reserve(total);
+
+    for (const auto& c : pChunks) {
+        if (c.Variable == TEMPLATEVAR_UNKNOWN) {
+            page->concat(pSource.c_str() + c.Offset, c.Length);
+        } else {
+            page->concat(values[c.Variable]);
+        }
+    }
+
+    // Responses still streaming the previous page keep their own reference to it
+    pRendered = page;
+    pBindings = bindings;
+    pRenders++;
+
+    return pRendered;
+}
+
+bool WebTemplate::Send(AsyncWebServerRequest* request, const String& mimetype) {
+    std::shared_ptr<String> page = Render();
+
+    AsyncWebServerResponse* response = request->beginResponse(mimetype, page->length(), [page](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+        size_t n = min(maxLen, page->length() - index);
+        memcpy(buffer, page->c_str() + index, n);
+        return n;
+    });
+
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+
+    return true;
+}
+
+WebTemplate* WebTemplate::Get(const String& filename) {
+    auto it = pTemplates.find(filename);
+    if (it != pTemplates.end()) return it->second;
+
+    WebTemplate* tpl = new WebTemplate(filename);
+    if (!tpl->Load()) {
+        delete tpl;
+        return nullptr;
+    }
+
+    pTemplates[filename] = tpl;
+    return tpl;
+}
@@ -1,6 +1,12 @@
 #include "Globals.h"
 
 #include "services/telnet.h"
+#include "services/webapi.h"
+
+// MQTT callbacks run on the MQTT client's task; components are only touched by loop()
+static void mqttSubmit(CommandOps op, Generic* comp, uint32_t layout, int32_t value = 0) {
+    if (CommandBus.Submit(op, comp, value, COMMANDSOURCE_MQTT, layout) == 0) LOG_W("MQTT: Command bus full - dropped command for %s", comp->Name().c_str());
+}
 
 void setup() {
     Serial.begin(115200);
@@ -24,13 +30,18 @@ void setup() {
     devClock->EpochUpdate(Defaults.InitialTimeAndDate);
 
     // Log
-    devLog = new Log(devFileSystem, devClock);
+    devLog = new LogPipeline(devFileSystem, devClock);
     devLog->SerialPort(&Serial);
     devLog->LogFileName(Defaults.LogFileName);
     devLog->Endpoint(Settings.Log.Endpoint());
     devLog->LogLevel(Settings.Log.LogLevel());
     devLog->SyslogServerHost(Settings.Log.SyslogServerHost());
     devLog->SyslogServerPort(Settings.Log.SyslogServerPort());
+    devLog->SyslogTransportMode(Settings.Log.SyslogTransport());
+    devLog->SyslogIdentity(Settings.Network.Hostname(), Version.ProductFamily);
+    devLog->Begin();
+
+    Profiler.Begin();
 
     devLog->Write(Version.ProductFamily + " " + Version.Software.Info(), LOGLEVEL_INFO);
 
@@ -151,8 +162,10 @@ void setup() {
                     // WebServer
                     if (Settings.WebServer.Enabled()) {
                         devWebServer = new AsyncWebServer(Settings.WebServer.Port());
+
+                        size_t assets = Web_LoadAssetManifest();
+                        if (assets == 0) devLog->Write("Web Server: No asset manifest, static content served without caching", LOGLEVEL_WARNING);
                     
-                        devWebServer->onNotFound([](AsyncWebServerRequest *request) { request->send(404); });
                         devWebServer->on("/res/css/styles.css", HTTP_GET, [&](AsyncWebServerRequest *request) { Web_Content("/res/css/styles.css", "text/css", request, false, true); });
                         devWebServer->on("/res/img/logo.png", HTTP_GET, [&](AsyncWebServerRequest *request) { Web_Content("/res/img/logo.png", "image/png", request, false, true); });
                         devWebServer->on("/res/img/logo-min.png", HTTP_GET, [&](AsyncWebServerRequest *request) { Web_Content("/res/img/logo-min.png", "image/png", request, false, true); });
@@ -188,103 +201,7 @@ void setup() {
                             }
                         });
 
-                        for (auto m : Settings.Components) {
-                            switch (m->Class()) {
-
-                                case CLASS_RELAY: {
-                                    devWebServer->on(String("/" + m->Name()).c_str(), HTTP_GET, [=](AsyncWebServerRequest *request) {
-                                        JsonDocument reply;
-                                        String json;
-
-                                        if (hasValidHeaderToken(request, Settings.WebServer.WebHooksToken())) {
-                                            bool setnewvalue = false;
-                                            String Arg, Val;
-
-                                            if (request->args() > 0) {
-                                                for (uint8_t i = 0; i < (uint8_t)request->args(); i++) {
-                                                    Arg = request->argName(i);
-                                                    Val = request->arg(i);
-
-                                                    if (Arg.equalsIgnoreCase("state")) {
-                                                        if (Val == "on" || Val == "true" || Val == "1") {
-                                                            m->as<Relay>()->State(true);
-                                                            setnewvalue = true;
-                                                        } else if (Val == "off" || Val == "false" || Val == "0") {
-                                                            m->as<Relay>()->State(false);
-                                                            setnewvalue = true;
-                                                        } else if (Val == "toggle" || Val == "invert" || Val == "~") {
-                                                            m->as<Relay>()->Invert();
-                                                            setnewvalue = true;
-                                                        }
-                                                    }
-                                                }
-                                            }
-
-                                            reply["Class"] = "Relay";
-                                            reply["State"] = m->as<Relay>()->State();
-                                            reply["Name"] = m->Name();
-
-                                            serializeJson(reply, json);
-
-                                            request->send(200, "application/json", json.c_str());
-
-                                            devLog->Write("Granted HTTP request " + String(setnewvalue ? "(SET '" + Arg + "=" + Val + "')"  : "(GET)") + " from " + request->client()->remoteIP().toString() + " to /" + m->Name(), LOGLEVEL_INFO);
-                                        } else {
-                                            reply["Error"] = "Unauthorized";
-                                            serializeJson(reply, json);
-
-                                            request->send(401, "application/json", json.c_str());
-                                            devLog->Write("Unauthorized HTTP request from " + request->client()->remoteIP().toString() + " to /" + m->Name(), LOGLEVEL_WARNING);
-                                        }
-                                    });
-                                } break;
-
-                                case CLASS_PIR : {
-                                    registerEndpoint(devWebServer, m, "PIR", [](JsonDocument& reply, DeviceIQ_Components::Generic* comp) {
-                                        reply["Motion"] = comp->as<PIR>()->State();
-                                    }, Settings.WebServer.WebHooksToken(), devLog);
-                                } break;
-
-                                case CLASS_BUTTON: {
-                                    registerEndpoint(devWebServer, m, "Button", [](JsonDocument& reply, DeviceIQ_Components::Generic* comp) {
-                                        reply["Pressed"] = comp->as<Button>()->IsPressed();
-                                    }, Settings.WebServer.WebHooksToken(), devLog);
-                                } break;
-
-                                case CLASS_CURRENTMETER: {
-                                    registerEndpoint(devWebServer, m, "Currentmeter", [](JsonDocument& reply, DeviceIQ_Components::Generic* comp) {
-                                        reply["Current AC"] = comp->as<Currentmeter>()->CurrentAC();
-                                        reply["Current DC"] = comp->as<Currentmeter>()->CurrentDC();
-                                    }, Settings.WebServer.WebHooksToken(), devLog);
-                                } break;
-
-                                case CLASS_THERMOMETER: {
-                                    registerEndpoint(devWebServer, m, "Thermometer", [](JsonDocument& reply, DeviceIQ_Components::Generic* comp) {
-                                        reply["Humidity"] = comp->as<Thermometer>()->Humidity();
-                                        reply["Temperature"] = comp->as<Thermometer>()->Temperature();
-                                    }, Settings.WebServer.WebHooksToken(), devLog);
-                                } break;
-
-                                case CLASS_BLINDS: {
-                                    registerEndpoint(devWebServer, m, "Blinds", [](JsonDocument& reply, DeviceIQ_Components::Generic* comp) {
-                                        reply["Position"] = comp->as<Blinds>()->Position();
-                                        reply["State"] = comp->as<Blinds>()->State() == BlindsStates::BLINDSSTATE_DECREASING ? "Decreasing" : (comp->as<Blinds>()->State() == BlindsStates::BLINDSSTATE_INCREASING ? "Increasing" : "Stopped");
-                                    }, Settings.WebServer.WebHooksToken(), devLog);
-                                } break;
-
-                                case CLASS_DOORBELL: {
-                                    registerEndpoint(devWebServer, m, "Doorbell", [](JsonDocument& reply, DeviceIQ_Components::Generic* comp) {
-                                        reply["State"] = comp->as<Doorbell>()->State();
-                                    }, Settings.WebServer.WebHooksToken(), devLog);
-                                } break;
-
-                                case CLASS_CONTACTSENSOR: {
-                                    registerEndpoint(devWebServer, m, "ContactSensor", [](JsonDocument& reply, DeviceIQ_Components::Generic* comp) {
-                                        reply["State"] = comp->as<ContactSensor>()->State();
-                                    }, Settings.WebServer.WebHooksToken(), devLog);
-                                } break;
-                            }
-                        }
+                        WebAPI::Begin(devWebServer);
 
                         devWebServer->begin();
                         devLog->Write("Web Server: Enabled on port " + String(Settings.WebServer.Port()), LOGLEVEL_INFO);
@@ -300,116 +217,101 @@ void setup() {
                         devMQTT->Password(Settings.MQTT.Password());
 
                         devMQTT->Subscribe(devNetwork->Hostname() + "/Set/#", [&](const String& topic, const String& payload) {
-                            const String prefixSet = devNetwork->Hostname() + "/Set/";
-
-                            if (topic.startsWith(prefixSet) == true) {
-                                String tmpClass, tmpName, tmpProperty, tmpPayload;
-
-                                String rest = topic.substring(prefixSet.length());
+                            MQTTLink.NoteReceived();
+                            ScopedLatency latency(MQTTLink.SetLatency());
 
-                                int slash = rest.indexOf('/');
-                                if (slash >= 0) rest = rest.substring(0, slash);
-
-                                int colon1 = rest.indexOf(':');
-                                int colon2 = rest.indexOf(':', colon1 + 1);
-
-                                if (colon1 <= 0 || colon2 <= colon1 + 1 || colon2 >= rest.length() - 1) {
-                                    devLog->Write("MQTT: Invalid topic format. Expected Class:Name:Property", LOGLEVEL_WARNING);
-                                    return;
-                                }
-
-                                tmpClass    = rest.substring(0, colon1);
-                                tmpName     = rest.substring(colon1 + 1, colon2);
-                                tmpProperty = rest.substring(colon2 + 1);
-                                tmpPayload  = payload;
+                            const String prefixSet = devNetwork->Hostname() + "/Set/";
 
-                                tmpClass.trim();
-                                tmpName.trim();
-                                tmpProperty.trim();
-                                tmpPayload.trim();
+                            mqtt_set_t set;
 
-                                tmpProperty.toLowerCase();
-                                tmpPayload.toLowerCase();
+                            if (!topic.startsWith(prefixSet)) {
+                                LOG_W("MQTT data received does not have expected structure");
+                            } else if (!mqtttopics::ParseSet(topic, prefixSet, payload, set)) {
+                                LOG_W("MQTT: Invalid topic format. Expected Class:Name:Property");
+                            } else {
+                                String& tmpClass = set.Class;
+                                String& tmpName = set.Name;
+                                String& tmpProperty = set.Property;
+                                String& tmpPayload = set.Payload;
 
+                                const uint32_t layout = CommandBus.Layout();
                                 auto comp = Settings.Components[tmpName];
 
                                 if (!comp) {
-                                    devLog->Write("MQTT: Target not found [" + tmpClass + ":" + tmpName + ":" + tmpProperty + "]", LOGLEVEL_WARNING);
+                                    LOG_W("MQTT: Target not found [%s:%s:%s]", tmpClass.c_str(), tmpName.c_str(), tmpProperty.c_str());
                                 } else {
                                     switch (comp->Class()) {
 
                                         case CLASS_RELAY: {
                                             if (!tmpClass.equalsIgnoreCase("relay")) {
-                                                devLog->Write("MQTT: Class mismatch - topic says [" + tmpClass + "], actual is Relay:" + tmpName, LOGLEVEL_WARNING);
+                                                LOG_W("MQTT: Class mismatch - topic says [%s], actual is Relay:%s", tmpClass.c_str(), tmpName.c_str());
                                             } else {
                                                 if (tmpProperty == "state") {
                                                     if (tmpPayload == "on" || tmpPayload == "true" || tmpPayload == "1")
-                                                        comp->as<Relay>()->State(true);
+                                                        mqttSubmit(COMMAND_RELAY_STATE, comp, layout, 1);
                                                     else if (tmpPayload == "off" || tmpPayload == "false" || tmpPayload == "0")
-                                                        comp->as<Relay>()->State(false);
+                                                        mqttSubmit(COMMAND_RELAY_STATE, comp, layout, 0);
                                                     else
-                                                        devLog->Write("MQTT: Invalid Relay state payload [" + tmpPayload + "]", LOGLEVEL_WARNING);
+                                                        LOG_W("MQTT: Invalid Relay state payload [%s]", tmpPayload.c_str());
                                                 }
                                                 else if (tmpProperty == "toggle" || tmpProperty == "invert") {
-                                                    comp->as<Relay>()->Invert();
+                                                    mqttSubmit(COMMAND_RELAY_INVERT, comp, layout);
                                                 }
                                                 else {
-                                                    devLog->Write("MQTT: Unsupported Relay property [" + tmpProperty + "]", LOGLEVEL_WARNING);
+                                                    LOG_W("MQTT: Unsupported Relay property [%s]", tmpProperty.c_str());
                                                 }
                                             }
                                         } break;
 
                                         case CLASS_BLINDS: {
                                             if (!tmpClass.equalsIgnoreCase("blinds")) {
-                                                devLog->Write("MQTT: Class mismatch - topic says [" + tmpClass + "], actual is Blinds:" + tmpName, LOGLEVEL_WARNING);
+                                                LOG_W("MQTT: Class mismatch - topic says [%s], actual is Blinds:%s", tmpClass.c_str(), tmpName.c_str());
                                             } else {
-                                                auto blinds = comp->as<Blinds>();
-
                                                 if (tmpProperty == "targetposition" || tmpProperty == "position") {
                                                     int position = tmpPayload.toInt();
 
                                                     if (position < 0 || position > 100) {
-                                                        devLog->Write("MQTT: Invalid Blinds position [" + tmpPayload + "]", LOGLEVEL_WARNING);
+                                                        LOG_W("MQTT: Invalid Blinds position [%s]", tmpPayload.c_str());
                                                     } else {
-                                                        blinds->Position(position);
+                                                        mqttSubmit(COMMAND_BLINDS_POSITION, comp, layout, position);
                                                     }
                                                 }
                                                 else if (tmpProperty == "currentposition") {
                                                     int position = tmpPayload.toInt();
 
                                                     if (position < 0 || position > 100) {
-                                                        devLog->Write("MQTT: Invalid Blinds current position [" + tmpPayload + "]", LOGLEVEL_WARNING);
+                                                        LOG_W("MQTT: Invalid Blinds current position [%s]", tmpPayload.c_str());
                                                     } else {
-                                                        blinds->Position(position, true); // sync sem movimento
+                                                        mqttSubmit(COMMAND_BLINDS_SYNC, comp, layout, position); // sync sem movimento
                                                     }
                                                 }
                                                 else if (tmpProperty == "state" || tmpProperty == "positionstate") {
                                                     int state = tmpPayload.toInt();
 
                                                     if (state == 2) {
-                                                        blinds->Stop();
+                                                        mqttSubmit(COMMAND_BLINDS_STOP, comp, layout);
                                                     } else {
-                                                        devLog->Write("MQTT: Ignoring Blinds state [" + tmpPayload + "]", LOGLEVEL_WARNING);
+                                                        LOG_W("MQTT: Ignoring Blinds state [%s]", tmpPayload.c_str());
                                                     }
                                                 }
                                                 else if (tmpProperty == "open") {
-                                                    blinds->Open();
+                                                    mqttSubmit(COMMAND_BLINDS_OPEN, comp, layout);
                                                 }
                                                 else if (tmpProperty == "close") {
-                                                    blinds->Close();
+                                                    mqttSubmit(COMMAND_BLINDS_CLOSE, comp, layout);
                                                 }
                                                 else if (tmpProperty == "stop") {
-                                                    blinds->Stop();
+                                                    mqttSubmit(COMMAND_BLINDS_STOP, comp, layout);
                                                 }
                                                 else {
-                                                    devLog->Write("MQTT: Unsupported Blinds property [" + tmpProperty + "]", LOGLEVEL_WARNING);
+                                                    LOG_W("MQTT: Unsupported Blinds property [%s]", tmpProperty.c_str());
                                                 }
                                             }
                                         } break;
 
                                         case CLASS_BUTTON: {
                                             if (!tmpClass.equalsIgnoreCase("button")) {
-                                                devLog->Write("MQTT: Class mismatch - topic says [" + tmpClass + "], actual is Button:" + tmpName, LOGLEVEL_WARNING);
+                                                LOG_W("MQTT: Class mismatch - topic says [%s], actual is Button:%s", tmpClass.c_str(), tmpName.c_str());
                                             } else {
                                                 // handleButton(comp, tmpProperty, tmpPayload);
                                             }
@@ -417,7 +319,7 @@ void setup() {
 
                                         case CLASS_THERMOMETER: {
                                             if (!tmpClass.equalsIgnoreCase("thermometer")) {
-                                                devLog->Write("MQTT: Class mismatch - topic says [" + tmpClass + "], actual is Thermometer:" + tmpName, LOGLEVEL_WARNING);
+                                                LOG_W("MQTT: Class mismatch - topic says [%s], actual is Thermometer:%s", tmpClass.c_str(), tmpName.c_str());
                                             } else {
                                                 // handleThermometer(comp, tmpProperty, tmpPayload);
                                             }
@@ -425,27 +327,22 @@ void setup() {
 
                                         case CLASS_CURRENTMETER: {
                                             if (!tmpClass.equalsIgnoreCase("currentmeter")) {
-                                                devLog->Write("MQTT: Class mismatch - topic says [" + tmpClass + "], actual is Currentmeter:" + tmpName, LOGLEVEL_WARNING);
+                                                LOG_W("MQTT: Class mismatch - topic says [%s], actual is Currentmeter:%s", tmpClass.c_str(), tmpName.c_str());
                                             } else {
                                                 // handleCurrentmeter(comp, tmpProperty, tmpPayload);
                                             }
                                         } break;
 
                                         default: {
-                                            devLog->Write("MQTT: Unsupported class on " + tmpName, LOGLEVEL_WARNING);
+                                            LOG_W("MQTT: Unsupported class on %s", tmpName.c_str());
                                         } break;
                                     }
                                 }
-                            } else {
-                                devLog->Write("MQTT data received does not have expected structure", LOGLEVEL_WARNING);
                             }
                         });
 
-                        if (devMQTT->Connect()) {
-                            devLog->Write("MQTT: Connected on " + Settings.MQTT.User() + "@" + Settings.MQTT.Broker() + ":" + String(Settings.MQTT.Port()), LOGLEVEL_INFO);
-                        } else {
-                            devLog->Write("MQTT: Unable to connected to " + Settings.MQTT.User() + "@" + Settings.MQTT.Broker() + ":" + String(Settings.MQTT.Port()), LOGLEVEL_ERROR);
-                        }
+                        // Connection is driven from loop(), a dead broker must not hold up network bring-up
+                        MQTTLink.Begin();
                     } else {
                         devLog->Write("MQTT: Disabled", LOGLEVEL_INFO);
                     }
@@ -490,12 +387,14 @@ void setup() {
 
 void loop() {
     // static bool s_updating = false;
+    const uint32_t started = micros();
 
-    devClock->Control();
-    devNetwork->Control();
+    { ScopedLatency latency(Profiler.Stage(PROFILESTAGE_CLOCK)); devClock->Control(); }
+    { ScopedLatency latency(Profiler.Stage(PROFILESTAGE_NETWORK)); devNetwork->Control(); }
 
     if (devNetwork->ConnectionMode() == APMode::WifiClient ) {
-        devMQTT->Control();
+        { ScopedLatency latency(Profiler.Stage(PROFILESTAGE_MQTT)); MQTTLink.Control(); }
+        Orchestrator.Control();
 
         // if (devUpdateClient) {
         //     devUpdateClient->Control();
@@ -526,7 +425,15 @@ void loop() {
         // }
     }
 
-    Settings.Components.Control();
+    { ScopedLatency latency(Profiler.Stage(PROFILESTAGE_COMMANDS)); CommandBus.Drain(); }
+
+    // Components added or removed since the last pass are hooked before their callbacks can run again
+    if (devWebServer) WebAPI::Sync();
+    { ScopedLatency latency(Profiler.Stage(PROFILESTAGE_COMPONENTS)); Settings.Components.Control(); }
+
+    if (devWebServer) { ScopedLatency latency(Profiler.Stage(PROFILESTAGE_WEBAPI)); WebAPI::Control(); }
 
     // devSaveState->Control();
+
+    Profiler.Tick(micros() - started);
 }
\ No newline at end of file
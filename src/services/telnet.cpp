@@ -1,4 +1,5 @@
 #include "telnet.h"
+#include "webapi.h"
 
 void Telnet::Begin() {
     if (Settings.TelnetServer.Enabled() == true) {
@@ -22,6 +23,7 @@ void Telnet::Begin() {
         registerCommand_ver();
         registerCommand_memory();
         registerCommand_storage();
+        registerCommand_perf();
         registerCommand_ping();
         registerCommand_telnet();
         registerCommand_webserver();
@@ -38,68 +40,58 @@ void Telnet::Begin() {
 }
 
 void Telnet::registerCommand_dumpcfg(bool admincmd) {
-    devTelnetServer->onCommand("dumpcfg", "Prints the configuration file\r\n\r\ndumpcfg", [&](AsyncClient* client, String* parameter) {
-        String result;
+    devTelnetServer->onCommandArgs("dumpcfg", "Prints the configuration file\r\n\r\ndumpcfg", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         const String path = Defaults.ConfigFileName;
 
-        File f = devFileSystem->OpenFile(path, "r");
-        if (!f) {
-            result += "Config         | Error opening config file '" + path + "'.\r\n";
-            client->write(result.c_str());
+        std::shared_ptr<File> f = std::make_shared<File>(devFileSystem->OpenFile(path, "r"));
+        if (!*f) {
+            session->print("Config         | Error opening config file '" + path + "'.\r\n");
             return;
         }
 
-        result += "Config         | File: " + path + "\r\n\r\n";
-
-        while (f.available()) {
-            String line = f.readStringUntil('\n');
-            result += line + "\r\n";
+        session->print("Config         | File: " + path + "\r\n\r\n");
 
-            if (result.length() > 2048) {
-                client->write(result.c_str());
-                result.clear();
+        // One line per call, so only what the client can take is read from flash
+        session->Stream([f](AsyncTelnetSession* session) -> bool {
+            if (!f->available()) {
+                f->close();
+                return false;
             }
-        }
 
-        f.close();
-
-        if (!result.isEmpty()) {
-            client->write(result.c_str());
-        }
+            session->print(f->readStringUntil('\n'));
+            session->print("\r\n");
+            return true;
+        });
     }, admincmd);
 }
 void Telnet::registerCommand_logon(bool admincmd) {
-    devTelnetServer->onCommand("logon", "Log into the system with specific credential\r\n\r\nlogon [username] [password]", [&](AsyncClient* client, String* parameter) {
+    devTelnetServer->onCommandArgs("logon", "Log into the system with specific credential\r\n\r\nlogon [username] [password]", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         String result;
         
-        if (parameter[0].isEmpty() || parameter[1].isEmpty()) {
+        if (args.Empty(0) || args.Empty(1)) {
             result += "Logon          | Missing username and password.\r\n";
         } else {
-            UserReturn ret = Settings.Users.Authenticate(parameter[0], parameter[1]);
+            UserReturn ret = Settings.Users.Authenticate(String(args[0]), String(args[1]));
 
             switch (ret) {
                 case UserReturn::Authenticated : {
-                    AsyncTelnetSession* session = devTelnetServer->CurrentSession(client);
-                    
-                    if (session != nullptr) {
-                        session->User = parameter[0];
-                        session->Admin = Settings.Users.IsAdmin(session->User);
-                    }
-                    
-                    result += "Logon          | Logon successful for user " + parameter[0] + ".\r\n";
-                    devLog->Write("Telnet Server: Logon successful for " + parameter[0] + "@" + client->remoteIP().toString() + ":" + String(client->remotePort()), LOGLEVEL_INFO);
+                    session->User = args[0];
+                    session->Admin = Settings.Users.IsAdmin(session->User);
+
+                    result += "Logon          | Logon successful for user " + String(args[0]) + ".\r\n";
+                    devLog->Write("Telnet Server: Logon successful for " + String(args[0]) + "@" + client->remoteIP().toString() + ":" + String(client->remotePort()), LOGLEVEL_INFO);
                 }
                 break;
 
                 case UserReturn::InvalidCredentials : {
-                    result += "Logon          | Logon failed for user " + parameter[0] + " - Invalid credentials.\r\n";
-                    devLog->Write("Telnet Server: Logon failed for " + parameter[0] + "@" + client->remoteIP().toString() + ":" + String(client->remotePort()) + " - Invalid credentials", LOGLEVEL_WARNING);
+                    result += "Logon          | Logon failed for user " + String(args[0]) + " - Invalid credentials.\r\n";
+                    devLog->Write("Telnet Server: Logon failed for " + String(args[0]) + "@" + client->remoteIP().toString() + ":" + String(client->remotePort()) + " - Invalid credentials", LOGLEVEL_WARNING);
                 }
                 break;
 
                 case UserReturn::UserNotFound : {
-                    result += "Logon          | Logon failed for user " + parameter[0] + " - user not found.\r\n";
-                    devLog->Write("Telnet Server: Logon failed for " + parameter[0] + "@" + client->remoteIP().toString() + ":" + String(client->remotePort()) + " - User not found", LOGLEVEL_WARNING);
+                    result += "Logon          | Logon failed for user " + String(args[0]) + " - user not found.\r\n";
+                    devLog->Write("Telnet Server: Logon failed for " + String(args[0]) + "@" + client->remoteIP().toString() + ":" + String(client->remotePort()) + " - User not found", LOGLEVEL_WARNING);
                 }
                 break;
             
@@ -107,20 +99,20 @@ void Telnet::registerCommand_logon(bool admincmd) {
                 break;
             }
         }
-        client->write(result.c_str());
+        devTelnetServer->Write(client, result.c_str());
     }, admincmd);
 }
 void Telnet::registerCommand_reboot(bool admincmd) {
-    devTelnetServer->onCommand("reboot", "Reboot the device\r\n\r\nreboot", [&](AsyncClient* client, String* parameter) {
+    devTelnetServer->onCommandArgs("reboot", "Reboot the device\r\n\r\nreboot", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         DeviceRestart();
     }, admincmd);
 }
 void Telnet::registerCommand_network(bool admincmd) {
-    devTelnetServer->onCommand("network", "Show or change network configuration\r\n\r\nnetwork [options]", [&](AsyncClient* client, String* parameter) {
+    devTelnetServer->onWorkerCommandArgs("network", "Show or change network configuration\r\n\r\nnetwork [options]", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         String result;
         bool changed = false;
 
-        if (parameter[0].isEmpty()) {
+        if (args.Empty(0)) {
             result += "Network        | " + LimitString("SSID: " + devNetwork->SSID(), 30, true) + LimitString(Settings.Network.SSID(), 30, true) + "\r\n";
             result += "               | " + LimitString("PSK: " + devNetwork->Passphrase(), 30, true) + LimitString(Settings.Network.Passphrase(), 30, true) + "\r\n";
             result += "               | " + LimitString("Hostname: " + devNetwork->Hostname(), 30, true) + LimitString(Settings.Network.Hostname(), 30, true) + "\r\n";
@@ -132,16 +124,16 @@ void Telnet::registerCommand_network(bool admincmd) {
             result += "               | " + LimitString("Secondary: " + devNetwork->DNS_Server(1).toString(), 30, true) + LimitString(Settings.Network.DNS(1).toString(), 30, true) + "\r\n\r\n";
             result += "MAC            | Address: " + devNetwork->MAC_Address() + "\r\n";
         } else {
-            if (parameter[0].equalsIgnoreCase("hostname")) {
-                if (!parameter[1].isEmpty() && !Settings.Network.Hostname().equalsIgnoreCase(parameter[1])) {
-                    Settings.Network.Hostname(parameter[1]);
+            if (args.Is(0, "hostname")) {
+                if (!args.Empty(1) && !Settings.Network.Hostname().equalsIgnoreCase(String(args[1]))) {
+                    Settings.Network.Hostname(String(args[1]));
                     changed = true;
                 }
                 result += "Network        | " + LimitString("Hostname: " + devNetwork->Hostname(), 30, true) + LimitString(Settings.Network.Hostname(), 30, true) + "\r\n";
-            } else if (parameter[0].equalsIgnoreCase("scan")) {
-                client->write("Network        | Scanning WiFi networks...\r\n");
+            } else if (args.Is(0, "scan")) {
+                devTelnetServer->Write(client, "Network        | Scanning WiFi networks...\r\n");
 
-                if (devNetwork->ConnectionMode() == APMode::WifiClient) client->write("               | WARNING: Device is connected as WiFi client. Scan may disrupt connection or cause reboot\r\n");
+                if (devNetwork->ConnectionMode() == APMode::WifiClient) devTelnetServer->Write(client, "               | WARNING: Device is connected as WiFi client. Scan may disrupt connection or cause reboot\r\n");
 
                 WiFi.scanDelete();
                 delay(10);
@@ -149,11 +141,11 @@ void Telnet::registerCommand_network(bool admincmd) {
                 int n = WiFi.scanNetworks(false, false);
 
                 if (n < 0) {
-                    client->write("Network        | Error scanning WiFi networks.\r\n");
+                    devTelnetServer->Write(client, "Network        | Error scanning WiFi networks.\r\n");
                 } else if (n == 0) {
-                    client->write("Network        | No networks found.\r\n");
+                    devTelnetServer->Write(client, "Network        | No networks found.\r\n");
                 } else {
-                    for (int i = 0; i < n; ++i) {
+                    for (int i = 0; i < n && !devTelnetServer->Cancelled(client); ++i) {
                         String ssid = WiFi.SSID(i);
                         int32_t rssi = WiFi.RSSI(i);
                         int32_t ch = WiFi.channel(i);
@@ -181,22 +173,22 @@ void Telnet::registerCommand_network(bool admincmd) {
                         line += " " + enc_str;
                         line += "\r\n";
 
-                        client->write(line.c_str());
+                        devTelnetServer->Write(client, line.c_str());
                         delay(0);
                     }
 
                     String line;
                     line = "               | Count: " + String(n) + "\r\n";
-                    client->write(line.c_str());
+                    devTelnetServer->Write(client, line.c_str());
                 }
 
                 WiFi.scanDelete();
-            } else if (parameter[0].equalsIgnoreCase("wifi")) {
-                if (parameter[1].isEmpty()) {
+            } else if (args.Is(0, "wifi")) {
+                if (args.Empty(1)) {
                     result += "Network        | " + LimitString("SSID: " + devNetwork->SSID(), 30, true) + LimitString(Settings.Network.SSID(), 30, true) + "\r\n";
                     result += "               | " + LimitString("PSK: " + devNetwork->Passphrase(), 30, true) + LimitString(Settings.Network.Passphrase(), 30, true) + "\r\n";
                 } else {
-                    String wifi_param = parameter[1];
+                    String wifi_param = args[1];
 
                     int sep = wifi_param.indexOf(':');
 
@@ -240,56 +232,56 @@ void Telnet::registerCommand_network(bool admincmd) {
 
                             if (changed_local) {
                                 result += "\r\n               | WiFi credentials updated - reboot required.\r\n";
-                                Settings.Save();
+                                CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
                                 changed = true;
                             }
                         }
                     }
                 }
-            } else if (parameter[0].equalsIgnoreCase("dhcp")) {
-                if (parameter[1].equalsIgnoreCase("true") || parameter[1].equalsIgnoreCase("on") || parameter[1].equalsIgnoreCase("yes")) {
+            } else if (args.Is(0, "dhcp")) {
+                if (args.Is(1, "true") || args.Is(1, "on") || args.Is(1, "yes")) {
                     if (!Settings.Network.DHCPClient()) {
                         Settings.Network.DHCPClient(true);
                         changed = true;
                     }
-                } else if (parameter[1].equalsIgnoreCase("false") || parameter[1].equalsIgnoreCase("off") || parameter[1].equalsIgnoreCase("no")) {
+                } else if (args.Is(1, "false") || args.Is(1, "off") || args.Is(1, "no")) {
                     if (Settings.Network.DHCPClient()) {
                         Settings.Network.DHCPClient(false);
                         changed = true;
                     }
                 }
                 result += "Network        | " + LimitString("DHCP: " + devNetwork->DHCP_Client() ? "Yes" : "No", 30, true) + LimitString(Settings.Network.DHCPClient() ? "Yes" : "No", 30, true) + "\r\n";
-            } else if (parameter[0].equalsIgnoreCase("ip")) {
-                if (!parameter[1].isEmpty() && !Settings.Network.IP_Address().toString().equalsIgnoreCase(parameter[1])) {
-                    Settings.Network.IP_Address(parameter[1]);
+            } else if (args.Is(0, "ip")) {
+                if (!args.Empty(1) && !Settings.Network.IP_Address().toString().equalsIgnoreCase(String(args[1]))) {
+                    Settings.Network.IP_Address(String(args[1]));
                     changed = true;
                 }
                 result += "Network        | " + LimitString("IP: " + devNetwork->IP_Address().toString(), 30, true) + LimitString(Settings.Network.IP_Address().toString(), 30, true) + "\r\n";
-            } else if (parameter[0].equalsIgnoreCase("gateway")) {
-                if (!parameter[1].isEmpty() && !Settings.Network.Gateway().toString().equalsIgnoreCase(parameter[1])) {
-                    Settings.Network.Gateway(parameter[1]);
+            } else if (args.Is(0, "gateway")) {
+                if (!args.Empty(1) && !Settings.Network.Gateway().toString().equalsIgnoreCase(String(args[1]))) {
+                    Settings.Network.Gateway(String(args[1]));
                     changed = true;
                 }
                 result += "Network        | " + LimitString("Gateway: " + devNetwork->Gateway().toString(), 30, true) + LimitString(Settings.Network.Gateway().toString(), 30, true) + "\r\n";
-            } else if (parameter[0].equalsIgnoreCase("mask")) {
-                if (!parameter[1].isEmpty() && !Settings.Network.Netmask().toString().equalsIgnoreCase(parameter[1])) {
-                    Settings.Network.Netmask(parameter[1]);
+            } else if (args.Is(0, "mask")) {
+                if (!args.Empty(1) && !Settings.Network.Netmask().toString().equalsIgnoreCase(String(args[1]))) {
+                    Settings.Network.Netmask(String(args[1]));
                     changed = true;
                 }
                 result += "Network        | " + LimitString("Mask: " + devNetwork->Netmask().toString(), 30, true) + LimitString(Settings.Network.Netmask().toString(), 30, true) + "\r\n";
-            } else if (parameter[0].equalsIgnoreCase("dns1")) {
-                if (!parameter[1].isEmpty() && !Settings.Network.DNS(0).toString().equalsIgnoreCase(parameter[1])) {
-                    Settings.Network.DNS(0, parameter[1]);
+            } else if (args.Is(0, "dns1")) {
+                if (!args.Empty(1) && !Settings.Network.DNS(0).toString().equalsIgnoreCase(String(args[1]))) {
+                    Settings.Network.DNS(0, String(args[1]));
                     changed = true;
                 }
                 result += "DNS            | " + LimitString("Primary: " + devNetwork->DNS_Server(0).toString(), 30, true) + LimitString(Settings.Network.DNS(0).toString(), 30, true) + "\r\n";
-            } else if (parameter[0].equalsIgnoreCase("dns2")) {
-                if (!parameter[1].isEmpty() && !Settings.Network.DNS(1).toString().equalsIgnoreCase(parameter[1])) {
-                    Settings.Network.DNS(1, parameter[1]);
+            } else if (args.Is(0, "dns2")) {
+                if (!args.Empty(1) && !Settings.Network.DNS(1).toString().equalsIgnoreCase(String(args[1]))) {
+                    Settings.Network.DNS(1, String(args[1]));
                     changed = true;
                 }
                 result += "DNS            | " + LimitString("Secondary: " + devNetwork->DNS_Server(1).toString(), 30, true) + LimitString(Settings.Network.DNS(1).toString(), 30, true) + "\r\n";
-            } else if (parameter[0].equalsIgnoreCase("mac")) {
+            } else if (args.Is(0, "mac")) {
                 result += "MAC            | Address: " + devNetwork->MAC_Address() + "\r\n";
             }  else {
                 result += "Network        | Error: Invalid network parameter.\r\n";
@@ -298,35 +290,35 @@ void Telnet::registerCommand_network(bool admincmd) {
         
         if (changed) {
             result += "\r\n               | Settings changed - reboot recommended to apply changes.\r\n";
-            Settings.Save();
+            CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
         }
-        client->write(result.c_str());
+        devTelnetServer->Write(client, result.c_str());
     }, admincmd);
 }
 void Telnet::registerCommand_ntp(bool admincmd) {
-    devTelnetServer->onCommand("ntp", "Show or change NTP configuration\r\n\r\nntp [options]", [&](AsyncClient* client, String* parameter) {
+    devTelnetServer->onWorkerCommandArgs("ntp", "Show or change NTP configuration\r\n\r\nntp [options]", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         String result;
         bool changed = false;
 
-        if (parameter[0].isEmpty()) {
+        if (args.Empty(0)) {
             result += "NTP            | Enabled: " + String(Settings.General.NTPUpdate() ? "Yes" : "No") + "\r\n";
             result += "               | Server: " + Settings.General.NTPServer() + "\r\n";
-        } else if (parameter[0].equalsIgnoreCase("enabled")) {
-            if (parameter[1].equalsIgnoreCase("true") || parameter[1].equalsIgnoreCase("on") || parameter[1].equalsIgnoreCase("yes")) {
+        } else if (args.Is(0, "enabled")) {
+            if (args.Is(1, "true") || args.Is(1, "on") || args.Is(1, "yes")) {
                 if (!Settings.General.NTPUpdate()) {
                     Settings.General.NTPUpdate(true);
                     changed = true;
                 }
-            } else if (parameter[1].equalsIgnoreCase("false") || parameter[1].equalsIgnoreCase("off") || parameter[1].equalsIgnoreCase("no")) {
+            } else if (args.Is(1, "false") || args.Is(1, "off") || args.Is(1, "no")) {
                 if (Settings.General.NTPUpdate()) {
                     Settings.General.NTPUpdate(false);
                     changed = true;
                 }
             }
             result += "NTP            | Enabled: " + String(Settings.General.NTPUpdate() ? "Yes" : "No") + "\r\n";
-        } else if (parameter[0].equalsIgnoreCase("server")) {
-            if (!parameter[1].isEmpty() && !Settings.General.NTPServer().equalsIgnoreCase(parameter[1])) {
-                Settings.General.NTPServer(parameter[1]);
+        } else if (args.Is(0, "server")) {
+            if (!args.Empty(1) && !Settings.General.NTPServer().equalsIgnoreCase(String(args[1]))) {
+                Settings.General.NTPServer(String(args[1]));
                 changed = true;
             }
             result += "NTP            | Server: " + Settings.General.NTPServer() + "\r\n";
@@ -336,27 +328,21 @@ void Telnet::registerCommand_ntp(bool admincmd) {
         
         if (changed) {
             result += "\r\n               | Settings changed - reboot recommended to apply changes.\r\n";
-            Settings.Save();
+            CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
         }
-        client->write(result.c_str());
+        devTelnetServer->Write(client, result.c_str());
     }, admincmd);
 }
 void Telnet::registerCommand_ver(bool admincmd) {
-    devTelnetServer->onCommand("ver", "Show device version info\r\n\r\nver", [&](AsyncClient* client, String* parameter) {
-        String result;
-
-        result += "Version        | Product: " + Version.ProductName + "\r\n";
-        result += "               | Family: " + Version.ProductFamily + "\r\n";
-        result += "               | Hardware: " + Version.Hardware.Info() + "\r\n";
-        result += "               | Software: " + Version.Software.Info() + "\r\n";
-
-        client->write(result.c_str());
+    devTelnetServer->onCommandArgs("ver", "Show device version info\r\n\r\nver", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
+        session->printf("Version        | Product: %s\r\n", Version.ProductName.c_str());
+        session->printf("               | Family: %s\r\n", Version.ProductFamily.c_str());
+        session->printf("               | Hardware: %s\r\n", Version.Hardware.Info().c_str());
+        session->printf("               | Software: %s\r\n", Version.Software.Info().c_str());
     }, admincmd);
 }
 void Telnet::registerCommand_memory(bool admincmd) {
-    devTelnetServer->onCommand("memory", "Show device memory information\r\n\r\nmemory", [&](AsyncClient* client, String* parameter) {
-        String result;
-        
+    devTelnetServer->onCommandArgs("memory", "Show device memory information\r\n\r\nmemory", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         uint32_t heapFree = ESP.getFreeHeap();
         uint32_t heapTotal = ESP.getHeapSize();
         uint32_t heapMin = ESP.getMinFreeHeap();
@@ -371,20 +357,73 @@ void Telnet::registerCommand_memory(bool admincmd) {
         float internalPct = (internalTotal > 0) ? ((float)internalFree / internalTotal) * 100.0 : 0;
         float psramPct = (psramTotal > 0) ? ((float)psramFree / psramTotal) * 100.0 : 0;
 
-        result += "Heap           | Free: " + String(heapFree) + "/" + String(heapTotal) + " bytes (" + String(heapPct, 1) + "%)\r\n";
-        result += "               | Min free: " + String(heapMin) + " bytes\r\n";
-        result += "               | Max alloc: " + String(heapMax) + " bytes\r\n\r\n";
-        result += "Internal RAM   | Free: " + String(internalFree) + "/" + String(internalTotal) + " bytes (" + String(internalPct, 1) + "%)\r\n";
-        result += "               | Min free: " + String(internalMin) + " bytes\r\n\r\n";
-        result += "PSRAM          | Free: " + String(psramFree) + "/" + String(psramTotal) + " bytes (" + String(psramPct, 1) + "%)\r\n";
+        session->printf("Heap           | Free: %u/%u bytes (%.1f%%)\r\n", (unsigned)heapFree, (unsigned)heapTotal, heapPct);
+        session->printf("               | Min free: %u bytes\r\n", (unsigned)heapMin);
+        session->printf("               | Max alloc: %u bytes\r\n\r\n", (unsigned)heapMax);
+        session->printf("Internal RAM   | Free: %u/%u bytes (%.1f%%)\r\n", (unsigned)internalFree, (unsigned)internalTotal, internalPct);
+        session->printf("               | Min free: %u bytes\r\n\r\n", (unsigned)internalMin);
+        session->printf("PSRAM          | Free: %u/%u bytes (%.1f%%)\r\n", (unsigned)psramFree, (unsigned)psramTotal, psramPct);
+    }, admincmd);
+}
+void Telnet::printPerf(Print& out) {
+    LatencyStats stages[PROFILESTAGE_COUNT];
+    profile_rate_t rates[PROFILEIF_COUNT];
+    profile_task_t tasks[PROFILER_MAXTASKS];
+
+    Profiler.Stages(stages);
+    Profiler.Rates(rates);
+    const size_t taskCount = Profiler.Tasks(tasks, PROFILER_MAXTASKS);
+
+    const uint32_t window = Profiler.WindowMs();
+    const uint32_t passes = window ? (uint32_t)((uint64_t)stages[PROFILESTAGE_LOOP].Count() * 1000 / window) : 0;
+
+    out.printf("Loop           | %u passes/s over the last %u ms\r\n", (unsigned)passes, (unsigned)window);
+    out.printf("               | %-12s %8s %8s %8s %8s (us)\r\n", "Stage", "Min", "Avg", "P99", "Max");
+    for (uint8_t i = 0; i < PROFILESTAGE_COUNT; i++) {
+        const LatencyStats& s = stages[i];
+        out.printf("               | %-12s %8u %8u %8u %8u\r\n", Profiler.StageName((ProfileStages)i), (unsigned)s.Min(), (unsigned)s.Avg(), (unsigned)s.Percentile(99), (unsigned)s.Max());
+    }
+
+    out.printf("\r\nTasks          | %-16s %6s %10s %4s %5s\r\n", "Name", "CPU", "Stack free", "Prio", "State");
+    if (taskCount == 0) out.print("               | Not available\r\n");
+    for (size_t i = 0; i < taskCount; i++) {
+        char share[8];
+        if (tasks[i].Share == PROFILE_NOSHARE) strlcpy(share, "-", sizeof(share));
+        else snprintf(share, sizeof(share), "%u.%u%%", (unsigned)(tasks[i].Share / 10), (unsigned)(tasks[i].Share % 10));
+
+        out.printf("               | %-16s %6s %10u %4u %5c\r\n", tasks[i].Name, share, (unsigned)tasks[i].StackFree, (unsigned)tasks[i].Priority, tasks[i].State);
+    }
+
+    out.printf("\r\nInterfaces     | %-12s %8s %8s %8s (per second)\r\n", "Name", "In", "Out", "Commands");
+    for (uint8_t i = 0; i < PROFILEIF_COUNT; i++) {
+        out.printf("               | %-12s %8u %8u %8u\r\n", Profiler.InterfaceName((ProfileInterfaces)i), (unsigned)rates[i].In, (unsigned)rates[i].Out, (unsigned)rates[i].Commands);
+    }
+
+    out.printf("\r\nCommand bus    | Depth %u/%u (max %u), full %u, rejected %u, saves %u\r\n", (unsigned)CommandBus.Depth(), (unsigned)COMMANDBUS_DEPTH, (unsigned)CommandBus.MaxDepth(), (unsigned)CommandBus.Full(), (unsigned)CommandBus.Rejected(), (unsigned)CommandBus.Saves());
+    out.print("               | Latency " + CommandBus.Latency().ToString() + "\r\n");
+}
+void Telnet::registerCommand_perf(bool admincmd) {
+    devTelnetServer->onCommandArgs("perf", "Show loop, task and interface statistics\r\n\r\nperf", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
+        printPerf(*session);
+    }, admincmd);
+
+    devTelnetServer->onCommandArgs("top", "Show perf statistics, refreshing in place until Ctrl-C\r\n\r\ntop", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
+        std::shared_ptr<uint32_t> next = std::make_shared<uint32_t>(millis());
 
-        client->write(result.c_str());
+        // Returning without output leaves the session idle until the next ack or poll
+        session->Stream([next](AsyncTelnetSession* session) -> bool {
+            if ((int32_t)(millis() - *next) < 0) return true;
+            *next = millis() + Defaults.Perf.RefreshMs;
+
+            session->print("\x1b[H\x1b[2J");
+            printPerf(*session);
+            session->print("\r\nPress Ctrl-C to stop.\r\n");
+            return true;
+        });
     }, admincmd);
 }
 void Telnet::registerCommand_storage(bool admincmd) {
-    devTelnetServer->onCommand("storage", "Show device storage information\r\n\r\nstorage", [&](AsyncClient* client, String* parameter) {
-        String result;
-
+    devTelnetServer->onCommandArgs("storage", "Show device storage information\r\n\r\nstorage", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         uint32_t flashChipSize = ESP.getFlashChipSize();
         uint32_t flashChipSpeed = ESP.getFlashChipSpeed();
         uint32_t flashSketchSize = ESP.getSketchSize();
@@ -402,24 +441,22 @@ void Telnet::registerCommand_storage(bool admincmd) {
         float fsUsedPct = (fsTotal > 0) ? ((float)fsUsed / fsTotal) * 100.0f : 0.0f;
         float fsFreePct = (fsTotal > 0) ? ((float)(fsTotal - fsUsed) / fsTotal) * 100.0f : 0.0f;
 
-        result += "Storage        | Chip size: " + String(flashChipSize) + " bytes\r\n";
-        result += "               | Chip speed: " + String(flashChipSpeed) + " Hz\r\n";
-        result += "               | Sketch size: " + String(flashSketchSize) + " / " + String(flashChipSize) + " bytes (" + String(flashSketchPct, 1) + "%)\r\n";
-        result += "               | Free sketch space: " + String(flashFreeSketch) + " / " + String(flashChipSize) + " bytes (" + String(flashFreePct, 1) + "%)\r\n\r\n";
-        result += "File System    | Used: " + String(fsUsed) + " / " + String(fsTotal) + " bytes (" + String(fsUsedPct, 1) + "%)\r\n";
-        result += "               | Free: " + String(fsTotal - fsUsed) + " / " + String(fsTotal) + " bytes (" + String(fsFreePct, 1) + "%)\r\n";
-
-        client->write(result.c_str());
+        session->printf("Storage        | Chip size: %u bytes\r\n", (unsigned)flashChipSize);
+        session->printf("               | Chip speed: %u Hz\r\n", (unsigned)flashChipSpeed);
+        session->printf("               | Sketch size: %u / %u bytes (%.1f%%)\r\n", (unsigned)flashSketchSize, (unsigned)flashChipSize, flashSketchPct);
+        session->printf("               | Free sketch space: %u / %u bytes (%.1f%%)\r\n\r\n", (unsigned)flashFreeSketch, (unsigned)flashChipSize, flashFreePct);
+        session->printf("File System    | Used: %u / %u bytes (%.1f%%)\r\n", (unsigned)fsUsed, (unsigned)fsTotal, fsUsedPct);
+        session->printf("               | Free: %u / %u bytes (%.1f%%)\r\n", (unsigned)(fsTotal - fsUsed), (unsigned)fsTotal, fsFreePct);
     }, admincmd);
 }
 void Telnet::registerCommand_ping(bool admincmd) {
-    devTelnetServer->onCommand("ping", "Ping IP or host\r\n\r\nping [destination] [-n ntimes]", [&](AsyncClient* client, String* parameter) {
+    devTelnetServer->onWorkerCommandArgs("ping", "Ping IP or host\r\n\r\nping [destination] [-n ntimes]", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         String result;
 
-        if (parameter[0].isEmpty()) {
+        if (args.Empty(0)) {
             result += "Ping           | Error: Missing destination\r\n";
         } else {
-            String destination = parameter[0];
+            String destination = args[0];
             struct hostent* host = gethostbyname(destination.c_str());
 
             if (!host) {
@@ -445,7 +482,7 @@ void Telnet::registerCommand_ping(bool admincmd) {
                 if (sock < 0) {
                     result += "               | Error: Cannot create socket\r\n\r\n";
                 } else {    
-                    client->write(result.c_str()); result.clear();
+                    devTelnetServer->Write(client, result.c_str()); result.clear();
 
                     struct timeval timeout;
                     timeout.tv_sec = 1;
@@ -460,9 +497,9 @@ void Telnet::registerCommand_ping(bool admincmd) {
                     uint32_t totalTime = 0;
 
                     int ntimes = 4;
-                    if (parameter[1].equalsIgnoreCase("-n")) ntimes = parameter[2].toInt();
+                    if (args.Is(1, "-n")) ntimes = atoi(args[2]);
 
-                    for (int i = 0; i < ntimes; i++) {
+                    for (int i = 0; i < ntimes && !devTelnetServer->Cancelled(client); i++) {
                         struct icmp_echo_hdr icmp;
                         memset(&icmp, 0, sizeof(icmp));
 
@@ -486,8 +523,8 @@ void Telnet::registerCommand_ping(bool admincmd) {
                         sentCount++;
 
                         if (sent < 0) {
-                            client->write(String("               | From " + String(ip) + " icmp_seq " + String(i + 1) + " send failed\r\n").c_str());
-                            delay(1000);
+                            devTelnetServer->Write(client, String("               | From " + String(ip) + " icmp_seq " + String(i + 1) + " send failed\r\n").c_str());
+                            devTelnetServer->Wait(client, 1000);
                             continue;
                         }
 
@@ -507,12 +544,12 @@ void Telnet::registerCommand_ping(bool admincmd) {
                             char fromIp[16];
                             inet_ntoa_r(from.sin_addr, fromIp, sizeof(fromIp));
 
-                            client->write(String("               | " + String(sizeof(packet)) + " bytes from " + String(fromIp) + ": icmp_seq = " + String(i + 1) + " ttl = 64 time = " + String(elapsed) + " ms\r\n").c_str());
+                            devTelnetServer->Write(client, String("               | " + String(sizeof(packet)) + " bytes from " + String(fromIp) + ": icmp_seq = " + String(i + 1) + " ttl = 64 time = " + String(elapsed) + " ms\r\n").c_str());
                         } else {
-                            client->write(String("               | Request timeout for icmp_seq " + String(i + 1) + "\r\n").c_str());
+                            devTelnetServer->Write(client, String("               | Request timeout for icmp_seq " + String(i + 1) + "\r\n").c_str());
                         }
 
-                        delay(1000);
+                        devTelnetServer->Wait(client, 1000);
                     }
 
                     close(sock);
@@ -531,34 +568,34 @@ void Telnet::registerCommand_ping(bool admincmd) {
             }
         }
 
-        client->write(result.c_str());
+        devTelnetServer->Write(client, result.c_str());
     }, admincmd);
 }
 void Telnet::registerCommand_telnet(bool admincmd) {
-    devTelnetServer->onCommand("telnet", "Show or change Telnet configuration\r\n\r\ntelnet [options]", [&](AsyncClient* client, String* parameter) {
+    devTelnetServer->onCommandArgs("telnet", "Show or change Telnet configuration\r\n\r\ntelnet [options]", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         String result;
         bool changed = false;
 
-        if (parameter[0].isEmpty()) {
+        if (args.Empty(0)) {
             result += "Telnet         | Enabled: " + String(Settings.TelnetServer.Enabled() ? "Yes" : "No") + "\r\n";
             result += "               | Port: " + String(Settings.TelnetServer.Port()) + "\r\n";
-         } else if (parameter[0].equalsIgnoreCase("enabled")) {
-            if (parameter[1].equalsIgnoreCase("true") || parameter[1].equalsIgnoreCase("on") || parameter[1].equalsIgnoreCase("yes")) {
+         } else if (args.Is(0, "enabled")) {
+            if (args.Is(1, "true") || args.Is(1, "on") || args.Is(1, "yes")) {
                 if (!Settings.TelnetServer.Enabled()) {
                     Settings.TelnetServer.Enabled(true);
                     changed = true;
                 }
-            } else if (parameter[1].equalsIgnoreCase("false") || parameter[1].equalsIgnoreCase("off") || parameter[1].equalsIgnoreCase("no")) {
+            } else if (args.Is(1, "false") || args.Is(1, "off") || args.Is(1, "no")) {
                 if (Settings.TelnetServer.Enabled()) {
                     Settings.TelnetServer.Enabled(false);
                     changed = true;
                 }
             } 
             result += "Telnet         | Enabled: " + String(Settings.TelnetServer.Enabled() ? "Yes" : "No") + "\r\n";
-            Settings.Save();
-        } else if (parameter[0].equalsIgnoreCase("port")) {
-            if (!parameter[1].isEmpty() && (Settings.TelnetServer.Port() != parameter[1].toInt())) {
-                Settings.TelnetServer.Port(parameter[1].toInt());
+            CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
+        } else if (args.Is(0, "port")) {
+            if (!args.Empty(1) && (Settings.TelnetServer.Port() != atoi(args[1]))) {
+                Settings.TelnetServer.Port(atoi(args[1]));
                 changed = true;
             }
             result += "Telnet         | Port: " + String(Settings.TelnetServer.Port()) + "\r\n";
@@ -568,43 +605,49 @@ void Telnet::registerCommand_telnet(bool admincmd) {
 
         if (changed) {
             result += "\r\n               | Settings changed - reboot recommended to apply changes.\r\n";
-            Settings.Save();
+            CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
         }
-        client->write(result.c_str());
+        devTelnetServer->Write(client, result.c_str());
     }, admincmd);
 }
 void Telnet::registerCommand_webserver(bool admincmd) {
-    devTelnetServer->onCommand("webserver", "Show or change WerServer configuration\r\n\r\nwebserver [options]", [&](AsyncClient* client, String* parameter) {
+    devTelnetServer->onCommandArgs("webserver", "Show or change WerServer configuration\r\n\r\nwebserver [options]", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         String result;
         bool changed = false;
 
-        if (parameter[0].isEmpty()) {
+        if (args.Empty(0)) {
             result += "WebServer      | Enabled: " + String(Settings.WebServer.Enabled() ? "Yes" : "No") + "\r\n";
             result += "               | Port: " + String(Settings.WebServer.Port()) + "\r\n";
             result += "               | Token: " + Settings.WebServer.WebHooksToken() + "\r\n";
-         } else if (parameter[0].equalsIgnoreCase("enabled")) {
-            if (parameter[1].equalsIgnoreCase("true") || parameter[1].equalsIgnoreCase("on") || parameter[1].equalsIgnoreCase("yes")) {
+            if (devWebServer) {
+                result += "\r\nEvents         | Clients: " + String(WebAPI::Subscribers()) + "\r\n";
+                result += "               | Generation: " + String(WebAPI::Generation()) + "\r\n";
+                result += "               | Sent: " + String(WebAPI::EventsSent()) + "\r\n";
+                result += "               | Dropped: " + String(WebAPI::EventsDropped()) + "\r\n";
+            }
+         } else if (args.Is(0, "enabled")) {
+            if (args.Is(1, "true") || args.Is(1, "on") || args.Is(1, "yes")) {
                 if (!Settings.WebServer.Enabled()) {
                     Settings.WebServer.Enabled(true);
                     changed = true;
                 }
-            } else if (parameter[1].equalsIgnoreCase("false") || parameter[1].equalsIgnoreCase("off") || parameter[1].equalsIgnoreCase("no")) {
+            } else if (args.Is(1, "false") || args.Is(1, "off") || args.Is(1, "no")) {
                 if (Settings.WebServer.Enabled()) {
                     Settings.WebServer.Enabled(false);
                     changed = true;
                 }
             } 
             result += "WebServer      | Enabled: " + String(Settings.WebServer.Enabled() ? "Yes" : "No") + "\r\n";
-            Settings.Save();
-        } else if (parameter[0].equalsIgnoreCase("port")) {
-            if (!parameter[1].isEmpty() && (Settings.WebServer.Port() != parameter[1].toInt())) {
-                Settings.WebServer.Port(parameter[1].toInt());
+            CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
+        } else if (args.Is(0, "port")) {
+            if (!args.Empty(1) && (Settings.WebServer.Port() != atoi(args[1]))) {
+                Settings.WebServer.Port(atoi(args[1]));
                 changed = true;
             }
             result += "WebServer      | Port: " + String(Settings.WebServer.Port()) + "\r\n";
-        } else if (parameter[0].equalsIgnoreCase("token")) {
-            if (!parameter[1].isEmpty() && (!Settings.WebServer.WebHooksToken().equalsIgnoreCase(parameter[1]))) {
-                Settings.WebServer.WebHooksToken(parameter[1]);
+        } else if (args.Is(0, "token")) {
+            if (!args.Empty(1) && (!Settings.WebServer.WebHooksToken().equalsIgnoreCase(String(args[1])))) {
+                Settings.WebServer.WebHooksToken(String(args[1]));
                 changed = true;
             }
             result += "WebServer      | Token: " + Settings.WebServer.WebHooksToken() + "\r\n";
@@ -614,77 +657,156 @@ void Telnet::registerCommand_webserver(bool admincmd) {
 
         if (changed) {
             result += "\r\n               | Settings changed - reboot recommended to apply changes.\r\n";
-            Settings.Save();
+            CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
         }
-        client->write(result.c_str());
+        devTelnetServer->Write(client, result.c_str());
     }, admincmd);
 }
 void Telnet::registerCommand_mqtt(bool admincmd) {
-    devTelnetServer->onCommand("mqtt", "Show or change mqtt configuration\r\n\r\nmqtt [options]", [&](AsyncClient* client, String* parameter) {
+    devTelnetServer->onCommandArgs("mqtt", "Show or change mqtt configuration\r\n\r\nmqtt [options]", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         String result;
         bool changed = false;
 
-        if (parameter[0].isEmpty()) {
+        if (args.Empty(0)) {
             result += "MQTT           | Enabled: " + String(Settings.MQTT.Enabled() ? "Yes" : "No") + "\r\n";
             result += "               | Broker: " + Settings.MQTT.Broker() + "\r\n";
             result += "               | Port: " + String(Settings.MQTT.Port()) + "\r\n";
             result += "               | User: " + Settings.MQTT.User() + "\r\n";
             result += "               | Password: " + Settings.MQTT.Password() + "\r\n";
-         } else if (parameter[0].equalsIgnoreCase("enabled")) {
-            if (parameter[1].equalsIgnoreCase("true") || parameter[1].equalsIgnoreCase("on") || parameter[1].equalsIgnoreCase("yes")) {
+            result += "               | Topic aliases: " + String(Settings.MQTT.TopicAliases() ? "Yes" : "No") + "\r\n";
+            result += "               | Compact payload: " + String(Settings.MQTT.CompactPayload() ? "Yes" : "No") + "\r\n\r\n";
+            result += "Connection     | Status: " + String(mqttlink::StateToString(MQTTLink.State()));
+            if (MQTTLink.Connected()) result += " (" + String((millis() - MQTTLink.ConnectedSince()) / 1000) + " s)";
+            if (MQTTLink.State() == MQTTLINK_WAITING) result += " (retry in " + String(MQTTLink.RetryIn() / 1000) + " s)";
+            result += "\r\n";
+            result += "               | Connects: " + String(MQTTLink.Connects()) + "\r\n";
+            result += "               | Connect failures: " + String(MQTTLink.ConnectFailures()) + "\r\n";
+            result += "               | Disconnects: " + String(MQTTLink.Disconnects()) + "\r\n";
+            result += "               | Published: " + String(MQTTLink.Publishes()) + "\r\n";
+            result += "               | Publish failures: " + String(MQTTLink.PublishFailures()) + "\r\n";
+            result += "               | Bytes published: " + String(MQTTLink.PublishedBytes()) + "\r\n";
+            result += "               | Topics: " + String(MQTTLink.TopicCount()) + "\r\n";
+         } else if (args.Is(0, "enabled")) {
+            if (args.Is(1, "true") || args.Is(1, "on") || args.Is(1, "yes")) {
                 if (!Settings.MQTT.Enabled()) {
                     Settings.MQTT.Enabled(true);
                     changed = true;
                 }
-            } else if (parameter[1].equalsIgnoreCase("false") || parameter[1].equalsIgnoreCase("off") || parameter[1].equalsIgnoreCase("no")) {
+            } else if (args.Is(1, "false") || args.Is(1, "off") || args.Is(1, "no")) {
                 if (Settings.MQTT.Enabled()) {
                     Settings.MQTT.Enabled(false);
                     changed = true;
                 }
             } 
             result += "MQTT           | Enabled: " + String(Settings.MQTT.Enabled() ? "Yes" : "No") + "\r\n";
-            Settings.Save();
-        } else if (parameter[0].equalsIgnoreCase("broker")) {
-            if (!parameter[1].isEmpty() && (!Settings.MQTT.Broker().equalsIgnoreCase(parameter[1]))) {
-                Settings.MQTT.Broker(parameter[1]);
+            CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
+        } else if (args.Is(0, "broker")) {
+            if (!args.Empty(1) && (!Settings.MQTT.Broker().equalsIgnoreCase(String(args[1])))) {
+                Settings.MQTT.Broker(String(args[1]));
                 changed = true;
             }
             result += "MQTT           | Broker: " + Settings.MQTT.Broker() + "\r\n";
-        } else if (parameter[0].equalsIgnoreCase("port")) {
-            if (!parameter[1].isEmpty() && (Settings.MQTT.Port() != parameter[1].toInt())) {
-                Settings.MQTT.Port(parameter[1].toInt());
+        } else if (args.Is(0, "port")) {
+            if (!args.Empty(1) && (Settings.MQTT.Port() != atoi(args[1]))) {
+                Settings.MQTT.Port(atoi(args[1]));
                 changed = true;
             }
             result += "MQTT           | Port: " + String(Settings.MQTT.Port()) + "\r\n";
-        } else if (parameter[0].equalsIgnoreCase("user")) {
-            if (!parameter[1].isEmpty() && (!Settings.MQTT.User().equalsIgnoreCase(parameter[1]))) {
-                Settings.MQTT.User(parameter[1]);
+        } else if (args.Is(0, "user")) {
+            if (!args.Empty(1) && (!Settings.MQTT.User().equalsIgnoreCase(String(args[1])))) {
+                Settings.MQTT.User(String(args[1]));
                 changed = true;
             }
             result += "MQTT           | User: " + Settings.MQTT.User() + "\r\n";
-        } else if (parameter[0].equalsIgnoreCase("password")) {
-            if (!parameter[1].isEmpty() && (!Settings.MQTT.Password().equalsIgnoreCase(parameter[1]))) {
-                Settings.MQTT.Password(parameter[1]);
+        } else if (args.Is(0, "password")) {
+            if (!args.Empty(1) && (!Settings.MQTT.Password().equalsIgnoreCase(String(args[1])))) {
+                Settings.MQTT.Password(String(args[1]));
                 changed = true;
             }
             result += "MQTT           | Password: " + Settings.MQTT.Password() + "\r\n";
+        } else if (args.Is(0, "aliases")) {
+            if (args.Is(1, "true") || args.Is(1, "on") || args.Is(1, "yes")) {
+                if (!Settings.MQTT.TopicAliases()) {
+                    Settings.MQTT.TopicAliases(true);
+                    changed = true;
+                }
+            } else if (args.Is(1, "false") || args.Is(1, "off") || args.Is(1, "no")) {
+                if (Settings.MQTT.TopicAliases()) {
+                    Settings.MQTT.TopicAliases(false);
+                    changed = true;
+                }
+            }
+            result += "MQTT           | Topic aliases: " + String(Settings.MQTT.TopicAliases() ? "Yes" : "No") + "\r\n";
+            if (Settings.MQTT.TopicAliases()) result += "               | Readings go to " + Settings.Network.Hostname() + "/A/<n>; consumers resolve them through the retained " + Settings.Network.Hostname() + "/Aliases map.\r\n";
+        } else if (args.Is(0, "compact")) {
+            if (args.Is(1, "true") || args.Is(1, "on") || args.Is(1, "yes")) {
+                if (!Settings.MQTT.CompactPayload()) {
+                    Settings.MQTT.CompactPayload(true);
+                    changed = true;
+                }
+            } else if (args.Is(1, "false") || args.Is(1, "off") || args.Is(1, "no")) {
+                if (Settings.MQTT.CompactPayload()) {
+                    Settings.MQTT.CompactPayload(false);
+                    changed = true;
+                }
+            }
+            result += "MQTT           | Compact payload: " + String(Settings.MQTT.CompactPayload() ? "Yes" : "No") + "\r\n";
+        } else if (args.Is(0, "stats")) {
+            if (args.Is(1, "reset")) MQTTLink.ResetStats();
+
+            float elapsed = max<uint32_t>(millis() - MQTTLink.StatsSince(), 1) / 1000.0f;
+
+            result += "MQTT Stats     | Window: " + String(elapsed, 0) + " s\r\n";
+            result += "               | Received: " + String(MQTTLink.Received()) + " (" + String(MQTTLink.Received() / elapsed, 2) + " msg/s)\r\n";
+            result += "               | Published: " + String(MQTTLink.Publishes()) + " (" + String(MQTTLink.Publishes() / elapsed, 2) + " msg/s)\r\n";
+            result += "               | Publish failures: " + String(MQTTLink.PublishFailures()) + "\r\n";
+            result += "               | Bytes published: " + String(MQTTLink.PublishedBytes()) + ", " + String(MQTTLink.AliasSavedBytes()) + " saved by aliases\r\n";
+            result += "               | Set latency: " + MQTTLink.SetLatency().ToString() + "\r\n";
+            result += "               | Publish latency: " + MQTTLink.PublishLatency().ToString() + "\r\n";
+            result += "               | Heap: " + String(ESP.getFreeHeap()) + " free, " + String(ESP.getMinFreeHeap()) + " minimum\r\n";
+        } else if (args.Is(0, "bench")) {
+            uint16_t count = args.Empty(1) ? 100 : constrain(atoi(args[1]), 1, 1000);
+            uint16_t size = args.Empty(2) ? 16 : constrain(atoi(args[2]), 1, 1024);
+
+            if (!MQTTLink.Connected()) {
+                result += "MQTT Bench     | Not connected to broker.\r\n";
+            } else if (session == nullptr || !MQTTLink.StartBenchmark(count, size)) {
+                result += "MQTT Bench     | A benchmark is already running.\r\n";
+            } else {
+                const uint32_t heapBefore = ESP.getFreeHeap();
+                result += "MQTT Bench     | Publishing " + String(count) + " x " + String(size) + " bytes to " + Settings.Network.Hostname() + "/Bench...\r\n";
+
+                // The publishes run on the loop task, which owns the client; this only waits for the result
+                session->Stream([heapBefore](AsyncTelnetSession* session) -> bool {
+                    if (!MQTTLink.BenchmarkDone()) return true;
+
+                    const LatencyStats& latency = MQTTLink.BenchmarkLatency();
+                    const uint32_t elapsed = MQTTLink.BenchmarkElapsed();
+
+                    session->print("               | Sent: " + String(latency.Count()) + " x " + String(MQTTLink.BenchmarkSize()) + " bytes\r\n");
+                    session->print("               | Elapsed: " + String(elapsed) + " ms (" + String(latency.Count() * 1000.0f / elapsed, 1) + " msg/s)\r\n");
+                    session->print("               | Latency: " + latency.ToString() + "\r\n");
+                    session->print("               | Heap: " + String(heapBefore) + " before, " + String(ESP.getFreeHeap()) + " after, " + String(ESP.getMinFreeHeap()) + " minimum\r\n");
+                    return false;
+                });
+            }
         } else {
             result += "MQTT           | Invalid webserver parameter.\r\n";
         }
 
         if (changed) {
             result += "\r\n               | Settings changed - reboot recommended to apply changes.\r\n";
-            Settings.Save();
+            CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
         }
-        client->write(result.c_str());
+        session->print(result);
     }, admincmd);
 }
 void Telnet::registerCommand_user(bool admincmd) {
-    devTelnetServer->onCommand("user", "Manage users\r\n\r\nuser", [&](AsyncClient* client, String* parameter) {
+    devTelnetServer->onCommandArgs("user", "Manage users\r\n\r\nuser", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         String result;
         bool changed = false;
 
-        if (parameter[0].equalsIgnoreCase("list")) {
+        if (args.Is(0, "list")) {
             bool first = true;
             for (auto m : Settings.Users) {
                 result += String(first ? "Users          | " : "               | ") + LimitString(m.Username(), 30, true) + String(m.Admin() ? "- Admin" : "") + "\r\n";                
@@ -693,19 +815,19 @@ void Telnet::registerCommand_user(bool admincmd) {
 
             result += "\r\n               | Max Users: " + String(MAX_USERS) + "\r\n";
             result += "               | Current: " + String(Settings.Users.Count()) + " user(s), " + String(Settings.Users.CountAdmins()) + " admin(s)\r\n";
-        } else if (parameter[0].equalsIgnoreCase("remove")) {
-            if (!parameter[1].isEmpty()) {
-                if (Settings.Users.Remove(parameter[1]) == UserReturn::OK) {
-                    result += "Users          | User '" + parameter[1] + "' removed.\r\n";
+        } else if (args.Is(0, "remove")) {
+            if (!args.Empty(1)) {
+                if (Settings.Users.Remove(String(args[1])) == UserReturn::OK) {
+                    result += "Users          | User '" + String(args[1]) + "' removed.\r\n";
                     changed = true;
                 } else {
-                    result += "Users          | Error removing user '" + parameter[1] + "'.\r\n";
+                    result += "Users          | Error removing user '" + String(args[1]) + "'.\r\n";
                 }
             }
-        } else if (parameter[0].equalsIgnoreCase("password")) {
-            if (!parameter[1].isEmpty() && !parameter[2].isEmpty()) {
-                String username = parameter[1];
-                String newpassword = parameter[2];
+        } else if (args.Is(0, "password")) {
+            if (!args.Empty(1) && !args.Empty(2)) {
+                String username = args[1];
+                String newpassword = args[2];
 
                 user_t* user = nullptr;
 
@@ -723,11 +845,11 @@ void Telnet::registerCommand_user(bool admincmd) {
                 result += "Users          | Missing parameters.\r\n";
                 result += "               | Usage: user password <username> <newpassword>\r\n";
             }
-        } else if (parameter[0].equalsIgnoreCase("add")) {
-            if (!parameter[1].isEmpty() && !parameter[2].isEmpty()) {
-                String username = parameter[1];
-                String password = parameter[2];
-                bool admin = (!parameter[3].isEmpty() && parameter[3].equalsIgnoreCase("admin"));
+        } else if (args.Is(0, "add")) {
+            if (!args.Empty(1) && !args.Empty(2)) {
+                String username = args[1];
+                String password = args[2];
+                bool admin = (!args.Empty(3) && args.Is(3, "admin"));
 
                 if (Settings.Users.Add(username, password, admin) == UserReturn::OK) {
                     result += "Users          | User '" + username + "' added.\r\n";
@@ -746,25 +868,452 @@ void Telnet::registerCommand_user(bool admincmd) {
 
         if (changed) {
             result += "\r\n               | Settings changed - reboot recommended to apply changes.\r\n";
-            Settings.Save();
+            CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
         }
-        client->write(result.c_str());
+        devTelnetServer->Write(client, result.c_str());
     }, admincmd);
 }
+// Queues the command for loop() and waits briefly, so the state printed afterwards already reflects it. Past the wait
+// the command is still queued and will be applied, it just is not visible yet.
+TelnetSubmitResults Telnet::submit(CommandOps op, Generic* target, uint32_t layout, int32_t value) {
+    const uint32_t ticket = CommandBus.Submit(op, target, value, COMMANDSOURCE_TELNET, layout);
+    if (ticket == 0) return TELNETSUBMIT_REJECTED;
+
+    return CommandBus.Wait(ticket, Defaults.CommandBus.ReplyWaitMs) ? TELNETSUBMIT_APPLIED : TELNETSUBMIT_QUEUED;
+}
+
+// Loop task only
+bool Telnet::removeComponent(const String* parameter, String& result) {
+    bool changed = false;
+
+    if (!parameter[1].isEmpty()) {
+        String comp_name = parameter[1];
+        Generic* target = Settings.Components[comp_name];
+
+        if (target == nullptr) {
+            result += "Components     | Error removing component '" + comp_name + "'.\r\n";
+        } else {
+            bool in_use_by_virtual = false;
+            String used_by;
+
+            // Só precisa proteger componente real sendo usado por virtual
+            if (!target->IsVirtual()) {
+                for (auto* existing : Settings.Components) {
+                    if (existing == nullptr) continue;
+                    if (!existing->IsVirtual()) continue;
+                    if (existing == target) continue;
+
+                    switch (existing->Class()) {
+                        case CLASS_BLINDS: {
+                            Blinds* b = existing->as<Blinds>();
+                            if (b == nullptr) continue;
+
+                            if (b->RelayUp() == target || b->RelayDown() == target) {
+                                in_use_by_virtual = true;
+                                used_by = existing->Name();
+                            }
+                        } break;
+
+                        default:
+                            break;
+                    }
+
+                    if (in_use_by_virtual) break;
+                }
+            }
+
+            if (in_use_by_virtual) {
+                result += "Components     | Component '" + comp_name + "' is in use by virtual component '" + used_by + "'.\r\n";
+            } else {
+                if (Settings.Components.Remove(comp_name) != -1) {
+                    result += "Components     | Component '" + comp_name + "' removed.\r\n";
+                    changed = true;
+                } else {
+                    result += "Components     | Error removing component '" + comp_name + "'.\r\n";
+                }
+            }
+        }
+    }
+
+    return changed;
+}
+
+// Loop task only
+bool Telnet::addComponent(const String* parameter, String& result) {
+    bool changed = false;
+
+    if (!parameter[1].isEmpty() && !parameter[2].isEmpty()) {
+        String comp_name = parameter[1];
+
+        if (Settings.Components.IndexOf(comp_name) != -1) {
+            result += "Components     | Component '" + comp_name + "' already exists.\r\n";
+        } else {
+            String comp_target = parameter[2];
+
+            int at = comp_target.indexOf('@');
+            int sep = comp_target.indexOf(':');
+
+            if (at <= 0 || sep <= (at + 1) || sep >= (int)comp_target.length() - 1) {
+                result += "Components     | Invalid component target '" + comp_target + "'.\r\n";
+                result += "               | Real component: comp add <name> <class>@<bus>:<address> [option] [enabled]\r\n";
+                result += "               | Virtual component: comp add <name> Blinds@Group:<relay_up>,<relay_down> [enabled]\r\n";
+            } else {
+                String comp_class = comp_target.substring(0, at);
+                String comp_bus = comp_target.substring(at + 1, sep);
+                String comp_addr_str = comp_target.substring(sep + 1);
+
+                auto it_class = AvailableComponentClasses.find(comp_class);
+                if (it_class == AvailableComponentClasses.end()) {
+                    result += "Components     | Invalid class '" + comp_class + "'.\r\n";
+                } else {
+                    auto it_bus = AvailableComponentBuses.find(comp_bus);
+                    if (it_bus == AvailableComponentBuses.end()) {
+                        result += "Components     | Invalid bus '" + comp_bus + "'.\r\n";
+                    } else {
+                        Classes c = it_class->second;
+                        Buses bus_type = it_bus->second;
+
+                        if (c == CLASS_BLINDS) {
+                            if (bus_type != BUS_GROUP) {
+                                result += "Components     | Class 'Blinds' only supports bus 'Group'.\r\n";
+                                result += "               | Usage: comp add <name> Blinds@Group:<relay_up>,<relay_down> <StepMs> [OpenAccel] [CloseAccel] [CalibrationMultiplier] [enabled]\r\n";
+                            } else {
+                                String step_ms_str = parameter[3];
+
+                                if (step_ms_str.isEmpty()) {
+                                    result += "Components     | Missing Blinds StepMs parameter.\r\n";
+                                    result += "               | Usage: comp add <name> Blinds@Group:<relay_up>,<relay_down> <StepMs> [OpenAccel] [CloseAccel] [CalibrationMultiplier] [enabled]\r\n";
+                                } else {
+                                    bool valid_stepms = true;
+                                    for (size_t i = 0; i < step_ms_str.length(); ++i) {
+                                        if (!isDigit(step_ms_str[i])) {
+                                            valid_stepms = false;
+                                            break;
+                                        }
+                                    }
+
+                                    if (!valid_stepms) {
+                                        result += "Components     | Invalid StepMs '" + step_ms_str + "'.\r\n";
+                                    } else {
+                                        uint16_t comp_step_ms = (uint16_t)step_ms_str.toInt();
+
+                                        float comp_open_accel = parameter[4].isEmpty() ? 0.0f : parameter[4].toFloat();
+                                        float comp_close_accel = parameter[5].isEmpty() ? 0.0f : parameter[5].toFloat();
+                                        uint8_t comp_calibration_multiplier = parameter[6].isEmpty() ? 3 : (uint8_t)parameter[6].toInt();
+                                        bool comp_enabled = parameter[7].isEmpty() ? true : parameter[7].equalsIgnoreCase("true");
+
+                                        int comma = comp_addr_str.indexOf(',');
+
+                                        if (comma <= 0 || comma >= (int)comp_addr_str.length() - 1 || comp_addr_str.indexOf(',', comma + 1) != -1) {
+                                            result += "Components     | Invalid Blinds group definition.\r\n";
+                                            result += "               | Usage: comp add <name> Blinds@Group:<relay_up>,<relay_down> <StepMs> [OpenAccel] [CloseAccel] [CalibrationMultiplier] [enabled]\r\n";
+                                        } else {
+                                            String relay_up_name = comp_addr_str.substring(0, comma);
+                                            String relay_down_name = comp_addr_str.substring(comma + 1);
+
+                                            relay_up_name.trim();
+                                            relay_down_name.trim();
+
+                                            if (relay_up_name.isEmpty() || relay_down_name.isEmpty()) {
+                                                result += "Components     | Invalid Blinds group definition.\r\n";
+                                                result += "               | Usage: comp add <name> Blinds@Group:<relay_up>,<relay_down> <StepMs> [OpenAccel] [CloseAccel] [CalibrationMultiplier] [enabled]\r\n";
+                                            } else if (relay_up_name.equalsIgnoreCase(relay_down_name)) {
+                                                result += "Components     | Blinds group contains repeated components.\r\n";
+                                            } else {
+                                                Generic* relay_up_generic = nullptr;
+                                                Generic* relay_down_generic = nullptr;
+
+                                                int idx = Settings.Components.IndexOf(relay_up_name);
+                                                if (idx != -1) relay_up_generic = Settings.Components[idx];
+
+                                                idx = Settings.Components.IndexOf(relay_down_name);
+                                                if (idx != -1) relay_down_generic = Settings.Components[idx];
+
+                                                if (relay_up_generic == nullptr) {
+                                                    result += "Components     | Component '" + relay_up_name + "' not found.\r\n";
+                                                } else if (relay_down_generic == nullptr) {
+                                                    result += "Components     | Component '" + relay_down_name + "' not found.\r\n";
+                                                } else if (relay_up_generic->Class() != CLASS_RELAY) {
+                                                    result += "Components     | Component '" + relay_up_name + "' must be a Relay.\r\n";
+                                                } else if (relay_down_generic->Class() != CLASS_RELAY) {
+                                                    result += "Components     | Component '" + relay_down_name + "' must be a Relay.\r\n";
+                                                } else {
+                                                    Relay* relay_up = (Relay*)relay_up_generic;
+                                                    Relay* relay_down = (Relay*)relay_down_generic;
+
+                                                    bool relay_pair_in_use = false;
+
+                                                    for (size_t i = 0; i < Settings.Components.Count(); ++i) {
+                                                        Generic* existing = Settings.Components[i];
+                                                        if (existing == nullptr) continue;
+                                                        if (existing->Class() != CLASS_BLINDS) continue;
+
+                                                        Blinds* existing_blinds = (Blinds*)existing;
+
+                                                        if (existing_blinds->RelayUp() == relay_up &&
+                                                            existing_blinds->RelayDown() == relay_down) {
+                                                            relay_pair_in_use = true;
+                                                            break;
+                                                        }
+                                                    }
+
+                                                    if (relay_pair_in_use) {
+                                                        result += "Components     | A Blinds component with relays '" + relay_up_name + "' and '" + relay_down_name + "' already exists.\r\n";
+                                                    } else {
+                                                        Blinds* NewComponent = new Blinds(
+                                                            comp_name,
+                                                            Settings.Components.Count() + 1,
+                                                            relay_up,
+                                                            relay_down
+                                                        );
+
+                                                        NewComponent->StepMs(comp_step_ms);
+                                                        NewComponent->OpenAccel(comp_open_accel);
+                                                        NewComponent->CloseAccel(comp_close_accel);
+                                                        NewComponent->CalibrationMultiplier(comp_calibration_multiplier);
+
+                                                        if (Settings.Components.Add(NewComponent)) {
+                                                            NewComponent->Enabled(comp_enabled);
+                                                            changed = true;
+
+                                                            result += "Components     | New component '" + comp_name + "' added\r\n";
+                                                            result += "               | Class: " + comp_class + "\r\n";
+                                                            result += "               | Bus: " + comp_bus + "\r\n";
+                                                            result += "               | RelayUp: " + relay_up_name + "\r\n";
+                                                            result += "               | RelayDown: " + relay_down_name + "\r\n";
+                                                            result += "               | StepMs: " + String(NewComponent->StepMs()) + "\r\n";
+                                                            result += "               | OpenAccel: " + String(NewComponent->OpenAccel(), 2) + "\r\n";
+                                                            result += "               | CloseAccel: " + String(NewComponent->CloseAccel(), 2) + "\r\n";
+                                                            result += "               | CalibrationMultiplier: " + String(NewComponent->CalibrationMultiplier()) + "\r\n";
+                                                            result += "               | Enabled: " + String(comp_enabled ? "true" : "false") + "\r\n";
+                                                        } else {
+                                                            delete NewComponent;
+                                                            result += "Components     | Error while adding component '" + comp_name + "'.\r\n";
+                                                        }
+                                                    }
+                                                }
+                                            }
+                                        }
+                                    }
+                                }
+                            }
+                        } else {
+                            String comp_option = parameter[3];
+                            bool comp_enabled = parameter[4].isEmpty() ? true : parameter[4].equalsIgnoreCase("true");
+
+                            bool valid_number = true;
+                            for (size_t i = 0; i < comp_addr_str.length(); ++i) {
+                                if (!isDigit(comp_addr_str[i])) {
+                                    valid_number = false;
+                                    break;
+                                }
+                            }
+
+                            if (comp_addr_str.isEmpty() || !valid_number) {
+                                result += "Components     | Invalid address '" + comp_addr_str + "'.\r\n";
+                            } else {
+                                uint8_t comp_address = (uint8_t)comp_addr_str.toInt();
+
+                                bool busaddr_in_use = false;
+                                for (size_t i = 0; i < Settings.Components.Count(); ++i) {
+                                    Generic* existing = Settings.Components[i];
+                                    if (existing == nullptr) continue;
+
+                                    switch (existing->Class()) {
+                                        case CLASS_GENERIC:
+                                        case CLASS_BLINDS:
+                                            break;
+
+                                        default:
+                                            if ((existing->Bus() == bus_type) && (existing->Address() == comp_address)) {
+                                                busaddr_in_use = true;
+                                            }
+                                            break;
+                                    }
+
+                                    if (busaddr_in_use) break;
+                                }
+
+                                if (busaddr_in_use) {
+                                    result += "Components     | Bus/address '" + comp_bus + ":" + String(comp_address) + "' already in use.\r\n";
+                                } else {
+                                    bool added = false;
+                                    Generic* NewComponent = nullptr;
+
+                                    switch (c) {
+                                        case CLASS_BUTTON: {
+                                            NewComponent = new Button(
+                                                comp_name,
+                                                Settings.Components.Count() + 1,
+                                                bus_type,
+                                                comp_address,
+                                                comp_option.equalsIgnoreCase("EdgesOnly")
+                                                    ? ButtonReportModes::BUTTONREPORTMODE_EDGESONLY
+                                                    : ButtonReportModes::BUTTONREPORTMODE_CLICKSONLY
+                                            );
+                                            added = true;
+                                        } break;
+
+                                        case CLASS_CONTACTSENSOR: {
+                                            NewComponent = new ContactSensor(
+                                                comp_name,
+                                                Settings.Components.Count() + 1,
+                                                bus_type,
+                                                comp_address,
+                                                comp_option.equalsIgnoreCase("Invert")
+                                            );
+                                            added = true;
+                                        } break;
+
+                                        case CLASS_CURRENTMETER: {
+                                            NewComponent = new Currentmeter(
+                                                comp_name,
+                                                Settings.Components.Count() + 1,
+                                                bus_type,
+                                                comp_address
+                                            );
+                                            added = true;
+                                        } break;
+
+                                        case CLASS_DOORBELL: {
+                                            NewComponent = new Doorbell(
+                                                comp_name,
+                                                Settings.Components.Count() + 1,
+                                                bus_type,
+                                                comp_address
+                                            );
+                                            added = true;
+                                        } break;
+
+                                        case CLASS_PIR: {
+                                            NewComponent = new PIR(
+                                                comp_name,
+                                                Settings.Components.Count() + 1,
+                                                bus_type,
+                                                comp_address
+                                            );
+                                            added = true;
+                                        } break;
+
+                                        case CLASS_RELAY: {
+                                            NewComponent = new Relay(
+                                                comp_name,
+                                                Settings.Components.Count() + 1,
+                                                bus_type,
+                                                comp_address,
+                                                comp_option.equalsIgnoreCase("NormallyOpened")
+                                                    ? RelayTypes::RELAYTYPE_NORMALLYOPENED
+                                                    : RelayTypes::RELAYTYPE_NORMALLYCLOSED
+                                            );
+                                            added = true;
+                                        } break;
+
+                                        case CLASS_THERMOMETER: {
+                                            ThermometerTypes comp_type = THERMOMETERTYPE_DHT11;
+
+                                            if (comp_option.equalsIgnoreCase("DHT11")) comp_type = THERMOMETERTYPE_DHT11;
+                                            else if (comp_option.equalsIgnoreCase("DHT12")) comp_type = THERMOMETERTYPE_DHT12;
+                                            else if (comp_option.equalsIgnoreCase("DHT21")) comp_type = THERMOMETERTYPE_DHT21;
+                                            else if (comp_option.equalsIgnoreCase("DHT22")) comp_type = THERMOMETERTYPE_DHT22;
+                                            else if (comp_option.equalsIgnoreCase("DS18B20")) comp_type = THERMOMETERTYPE_DS18B20;
+
+                                            NewComponent = new Thermometer(
+                                                comp_name,
+                                                Settings.Components.Count() + 1,
+                                                bus_type,
+                                                comp_address,
+                                                comp_type
+                                            );
+                                            added = true;
+                                        } break;
+
+                                        default:
+                                            break;
+                                    }
+
+                                    if (added) {
+                                        if (Settings.Components.Add(NewComponent)) {
+                                            NewComponent->Enabled(comp_enabled);
+                                            changed = true;
+
+                                            result += "Components     | New component '" + comp_name + "' added\r\n";
+                                            result += "               | Class: " + comp_class + "\r\n";
+                                            result += "               | Bus: " + comp_bus + "\r\n";
+                                            result += "               | Address: " + String(comp_address) + "\r\n";
+                                            if (!comp_option.isEmpty())
+                                                result += "               | Option: " + comp_option + "\r\n";
+                                            result += "               | Enabled: " + String(comp_enabled ? "true" : "false") + "\r\n";
+                                        } else {
+                                            delete NewComponent;
+                                            result += "Components     | Error while adding component '" + comp_name + "'.\r\n";
+                                        }
+                                    } else {
+                                        result += "Components     | Error while creating component '" + comp_name + "'.\r\n";
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    } else {
+        result += "Components     | Missing new component parameters.\r\n";
+        result += "               | Real component: comp add <name> <class>@<bus>:<address> [option] [enabled]\r\n";
+        result += "               | Virtual component: comp add <name> Blinds@Group:<relay_up>,<relay_down> [enabled]\r\n";
+    }
+
+    return changed;
+}
+
+// Components are only added or removed by the loop task, between control ticks: the checks and the change run there
+// together as one command bus job, and the handler waits briefly for its report
+void Telnet::changeComponents(const AsyncTelnetArgs& args, String& result) {
+    struct change_t {
+        String Parameter[ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS];
+        String Result;
+        bool Changed = false;
+    };
+
+    auto change = std::make_shared<change_t>();
+    for (uint8_t i = 0; i < ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS; i++) change->Parameter[i] = args[i];
+
+    const uint32_t ticket = CommandBus.Components([change]() -> bool {
+        change->Changed = change->Parameter[0].equalsIgnoreCase("add") ? addComponent(change->Parameter, change->Result) : removeComponent(change->Parameter, change->Result);
+        if (change->Changed) CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
+        return change->Changed;
+    }, COMMANDSOURCE_TELNET);
+
+    if (ticket == 0) {
+        result += "Components     | Command queue busy - try again.\r\n";
+        return;
+    }
+
+    // Past the wait the job still runs and saves; only its report is lost
+    if (!CommandBus.Wait(ticket, Defaults.CommandBus.ReplyWaitMs)) {
+        result += "Components     | Change queued - not applied yet, check with 'comp list'.\r\n";
+        return;
+    }
+
+    result += change->Result;
+    if (change->Changed) result += "\r\n               | Settings changed - reboot recommended to apply changes.\r\n";
+}
+
 void Telnet::registerCommand_comp(bool admincmd) {
-    devTelnetServer->onCommand("comp", "Manage components\r\n\r\ncomp", [&](AsyncClient* client, String* parameter) {
+    devTelnetServer->onCommandArgs("comp", "Manage components\r\n\r\ncomp", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
         String result;
-        bool changed = false;
 
-        if (parameter[0].equalsIgnoreCase("set")) {
-            if (!parameter[1].isEmpty()) {
-                Generic* target = Settings.Components[parameter[1]];
+        if (args.Is(0, "set")) {
+            if (!args.Empty(1)) {
+                // Read before the lookup: a command from an older layout is rejected instead of reaching a stranger
+                const uint32_t layout = CommandBus.Layout();
+                Generic* target = Settings.Components[String(args[1])];
 
                 if (target == nullptr) {
-                    result += "Components     | Error finding component '" + parameter[1] + "'.\r\n";
+                    result += "Components     | Error finding component '" + String(args[1]) + "'.\r\n";
                 } else {
-                    if (!parameter[2].isEmpty()) {
-                        String param = parameter[2];
+                    if (!args.Empty(2)) {
+                        String param = args[2];
 
                         int sep = param.indexOf('=');
                         if (sep <= 0 || sep >= param.length() - 1) {
@@ -776,45 +1325,54 @@ void Telnet::registerCommand_comp(bool admincmd) {
                             key.trim();
                             value.trim();
 
+                            // Only an applied command may report the new state
+                            auto report = [&](TelnetSubmitResults submitted, const String& applied) {
+                                switch (submitted) {
+                                    case TELNETSUBMIT_APPLIED: result += applied; break;
+                                    case TELNETSUBMIT_QUEUED: result += "Components     | " + String(args[1]) + " command queued - not applied yet.\r\n"; break;
+                                    default: result += "Components     | Command queue busy - try again.\r\n"; break;
+                                }
+                            };
+
                             switch (target->Class()) {
                                 case Classes::CLASS_RELAY : {
                                     if (key.equalsIgnoreCase("State")) {
+                                        TelnetSubmitResults submitted;
+
                                         if (value.equalsIgnoreCase("On") || value.equalsIgnoreCase("True") || value.equalsIgnoreCase("Yes") || value.equalsIgnoreCase("1")) {
-                                            target->as<Relay>()->State(true);
+                                            submitted = submit(COMMAND_RELAY_STATE, target, layout, 1);
                                         } else if (value.equalsIgnoreCase("Off") || value.equalsIgnoreCase("False") || value.equalsIgnoreCase("No") || value.equalsIgnoreCase("0")) {
-                                            target->as<Relay>()->State(false);
+                                            submitted = submit(COMMAND_RELAY_STATE, target, layout, 0);
                                         } else if (value.equalsIgnoreCase("~") || value.equalsIgnoreCase("Invert")) {
-                                            target->as<Relay>()->Invert();
+                                            submitted = submit(COMMAND_RELAY_INVERT, target, layout);
+                                        } else {
+                                            result += "Components     | Invalid value '" + value + "' for " + String(args[1]) + "\r\n";
+                                            break;
                                         }
-                                        
-                                        result += "Components     | " + parameter[1] + " set to " + String(target->as<Relay>()->State() ? "ON" : "OFF") + "\r\n";
+
+                                        report(submitted, "Components     | " + String(args[1]) + " set to " + String(target->as<Relay>()->State() ? "ON" : "OFF") + "\r\n");
                                     } else {
                                         result += "Components     | Unknown key '" + key + "'\r\n";
                                     }
                                 } break;
                                 case Classes::CLASS_BUTTON : {
                                     if (key.equalsIgnoreCase("Do")) {
-                                        bool valid = false;
+                                        TelnetSubmitResults submitted;
 
                                         if (value.equalsIgnoreCase("ClickSingle")) {
-                                            target->as<Button>()->Do(ClickTypes::CLICKTYPE_SINGLE);
-                                            valid = true;
+                                            submitted = submit(COMMAND_BUTTON_DO, target, layout, ClickTypes::CLICKTYPE_SINGLE);
                                         } else if (value.equalsIgnoreCase("ClickDouble")) {
-                                            target->as<Button>()->Do(ClickTypes::CLICKTYPE_DOUBLE);
-                                            valid = true;
+                                            submitted = submit(COMMAND_BUTTON_DO, target, layout, ClickTypes::CLICKTYPE_DOUBLE);
                                         } else if (value.equalsIgnoreCase("ClickTriple")) {
-                                            target->as<Button>()->Do(ClickTypes::CLICKTYPE_TRIPLE);
-                                            valid = true;
+                                            submitted = submit(COMMAND_BUTTON_DO, target, layout, ClickTypes::CLICKTYPE_TRIPLE);
                                         } else if (value.equalsIgnoreCase("ClickLong")) {
-                                            target->as<Button>()->Do(ClickTypes::CLICKTYPE_LONG);
-                                            valid = true;
-                                        }
-
-                                        if (valid) {
-                                            result += "Components     | Sent " + value + " to " + parameter[1] +  + "\r\n";
+                                            submitted = submit(COMMAND_BUTTON_DO, target, layout, ClickTypes::CLICKTYPE_LONG);
                                         } else {
-                                            result += "Components     | Invalid set '" + value + "' to " + parameter[1] +  + "\r\n";
+                                            result += "Components     | Invalid set '" + value + "' to " + String(args[1]) + "\r\n";
+                                            break;
                                         }
+
+                                        report(submitted, "Components     | Sent " + value + " to " + String(args[1]) + "\r\n");
                                     } else {
                                         result += "Components     | Unknown key '" + key + "'\r\n";
                                     }
@@ -822,16 +1380,21 @@ void Telnet::registerCommand_comp(bool admincmd) {
 
                                 case Classes::CLASS_BLINDS : {
                                     if (key.equalsIgnoreCase("State")) {
+                                        TelnetSubmitResults submitted;
+
                                         if (value.equalsIgnoreCase("Open")) {
-                                            target->as<Blinds>()->Open();
+                                            submitted = submit(COMMAND_BLINDS_OPEN, target, layout);
                                         } else if (value.equalsIgnoreCase("Close")) {
-                                            target->as<Blinds>()->Close();
+                                            submitted = submit(COMMAND_BLINDS_CLOSE, target, layout);
+                                        } else {
+                                            result += "Components     | Invalid value '" + value + "' for " + String(args[1]) + "\r\n";
+                                            break;
                                         }
-                                        
-                                        result += "Components     | " + parameter[1] + " set to " + value + "\r\n";
+
+                                        report(submitted, "Components     | " + String(args[1]) + " set to " + value + "\r\n");
                                     } else if (key.equalsIgnoreCase("TargetPosition")) {
-                                        target->as<Blinds>()->Position(value.toInt());
-                                        result += "Components     | " + parameter[1] + " set to " + String(constrain(value.toInt(), 0 ,100)) + "\r\n";
+                                        const TelnetSubmitResults submitted = submit(COMMAND_BLINDS_POSITION, target, layout, value.toInt());
+                                        report(submitted, "Components     | " + String(args[1]) + " set to " + String(constrain(value.toInt(), 0 ,100)) + "\r\n");
                                     } else {
                                         result += "Components     | Unknown key '" + key + "'\r\n";
                                     }
@@ -848,14 +1411,14 @@ void Telnet::registerCommand_comp(bool admincmd) {
             } else {
                 result += "Components     | Invalid set parameter\r\n               | set [componentname] [value]\r\n";
             }
-        } else if (parameter[0].equalsIgnoreCase("get")) {
-            if (!parameter[1].isEmpty()) {
-                Generic* target = Settings.Components[parameter[1]];
+        } else if (args.Is(0, "get")) {
+            if (!args.Empty(1)) {
+                Generic* target = Settings.Components[String(args[1])];
 
                 if (target == nullptr) {
-                    result += "Components     | Error finding component '" + parameter[1] + "'.\r\n";
+                    result += "Components     | Error finding component '" + String(args[1]) + "'.\r\n";
                 } else {
-                    result += "Components     | " + parameter[1] + "\r\n";
+                    result += "Components     | " + String(args[1]) + "\r\n";
                     switch (target->Class()) {
                         case Classes::CLASS_RELAY : {
                             result += "               | State: " + String(target->as<Relay>()->State() ? "On" : "Off") + "\r\n";
@@ -875,21 +1438,21 @@ void Telnet::registerCommand_comp(bool admincmd) {
             } else {
                 result += "Components     | Invalid set parameter\r\n               | get [componentname]\r\n";
             }
-        } else if (parameter[0].equalsIgnoreCase("event")) {
-            if (parameter[1].isEmpty()) {
+        } else if (args.Is(0, "event")) {
+            if (args.Empty(1)) {
                 result += "Components     | Missing component name\r\n";
                 result += "               | event [componentname]\r\n";
                 result += "               | event [componentname] [eventname] '[script]'\r\n";
             } else {
-                Generic* target = Settings.Components[parameter[1]];
+                Generic* target = Settings.Components[String(args[1])];
 
                 if (target == nullptr) {
-                    result += "Components     | Error finding component '" + parameter[1] + "'.\r\n";
+                    result += "Components     | Error finding component '" + String(args[1]) + "'.\r\n";
                 } else {
                     // =========================
                     // LISTAR EVENTOS
                     // =========================
-                    if (parameter[2].isEmpty()) {
+                    if (args.Empty(2)) {
                         File f = devFileSystem->OpenFile(Defaults.ConfigFileName, "r");
                         if (!f || !f.available()) {
                             if (f) f.close();
@@ -910,7 +1473,7 @@ void Telnet::registerCommand_comp(bool admincmd) {
 
                                     for (JsonObject comp : components) {
                                         String compName = String(comp["Name"] | "");
-                                        if (!compName.equalsIgnoreCase(parameter[1])) continue;
+                                        if (!compName.equalsIgnoreCase(String(args[1]))) continue;
 
                                         found = true;
                                         result += "Components     | Events for '" + compName + "'\r\n\r\n";
@@ -937,7 +1500,7 @@ void Telnet::registerCommand_comp(bool admincmd) {
                                     }
 
                                     if (!found) {
-                                        result += "Components     | Component '" + parameter[1] + "' was instantiated but not found in config.\r\n";
+                                        result += "Components     | Component '" + String(args[1]) + "' was instantiated but not found in config.\r\n";
                                     }
                                 }
                             }
@@ -947,11 +1510,11 @@ void Telnet::registerCommand_comp(bool admincmd) {
                     // SETAR / LIMPAR EVENTO
                     // =========================
                     else {
-                        const String eventName = parameter[2];
+                        const String eventName = args[2];
 
                         auto itEvent = target->Event.find(eventName);
                         if (itEvent == target->Event.end()) {
-                            result += "Components     | Event '" + eventName + "' is not valid for component '" + parameter[1] + "'.\r\n";
+                            result += "Components     | Event '" + eventName + "' is not valid for component '" + String(args[1]) + "'.\r\n";
 
                             if (!target->Event.empty()) {
                                 result += "               | Valid events: ";
@@ -986,7 +1549,7 @@ void Telnet::registerCommand_comp(bool admincmd) {
 
                                         for (JsonObject comp : components) {
                                             String compName = String(comp["Name"] | "");
-                                            if (!compName.equalsIgnoreCase(parameter[1])) continue;
+                                            if (!compName.equalsIgnoreCase(String(args[1]))) continue;
 
                                             found = true;
 
@@ -999,9 +1562,9 @@ void Telnet::registerCommand_comp(bool admincmd) {
                                             // RECONSTRUIR SCRIPT
                                             // =========================
                                             String script;
-                                            for (int i = 3; !parameter[i].isEmpty(); ++i) {
+                                            for (int i = 3; !args.Empty(i); ++i) {
                                                 if (!script.isEmpty()) script += " ";
-                                                script += parameter[i];
+                                                script += args[i];
                                             }
 
                                             script.trim();
@@ -1045,7 +1608,7 @@ void Telnet::registerCommand_comp(bool admincmd) {
                                         }
 
                                         if (!found) {
-                                            result += "Components     | Component '" + parameter[1] + "' was instantiated but not found in config.\r\n";
+                                            result += "Components     | Component '" + String(args[1]) + "' was instantiated but not found in config.\r\n";
                                         }
                                     }
                                 }
@@ -1054,7 +1617,7 @@ void Telnet::registerCommand_comp(bool admincmd) {
                     }
                 }
             }
-        } else if (parameter[0].equalsIgnoreCase("list")) {
+        } else if (args.Is(0, "list")) {
             result += "Components     | Listing total of " + String(Settings.Components.Count()) + " component(s)\r\n";
 
             uint8_t mComponent_Count = 0;
@@ -1093,430 +1656,255 @@ void Telnet::registerCommand_comp(bool admincmd) {
 
                     first = false;
                     mComponent_Count++;
+
+                    // Queued per component instead of building the whole listing in one String
+                    session->print(result);
+                    result.clear();
                 }
 
                 if (mComponent_Count > 0) {
                     result += "\r\n               | Count: " + String(mComponent_Count) + "\r\n";
                 }
             }
-        } else if (parameter[0].equalsIgnoreCase("bus")) {
+        } else if (args.Is(0, "bus")) {
             result += "Buses          | Count: " + String(AvailableComponentBuses.size()) + "\r\n\r\n";
             for (auto m : AvailableComponentBuses) {
                 result += "               | " + m.first + ":" + String(m.second) + "\r\n";
             }
-        } else if (parameter[0].equalsIgnoreCase("class")) {
+        } else if (args.Is(0, "class")) {
             result += "Classes        | Count: " + String(AvailableComponentClasses.size()) + "\r\n\r\n";
             for (auto m : AvailableComponentClasses) {
                 result += "               | " + m.first + ":" + String(m.second) + "\r\n";
             }
-        }else if (parameter[0].equalsIgnoreCase("remove")) {
-            if (!parameter[1].isEmpty()) {
-                String comp_name = parameter[1];
-                Generic* target = Settings.Components[comp_name];
+        } else if (args.Is(0, "remove") || args.Is(0, "add")) {
+            changeComponents(args, result);
+        } else {
+            result += "Components     | Invalid comp parameter.\r\n";
+        }
 
-                if (target == nullptr) {
-                    result += "Components     | Error removing component '" + comp_name + "'.\r\n";
-                } else {
-                    bool in_use_by_virtual = false;
-                    String used_by;
-
-                    // Só precisa proteger componente real sendo usado por virtual
-                    if (!target->IsVirtual()) {
-                        for (auto* existing : Settings.Components) {
-                            if (existing == nullptr) continue;
-                            if (!existing->IsVirtual()) continue;
-                            if (existing == target) continue;
-
-                            switch (existing->Class()) {
-                                case CLASS_BLINDS: {
-                                    Blinds* b = existing->as<Blinds>();
-                                    if (b == nullptr) continue;
-
-                                    if (b->RelayUp() == target || b->RelayDown() == target) {
-                                        in_use_by_virtual = true;
-                                        used_by = existing->Name();
-                                    }
-                                } break;
+        session->print(result);
+    }, admincmd);
+}
+void Telnet::registerCommand_log(bool admincmd) {
+    // On the worker: flush waits, index reads and decoding of compacted segments on flash stay off the AsyncTCP task
+    devTelnetServer->onWorkerCommandArgs("log", "Show/clear device log\r\n\r\nlog [nlines][level|clear|stats]\r\nlog range <from> [to] [level]\r\nlog follow [level]\r\nlog syslog [udp|tcp]", [&](AsyncClient* client, AsyncTelnetSession* session, const AsyncTelnetArgs& args) {
 
-                                default:
-                                    break;
-                            }
+        auto writeSafe = [&](const String& s) {
+            if (session == nullptr) return;
+            session->print(s);
+        };
 
-                            if (in_use_by_virtual) break;
-                        }
-                    }
+        auto isValidLevel = [&](const char* s) -> bool {
+            if (s[0] == '\0' || s[1] != '\0') return false;
+            char c = toupper(s[0]);
+            return (c == 'E' || c == 'W' || c == 'I' || c == 'D');
+        };
 
-                    if (in_use_by_virtual) {
-                        result += "Components     | Component '" + comp_name + "' is in use by virtual component '" + used_by + "'.\r\n";
-                    } else {
-                        if (Settings.Components.Remove(comp_name) != -1) {
-                            result += "Components     | Component '" + comp_name + "' removed.\r\n";
-                            changed = true;
-                        } else {
-                            result += "Components     | Error removing component '" + comp_name + "'.\r\n";
-                        }
-                    }
-                }
+        // YYYY-MM-DD, YYYY-MM-DDTHH:MM[:SS] or HH:MM[:SS] (today); as an upper bound a bare date runs to the end of the day
+        auto parseTime = [&](const String& s, bool upper, uint32_t& out) -> bool {
+            time_t now = time(nullptr);
+            struct tm t;
+            localtime_r(&now, &t);
+
+            int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = upper ? 59 : 0;
+            int n = sscanf(s.c_str(), "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &minute, &second);
+
+            if (n == 3) {
+                if (upper) { hour = 23; minute = 59; }
+            } else if (n < 5) {
+                if (s.indexOf('-') >= 0 || sscanf(s.c_str(), "%d:%d:%d", &hour, &minute, &second) < 2) return false;
+                year = t.tm_year + 1900;
+                month = t.tm_mon + 1;
+                day = t.tm_mday;
             }
-        } else if (parameter[0].equalsIgnoreCase("add")) {
-            if (!parameter[1].isEmpty() && !parameter[2].isEmpty()) {
-                String comp_name = parameter[1];
 
-                if (Settings.Components.IndexOf(comp_name) != -1) {
-                    result += "Components     | Component '" + comp_name + "' already exists.\r\n";
-                } else {
-                    String comp_target = parameter[2];
+            t.tm_year = year - 1900;
+            t.tm_mon = month - 1;
+            t.tm_mday = day;
+            t.tm_hour = hour;
+            t.tm_min = minute;
+            t.tm_sec = second;
+            t.tm_isdst = -1;
 
-                    int at = comp_target.indexOf('@');
-                    int sep = comp_target.indexOf(':');
+            time_t value = mktime(&t);
+            if (value < 0) return false;
 
-                    if (at <= 0 || sep <= (at + 1) || sep >= (int)comp_target.length() - 1) {
-                        result += "Components     | Invalid component target '" + comp_target + "'.\r\n";
-                        result += "               | Real component: comp add <name> <class>@<bus>:<address> [option] [enabled]\r\n";
-                        result += "               | Virtual component: comp add <name> Blinds@Group:<relay_up>,<relay_down> [enabled]\r\n";
-                    } else {
-                        String comp_class = comp_target.substring(0, at);
-                        String comp_bus = comp_target.substring(at + 1, sep);
-                        String comp_addr_str = comp_target.substring(sep + 1);
+            out = (uint32_t)value;
+            return true;
+        };
 
-                        auto it_class = AvailableComponentClasses.find(comp_class);
-                        if (it_class == AvailableComponentClasses.end()) {
-                            result += "Components     | Invalid class '" + comp_class + "'.\r\n";
-                        } else {
-                            auto it_bus = AvailableComponentBuses.find(comp_bus);
-                            if (it_bus == AvailableComponentBuses.end()) {
-                                result += "Components     | Invalid bus '" + comp_bus + "'.\r\n";
-                            } else {
-                                Classes c = it_class->second;
-                                Buses bus_type = it_bus->second;
+        auto showLines = [&](const String& header, std::vector<String> lines) {
+            if (lines.empty()) {
+                writeSafe("Log            | No matching log entries.\r\n");
+                return;
+            }
 
-                                if (c == CLASS_BLINDS) {
-                                    if (bus_type != BUS_GROUP) {
-                                        result += "Components     | Class 'Blinds' only supports bus 'Group'.\r\n";
-                                        result += "               | Usage: comp add <name> Blinds@Group:<relay_up>,<relay_down> <StepMs> [OpenAccel] [CloseAccel] [CalibrationMultiplier] [enabled]\r\n";
-                                    } else {
-                                        String step_ms_str = parameter[3];
+            writeSafe(header);
+            if (session == nullptr) return;
 
-                                        if (step_ms_str.isEmpty()) {
-                                            result += "Components     | Missing Blinds StepMs parameter.\r\n";
-                                            result += "               | Usage: comp add <name> Blinds@Group:<relay_up>,<relay_down> <StepMs> [OpenAccel] [CloseAccel] [CalibrationMultiplier] [enabled]\r\n";
-                                        } else {
-                                            bool valid_stepms = true;
-                                            for (size_t i = 0; i < step_ms_str.length(); ++i) {
-                                                if (!isDigit(step_ms_str[i])) {
-                                                    valid_stepms = false;
-                                                    break;
-                                                }
-                                            }
+            // Handed out one line per call as the client acknowledges them
+            auto pending = std::make_shared<std::vector<String>>(std::move(lines));
+            size_t next = 0;
 
-                                            if (!valid_stepms) {
-                                                result += "Components     | Invalid StepMs '" + step_ms_str + "'.\r\n";
-                                            } else {
-                                                uint16_t comp_step_ms = (uint16_t)step_ms_str.toInt();
+            session->Stream([pending, next](AsyncTelnetSession* session) mutable -> bool {
+                if (next >= pending->size()) return false;
 
-                                                float comp_open_accel = parameter[4].isEmpty() ? 0.0f : parameter[4].toFloat();
-                                                float comp_close_accel = parameter[5].isEmpty() ? 0.0f : parameter[5].toFloat();
-                                                uint8_t comp_calibration_multiplier = parameter[6].isEmpty() ? 3 : (uint8_t)parameter[6].toInt();
-                                                bool comp_enabled = parameter[7].isEmpty() ? true : parameter[7].equalsIgnoreCase("true");
+                session->print((*pending)[next++]);
+                session->print("\r\n");
+                return true;
+            });
+        };
 
-                                                int comma = comp_addr_str.indexOf(',');
+        size_t nlines = Defaults.Log.ShowMaxLines;
+        char levelFilter = '\0';
 
-                                                if (comma <= 0 || comma >= (int)comp_addr_str.length() - 1 || comp_addr_str.indexOf(',', comma + 1) != -1) {
-                                                    result += "Components     | Invalid Blinds group definition.\r\n";
-                                                    result += "               | Usage: comp add <name> Blinds@Group:<relay_up>,<relay_down> <StepMs> [OpenAccel] [CloseAccel] [CalibrationMultiplier] [enabled]\r\n";
-                                                } else {
-                                                    String relay_up_name = comp_addr_str.substring(0, comma);
-                                                    String relay_down_name = comp_addr_str.substring(comma + 1);
+        if (!args.Empty(0)) {
+            if (args.Is(0, "clear")) {
+                devLog->Clear();
+                writeSafe("Log            | All log entries were cleared: " + String(Defaults.LogDirectory) + "\r\n\r\n");
+                return;
+            }
 
-                                                    relay_up_name.trim();
-                                                    relay_down_name.trim();
+            if (args.Is(0, "stats")) {
+                String result;
+                result += "Log            | Queued: " + String(devLog->Queued()) + "\r\n";
+                result += "               | Dropped: " + String(devLog->Dropped()) + "\r\n";
+                result += "               | Written: " + String(devLog->Written()) + "\r\n";
+                result += "               | Flushes: " + String(devLog->Flushes()) + " (" + String(devLog->BytesWritten()) + " bytes, " + String(devLog->FlushErrors()) + " errors)\r\n";
+                result += "               | Flush latency: " + devLog->FlushLatency().ToString() + "\r\n";
+                result += "               | Ring free: " + String(devLog->RingFree()) + " of " + String(Defaults.Log.RingSize) + " bytes\r\n";
+                result += "               | Tail: " + String(devLog->Tail().Records()) + " record(s), " + String(devLog->Tail().Used()) + " of " + String(devLog->Tail().Size()) + " bytes, " + String(devLog->Tail().Evicted()) + " evicted\r\n";
+                result += "               | Segments: " + String(devLog->Store().Segments()) + " of " + String(Defaults.Log.MaxSegments) + " (" + String(devLog->Store().Bytes()) + " of " + String(Defaults.Log.MaxStoreSize) + " bytes, " + String(devLog->Store().Rolls()) + " rolls, " + String(devLog->Store().Pruned()) + " pruned)\r\n";
+                result += "               | Compressed: " + String(devLog->Store().Compressed()) + " segment(s), " + String(devLog->Store().Compactions()) + " compactions, " + String(devLog->Store().Saved()) + " bytes saved\r\n";
+                result += "               | Collapsed: " + String(devLog->Collapsed()) + " repeated message(s)\r\n";
+                result += "               | Suppressed: " + String(devLog->Suppressed()) + " (limit " + String(Defaults.Log.RateLimit) + "/s, burst " + String(Defaults.Log.RateBurst) + " per module and level)\r\n";
+
+                SyslogTransport& syslog = devLog->Syslog();
+                result += "               | Syslog: " + String(SyslogTransport::ModeName(syslog.Mode())) + " to " + Settings.Log.SyslogServerHost() + ":" + String(Settings.Log.SyslogServerPort()) + String((devLog->Endpoint() & LOGENDPOINT_SYSLOG) ? "" : " (endpoint disabled)") + "\r\n";
+                result += "               |   Sent: " + String(syslog.Sent()) + " in " + String(syslog.Batches()) + " batch(es), dropped: " + String(syslog.Dropped()) + ", errors: " + String(syslog.Errors()) + ", connects: " + String(syslog.Connects()) + "\r\n";
+                result += "               |   Backlog: " + String(syslog.Queued()) + " record(s), " + String(syslog.BacklogBytes()) + " of " + String(Defaults.Log.SyslogBacklog) + " bytes\r\n";
+
+                log_bucket_t buckets[LOG_RATEBUCKETS];
+                size_t limited = devLog->SuppressedBy(buckets, LOG_RATEBUCKETS);
+                for (size_t i = 0; i < limited; i++) {
+                    result += "               |   " + String(buckets[i].Module[0] ? buckets[i].Module : "(none)") + " [" + String(LogPipeline::LevelChar(buckets[i].Level)) + "]: " + String(buckets[i].Total) + "\r\n";
+                }
+                writeSafe(result);
+                return;
+            }
 
-                                                    if (relay_up_name.isEmpty() || relay_down_name.isEmpty()) {
-                                                        result += "Components     | Invalid Blinds group definition.\r\n";
-                                                        result += "               | Usage: comp add <name> Blinds@Group:<relay_up>,<relay_down> <StepMs> [OpenAccel] [CloseAccel] [CalibrationMultiplier] [enabled]\r\n";
-                                                    } else if (relay_up_name.equalsIgnoreCase(relay_down_name)) {
-                                                        result += "Components     | Blinds group contains repeated components.\r\n";
-                                                    } else {
-                                                        Generic* relay_up_generic = nullptr;
-                                                        Generic* relay_down_generic = nullptr;
-
-                                                        int idx = Settings.Components.IndexOf(relay_up_name);
-                                                        if (idx != -1) relay_up_generic = Settings.Components[idx];
-
-                                                        idx = Settings.Components.IndexOf(relay_down_name);
-                                                        if (idx != -1) relay_down_generic = Settings.Components[idx];
-
-                                                        if (relay_up_generic == nullptr) {
-                                                            result += "Components     | Component '" + relay_up_name + "' not found.\r\n";
-                                                        } else if (relay_down_generic == nullptr) {
-                                                            result += "Components     | Component '" + relay_down_name + "' not found.\r\n";
-                                                        } else if (relay_up_generic->Class() != CLASS_RELAY) {
-                                                            result += "Components     | Component '" + relay_up_name + "' must be a Relay.\r\n";
-                                                        } else if (relay_down_generic->Class() != CLASS_RELAY) {
-                                                            result += "Components     | Component '" + relay_down_name + "' must be a Relay.\r\n";
-                                                        } else {
-                                                            Relay* relay_up = (Relay*)relay_up_generic;
-                                                            Relay* relay_down = (Relay*)relay_down_generic;
-
-                                                            bool relay_pair_in_use = false;
-
-                                                            for (size_t i = 0; i < Settings.Components.Count(); ++i) {
-                                                                Generic* existing = Settings.Components[i];
-                                                                if (existing == nullptr) continue;
-                                                                if (existing->Class() != CLASS_BLINDS) continue;
-
-                                                                Blinds* existing_blinds = (Blinds*)existing;
-
-                                                                if (existing_blinds->RelayUp() == relay_up &&
-                                                                    existing_blinds->RelayDown() == relay_down) {
-                                                                    relay_pair_in_use = true;
-                                                                    break;
-                                                                }
-                                                            }
-
-                                                            if (relay_pair_in_use) {
-                                                                result += "Components     | A Blinds component with relays '" + relay_up_name + "' and '" + relay_down_name + "' already exists.\r\n";
-                                                            } else {
-                                                                Blinds* NewComponent = new Blinds(
-                                                                    comp_name,
-                                                                    Settings.Components.Count() + 1,
-                                                                    relay_up,
-                                                                    relay_down
-                                                                );
-
-                                                                NewComponent->StepMs(comp_step_ms);
-                                                                NewComponent->OpenAccel(comp_open_accel);
-                                                                NewComponent->CloseAccel(comp_close_accel);
-                                                                NewComponent->CalibrationMultiplier(comp_calibration_multiplier);
-
-                                                                if (Settings.Components.Add(NewComponent)) {
-                                                                    NewComponent->Enabled(comp_enabled);
-                                                                    changed = true;
-
-                                                                    result += "Components     | New component '" + comp_name + "' added\r\n";
-                                                                    result += "               | Class: " + comp_class + "\r\n";
-                                                                    result += "               | Bus: " + comp_bus + "\r\n";
-                                                                    result += "               | RelayUp: " + relay_up_name + "\r\n";
-                                                                    result += "               | RelayDown: " + relay_down_name + "\r\n";
-                                                                    result += "               | StepMs: " + String(NewComponent->StepMs()) + "\r\n";
-                                                                    result += "               | OpenAccel: " + String(NewComponent->OpenAccel(), 2) + "\r\n";
-                                                                    result += "               | CloseAccel: " + String(NewComponent->CloseAccel(), 2) + "\r\n";
-                                                                    result += "               | CalibrationMultiplier: " + String(NewComponent->CalibrationMultiplier()) + "\r\n";
-                                                                    result += "               | Enabled: " + String(comp_enabled ? "true" : "false") + "\r\n";
-                                                                } else {
-                                                                    delete NewComponent;
-                                                                    result += "Components     | Error while adding component '" + comp_name + "'.\r\n";
-                                                                }
-                                                            }
-                                                        }
-                                                    }
-                                                }
-                                            }
-                                        }
-                                    }
-                                } else {
-                                    String comp_option = parameter[3];
-                                    bool comp_enabled = parameter[4].isEmpty() ? true : parameter[4].equalsIgnoreCase("true");
+            if (args.Is(0, "follow")) {
+                if (!args.Empty(1)) {
+                    if (!isValidLevel(args[1])) {
+                        writeSafe("Log            | Invalid level filter.\r\n");
+                        writeSafe("               | Valid filters: E, W, I, D\r\n");
+                        return;
+                    }
 
-                                    bool valid_number = true;
-                                    for (size_t i = 0; i < comp_addr_str.length(); ++i) {
-                                        if (!isDigit(comp_addr_str[i])) {
-                                            valid_number = false;
-                                            break;
-                                        }
-                                    }
+                    levelFilter = toupper(args[1][0]);
+                }
 
-                                    if (comp_addr_str.isEmpty() || !valid_number) {
-                                        result += "Components     | Invalid address '" + comp_addr_str + "'.\r\n";
-                                    } else {
-                                        uint8_t comp_address = (uint8_t)comp_addr_str.toInt();
+                if (session == nullptr) return;
 
-                                        bool busaddr_in_use = false;
-                                        for (size_t i = 0; i < Settings.Components.Count(); ++i) {
-                                            Generic* existing = Settings.Components[i];
-                                            if (existing == nullptr) continue;
+                struct follow_t {
+                    LogTail::cursor_t Cursor;
+                    LogTail::record_t Record;
+                };
 
-                                            switch (existing->Class()) {
-                                                case CLASS_GENERIC:
-                                                case CLASS_BLINDS:
-                                                    break;
+                auto follow = std::make_shared<follow_t>();
+                follow->Cursor = devLog->Tail().Start(Defaults.Log.FollowBacklog);
 
-                                                default:
-                                                    if ((existing->Bus() == bus_type) && (existing->Address() == comp_address)) {
-                                                        busaddr_in_use = true;
-                                                    }
-                                                    break;
-                                            }
+                writeSafe("Log            | Following" + String(levelFilter != '\0' ? " [" + String(levelFilter) + "]" : "") + " - press Ctrl-C to stop.\r\n\r\n");
 
-                                            if (busaddr_in_use) break;
-                                        }
+                // Read straight from the RAM tail, one record per call, only as fast as this client takes them
+                session->Stream([follow, levelFilter](AsyncTelnetSession* session) -> bool {
+                    uint32_t skipped = 0;
 
-                                        if (busaddr_in_use) {
-                                            result += "Components     | Bus/address '" + comp_bus + ":" + String(comp_address) + "' already in use.\r\n";
-                                        } else {
-                                            bool added = false;
-                                            Generic* NewComponent = nullptr;
-
-                                            switch (c) {
-                                                case CLASS_BUTTON: {
-                                                    NewComponent = new Button(
-                                                        comp_name,
-                                                        Settings.Components.Count() + 1,
-                                                        bus_type,
-                                                        comp_address,
-                                                        comp_option.equalsIgnoreCase("EdgesOnly")
-                                                            ? ButtonReportModes::BUTTONREPORTMODE_EDGESONLY
-                                                            : ButtonReportModes::BUTTONREPORTMODE_CLICKSONLY
-                                                    );
-                                                    added = true;
-                                                } break;
-
-                                                case CLASS_CONTACTSENSOR: {
-                                                    NewComponent = new ContactSensor(
-                                                        comp_name,
-                                                        Settings.Components.Count() + 1,
-                                                        bus_type,
-                                                        comp_address,
-                                                        comp_option.equalsIgnoreCase("Invert")
-                                                    );
-                                                    added = true;
-                                                } break;
-
-                                                case CLASS_CURRENTMETER: {
-                                                    NewComponent = new Currentmeter(
-                                                        comp_name,
-                                                        Settings.Components.Count() + 1,
-                                                        bus_type,
-                                                        comp_address
-                                                    );
-                                                    added = true;
-                                                } break;
-
-                                                case CLASS_DOORBELL: {
-                                                    NewComponent = new Doorbell(
-                                                        comp_name,
-                                                        Settings.Components.Count() + 1,
-                                                        bus_type,
-                                                        comp_address
-                                                    );
-                                                    added = true;
-                                                } break;
-
-                                                case CLASS_PIR: {
-                                                    NewComponent = new PIR(
-                                                        comp_name,
-                                                        Settings.Components.Count() + 1,
-                                                        bus_type,
-                                                        comp_address
-                                                    );
-                                                    added = true;
-                                                } break;
-
-                                                case CLASS_RELAY: {
-                                                    NewComponent = new Relay(
-                                                        comp_name,
-                                                        Settings.Components.Count() + 1,
-                                                        bus_type,
-                                                        comp_address,
-                                                        comp_option.equalsIgnoreCase("NormallyOpened")
-                                                            ? RelayTypes::RELAYTYPE_NORMALLYOPENED
-                                                            : RelayTypes::RELAYTYPE_NORMALLYCLOSED
-                                                    );
-                                                    added = true;
-                                                } break;
-
-                                                case CLASS_THERMOMETER: {
-                                                    ThermometerTypes comp_type = THERMOMETERTYPE_DHT11;
-
-                                                    if (comp_option.equalsIgnoreCase("DHT11")) comp_type = THERMOMETERTYPE_DHT11;
-                                                    else if (comp_option.equalsIgnoreCase("DHT12")) comp_type = THERMOMETERTYPE_DHT12;
-                                                    else if (comp_option.equalsIgnoreCase("DHT21")) comp_type = THERMOMETERTYPE_DHT21;
-                                                    else if (comp_option.equalsIgnoreCase("DHT22")) comp_type = THERMOMETERTYPE_DHT22;
-                                                    else if (comp_option.equalsIgnoreCase("DS18B20")) comp_type = THERMOMETERTYPE_DS18B20;
-
-                                                    NewComponent = new Thermometer(
-                                                        comp_name,
-                                                        Settings.Components.Count() + 1,
-                                                        bus_type,
-                                                        comp_address,
-                                                        comp_type
-                                                    );
-                                                    added = true;
-                                                } break;
-
-                                                default:
-                                                    break;
-                                            }
+                    while (devLog->Tail().Read(follow->Cursor, follow->Record, skipped)) {
+                        if (skipped > 0) session->printf("Log            | %u record(s) skipped - client too slow.\r\n", (unsigned)skipped);
 
-                                            if (added) {
-                                                if (Settings.Components.Add(NewComponent)) {
-                                                    NewComponent->Enabled(comp_enabled);
-                                                    changed = true;
-
-                                                    result += "Components     | New component '" + comp_name + "' added\r\n";
-                                                    result += "               | Class: " + comp_class + "\r\n";
-                                                    result += "               | Bus: " + comp_bus + "\r\n";
-                                                    result += "               | Address: " + String(comp_address) + "\r\n";
-                                                    if (!comp_option.isEmpty())
-                                                        result += "               | Option: " + comp_option + "\r\n";
-                                                    result += "               | Enabled: " + String(comp_enabled ? "true" : "false") + "\r\n";
-                                                } else {
-                                                    delete NewComponent;
-                                                    result += "Components     | Error while adding component '" + comp_name + "'.\r\n";
-                                                }
-                                            } else {
-                                                result += "Components     | Error while creating component '" + comp_name + "'.\r\n";
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
+                        const char level = LogPipeline::LevelChar(follow->Record.Level);
+                        if (levelFilter != '\0' && level != levelFilter) continue;
+
+                        char stamp[24];
+                        time_t t = follow->Record.Epoch;
+                        struct tm tmv;
+                        localtime_r(&t, &tmv);
+                        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tmv);
+
+                        session->printf("[%c] %s ", level, stamp);
+                        session->write((const uint8_t*)follow->Record.Message, follow->Record.Length);
+                        session->print("\r\n");
+                        break;
                     }
+
+                    return true;
+                });
+                return;
+            }
+
+            if (args.Is(0, "syslog")) {
+                if (args.Is(1, "udp") || args.Is(1, "tcp")) {
+                    Settings.Log.SyslogTransport(String(args[1]));
+                    CommandBus.SaveSettings(COMMANDSOURCE_TELNET);
+                    devLog->SyslogTransportMode(Settings.Log.SyslogTransport());
+                } else if (!args.Empty(1)) {
+                    writeSafe("Log            | Invalid syslog transport.\r\n");
+                    writeSafe("               | Usage: log syslog [udp|tcp]\r\n");
+                    return;
                 }
-            } else {
-                result += "Components     | Missing new component parameters.\r\n";
-                result += "               | Real component: comp add <name> <class>@<bus>:<address> [option] [enabled]\r\n";
-                result += "               | Virtual component: comp add <name> Blinds@Group:<relay_up>,<relay_down> [enabled]\r\n";
+
+                writeSafe("Log            | Syslog transport: " + String(SyslogTransport::ModeName(Settings.Log.SyslogTransport())) + String(Settings.Log.SyslogTransport() == SYSLOG_TCP ? " (RFC 6587 octet counting)" : " (batched datagrams)") + "\r\n");
+                return;
             }
-        } else {
-            result += "Components     | Invalid comp parameter.\r\n";
-        }
 
-        if (changed) {
-            result += "\r\n               | Settings changed - reboot recommended to apply changes.\r\n";
-            Settings.Save();
-        }
-        client->write(result.c_str());
-    }, admincmd);
-}
-void Telnet::registerCommand_log(bool admincmd) {
-    devTelnetServer->onCommand("log", "Show/clear log file\r\n\r\nlog [nlines][level|clear]", [&](AsyncClient* client, String* parameter) {
+            if (args.Is(0, "range")) {
+                uint32_t from = 0;
+                uint32_t to = (uint32_t)time(nullptr);
+                size_t next = 2;
 
-        auto writeSafe = [&](const String& s) {
-            if (client == nullptr) return;
-            client->write(s.c_str());
-            yield();
-        };
+                if (args.Empty(1) || !parseTime(String(args[1]), false, from)) {
+                    writeSafe("Log            | Invalid start time.\r\n");
+                    writeSafe("               | Usage: log range <from> [to] [level]\r\n");
+                    writeSafe("               | Times: YYYY-MM-DD, YYYY-MM-DDTHH:MM[:SS] or HH:MM[:SS]\r\n");
+                    return;
+                }
 
-        auto isValidLevel = [&](const String& s) -> bool {
-            if (s.length() != 1) return false;
-            char c = toupper(s[0]);
-            return (c == 'E' || c == 'W' || c == 'I' || c == 'D');
-        };
+                if (!args.Empty(2) && !isValidLevel(args[2])) {
+                    if (!parseTime(String(args[2]), true, to)) {
+                        writeSafe("Log            | Invalid end time.\r\n");
+                        return;
+                    }
+                    next = 3;
+                }
 
-        size_t nlines = Defaults.Log.ShowMaxLines;
-        char levelFilter = '\0';
+                if (!args.Empty(next)) {
+                    if (!isValidLevel(args[next])) {
+                        writeSafe("Log            | Invalid level filter.\r\n");
+                        writeSafe("               | Valid filters: E, W, I, D\r\n");
+                        return;
+                    }
 
-        if (!parameter[0].isEmpty()) {
-            if (parameter[0].equalsIgnoreCase("clear")) {
-                devLog->Clear();
-                writeSafe("Log            | All log entries were cleared: " + String(Defaults.LogFileName) + "\r\n\r\n");
+                    levelFilter = toupper(args[next][0]);
+                }
+
+                devLog->Flush(250);
+
+                std::vector<String> lines;
+                devLog->Store().Range(from, to, levelFilter, 100, [&](const String& line) { lines.push_back(line); });
+
+                String header = "Log            | Showing " + String(lines.size()) + " log entr" + String(lines.size() == 1 ? "y" : "ies") + " from " + String(args[1]);
+                if (next == 3) header += " to " + String(args[2]);
+                if (levelFilter != '\0') header += " [" + String(levelFilter) + "]";
+                if (lines.size() == 100) header += " (first 100)";
+                header += "\r\n\r\n";
+
+                showLines(header, std::move(lines));
                 return;
             }
 
-            if (IsNumber(parameter[0])) {
-                nlines = (size_t)parameter[0].toInt();
+            if (IsNumber(String(args[0]))) {
+                nlines = (size_t)atoi(args[0]);
 
                 if (nlines == 0) {
                     writeSafe("Log            | Invalid number of lines.\r\n");
@@ -1527,22 +1915,22 @@ void Telnet::registerCommand_log(bool admincmd) {
                     nlines = 100;
                 }
 
-                if (!parameter[1].isEmpty()) {
-                    if (!isValidLevel(parameter[1])) {
+                if (!args.Empty(1)) {
+                    if (!isValidLevel(args[1])) {
                         writeSafe("Log            | Invalid level filter.\r\n");
                         writeSafe("               | Valid filters: E, W, I, D\r\n");
-                        writeSafe("               | Usage: log [nlines] [level|clear]\r\n");
+                        writeSafe("               | Usage: log [nlines] [level|clear|stats|range|follow|syslog]\r\n");
                         return;
                     }
 
-                    levelFilter = toupper(parameter[1][0]);
+                    levelFilter = toupper(args[1][0]);
                 }
-            } else if (isValidLevel(parameter[0])) {
-                levelFilter = toupper(parameter[0][0]);
+            } else if (isValidLevel(args[0])) {
+                levelFilter = toupper(args[0][0]);
 
-                if (!parameter[1].isEmpty()) {
-                    if (IsNumber(parameter[1])) {
-                        nlines = (size_t)parameter[1].toInt();
+                if (!args.Empty(1)) {
+                    if (IsNumber(String(args[1]))) {
+                        nlines = (size_t)atoi(args[1]);
 
                         if (nlines == 0) {
                             writeSafe("Log            | Invalid number of lines.\r\n");
@@ -1554,113 +1942,32 @@ void Telnet::registerCommand_log(bool admincmd) {
                         }
                     } else {
                         writeSafe("Log            | Invalid parameter.\r\n");
-                        writeSafe("               | Usage: log [nlines] [level|clear]\r\n");
+                        writeSafe("               | Usage: log [nlines] [level|clear|stats|range|follow|syslog]\r\n");
                         return;
                     }
                 }
             } else {
                 writeSafe("Log            | Invalid parameter.\r\n");
-                writeSafe("               | Usage: log [nlines] [level|clear]\r\n");
+                writeSafe("               | Usage: log [nlines] [level|clear|stats|range|follow|syslog]\r\n");
                 writeSafe("               | Levels: E, W, I, D\r\n");
                 return;
             }
         }
 
-        File f = devFileSystem->OpenFile(Defaults.LogFileName, "r");
-        if (!f) {
-            writeSafe("Log            | Error opening log file '" + String(Defaults.LogFileName) + "'.\r\n");
-            return;
-        }
-
-        const size_t fileSize = f.size();
-        if (fileSize == 0) {
-            f.close();
-            writeSafe("Log            | Log file is empty: " + String(Defaults.LogFileName) + "\r\n");
-            return;
-        }
-
-        String* lines = new String[nlines];
-        if (lines == nullptr) {
-            f.close();
-            writeSafe("Log            | Not enough memory.\r\n");
-            return;
-        }
-
-        size_t count = 0;
-        String current;
-        current.reserve(256);
-
-        int32_t pos = (int32_t)fileSize - 1;
-
-        auto matchesLevel = [&](const String& line) -> bool {
-            if (levelFilter == '\0') return true;
-            return (line.length() > 1 && toupper(line[1]) == levelFilter);
-        };
-
-        while (pos >= 0 && count < nlines) {
-            f.seek(pos, SeekSet);
-            int c = f.read();
-
-            if (c < 0) break;
-
-            if (c == '\n') {
-                if (!current.isEmpty()) {
-                    String ready;
-                    ready.reserve(current.length());
-
-                    for (int i = (int)current.length() - 1; i >= 0; --i) {
-                        ready += current[i];
-                    }
+        // Records still buffered in RAM would otherwise be missing from the tail
+        devLog->Flush(250);
 
-                    ready.trim();
+        std::vector<String> lines;
+        lines.reserve(nlines);
+        devLog->Store().Tail(nlines, levelFilter, [&](const String& line) { lines.push_back(line); });
 
-                    if (matchesLevel(ready)) {
-                        lines[count++] = ready;
-                    }
-
-                    current.clear();
-                }
-            } else if (c != '\r') {
-                current += (char)c;
-            }
-
-            pos--;
-
-            if ((pos & 0x1FF) == 0) {
-                yield();
-            }
-        }
-
-        if (!current.isEmpty() && count < nlines) {
-            String ready;
-            ready.reserve(current.length());
-
-            for (int i = (int)current.length() - 1; i >= 0; --i) {
-                ready += current[i];
-            }
-
-            ready.trim();
-
-            if (matchesLevel(ready)) {
-                lines[count++] = ready;
-            }
-        }
-
-        f.close();
-
-        String header = "Log            | Showing last " + String(count) + " log entr" + String(count == 1 ? "y" : "ies");
+        String header = "Log            | Showing last " + String(lines.size()) + " log entr" + String(lines.size() == 1 ? "y" : "ies");
         if (levelFilter != '\0') {
             header += " [" + String(levelFilter) + "]";
         }
-        header += ": " + String(Defaults.LogFileName) + "\r\n\r\n";
-
-        writeSafe(header);
-
-        for (int i = (int)count - 1; i >= 0; --i) {
-            writeSafe(lines[i] + "\r\n");
-        }
+        header += ": " + String(Defaults.LogDirectory) + "\r\n\r\n";
 
-        delete[] lines;
+        showLines(header, std::move(lines));
 
     }, admincmd);
 }
\ No newline at end of file
@@ -2,10 +2,14 @@
 
 #include <Arduino.h>
 #include <AsyncTCP.h>
+#include <memory>
 #include "AsyncTelnetServer.h"
 
 #include "Globals.h"
 
+// Rejected: the command bus was full. Queued: accepted, but loop() had not applied it within the reply wait.
+enum TelnetSubmitResults { TELNETSUBMIT_REJECTED, TELNETSUBMIT_QUEUED, TELNETSUBMIT_APPLIED };
+
 class Telnet {
     public:
         static void Begin();
@@ -18,6 +22,7 @@ class Telnet {
         static void registerCommand_ver(bool admincmd = false);
         static void registerCommand_memory(bool admincmd = false);
         static void registerCommand_storage(bool admincmd = false);
+        static void registerCommand_perf(bool admincmd = false);
         static void registerCommand_ping(bool admincmd = true);
         static void registerCommand_telnet(bool admincmd = true);
         static void registerCommand_webserver(bool admincmd = true);
@@ -26,4 +31,10 @@ class Telnet {
         static void registerCommand_comp(bool admincmd = true);
         static void registerCommand_log(bool admincmd = true);
         static void registerCommand_set(bool admincmd = true);
+
+        static TelnetSubmitResults submit(CommandOps op, Generic* target, uint32_t layout, int32_t value = 0);
+        static bool removeComponent(const String* parameter, String& result);
+        static bool addComponent(const String* parameter, String& result);
+        static void changeComponents(const AsyncTelnetArgs& args, String& result);
+        static void printPerf(Print& out);
 };
\ No newline at end of file
@@ -0,0 +1,608 @@
+#include "webapi.h"
+
+std::shared_ptr<const webapi_index_t> WebAPI::pIndex;
+std::unordered_map<Generic*, std::shared_ptr<webapi_state_t>> WebAPI::pStates;
+uint32_t WebAPI::pLayout = 0;
+std::atomic<uint32_t> WebAPI::pGeneration{1};
+uint32_t WebAPI::pBootID = 0;
+
+AsyncEventSource* WebAPI::pEvents = nullptr;
+std::vector<webapi_subscriber_t> WebAPI::pSubscribers;
+SemaphoreHandle_t WebAPI::pSubscribersLock = nullptr;
+std::atomic<size_t> WebAPI::pSubscriberCount{0};
+uint32_t WebAPI::pEventsSent = 0;
+uint32_t WebAPI::pEventsDropped = 0;
+uint32_t WebAPI::pRequests = 0;
+
+std::unordered_map<AsyncWebServerRequest*, std::unique_ptr<webapi_batch_t>> WebAPI::pBatches;
+
+static const char* ComponentsRoute = "/api/components/";
+
+// Both run on the AsyncTCP task: they only validate and queue, loop() does the actuation
+static bool applyRelay(Generic* comp, uint32_t layout, const String& key, const String& value, uint32_t* ticket) {
+    if (!key.equalsIgnoreCase("state")) return false;
+
+    CommandOps op;
+    int32_t arg = 0;
+
+    if (value == "on" || value == "true" || value == "1") {
+        op = COMMAND_RELAY_STATE;
+        arg = 1;
+    } else if (value == "off" || value == "false" || value == "0") {
+        op = COMMAND_RELAY_STATE;
+    } else if (value == "toggle" || value == "invert" || value == "~") {
+        op = COMMAND_RELAY_INVERT;
+    } else {
+        return false;
+    }
+
+    if (ticket != nullptr) *ticket = CommandBus.Submit(op, comp, arg, COMMANDSOURCE_WEB, layout);
+    return true;
+}
+
+static bool applyBlinds(Generic* comp, uint32_t layout, const String& key, const String& value, uint32_t* ticket) {
+    CommandOps op;
+    int32_t arg = 0;
+
+    if (key.equalsIgnoreCase("position")) {
+        if (!IsNumber(value) || value.toInt() > 100) return false;
+        op = COMMAND_BLINDS_POSITION;
+        arg = value.toInt();
+    } else if (key.equalsIgnoreCase("action")) {
+        if (value.equalsIgnoreCase("open")) op = COMMAND_BLINDS_OPEN;
+        else if (value.equalsIgnoreCase("close")) op = COMMAND_BLINDS_CLOSE;
+        else if (value.equalsIgnoreCase("stop")) op = COMMAND_BLINDS_STOP;
+        else return false;
+    } else {
+        return false;
+    }
+
+    if (ticket != nullptr) *ticket = CommandBus.Submit(op, comp, arg, COMMANDSOURCE_WEB, layout);
+    return true;
+}
+
+static const webapi_handler_t Handlers[] = {
+    { CLASS_RELAY, "Relay", [](JsonDocument& reply, Generic* comp) {
+        reply["State"] = comp->as<Relay>()->State();
+    }, applyRelay },
+    { CLASS_PIR, "PIR", [](JsonDocument& reply, Generic* comp) {
+        reply["Motion"] = comp->as<PIR>()->State();
+    }, nullptr },
+    { CLASS_BUTTON, "Button", [](JsonDocument& reply, Generic* comp) {
+        reply["Pressed"] = comp->as<Button>()->IsPressed();
+    }, nullptr },
+    { CLASS_CURRENTMETER, "Currentmeter", [](JsonDocument& reply, Generic* comp) {
+        reply["Current AC"] = comp->as<Currentmeter>()->CurrentAC();
+        reply["Current DC"] = comp->as<Currentmeter>()->CurrentDC();
+    }, nullptr },
+    { CLASS_THERMOMETER, "Thermometer", [](JsonDocument& reply, Generic* comp) {
+        reply["Humidity"] = comp->as<Thermometer>()->Humidity();
+        reply["Temperature"] = comp->as<Thermometer>()->Temperature();
+    }, nullptr },
+    { CLASS_BLINDS, "Blinds", [](JsonDocument& reply, Generic* comp) {
+        reply["Position"] = comp->as<Blinds>()->Position();
+        reply["State"] = comp->as<Blinds>()->State() == BlindsStates::BLINDSSTATE_DECREASING ? "Decreasing" : (comp->as<Blinds>()->State() == BlindsStates::BLINDSSTATE_INCREASING ? "Increasing" : "Stopped");
+    }, applyBlinds },
+    { CLASS_DOORBELL, "Doorbell", [](JsonDocument& reply, Generic* comp) {
+        reply["State"] = comp->as<Doorbell>()->State();
+    }, nullptr },
+    { CLASS_CONTACTSENSOR, "ContactSensor", [](JsonDocument& reply, Generic* comp) {
+        reply["State"] = comp->as<ContactSensor>()->State();
+    }, nullptr },
+};
+
+const webapi_handler_t* WebAPI::HandlerFor(Classes cls) {
+    for (const auto& h : Handlers) {
+        if (h.Class == cls) return &h;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<webapi_state_t> WebAPI::track(Generic* comp) {
+    auto it = pStates.find(comp);
+    if (it != pStates.end()) return it->second;
+
+    auto state = std::make_shared<webapi_state_t>();
+    state->Generation = pGeneration.load();
+
+    // Any event the component raises counts as a state change for ?since= polling
+    for (auto& ev : comp->Event) {
+        callback_t previous = comp->GetEventCallback(ev.first);
+
+        comp->SetEventCallback(ev.first, [previous, state, comp] {
+            if (previous) previous();
+            state->Generation = ++pGeneration;
+
+            const webapi_handler_t* handler = HandlerFor(comp->Class());
+            if (handler) notify({ comp, handler, state });
+        });
+    }
+
+    pStates[comp] = state;
+    return state;
+}
+
+std::shared_ptr<const webapi_fragment_t> WebAPI::fragment(const webapi_entry_t& entry) {
+    uint32_t generation = entry.State->Generation.load();
+    std::shared_ptr<const webapi_fragment_t> cached = std::atomic_load(&entry.State->Fragment);
+
+    if (cached && cached->Generation == generation) return cached;
+
+    JsonDocument doc;
+    Fill(doc, entry);
+    doc["Generation"] = generation;
+
+    auto data = std::make_shared<webapi_fragment_t>();
+    data->Generation = generation;
+    serializeJson(doc, data->Json);
+
+    std::shared_ptr<const webapi_fragment_t> result = data;
+    std::atomic_store(&entry.State->Fragment, result);
+
+    return result;
+}
+
+String WebAPI::etag(uint32_t generation) {
+    // Boot id keeps a generation from a previous run from matching after a reboot
+    return "\"" + String(pBootID, HEX) + "-" + String(generation) + "\"";
+}
+
+void WebAPI::notify(const webapi_entry_t& entry) {
+    if (pSubscriberCount.load(std::memory_order_relaxed) == 0 || pSubscribersLock == nullptr) return;
+
+    // Serialized once, shared by every subscriber ring and by the next GET of this component
+    std::shared_ptr<const webapi_fragment_t> data = fragment(entry);
+
+    xSemaphoreTake(pSubscribersLock, portMAX_DELAY);
+    for (auto& s : pSubscribers) {
+        if (s.Count == s.Ring.size()) {
+            s.Head = (s.Head + 1) % s.Ring.size();
+            s.Count--;
+            s.Dropped++;
+            pEventsDropped++;
+        }
+        s.Ring[(s.Head + s.Count) % s.Ring.size()] = { data };
+        s.Count++;
+    }
+    xSemaphoreGive(pSubscribersLock);
+}
+
+void WebAPI::Control() {
+    if (pEvents == nullptr || pSubscriberCount.load(std::memory_order_relaxed) == 0) return;
+
+    xSemaphoreTake(pSubscribersLock, portMAX_DELAY);
+    for (auto& s : pSubscribers) {
+        if (!s.Client->connected()) continue;
+
+        // Tell the client it missed records so it can resync with /api/state?since=<last id>
+        if (s.Dropped > 0 && s.Client->packetsWaiting() < Defaults.WebServer.EventMaxInFlight) {
+            s.Client->send(String(s.Dropped).c_str(), "overflow", s.Client->lastId());
+            s.Dropped = 0;
+        }
+
+        while (s.Count > 0 && s.Client->packetsWaiting() < Defaults.WebServer.EventMaxInFlight) {
+            webapi_change_t& change = s.Ring[s.Head];
+            s.Client->send(change.Data->Json.c_str(), "change", change.Data->Generation);
+            change.Data.reset();
+
+            s.Head = (s.Head + 1) % s.Ring.size();
+            s.Count--;
+            pEventsSent++;
+        }
+    }
+    xSemaphoreGive(pSubscribersLock);
+}
+
+void WebAPI::Sync() {
+    if (CommandBus.Layout() != pLayout) reindex();
+}
+
+// Loop task only, like the component callbacks it hooks
+void WebAPI::reindex() {
+    auto index = std::make_shared<webapi_index_t>();
+    const uint32_t layout = CommandBus.Layout();
+    pLayout = layout;
+    index->reserve(Settings.Components.Count());
+
+    // Forget removed components; their hooks died with them and the address may be reused
+    for (auto it = pStates.begin(); it != pStates.end(); ) {
+        bool present = false;
+        for (auto m : Settings.Components) { if (m == it->first) { present = true; break; } }
+        it = present ? std::next(it) : pStates.erase(it);
+    }
+
+    for (auto m : Settings.Components) {
+        const webapi_handler_t* handler = HandlerFor(m->Class());
+        if (handler) (*index)[std::string(m->Name().c_str())] = { m, handler, track(m), layout };
+    }
+
+    std::shared_ptr<const webapi_index_t> result = index;
+    std::atomic_store(&pIndex, result);
+}
+
+std::shared_ptr<const webapi_entry_t> WebAPI::Find(const String& name) {
+    std::shared_ptr<const webapi_index_t> index = std::atomic_load(&pIndex);
+    if (!index) return nullptr;
+
+    auto it = index->find(std::string(name.c_str()));
+
+    // Shares ownership of the whole index, so the entry stays valid even if a reindex swaps it out meanwhile
+    return (it == index->end()) ? nullptr : std::shared_ptr<const webapi_entry_t>(index, &it->second);
+}
+
+void WebAPI::Fill(JsonDocument& reply, const webapi_entry_t& entry) {
+    reply["Class"] = entry.Handler->ClassName;
+    reply["Name"] = entry.Component->Name();
+    entry.Handler->Fill(reply, entry.Component);
+}
+
+void WebAPI::handleComponent(AsyncWebServerRequest* request, const String& name) {
+    pRequests++;
+
+    JsonDocument reply;
+    String json;
+
+    if (!hasValidHeaderToken(request, Settings.WebServer.WebHooksToken())) {
+        reply["Error"] = "Unauthorized";
+        serializeJson(reply, json);
+
+        request->send(401, "application/json", json.c_str());
+        LOG_W("Unauthorized HTTP request from %s to /%s", request->client()->remoteIP().toString().c_str(), name.c_str());
+        return;
+    }
+
+    std::shared_ptr<const webapi_entry_t> entry = Find(name);
+
+    if (!entry) {
+        reply["Error"] = "Not found";
+        serializeJson(reply, json);
+
+        request->send(404, "application/json", json.c_str());
+        return;
+    }
+
+    String applied;
+    uint32_t ticket = 0;
+
+    if (entry->Handler->Apply) {
+        for (size_t i = 0; i < request->args(); i++) {
+            if (entry->Handler->Apply(entry->Component, entry->Layout, request->argName(i), request->arg(i), &ticket)) {
+                if (ticket == 0) {
+                    reply["Error"] = "Busy";
+                    serializeJson(reply, json);
+
+                    request->send(503, "application/json", json.c_str());
+                    return;
+                }
+
+                applied += (applied.isEmpty() ? "" : ", ") + request->argName(i) + "=" + request->arg(i);
+            }
+        }
+    }
+
+    // Commands are applied in order, so the last ticket covers all of them; past the wait the reply shows the state as it is
+    if (!applied.isEmpty()) CommandBus.Wait(ticket, Defaults.CommandBus.ReplyWaitMs);
+
+    // Unchanged state costs a header compare and an empty reply
+    const String current = etag(entry->State->Generation);
+
+    if (applied.isEmpty() && request->hasHeader("If-None-Match") && request->header("If-None-Match") == current) {
+        AsyncWebServerResponse* response = request->beginResponse(304);
+        response->addHeader("ETag", current);
+        request->send(response);
+        return;
+    }
+
+    std::shared_ptr<const webapi_fragment_t> data = fragment(*entry);
+
+    AsyncWebServerResponse* response = request->beginResponse("application/json", data->Json.length(), [data](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+        size_t n = min(maxLen, data->Json.length() - index);
+        memcpy(buffer, data->Json.c_str() + index, n);
+        return n;
+    });
+    response->addHeader("ETag", etag(data->Generation));
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+
+    if (!applied.isEmpty()) {
+        LOG_I("Granted HTTP request (SET '%s') from %s to /%s", applied.c_str(), request->client()->remoteIP().toString().c_str(), name.c_str());
+    }
+}
+
+void WebAPI::handleState(AsyncWebServerRequest* request) {
+    pRequests++;
+
+    if (!hasValidHeaderToken(request, Settings.WebServer.WebHooksToken())) {
+        request->send(401, "application/json", "{\"Error\":\"Unauthorized\"}");
+        return;
+    }
+
+    struct stream_t {
+        std::vector<String> Names;
+        size_t Next = 0;
+        uint32_t Since = 0;
+        String Pending;
+        size_t PendingPos = 0;
+        bool Separator = false;
+    };
+
+    auto stream = std::make_shared<stream_t>();
+    stream->Since = request->hasArg("since") ? (uint32_t)strtoul(request->arg("since").c_str(), nullptr, 10) : 0;
+
+    // Only names are captured; each one is resolved again when its turn comes, so a removed component is skipped, not dereferenced
+    std::shared_ptr<const webapi_index_t> index = std::atomic_load(&pIndex);
+    if (index) {
+        stream->Names.reserve(index->size());
+        for (const auto& kv : *index) stream->Names.emplace_back(kv.first.c_str());
+    }
+
+    stream->Pending = "{\"Generation\":" + String(Generation()) + ",\"Components\":[";
+
+    AsyncWebServerResponse* response = request->beginChunkedResponse("application/json", [stream](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+        size_t written = 0;
+
+        while (written < maxLen) {
+            if (stream->PendingPos >= stream->Pending.length()) {
+                stream->Pending = "";
+                stream->PendingPos = 0;
+
+                while (stream->Pending.isEmpty() && stream->Next < stream->Names.size()) {
+                    std::shared_ptr<const webapi_entry_t> entry = Find(stream->Names[stream->Next++]);
+                    if (!entry || entry->State->Generation <= stream->Since) continue;
+
+                    if (stream->Separator) stream->Pending = ",";
+                    stream->Pending += fragment(*entry)->Json;
+                    stream->Separator = true;
+                }
+
+                if (stream->Pending.isEmpty()) {
+                    if (stream->Next == SIZE_MAX) break;
+
+                    stream->Pending = "]}";
+                    stream->Next = SIZE_MAX;
+                }
+            }
+
+            size_t n = min(maxLen - written, stream->Pending.length() - stream->PendingPos);
+            memcpy(buffer + written, stream->Pending.c_str() + stream->PendingPos, n);
+            stream->PendingPos += n;
+            written += n;
+        }
+
+        return written;
+    });
+
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
+static String batchValue(JsonVariantConst value) {
+    return value.is<bool>() ? String(value.as<bool>() ? "true" : "false") : value.as<String>();
+}
+
+// Never waits: runs on the AsyncTCP task once per element, the reply waits a single time for the last ticket
+void WebAPI::batchApply(webapi_batch_t& batch) {
+    JsonDocument action;
+    webapi_batch_result_t result;
+
+    if (deserializeJson(action, batch.Element) || !action.is<JsonObjectConst>()) {
+        result.Reason = "Invalid action";
+    } else {
+        result.Name = action["Name"] | "";
+
+        std::shared_ptr<const webapi_entry_t> entry = Find(result.Name);
+
+        if (!entry) {
+            result.Reason = "Not found";
+        } else if (entry->Handler->Apply == nullptr) {
+            result.Reason = "Read only";
+        } else {
+            // Every key is checked before any is queued, so an action is applied whole or not at all
+            for (JsonPairConst kv : action.as<JsonObjectConst>()) {
+                if (strcasecmp(kv.key().c_str(), "Name") == 0) continue;
+
+                const String value = batchValue(kv.value());
+                if (!entry->Handler->Apply(entry->Component, entry->Layout, String(kv.key().c_str()), value, nullptr)) {
+                    result.Reason = "Unsupported " + String(kv.key().c_str()) + "=" + value;
+                    break;
+                }
+            }
+
+            String queued;
+
+            for (JsonPairConst kv : action.as<JsonObjectConst>()) {
+                if (!result.Reason.isEmpty()) break;
+                if (strcasecmp(kv.key().c_str(), "Name") == 0) continue;
+
+                uint32_t ticket = 0;
+                entry->Handler->Apply(entry->Component, entry->Layout, String(kv.key().c_str()), batchValue(kv.value()), &ticket);
+
+                // A full bus can still cut an action short; the keys already queued are named so the client can tell
+                if (ticket == 0) {
+                    result.Reason = queued.isEmpty() ? String("Busy") : "Busy - partially applied: " + queued;
+                    break;
+                }
+
+                batch.Ticket = ticket;
+                queued += (queued.isEmpty() ? "" : ", ") + String(kv.key().c_str());
+            }
+        }
+    }
+
+    if (result.Reason.isEmpty()) batch.Applied++; else batch.Rejected++;
+    batch.Results.push_back(std::move(result));
+}
+
+String WebAPI::batchResults(const webapi_batch_t& batch) {
+    String json;
+
+    for (const auto& r : batch.Results) {
+        JsonDocument result;
+        result["Name"] = r.Name;
+
+        // Looked up again: state is read after the wait, and the component may be gone by now
+        std::shared_ptr<const webapi_entry_t> entry = r.Reason.isEmpty() ? Find(r.Name) : nullptr;
+        if (entry) Fill(result, *entry);
+
+        result["Result"] = r.Reason.isEmpty() ? String("OK") : r.Reason;
+
+        if (!json.isEmpty()) json += ",";
+        serializeJson(result, json);
+    }
+
+    return json;
+}
+
+void WebAPI::batchFeed(webapi_batch_t& batch, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len && !batch.Failed; i++) {
+        char c = (char)data[i];
+
+        if (!batch.Started) {
+            if (c == '[') batch.Started = true;
+            else if (!isspace((unsigned char)c)) batch.Failed = true;
+            continue;
+        }
+
+        if (batch.Ended) {
+            if (!isspace((unsigned char)c)) batch.Failed = true;
+            continue;
+        }
+
+        // Between elements only separators and the closing bracket are allowed
+        if (batch.Depth == 0) {
+            if (c == '{') {
+                batch.Depth = 1;
+                batch.Element = "{";
+            } else if (c == ']') {
+                batch.Ended = true;
+            } else if (c != ',' && !isspace((unsigned char)c)) {
+                batch.Failed = true;
+            }
+            continue;
+        }
+
+        batch.Element += c;
+        if (batch.Element.length() > Defaults.WebServer.BatchMaxAction) { batch.Failed = true; continue; }
+
+        if (batch.InString) {
+            if (batch.Escape) batch.Escape = false;
+            else if (c == '\\') batch.Escape = true;
+            else if (c == '"') batch.InString = false;
+        } else if (c == '"') {
+            batch.InString = true;
+        } else if (c == '{' || c == '[') {
+            batch.Depth++;
+        } else if (c == '}' || c == ']') {
+            if (--batch.Depth == 0) {
+                batchApply(batch);
+                batch.Element = "";
+            }
+        }
+    }
+}
+
+void WebAPI::handleBatch(AsyncWebServerRequest* request) {
+    pRequests++;
+
+    // A request without a body never had an entry created for it, whatever may be keyed at its address
+    auto it = pBatches.find(request);
+    std::unique_ptr<webapi_batch_t> batch = (it == pBatches.end() || request->contentLength() == 0) ? nullptr : std::move(it->second);
+    if (it != pBatches.end()) pBatches.erase(it);
+
+    if (!hasValidHeaderToken(request, Settings.WebServer.WebHooksToken())) {
+        request->send(401, "application/json", "{\"Error\":\"Unauthorized\"}");
+        LOG_W("Unauthorized HTTP request from %s to /api/batch", request->client()->remoteIP().toString().c_str());
+        return;
+    }
+
+    if (request->contentLength() > Defaults.WebServer.BatchMaxBody) {
+        request->send(413, "application/json", "{\"Error\":\"Batch too large\"}");
+        return;
+    }
+
+    // Commands are applied in order, so one wait on the last ticket covers the whole batch
+    if (batch && batch->Ticket != 0) CommandBus.Wait(batch->Ticket, Defaults.CommandBus.ReplyWaitMs);
+
+    if (!batch || batch->Failed || !batch->Ended) {
+        String json = "{\"Error\":\"Malformed batch\",\"Results\":[" + (batch ? batchResults(*batch) : String()) + "]}";
+        request->send(400, "application/json", json);
+        return;
+    }
+
+    String json = "{\"Applied\":" + String(batch->Applied) + ",\"Rejected\":" + String(batch->Rejected) + ",\"Results\":[" + batchResults(*batch) + "]}";
+    request->send(200, "application/json", json);
+
+    LOG_I("Granted HTTP batch (%u applied, %u rejected) from %s", batch->Applied, batch->Rejected, request->client()->remoteIP().toString().c_str());
+}
+
+void WebAPI::Begin(AsyncWebServer* server) {
+    pBootID = esp_random();
+    reindex();
+
+    server->on("/api/state", HTTP_GET, [](AsyncWebServerRequest* request) { handleState(request); });
+
+    // Actions are applied as soon as each array element closes; state persistence stays a single deferred flag
+    server->on("/api/batch", HTTP_POST, [](AsyncWebServerRequest* request) { handleBatch(request); }, nullptr,
+        [](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+            if (index == 0) {
+                // Entries are keyed by the request's address, so one must never outlive its request: a client that
+                // drops mid-body is cleaned up here, and a rejected body never inherits an entry from an earlier request
+                request->onDisconnect([request] { pBatches.erase(request); });
+                pBatches.erase(request);
+
+                if (!hasValidHeaderToken(request, Settings.WebServer.WebHooksToken()) || total > Defaults.WebServer.BatchMaxBody) return;
+
+                pBatches[request] = std::make_unique<webapi_batch_t>();
+            }
+
+            auto it = pBatches.find(request);
+            if (it != pBatches.end()) batchFeed(*it->second, data, len);
+        });
+
+    pSubscribersLock = xSemaphoreCreateMutex();
+    pEvents = new AsyncEventSource("/api/events");
+
+    // Browsers cannot set headers on an EventSource, so the token may also come as ?token=
+    pEvents->setFilter([](AsyncWebServerRequest* request) {
+        return hasValidHeaderToken(request, Settings.WebServer.WebHooksToken()) || (request->hasArg("token") && request->arg("token").equals(Settings.WebServer.WebHooksToken()));
+    });
+
+    pEvents->onConnect([](AsyncEventSourceClient* client) {
+        webapi_subscriber_t s;
+        s.Client = client;
+        s.Ring.resize(Defaults.WebServer.EventQueueDepth);
+
+        xSemaphoreTake(pSubscribersLock, portMAX_DELAY);
+        pSubscribers.push_back(std::move(s));
+        pSubscriberCount.store(pSubscribers.size(), std::memory_order_relaxed);
+        xSemaphoreGive(pSubscribersLock);
+
+        client->send(String(Generation()).c_str(), "hello", Generation());
+        LOG_I("HTTP Server: Event client %s connected", client->client()->remoteIP().toString().c_str());
+    });
+
+    pEvents->onDisconnect([](AsyncEventSourceClient* client) {
+        xSemaphoreTake(pSubscribersLock, portMAX_DELAY);
+        for (auto it = pSubscribers.begin(); it != pSubscribers.end(); ++it) {
+            if (it->Client == client) { pSubscribers.erase(it); break; }
+        }
+        pSubscriberCount.store(pSubscribers.size(), std::memory_order_relaxed);
+        xSemaphoreGive(pSubscribersLock);
+    });
+
+    server->addHandler(pEvents);
+
+    // One route for every component, however many are installed; the name after the prefix selects it
+    server->on("/api/components/*", HTTP_GET, [](AsyncWebServerRequest* request) {
+        handleComponent(request, request->url().substring(strlen(ComponentsRoute)));
+    });
+
+    // Legacy /<name> URLs resolve through the same index instead of one registered handler per component
+    server->onNotFound([](AsyncWebServerRequest* request) {
+        if (request->method() == HTTP_GET && request->url().indexOf('/', 1) < 0 && Find(request->url().substring(1))) {
+            handleComponent(request, request->url().substring(1));
+            return;
+        }
+        request->send(404);
+    });
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <unordered_map>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <vector>
+
+#include "Globals.h"
+
+struct webapi_handler_t {
+    Classes Class;
+    const char* ClassName;
+    void (*Fill)(JsonDocument& reply, Generic* comp);
+    // nullptr for read-only classes. With ticket == nullptr the key is only validated; otherwise it is queued against
+    // the layout the component was indexed in, and the ticket is 0 when the command bus was full
+    bool (*Apply)(Generic* comp, uint32_t layout, const String& key, const String& value, uint32_t* ticket);
+};
+
+struct webapi_fragment_t {
+    String Json;
+    uint32_t Generation;
+};
+
+struct webapi_state_t {
+    std::atomic<uint32_t> Generation{0};
+
+    // Last serialized reply; swapped atomically, readers keep their own reference while sending
+    std::shared_ptr<const webapi_fragment_t> Fragment;
+};
+
+struct webapi_change_t {
+    std::shared_ptr<const webapi_fragment_t> Data;
+};
+
+// One per connected /api/events client; a slow client only ever loses its own oldest records
+struct webapi_subscriber_t {
+    AsyncEventSourceClient* Client;
+    std::vector<webapi_change_t> Ring;
+    size_t Head = 0;
+    size_t Count = 0;
+    uint32_t Dropped = 0;
+};
+
+// Incremental splitter for a top-level JSON array of objects; elements are handed over one at a time as they close
+struct webapi_batch_result_t {
+    String Name;
+    String Reason; // Empty when applied
+};
+
+struct webapi_batch_t {
+    String Element;
+    std::vector<webapi_batch_result_t> Results;
+    uint32_t Ticket = 0; // Last command queued; replies wait once on it
+    uint8_t Depth = 0;
+    bool Started = false;
+    bool Ended = false;
+    bool InString = false;
+    bool Escape = false;
+    bool Failed = false;
+    uint16_t Applied = 0;
+    uint16_t Rejected = 0;
+};
+
+struct webapi_entry_t {
+    Generic* Component;
+    const webapi_handler_t* Handler;
+    std::shared_ptr<webapi_state_t> State; // Shared with the component's hooks, so a reader's entry outlives a reindex
+    uint32_t Layout = 0; // CommandBus layout at the reindex that produced this entry
+};
+
+// Rebuilt as a whole on the loop task and swapped atomically; readers on the AsyncTCP task keep their own reference
+using webapi_index_t = std::unordered_map<std::string, webapi_entry_t>;
+
+class WebAPI {
+    public:
+        static void Begin(AsyncWebServer* server);
+        static void Control();
+
+        // Loop task, right after CommandBus.Drain(): reindexes once a COMMAND_COMPONENTS job started a new layout, since
+        // hooking a component's events must not race its callbacks
+        static void Sync();
+
+        static std::shared_ptr<const webapi_entry_t> Find(const String& name);
+        static const webapi_handler_t* HandlerFor(Classes cls);
+        static void Fill(JsonDocument& reply, const webapi_entry_t& entry);
+
+        [[nodiscard]] static uint32_t Generation() noexcept { return pGeneration.load(); }
+        [[nodiscard]] static size_t Subscribers() noexcept { return pSubscriberCount.load(std::memory_order_relaxed); }
+        [[nodiscard]] static uint32_t EventsSent() noexcept { return pEventsSent; }
+        [[nodiscard]] static uint32_t EventsDropped() noexcept { return pEventsDropped; }
+        [[nodiscard]] static uint32_t Requests() noexcept { return pRequests; }
+    private:
+        static std::shared_ptr<const webapi_index_t> pIndex;
+        static std::unordered_map<Generic*, std::shared_ptr<webapi_state_t>> pStates; // Loop task only
+        static uint32_t pLayout;
+        static std::atomic<uint32_t> pGeneration;
+
+        static AsyncEventSource* pEvents;
+        static std::vector<webapi_subscriber_t> pSubscribers;
+        static SemaphoreHandle_t pSubscribersLock;
+        static std::atomic<size_t> pSubscriberCount; // Mirrors pSubscribers.size() for the lock-free early outs on the loop task
+        static uint32_t pEventsSent;
+        static uint32_t pEventsDropped;
+        static uint32_t pRequests;
+
+        static uint32_t pBootID;
+
+        static void reindex();
+        static std::shared_ptr<webapi_state_t> track(Generic* comp);
+        static void notify(const webapi_entry_t& entry);
+        static std::shared_ptr<const webapi_fragment_t> fragment(const webapi_entry_t& entry);
+        static String etag(uint32_t generation);
+        static void handleComponent(AsyncWebServerRequest* request, const String& name);
+        static void handleState(AsyncWebServerRequest* request);
+
+        static std::unordered_map<AsyncWebServerRequest*, std::unique_ptr<webapi_batch_t>> pBatches;
+
+        static void batchFeed(webapi_batch_t& batch, const uint8_t* data, size_t len);
+        static void batchApply(webapi_batch_t& batch);
+        static String batchResults(const webapi_batch_t& batch);
+        static void handleBatch(AsyncWebServerRequest* request);
+};
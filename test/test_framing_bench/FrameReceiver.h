@@ -0,0 +1,105 @@
+#ifndef FrameReceiver_h
+#define FrameReceiver_h
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "FileFrames.h"
+
+// Receiving end of a FileFrames stream, as the Orchestrator would run it: fed whatever the socket hands over, in
+// any split, it parses the header, checks each chunk length against the advertised limit and verifies the trailer
+// against its own size and CRC32.
+class framereceiver {
+    public:
+        enum States : uint8_t { HEADERLENGTH, HEADER, CHUNKLENGTH, CHUNK, TRAILER, DONE, FAILED };
+    private:
+        States pState = HEADERLENGTH;
+        uint8_t pPrefix[8] = {};
+        size_t pPrefixLen = 0;
+        size_t pRemaining = 0;
+        size_t pMaxChunk;
+
+        std::string pHeader;
+        std::string pData;
+        bool pKeep;
+        size_t pSize = 0;
+        uint32_t pCRC = 0;
+        uint32_t pChunks = 0;
+
+        // Collects a fixed-size prefix across feeds; true once it is complete
+        bool prefix(const uint8_t*& data, size_t& len, size_t want) {
+            while (pPrefixLen < want && len > 0) {
+                pPrefix[pPrefixLen++] = *data++;
+                len--;
+            }
+            if (pPrefixLen < want) return false;
+
+            pPrefixLen = 0;
+            return true;
+        }
+    public:
+        explicit framereceiver(size_t maxchunk, bool keep = false) : pMaxChunk(maxchunk), pKeep(keep) {}
+
+        bool Feed(const uint8_t* data, size_t len) {
+            while (len > 0 && pState != DONE && pState != FAILED) {
+                switch (pState) {
+                    case HEADERLENGTH: {
+                        if (!prefix(data, len, 4)) break;
+                        pRemaining = FileFrames::GetBE32(pPrefix);
+                        pState = pRemaining > 0 && pRemaining <= 1024 ? HEADER : FAILED;
+                    } break;
+
+                    case HEADER: {
+                        const size_t n = len < pRemaining ? len : pRemaining;
+                        pHeader.append((const char*)data, n);
+                        data += n;
+                        len -= n;
+                        if ((pRemaining -= n) == 0) pState = CHUNKLENGTH;
+                    } break;
+
+                    case CHUNKLENGTH: {
+                        if (!prefix(data, len, 4)) break;
+                        pRemaining = FileFrames::GetBE32(pPrefix);
+                        if (pRemaining == 0) pState = TRAILER;
+                        else pState = pRemaining <= pMaxChunk ? CHUNK : FAILED;
+                    } break;
+
+                    case CHUNK: {
+                        const size_t n = len < pRemaining ? len : pRemaining;
+                        pCRC = CRC32_Update(pCRC, data, n);
+                        pSize += n;
+                        if (pKeep) pData.append((const char*)data, n);
+                        data += n;
+                        len -= n;
+                        if ((pRemaining -= n) == 0) {
+                            pChunks++;
+                            pState = CHUNKLENGTH;
+                        }
+                    } break;
+
+                    case TRAILER: {
+                        if (!prefix(data, len, 8)) break;
+                        pState = FileFrames::GetBE32(pPrefix) == pSize && FileFrames::GetBE32(pPrefix + 4) == pCRC ? DONE : FAILED;
+                    } break;
+
+                    default: break;
+                }
+            }
+
+            // Bytes past the trailer are a protocol error too
+            if (pState == DONE && len > 0) pState = FAILED;
+            return pState != FAILED;
+        }
+
+        [[nodiscard]] States State() const noexcept { return pState; }
+        [[nodiscard]] bool Done() const noexcept { return pState == DONE; }
+        [[nodiscard]] const std::string& Header() const noexcept { return pHeader; }
+        [[nodiscard]] const std::string& Data() const noexcept { return pData; }
+        [[nodiscard]] size_t Size() const noexcept { return pSize; }
+        [[nodiscard]] uint32_t CRC() const noexcept { return pCRC; }
+        [[nodiscard]] uint32_t Chunks() const noexcept { return pChunks; }
+};
+
+#endif
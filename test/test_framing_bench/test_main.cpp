@@ -0,0 +1,266 @@
+// Host benchmark for the binary file transfer: pio test -e native -f test_framing_bench -v
+//
+// Streams a log-shaped source through the device's own FileFrames writer into a local receiver that parses the
+// frames in TCP-segment-sized pieces and checks the trailer. The base64 JSON variant repeats the legacy path's
+// 384-byte base64 chunks on the sender only, for the wire size and encode cost it is compared against. No socket is
+// involved: the numbers are the CPU and framing cost per transfer, not the network. Reports MB/s, wire overhead and
+// heap allocations per transfer.
+
+#include <Arduino.h>
+#include <NativeHeap.h>
+#include <unity.h>
+
+#include <cstdio>
+#include <string>
+
+#include "FileFrames.h"
+#include "FrameReceiver.h"
+
+static constexpr size_t SourceSize = 1024 * 1024;
+static constexpr uint32_t Transfers = 8;
+static constexpr size_t Segment = 1460;
+static constexpr size_t LegacyChunk = 384;
+
+static const String Header = "{\"Provider\":\"Orchestrator\",\"Command\":\"GetLog\",\"Parameter\":{\"MAC Address\":\"AA:BB:CC:DD:EE:FF\",\"Filename\":\"/log.txt\",\"Encoding\":\"binary\",\"Chunk\":4092}}";
+
+// Log-shaped text: timestamps, levels and a varying message, like the segments GetLog sends
+static std::string make_source(size_t size) {
+    static const char* const Levels[] = { "INFO", "WARN", "ERROR", "DEBUG" };
+    std::string out;
+    out.reserve(size + 128);
+
+    for (uint32_t n = 0; out.size() < size; n++) {
+        char line[128];
+        snprintf(line, sizeof(line), "2026-10-18 12:%02u:%02u.%03u [%s] Relay Kitchen %u changed state to %s\n",
+            (n / 60000) % 60, (n / 1000) % 60, n % 1000, Levels[n % 4], n % 8, n % 3 ? "on" : "off");
+        out += line;
+    }
+
+    out.resize(size);
+    return out;
+}
+
+static FileFrames::reader_t source_reader(const std::string& source, size_t& at) {
+    return [&source, &at](uint8_t* buffer, size_t len) -> size_t {
+        const size_t n = min(len, source.size() - at);
+        memcpy(buffer, source.data() + at, n);
+        at += n;
+        return n;
+    };
+}
+
+static size_t base64_encode(const uint8_t* in, size_t len, char* out) {
+    static const char Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char* p = out;
+
+    for (size_t i = 0; i < len; i += 3) {
+        const uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < len ? (uint32_t)in[i + 1] << 8 : 0) | (i + 2 < len ? in[i + 2] : 0);
+        *p++ = Alphabet[(v >> 18) & 0x3F];
+        *p++ = Alphabet[(v >> 12) & 0x3F];
+        *p++ = i + 1 < len ? Alphabet[(v >> 6) & 0x3F] : '=';
+        *p++ = i + 2 < len ? Alphabet[v & 0x3F] : '=';
+    }
+
+    return p - out;
+}
+
+static void report(const char* name, size_t bytes, size_t wire, uint32_t elapsed, uint32_t transfers, uint32_t allocations) {
+    char line[192];
+    snprintf(line, sizeof(line), "%-14s | %u x %u B, %.1f MB/s, wire %u B/transfer (%+.2f%%), %.1f allocs/transfer",
+        name, transfers, (unsigned)bytes, elapsed ? (double)bytes * transfers / elapsed : 0.0, (unsigned)wire,
+        (wire - (double)bytes) * 100.0 / bytes, (double)allocations / transfers);
+    TEST_MESSAGE(line);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_be32() {
+    uint8_t buf[4];
+    FileFrames::PutBE32(buf, 0x12345678);
+    TEST_ASSERT_EQUAL_UINT8(0x12, buf[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x78, buf[3]);
+    TEST_ASSERT_EQUAL_UINT32(0x12345678, FileFrames::GetBE32(buf));
+}
+
+static void test_crc32() {
+    // Standard CRC-32 check value, and the same result when fed in pieces
+    const uint8_t check[] = "123456789";
+    TEST_ASSERT_EQUAL_UINT32(0xCBF43926, CRC32_Update(0, check, 9));
+    TEST_ASSERT_EQUAL_UINT32(0xCBF43926, CRC32_Update(CRC32_Update(0, check, 4), check + 4, 5));
+    TEST_ASSERT_EQUAL_UINT32(0, CRC32_Update(0, check, 0));
+}
+
+static void test_loopback() {
+    const std::string source = make_source(10000);
+    size_t at = 0;
+    framereceiver receiver(100, true);
+
+    // Uneven pieces, so every prefix and the trailer get split somewhere
+    uint32_t piece = 0;
+    size_t size = 0;
+    uint32_t crc = 0;
+    TEST_ASSERT_TRUE(FileFrames::Write(Header, source_reader(source, at), [&](const uint8_t* data, size_t len) -> bool {
+        while (len > 0) {
+            const size_t n = min(len, (size_t)(1 + piece++ % 7));
+            if (!receiver.Feed(data, n)) return false;
+            data += n;
+            len -= n;
+        }
+        return true;
+    }, size, crc, 100));
+
+    TEST_ASSERT_TRUE(receiver.Done());
+    TEST_ASSERT_EQUAL_STRING(Header.c_str(), receiver.Header().c_str());
+    TEST_ASSERT_TRUE(receiver.Data() == source);
+    TEST_ASSERT_EQUAL_UINT32(100, receiver.Chunks());
+    TEST_ASSERT_EQUAL_UINT32(10000, size);
+    TEST_ASSERT_EQUAL_UINT32(CRC32_Update(0, (const uint8_t*)source.data(), source.size()), crc);
+    TEST_ASSERT_EQUAL_UINT32(crc, receiver.CRC());
+}
+
+static void test_empty_source() {
+    const std::string source;
+    size_t at = 0;
+    framereceiver receiver(FILEFRAMES_CHUNK);
+
+    size_t size = 1;
+    uint32_t crc = 1;
+    TEST_ASSERT_TRUE(FileFrames::Write(Header, source_reader(source, at), [&](const uint8_t* data, size_t len) -> bool { return receiver.Feed(data, len); }, size, crc));
+
+    TEST_ASSERT_TRUE(receiver.Done());
+    TEST_ASSERT_EQUAL_UINT32(0, size);
+    TEST_ASSERT_EQUAL_UINT32(0, crc);
+    TEST_ASSERT_EQUAL_UINT32(0, receiver.Chunks());
+}
+
+static void test_corruption() {
+    const std::string source = make_source(5000);
+
+    // One flipped data bit fails the trailer check
+    {
+        size_t at = 0;
+        framereceiver receiver(FILEFRAMES_CHUNK);
+        size_t size;
+        uint32_t crc;
+        bool flipped = false;
+
+        FileFrames::Write(Header, source_reader(source, at), [&](const uint8_t* data, size_t len) -> bool {
+            std::string copy((const char*)data, len);
+            if (!flipped && len > 1000) {
+                copy[50] ^= 0x01;
+                flipped = true;
+            }
+            receiver.Feed((const uint8_t*)copy.data(), copy.size());
+            return true;
+        }, size, crc);
+
+        TEST_ASSERT_TRUE(flipped);
+        TEST_ASSERT_TRUE(receiver.State() == framereceiver::FAILED);
+    }
+
+    // A chunk longer than the advertised limit is rejected as soon as its length arrives
+    {
+        size_t at = 0;
+        framereceiver receiver(64);
+        size_t size;
+        uint32_t crc;
+
+        TEST_ASSERT_FALSE(FileFrames::Write(Header, source_reader(source, at), [&](const uint8_t* data, size_t len) -> bool { return receiver.Feed(data, len); }, size, crc, 128));
+        TEST_ASSERT_TRUE(receiver.State() == framereceiver::FAILED);
+    }
+}
+
+static void test_write_failure() {
+    const std::string source = make_source(50000);
+    size_t at = 0;
+    size_t written = 0;
+    uint32_t writes = 0;
+    size_t size;
+    uint32_t crc;
+
+    // The peer goes away on the first chunk, after the header prefix and the header: nothing more is read or sent
+    TEST_ASSERT_FALSE(FileFrames::Write(Header, source_reader(source, at), [&](const uint8_t*, size_t len) -> bool {
+        if (++writes == 3) return false;
+        written += len;
+        return true;
+    }, size, crc, 1000));
+
+    TEST_ASSERT_EQUAL_UINT32(3, writes);
+    TEST_ASSERT_EQUAL_UINT32(1000, at);
+    TEST_ASSERT_EQUAL_UINT32(4 + Header.length(), written);
+}
+
+static void test_bench_binary() {
+    const std::string source = make_source(SourceSize);
+    size_t wire = 0;
+
+    NativeHeap.Mark();
+    const uint32_t start = micros();
+
+    for (uint32_t t = 0; t < Transfers; t++) {
+        size_t at = 0;
+        framereceiver receiver(FILEFRAMES_CHUNK);
+        size_t size;
+        uint32_t crc;
+        wire = 0;
+
+        // The receiver gets the stream one TCP segment at a time
+        TEST_ASSERT_TRUE(FileFrames::Write(Header, source_reader(source, at), [&](const uint8_t* data, size_t len) -> bool {
+            wire += len;
+            for (size_t n; len > 0; data += n, len -= n) {
+                n = min(len, Segment);
+                if (!receiver.Feed(data, n)) return false;
+            }
+            return true;
+        }, size, crc));
+
+        TEST_ASSERT_TRUE(receiver.Done());
+        TEST_ASSERT_EQUAL_UINT32(SourceSize, receiver.Size());
+    }
+
+    const uint32_t elapsed = micros() - start;
+    report("Binary frames", SourceSize, wire, elapsed, Transfers, NativeHeap.Allocations);
+}
+
+static void test_bench_base64() {
+    const std::string source = make_source(SourceSize);
+    char out[LegacyChunk / 3 * 4 + 4];
+    size_t wire = 0;
+
+    NativeHeap.Mark();
+    const uint32_t start = micros();
+
+    for (uint32_t t = 0; t < Transfers; t++) {
+        uint32_t crc = 0;
+        wire = Header.length() + 32;
+
+        // Sender side of the legacy path: CRC and base64 per chunk, the receiver would still have to decode it
+        for (size_t at = 0; at < source.size(); at += LegacyChunk) {
+            const size_t n = min(LegacyChunk, source.size() - at);
+            crc = CRC32_Update(crc, (const uint8_t*)source.data() + at, n);
+            wire += base64_encode((const uint8_t*)source.data() + at, n, out);
+        }
+
+        TEST_ASSERT_EQUAL_UINT32(CRC32_Update(0, (const uint8_t*)source.data(), source.size()), crc);
+    }
+
+    const uint32_t elapsed = micros() - start;
+    report("Base64 JSON", SourceSize, wire, elapsed, Transfers, NativeHeap.Allocations);
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_be32);
+    RUN_TEST(test_crc32);
+    RUN_TEST(test_loopback);
+    RUN_TEST(test_empty_source);
+    RUN_TEST(test_corruption);
+    RUN_TEST(test_write_failure);
+
+    RUN_TEST(test_bench_binary);
+    RUN_TEST(test_bench_base64);
+
+    return UNITY_END();
+}
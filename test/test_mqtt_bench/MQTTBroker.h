@@ -0,0 +1,284 @@
+#ifndef MQTTBroker_h
+#define MQTTBroker_h
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Minimal in-process MQTT 3.1.1 broker stand-in for the host benchmark: CONNECT, SUBSCRIBE with + and # filters,
+// QoS 0 PUBLISH with retained messages, PINGREQ and DISCONNECT. Clients hand it encoded packets through byte queues,
+// so every message crosses the same wire format it would against the production broker.
+
+namespace mqttwire {
+    enum PacketTypes : uint8_t {
+        CONNECT = 1, CONNACK = 2, PUBLISH = 3, SUBSCRIBE = 8, SUBACK = 9, PINGREQ = 12, PINGRESP = 13, DISCONNECT = 14
+    };
+
+    struct packet_t {
+        uint8_t Type = 0;
+        uint8_t Flags = 0;
+        std::string Body;
+    };
+
+    inline void putLength(std::string& out, size_t length) {
+        do {
+            uint8_t b = length % 128;
+            length /= 128;
+            if (length > 0) b |= 0x80;
+            out += (char)b;
+        } while (length > 0);
+    }
+
+    inline void putString(std::string& out, const std::string& s) {
+        out += (char)(s.size() >> 8);
+        out += (char)(s.size() & 0xFF);
+        out += s;
+    }
+
+    inline uint16_t getU16(const std::string& s, size_t at) {
+        return (uint16_t)(((uint8_t)s[at] << 8) | (uint8_t)s[at + 1]);
+    }
+
+    inline std::string Frame(uint8_t type, uint8_t flags, const std::string& body) {
+        std::string out;
+        out += (char)((type << 4) | flags);
+        putLength(out, body.size());
+        out += body;
+        return out;
+    }
+
+    inline std::string Connect(const std::string& clientid, uint16_t keepalive) {
+        std::string body;
+        putString(body, "MQTT");
+        body += (char)4;        // Protocol level 3.1.1
+        body += (char)0x02;     // Clean session
+        body += (char)(keepalive >> 8);
+        body += (char)(keepalive & 0xFF);
+        putString(body, clientid);
+        return Frame(CONNECT, 0, body);
+    }
+
+    inline std::string Subscribe(uint16_t id, const std::string& filter) {
+        std::string body;
+        body += (char)(id >> 8);
+        body += (char)(id & 0xFF);
+        putString(body, filter);
+        body += (char)0;        // QoS 0
+        return Frame(SUBSCRIBE, 0x02, body);
+    }
+
+    inline std::string Publish(const std::string& topic, const std::string& payload, bool retained) {
+        std::string body;
+        putString(body, topic);
+        body += payload;
+        return Frame(PUBLISH, retained ? 0x01 : 0x00, body);
+    }
+
+    inline std::string Ping() { return Frame(PINGREQ, 0, ""); }
+    inline std::string Disconnect() { return Frame(DISCONNECT, 0, ""); }
+
+    // Takes one complete packet off the front of the queue; false while it is still incomplete
+    inline bool Take(std::string& queue, packet_t& packet) {
+        size_t length = 0;
+        size_t pos = 1;
+
+        for (uint32_t multiplier = 1; ; multiplier *= 128, pos++) {
+            if (pos >= queue.size() || pos > 4) return false;
+
+            length += ((uint8_t)queue[pos] & 0x7F) * multiplier;
+            if (((uint8_t)queue[pos] & 0x80) == 0) break;
+        }
+        pos++;
+
+        if (queue.size() < pos + length) return false;
+
+        packet.Type = (uint8_t)queue[0] >> 4;
+        packet.Flags = (uint8_t)queue[0] & 0x0F;
+        packet.Body.assign(queue, pos, length);
+        queue.erase(0, pos + length);
+        return true;
+    }
+
+    inline bool SplitPublish(const packet_t& packet, std::string& topic, std::string& payload) {
+        if (packet.Type != PUBLISH || packet.Body.size() < 2) return false;
+
+        size_t length = getU16(packet.Body, 0);
+        size_t at = 2 + length + (((packet.Flags >> 1) & 0x03) ? 2 : 0);
+        if (packet.Body.size() < at) return false;
+
+        topic.assign(packet.Body, 2, length);
+        payload.assign(packet.Body, at, std::string::npos);
+        return true;
+    }
+}
+
+class mqttbroker {
+    private:
+        struct session_t {
+            bool Open = false;
+            bool Connected = false;
+            std::vector<std::string> Filters;
+            std::string In;
+            std::string Out;
+        };
+
+        std::vector<session_t> pSessions;
+        std::map<std::string, std::string> pRetained;
+        uint32_t pRouted = 0;
+        uint32_t pConnects = 0;
+
+        void deliver(session_t& session, const std::string& topic, const std::string& payload, bool retained) {
+            for (auto& filter : session.Filters) {
+                if (!Matches(filter, topic)) continue;
+
+                session.Out += mqttwire::Publish(topic, payload, retained);
+                pRouted++;
+                return;
+            }
+        }
+
+        void handle(size_t id, const mqttwire::packet_t& packet) {
+            session_t& session = pSessions[id];
+
+            if (!session.Connected && packet.Type != mqttwire::CONNECT) {
+                Drop(id);
+                return;
+            }
+
+            switch (packet.Type) {
+                case mqttwire::CONNECT: {
+                    const bool valid = packet.Body.size() >= 10 && packet.Body.compare(0, 6, std::string("\x00\x04MQTT", 6)) == 0 && packet.Body[6] == 4;
+
+                    session.Out += mqttwire::Frame(mqttwire::CONNACK, 0, std::string("\x00", 1) + (char)(valid ? 0x00 : 0x01));
+                    if (!valid) {
+                        Drop(id);
+                        return;
+                    }
+
+                    session.Connected = true;
+                    pConnects++;
+                } break;
+
+                case mqttwire::SUBSCRIBE: {
+                    std::string ack = packet.Body.substr(0, 2);
+                    std::vector<std::string> added;
+
+                    for (size_t at = 2; at + 2 <= packet.Body.size(); ) {
+                        size_t length = mqttwire::getU16(packet.Body, at);
+                        added.push_back(packet.Body.substr(at + 2, length));
+                        at += 2 + length + 1;
+                        ack += (char)0x00;
+                    }
+
+                    session.Out += mqttwire::Frame(mqttwire::SUBACK, 0, ack);
+                    for (auto& filter : added) session.Filters.push_back(filter);
+
+                    // Retained messages go to a new subscription straight away, as a real broker would
+                    for (auto& m : pRetained) {
+                        for (auto& filter : added) {
+                            if (!Matches(filter, m.first)) continue;
+
+                            session.Out += mqttwire::Publish(m.first, m.second, true);
+                            pRouted++;
+                            break;
+                        }
+                    }
+                } break;
+
+                case mqttwire::PUBLISH: {
+                    std::string topic, payload;
+                    if (!mqttwire::SplitPublish(packet, topic, payload)) break;
+
+                    if (packet.Flags & 0x01) {
+                        if (payload.empty()) pRetained.erase(topic);
+                        else pRetained[topic] = payload;
+                    }
+
+                    for (auto& m : pSessions) {
+                        if (m.Connected) deliver(m, topic, payload, false);
+                    }
+                } break;
+
+                case mqttwire::PINGREQ: {
+                    session.Out += mqttwire::Frame(mqttwire::PINGRESP, 0, "");
+                } break;
+
+                case mqttwire::DISCONNECT: {
+                    Drop(id);
+                } break;
+
+                default: {
+                    Drop(id);
+                } break;
+            }
+        }
+    public:
+        size_t Attach() {
+            pSessions.emplace_back();
+            pSessions.back().Open = true;
+            return pSessions.size() - 1;
+        }
+
+        // The connection is gone; with a clean session its subscriptions go with it
+        void Drop(size_t id) {
+            session_t& session = pSessions[id];
+            session.Open = false;
+            session.Connected = false;
+            session.Filters.clear();
+            session.In.clear();
+        }
+
+        void Reopen(size_t id) {
+            pSessions[id].Open = true;
+            pSessions[id].Out.clear();
+        }
+
+        void Write(size_t id, const std::string& bytes) {
+            session_t& session = pSessions[id];
+            if (!session.Open) return;
+
+            session.In += bytes;
+
+            mqttwire::packet_t packet;
+            while (pSessions[id].Open && mqttwire::Take(pSessions[id].In, packet)) handle(id, packet);
+        }
+
+        std::string Read(size_t id) {
+            std::string out;
+            out.swap(pSessions[id].Out);
+            return out;
+        }
+
+        [[nodiscard]] bool Connected(size_t id) const { return pSessions[id].Connected; }
+        [[nodiscard]] uint32_t Routed() const noexcept { return pRouted; }
+        [[nodiscard]] uint32_t Connects() const noexcept { return pConnects; }
+
+        static std::vector<std::string> Levels(const std::string& s) {
+            std::vector<std::string> levels;
+            size_t from = 0;
+
+            for (size_t at; (at = s.find('/', from)) != std::string::npos; from = at + 1) levels.push_back(s.substr(from, at - from));
+            levels.push_back(s.substr(from));
+
+            return levels;
+        }
+
+        static bool Matches(const std::string& filter, const std::string& topic) {
+            const auto f = Levels(filter);
+            const auto t = Levels(topic);
+
+            for (size_t i = 0; i < f.size(); i++) {
+                // '#' also matches the parent level: a/# matches a
+                if (f[i] == "#") return true;
+                if (i >= t.size()) return false;
+                if (f[i] != "+" && f[i] != t[i]) return false;
+            }
+
+            return f.size() == t.size();
+        }
+};
+
+#endif
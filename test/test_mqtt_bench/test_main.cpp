@@ -0,0 +1,394 @@
+// Host benchmark for the MQTT link: pio test -e native -f test_mqtt_bench -v
+//
+// Replays synthetic Set and Get workloads and broker reconnects through an in-process MQTT 3.1.1 broker stand-in,
+// running the device's own topic table, Set parser, payload encoder and latency histogram. The client library and
+// the radio are not part of it: the numbers are the device-side cost per message plus the wire format, not the
+// network. Reports msg/s, p50/p99 and heap per workload.
+
+#include <Arduino.h>
+#include <NativeHeap.h>
+#include <unity.h>
+
+#include <vector>
+
+#include "MQTTBroker.h"
+#include "MQTTTopics.h"
+#include "Stats.h"
+
+static const String Hostname = "bench-device";
+static constexpr uint8_t RelayCount = 8;
+static constexpr uint32_t SetRounds = 20000;
+static constexpr uint32_t GetRounds = 20000;
+static constexpr uint32_t GetBatch = 16;
+static constexpr uint32_t Reconnects = 2000;
+
+// Stands in for the device: main.cpp's Set callback and mqttlink's publish path, on the real mqtttopics
+class benchdevice {
+    private:
+        mqttbroker& pBroker;
+        size_t pSession;
+        mqtttopics pTopics;
+        bool pAliases;
+        bool pCompact;
+
+        std::vector<String> pRelayNames;
+        std::vector<bool> pRelayStates;
+        std::vector<uint16_t> pRelayAliases;
+        uint16_t pTemperature = 0;
+
+        uint32_t pPublishedBytes = 0;
+        uint32_t pAllocations = 0;
+
+        void publish(const String& topic, const String& payload, bool retained = false) {
+            pBroker.Write(pSession, mqttwire::Publish(topic.c_str(), payload.c_str(), retained));
+            pPublishedBytes += topic.length() + payload.length();
+        }
+
+        void publish(uint16_t alias, const String& payload) {
+            if (!pTopics.Valid(alias)) return;
+            publish(pAliases ? pTopics.AliasTopic(alias) : pTopics.Topic(alias), payload);
+        }
+
+        // Same shape as main.cpp's relay branch; the command bus hop is replaced by applying in place
+        void set(const String& topic, const String& payload) {
+            mqtt_set_t set;
+            if (!mqtttopics::ParseSet(topic, Hostname + "/Set/", payload, set)) return;
+
+            for (size_t i = 0; i < pRelayNames.size(); i++) {
+                if (pRelayNames[i] != set.Name) continue;
+                if (!set.Class.equalsIgnoreCase("relay") || set.Property != "state") return;
+
+                if (set.Payload == "on" || set.Payload == "true" || set.Payload == "1") pRelayStates[i] = true;
+                else if (set.Payload == "off" || set.Payload == "false" || set.Payload == "0") pRelayStates[i] = false;
+                else return;
+
+                publish(pRelayAliases[i], pRelayStates[i] ? "on" : "off");
+                return;
+            }
+        }
+    public:
+        benchdevice(mqttbroker& broker, bool aliases, bool compact) : pBroker(broker), pSession(broker.Attach()), pAliases(aliases), pCompact(compact) {
+            // Registration order follows Settings::Load
+            for (uint8_t i = 0; i < RelayCount; i++) {
+                pRelayNames.push_back("Relay" + String(i + 1));
+                pRelayStates.push_back(false);
+                pRelayAliases.push_back(pTopics.Register(Hostname + "/Get/Relay:" + pRelayNames.back() + ":State", Hostname));
+            }
+            pTemperature = pTopics.Register(Hostname + "/Get/Thermometer:Room:Temperature", Hostname);
+            pTopics.Register(Hostname + "/Get/Thermometer:Room:Humidity", Hostname);
+        }
+
+        // Connect, subscribe and, in alias mode, the retained alias map, as mqttlink::connected() does. The map is
+        // built by hand here; the device serializes the same document with ArduinoJson.
+        bool Connect() {
+            pBroker.Reopen(pSession);
+            pBroker.Write(pSession, mqttwire::Connect(Hostname.c_str(), 60));
+            pBroker.Write(pSession, mqttwire::Subscribe(1, (Hostname + "/Set/#").c_str()));
+
+            if (pAliases) {
+                String map = "{";
+                for (uint16_t i = 1; i <= pTopics.Count(); i++) {
+                    if (i > 1) map += ",";
+                    map += "\"" + String(i) + "\":\"" + pTopics.Topic(i) + "\"";
+                }
+                map += "}";
+
+                publish(Hostname + "/Aliases", map, true);
+            }
+
+            std::string in = pBroker.Read(pSession);
+            mqttwire::packet_t packet;
+
+            bool connack = false, suback = false;
+            while (mqttwire::Take(in, packet)) {
+                if (packet.Type == mqttwire::CONNACK) connack = packet.Body.size() == 2 && packet.Body[1] == 0;
+                if (packet.Type == mqttwire::SUBACK) suback = true;
+            }
+
+            return connack && suback && pBroker.Connected(pSession);
+        }
+
+        void Drop() { pBroker.Drop(pSession); }
+
+        // One pass of the client's Control(): everything the broker delivered since the last one
+        void Poll() {
+            const uint32_t allocations = NativeHeap.Allocations;
+
+            std::string in = pBroker.Read(pSession);
+            mqttwire::packet_t packet;
+            std::string topic, payload;
+
+            while (mqttwire::Take(in, packet)) {
+                if (mqttwire::SplitPublish(packet, topic, payload)) set(topic.c_str(), payload.c_str());
+            }
+
+            pAllocations += NativeHeap.Allocations - allocations;
+        }
+
+        void PublishTemperature(float value) {
+            const uint32_t allocations = NativeHeap.Allocations;
+            publish(pTemperature, pCompact ? mqtttopics::CompactNumber(value) : String(value));
+            pAllocations += NativeHeap.Allocations - allocations;
+        }
+
+        [[nodiscard]] const String& RelayTopic(uint8_t relay) const { return pAliases ? pTopics.AliasTopic(pRelayAliases[relay]) : pTopics.Topic(pRelayAliases[relay]); }
+        [[nodiscard]] const String& TemperatureTopic() const { return pAliases ? pTopics.AliasTopic(pTemperature) : pTopics.Topic(pTemperature); }
+
+        [[nodiscard]] uint32_t PublishedBytes() const noexcept { return pPublishedBytes; }
+        [[nodiscard]] uint32_t Allocations() const noexcept { return pAllocations; }
+};
+
+// The other end: what the orchestrator or a home automation hub sees
+class benchcontroller {
+    private:
+        mqttbroker& pBroker;
+        size_t pSession;
+    public:
+        explicit benchcontroller(mqttbroker& broker) : pBroker(broker), pSession(broker.Attach()) {
+            pBroker.Write(pSession, mqttwire::Connect("bench-controller", 60));
+            pBroker.Write(pSession, mqttwire::Subscribe(1, (Hostname + "/Get/#").c_str()));
+            pBroker.Write(pSession, mqttwire::Subscribe(2, (Hostname + "/A/#").c_str()));
+            pBroker.Read(pSession);
+        }
+
+        void Set(const String& topic, const String& payload) {
+            pBroker.Write(pSession, mqttwire::Publish(topic.c_str(), payload.c_str(), false));
+        }
+
+        // Returns the number of messages received, and the last one's topic and payload
+        uint32_t Receive(std::string& topic, std::string& payload) {
+            std::string in = pBroker.Read(pSession);
+            mqttwire::packet_t packet;
+            uint32_t count = 0;
+
+            while (mqttwire::Take(in, packet)) {
+                if (mqttwire::SplitPublish(packet, topic, payload)) count++;
+            }
+
+            return count;
+        }
+};
+
+// Allocations are the device side's only; the peak heap covers the whole harness, broker included
+static void report(const char* workload, uint32_t messages, uint32_t elapsedus, const LatencyStats& latency, uint32_t allocations, size_t peak, double bytes) {
+    char line[256];
+    snprintf(line, sizeof(line), "%-14s | %u msgs, %.0f msg/s, p50=%u p99=%u max=%u us, %.2f device allocs/msg, peak heap %u B, %.1f B/publish",
+        workload, (unsigned)messages, messages * 1e6 / max<uint32_t>(elapsedus, 1), (unsigned)latency.Percentile(50), (unsigned)latency.Percentile(99),
+        (unsigned)latency.Max(), messages ? (double)allocations / messages : 0.0, (unsigned)peak, bytes);
+    TEST_MESSAGE(line);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_compact_number() {
+    TEST_ASSERT_EQUAL_STRING("21.5", mqtttopics::CompactNumber(21.5f).c_str());
+    TEST_ASSERT_EQUAL_STRING("21.25", mqtttopics::CompactNumber(21.25f).c_str());
+    TEST_ASSERT_EQUAL_STRING("20", mqtttopics::CompactNumber(20.0f).c_str());
+    TEST_ASSERT_EQUAL_STRING("0.1", mqtttopics::CompactNumber(0.1f).c_str());
+    TEST_ASSERT_EQUAL_STRING("-3.5", mqtttopics::CompactNumber(-3.5f).c_str());
+    TEST_ASSERT_EQUAL_STRING("0", mqtttopics::CompactNumber(-0.001f).c_str());
+}
+
+static void test_parse_set() {
+    const String prefix = Hostname + "/Set/";
+    mqtt_set_t set;
+
+    TEST_ASSERT_TRUE(mqtttopics::ParseSet(prefix + "Relay:Kitchen:State", prefix, " ON ", set));
+    TEST_ASSERT_EQUAL_STRING("Relay", set.Class.c_str());
+    TEST_ASSERT_EQUAL_STRING("Kitchen", set.Name.c_str());
+    TEST_ASSERT_EQUAL_STRING("state", set.Property.c_str());
+    TEST_ASSERT_EQUAL_STRING("on", set.Payload.c_str());
+
+    // Anything after the first level below Set/ is ignored
+    TEST_ASSERT_TRUE(mqtttopics::ParseSet(prefix + "Blinds: Hall :Position/extra", prefix, "40", set));
+    TEST_ASSERT_EQUAL_STRING("Hall", set.Name.c_str());
+    TEST_ASSERT_EQUAL_STRING("position", set.Property.c_str());
+
+    TEST_ASSERT_FALSE(mqtttopics::ParseSet("other/Set/Relay:Kitchen:State", prefix, "on", set));
+    TEST_ASSERT_FALSE(mqtttopics::ParseSet(prefix + "Relay:Kitchen", prefix, "on", set));
+    TEST_ASSERT_FALSE(mqtttopics::ParseSet(prefix + "Relay::State", prefix, "on", set));
+    TEST_ASSERT_FALSE(mqtttopics::ParseSet(prefix + ":Kitchen:State", prefix, "on", set));
+    TEST_ASSERT_FALSE(mqtttopics::ParseSet(prefix + "Relay:Kitchen:", prefix, "on", set));
+}
+
+static void test_topic_aliases() {
+    mqtttopics topics;
+
+    TEST_ASSERT_EQUAL_UINT16(1, topics.Register(Hostname + "/Get/Relay:A:State", Hostname));
+    TEST_ASSERT_EQUAL_UINT16(2, topics.Register(Hostname + "/Get/Relay:B:State", Hostname));
+    TEST_ASSERT_EQUAL_UINT16(1, topics.Register(Hostname + "/Get/Relay:A:State", Hostname));
+    TEST_ASSERT_EQUAL_UINT32(2, topics.Count());
+
+    TEST_ASSERT_FALSE(topics.Valid(0));
+    TEST_ASSERT_FALSE(topics.Valid(3));
+    TEST_ASSERT_EQUAL_STRING("bench-device/A/2", topics.AliasTopic(2).c_str());
+    TEST_ASSERT_EQUAL_STRING("bench-device/Get/Relay:B:State", topics.Topic(2).c_str());
+
+    topics.Clear();
+    TEST_ASSERT_EQUAL_UINT32(0, topics.Count());
+    TEST_ASSERT_EQUAL_UINT16(1, topics.Register(Hostname + "/Get/Relay:B:State", Hostname));
+}
+
+static void test_latency_stats() {
+    LatencyStats stats;
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Percentile(50));
+
+    for (uint32_t us = 1; us <= 1000; us++) stats.Add(us);
+
+    TEST_ASSERT_EQUAL_UINT32(1000, stats.Count());
+    TEST_ASSERT_EQUAL_UINT32(1, stats.Min());
+    TEST_ASSERT_EQUAL_UINT32(1000, stats.Max());
+    TEST_ASSERT_EQUAL_UINT32(500, stats.Avg());
+
+    // Upper bound of the bucket the rank falls in, never above the largest sample
+    TEST_ASSERT_EQUAL_UINT32(511, stats.Percentile(50));
+    TEST_ASSERT_EQUAL_UINT32(1000, stats.Percentile(99));
+
+    stats.Reset();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Count());
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Min());
+}
+
+static void test_broker_filters() {
+    TEST_ASSERT_TRUE(mqttbroker::Matches("h/Set/#", "h/Set/Relay:A:State"));
+    TEST_ASSERT_TRUE(mqttbroker::Matches("h/Set/#", "h/Set"));
+    TEST_ASSERT_TRUE(mqttbroker::Matches("h/+/x", "h/A/x"));
+    TEST_ASSERT_FALSE(mqttbroker::Matches("h/+/x", "h/A/y"));
+    TEST_ASSERT_FALSE(mqttbroker::Matches("h/+", "h"));
+    TEST_ASSERT_FALSE(mqttbroker::Matches("h/Get/#", "h/Set/Relay:A:State"));
+    TEST_ASSERT_FALSE(mqttbroker::Matches("h/A", "h/A/1"));
+}
+
+// Set -> device -> state publish -> controller, one round trip at a time
+static void runSet(const char* workload, bool aliases) {
+    mqttbroker broker;
+    benchdevice device(broker, aliases, true);
+    benchcontroller controller(broker);
+    TEST_ASSERT_TRUE(device.Connect());
+
+    LatencyStats latency;
+    std::string topic, payload;
+    const uint32_t routed = broker.Routed();
+    const uint32_t bytes = device.PublishedBytes();
+
+    NativeHeap.Mark();
+    const uint32_t start = micros();
+
+    for (uint32_t i = 0; i < SetRounds; i++) {
+        const uint8_t relay = i % RelayCount;
+        const bool on = (i / RelayCount) % 2 == 0;
+
+        const uint32_t t0 = micros();
+        controller.Set(Hostname + "/Set/Relay:Relay" + String(relay + 1) + ":State", on ? "on" : "off");
+        device.Poll();
+        const uint32_t received = controller.Receive(topic, payload);
+        latency.Add(micros() - t0);
+
+        TEST_ASSERT_EQUAL_UINT32(1, received);
+        TEST_ASSERT_EQUAL_STRING(device.RelayTopic(relay).c_str(), topic.c_str());
+        TEST_ASSERT_EQUAL_STRING(on ? "on" : "off", payload.c_str());
+    }
+
+    const uint32_t elapsed = micros() - start;
+    TEST_ASSERT_EQUAL_UINT32(SetRounds * 2, broker.Routed() - routed);
+
+    // Each round trip is two messages: the Set and the state it caused
+    report(workload, SetRounds * 2, elapsed, latency, device.Allocations(), NativeHeap.Peak, (double)(device.PublishedBytes() - bytes) / SetRounds);
+}
+
+// Sensor readings -> controller, drained a batch at a time like the client does between loop() passes
+static void runGet(const char* workload, bool aliases, bool compact) {
+    mqttbroker broker;
+    benchdevice device(broker, aliases, compact);
+    benchcontroller controller(broker);
+    TEST_ASSERT_TRUE(device.Connect());
+
+    LatencyStats latency;
+    std::string topic, payload;
+    uint32_t received = 0;
+    const uint32_t bytes = device.PublishedBytes();
+
+    NativeHeap.Mark();
+    const uint32_t start = micros();
+
+    for (uint32_t i = 0; i < GetRounds; i += GetBatch) {
+        uint32_t sent[GetBatch];
+        uint32_t n = 0;
+
+        for (uint32_t j = i; j < i + GetBatch && j < GetRounds; j++, n++) {
+            sent[n] = micros();
+            device.PublishTemperature(20.0f + (j % 300) * 0.01f);
+        }
+        received += controller.Receive(topic, payload);
+
+        // Publish to delivery, for every reading in the batch
+        const uint32_t now = micros();
+        for (uint32_t k = 0; k < n; k++) latency.Add(now - sent[k]);
+    }
+
+    const uint32_t elapsed = micros() - start;
+    TEST_ASSERT_EQUAL_UINT32(GetRounds, received);
+    TEST_ASSERT_EQUAL_STRING(device.TemperatureTopic().c_str(), topic.c_str());
+
+    report(workload, GetRounds, elapsed, latency, device.Allocations(), NativeHeap.Peak, (double)(device.PublishedBytes() - bytes) / GetRounds);
+}
+
+static void test_set_full_topics() { runSet("Set", false); }
+static void test_set_aliases() { runSet("Set aliased", true); }
+static void test_get_full_topics() { runGet("Get", false, false); }
+static void test_get_aliases_compact() { runGet("Get aliased", true, true); }
+
+// Broker drops the device and it comes back: CONNECT, SUBSCRIBE and the retained alias map, then a Set must work
+static void test_reconnect() {
+    mqttbroker broker;
+    benchdevice device(broker, true, true);
+    benchcontroller controller(broker);
+    TEST_ASSERT_TRUE(device.Connect());
+
+    LatencyStats latency;
+    std::string topic, payload;
+
+    NativeHeap.Mark();
+    const uint32_t start = micros();
+
+    for (uint32_t i = 0; i < Reconnects; i++) {
+        device.Drop();
+
+        // Nothing reaches a dropped session
+        controller.Set(Hostname + "/Set/Relay:Relay1:State", "on");
+        device.Poll();
+        controller.Receive(topic, payload);
+
+        const uint32_t t0 = micros();
+        TEST_ASSERT_TRUE(device.Connect());
+        latency.Add(micros() - t0);
+
+        controller.Set(Hostname + "/Set/Relay:Relay1:State", (i % 2) ? "on" : "off");
+        device.Poll();
+        TEST_ASSERT_EQUAL_UINT32(1, controller.Receive(topic, payload));
+    }
+
+    const uint32_t elapsed = micros() - start;
+    TEST_ASSERT_EQUAL_UINT32(Reconnects + 1, broker.Connects() - 1);
+
+    report("Reconnect", Reconnects, elapsed, latency, device.Allocations(), NativeHeap.Peak, 0.0);
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_compact_number);
+    RUN_TEST(test_parse_set);
+    RUN_TEST(test_topic_aliases);
+    RUN_TEST(test_latency_stats);
+    RUN_TEST(test_broker_filters);
+
+    RUN_TEST(test_set_full_topics);
+    RUN_TEST(test_set_aliases);
+    RUN_TEST(test_get_full_topics);
+    RUN_TEST(test_get_aliases_compact);
+    RUN_TEST(test_reconnect);
+
+    return UNITY_END();
+}
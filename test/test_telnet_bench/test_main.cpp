@@ -0,0 +1,212 @@
+// Host benchmark for the telnet command path: pio test -e native -f test_telnet_bench -v
+//
+// Runs the server's own line tokenizer and sorted command table over a replayed command mix, the part of every
+// dispatch that does not depend on the network. The String slot variant repeats the copy the compatibility
+// onCommand path still does, for comparison; tokens this short stay in the small string buffer, so the gap is the
+// copy rather than the heap. Reports lines/s, ns/line and heap allocations per line.
+
+#include <Arduino.h>
+#include <NativeHeap.h>
+#include <unity.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "AsyncTelnetCommand.h"
+
+static constexpr uint32_t Rounds = 200000;
+
+static const char* const Commands[] = {
+    "clear", "exit", "sessions", "whoami", "help", "echo", "logon", "network", "ntp", "ping", "telnet", "webserver",
+    "mqtt", "user", "comp", "log", "reboot", "restart", "status", "uptime", "heap", "tasks", "config", "save",
+    "load", "reset", "time", "wifi", "scan", "version"
+};
+
+static const char* const Lines[] = {
+    "comp set Relay Kitchen State on",
+    "  log tail 20  ",
+    "mqtt status",
+    "help comp",
+    "network",
+    "ping   192.168.1.1 4",
+    "comp list",
+    "user add guest secret",
+    "unknown command here",
+    "log level mqtt debug",
+};
+
+static void register_commands(AsyncTelnetCommandList& list, std::vector<AsyncTelnetCommand>& storage) {
+    storage.clear();
+    storage.reserve(sizeof(Commands) / sizeof(Commands[0]));
+
+    for (const char* name : Commands) {
+        storage.push_back({name, "", nullptr, false, nullptr, false});
+        list.Add(&storage.back());
+    }
+}
+
+static void report(const char* name, uint32_t lines, uint32_t elapsed, uint32_t allocations) {
+    char line[160];
+    snprintf(line, sizeof(line), "%-14s | %u lines, %.0f lines/s, %.1f ns/line, %.3f allocs/line",
+        name, lines, elapsed ? lines * 1e6 / elapsed : 0.0, elapsed * 1000.0 / lines, (double)allocations / lines);
+    TEST_MESSAGE(line);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_trim() {
+    char a[] = "   help  ";
+    TEST_ASSERT_EQUAL_STRING("help", AsyncTelnetArgs::Trim(a));
+
+    char b[] = "     ";
+    TEST_ASSERT_EQUAL_STRING("", AsyncTelnetArgs::Trim(b));
+
+    char c[] = "";
+    TEST_ASSERT_EQUAL_STRING("", AsyncTelnetArgs::Trim(c));
+}
+
+static void test_split() {
+    AsyncTelnetArgs args;
+
+    char a[] = "comp  set Relay   Kitchen";
+    TEST_ASSERT_EQUAL_STRING("comp", args.Split(a));
+    TEST_ASSERT_EQUAL_UINT8(3, args.Count);
+    TEST_ASSERT_EQUAL_STRING("set", args[0]);
+    TEST_ASSERT_EQUAL_STRING("Relay", args[1]);
+    TEST_ASSERT_EQUAL_STRING("Kitchen", args[2]);
+
+    // A reused instance starts over, and missing parameters read as ""
+    char b[] = "help";
+    TEST_ASSERT_EQUAL_STRING("help", args.Split(b));
+    TEST_ASSERT_EQUAL_UINT8(0, args.Count);
+    TEST_ASSERT_EQUAL_STRING("", args[0]);
+    TEST_ASSERT_TRUE(args.Empty(0));
+}
+
+static void test_split_cap() {
+    AsyncTelnetArgs args;
+
+    char line[] = "cmd 1 2 3 4 5 6 7 8 9 10 11 12";
+    TEST_ASSERT_EQUAL_STRING("cmd", args.Split(line));
+    TEST_ASSERT_EQUAL_UINT8(ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS, args.Count);
+    TEST_ASSERT_EQUAL_STRING("10", args[ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS - 1]);
+    TEST_ASSERT_EQUAL_STRING("", args[ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS]);
+}
+
+static void test_is_empty() {
+    AsyncTelnetArgs args;
+
+    char line[] = "log LEVEL Debug";
+    args.Split(line);
+    TEST_ASSERT_TRUE(args.Is(0, "level"));
+    TEST_ASSERT_TRUE(args.Is(1, "debug"));
+    TEST_ASSERT_FALSE(args.Is(1, "info"));
+    TEST_ASSERT_FALSE(args.Empty(1));
+    TEST_ASSERT_TRUE(args.Empty(2));
+    TEST_ASSERT_TRUE(args.Is(2, ""));
+}
+
+static void test_command_list() {
+    AsyncTelnetCommandList list;
+    std::vector<AsyncTelnetCommand> storage;
+    register_commands(list, storage);
+
+    TEST_ASSERT_EQUAL_UINT32(sizeof(Commands) / sizeof(Commands[0]), list.size());
+    for (size_t i = 1; i < list.size(); i++) TEST_ASSERT_TRUE(strcmp(list[i - 1]->Command.c_str(), list[i]->Command.c_str()) < 0);
+
+    for (const char* name : Commands) {
+        AsyncTelnetCommand* cmd = list.Find(name);
+        TEST_ASSERT_NOT_NULL(cmd);
+        TEST_ASSERT_EQUAL_STRING(name, cmd->Command.c_str());
+    }
+
+    TEST_ASSERT_NULL(list.Find("unknown"));
+    TEST_ASSERT_NULL(list.Find(""));
+    TEST_ASSERT_NULL(list.Find("com"));
+
+    // A name registered twice keeps its first entry
+    AsyncTelnetCommand duplicate = {"comp", "second", nullptr, true, nullptr, false};
+    AsyncTelnetCommand* first = list.Find("comp");
+    list.Add(&duplicate);
+    TEST_ASSERT_TRUE(list.Find("comp") == first);
+}
+
+static void test_bench_args() {
+    AsyncTelnetCommandList list;
+    std::vector<AsyncTelnetCommand> storage;
+    register_commands(list, storage);
+
+    constexpr uint32_t count = sizeof(Lines) / sizeof(Lines[0]);
+    char buffer[128];
+    AsyncTelnetArgs args;
+    uint32_t found = 0;
+
+    NativeHeap.Mark();
+    const uint32_t start = micros();
+
+    for (uint32_t n = 0; n < Rounds; n++) {
+        const char* source = Lines[n % count];
+        memcpy(buffer, source, strlen(source) + 1);
+
+        char* line = AsyncTelnetArgs::Trim(buffer);
+        if (list.Find(args.Split(line)) != nullptr) found++;
+    }
+
+    const uint32_t elapsed = micros() - start;
+    const uint32_t allocations = NativeHeap.Allocations;
+
+    TEST_ASSERT_EQUAL_UINT32(Rounds - Rounds / count, found);
+    TEST_ASSERT_EQUAL_UINT32(0, allocations);
+
+    report("Args", Rounds, elapsed, allocations);
+}
+
+static void test_bench_string_slots() {
+    AsyncTelnetCommandList list;
+    std::vector<AsyncTelnetCommand> storage;
+    register_commands(list, storage);
+
+    constexpr uint32_t count = sizeof(Lines) / sizeof(Lines[0]);
+    char buffer[128];
+    AsyncTelnetArgs args;
+    String parameter[ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS];
+    uint32_t found = 0;
+
+    NativeHeap.Mark();
+    const uint32_t start = micros();
+
+    for (uint32_t n = 0; n < Rounds; n++) {
+        const char* source = Lines[n % count];
+        memcpy(buffer, source, strlen(source) + 1);
+
+        char* line = AsyncTelnetArgs::Trim(buffer);
+        if (list.Find(args.Split(line)) == nullptr) continue;
+
+        // What the compatibility path does before calling a String* callback
+        for (uint8_t i = 0; i < ASYNCTELNETSERVER_MAXCOMMANDPARAMETERS; i++) parameter[i] = args[i];
+        found++;
+    }
+
+    const uint32_t elapsed = micros() - start;
+    const uint32_t allocations = NativeHeap.Allocations;
+
+    TEST_ASSERT_EQUAL_UINT32(Rounds - Rounds / count, found);
+
+    report("String slots", Rounds, elapsed, allocations);
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_trim);
+    RUN_TEST(test_split);
+    RUN_TEST(test_split_cap);
+    RUN_TEST(test_is_empty);
+    RUN_TEST(test_command_list);
+
+    RUN_TEST(test_bench_args);
+    RUN_TEST(test_bench_string_slots);
+
+    return UNITY_END();
+}
@@ -0,0 +1,75 @@
+# scripts/web_assets.py
+import os, gzip, json, shutil, hashlib
+from SCons.Script import Import
+Import("env")
+
+PROJECT_DIR = env.subst("$PROJECT_DIR")
+BUILD_DIR   = env.subst("$BUILD_DIR")
+
+src_dir   = os.path.join(PROJECT_DIR, "data")
+stage_dir = os.path.join(BUILD_DIR, "data")
+
+# Served from /res with fingerprinted URLs; anything else (config, templates) is copied as-is
+ASSET_PREFIX  = "res/"
+GZIP_TYPES    = (".css", ".js", ".svg", ".json", ".txt", ".ico")
+REWRITE_TYPES = (".html", ".css")
+MANIFEST      = "assets.json"
+
+def log(msg): print(f"[web_assets] {msg}")
+
+def stage():
+    if not os.path.isdir(src_dir):
+        log(f"No data directory at {src_dir}")
+        return
+
+    shutil.rmtree(stage_dir, ignore_errors=True)
+    os.makedirs(stage_dir)
+
+    files = []
+    for root, _, names in os.walk(src_dir):
+        for name in names:
+            files.append(os.path.relpath(os.path.join(root, name), src_dir).replace(os.sep, "/"))
+
+    # Rewriting files go last (pages after stylesheets) so their fingerprint covers the references they now carry
+    files.sort(key=lambda rel: 2 if rel.lower().endswith(".html") else 1 if rel.lower().endswith(REWRITE_TYPES) else 0)
+
+    manifest = {}
+    for rel in files:
+        src = os.path.join(src_dir, rel)
+        dst = os.path.join(stage_dir, rel)
+        os.makedirs(os.path.dirname(dst), exist_ok=True)
+
+        with open(src, "rb") as f:
+            data = f.read()
+
+        # Cache-bust references so pages can keep immutable assets forever
+        if rel.lower().endswith(REWRITE_TYPES):
+            text = data.decode("utf-8")
+            for path, info in manifest.items():
+                text = text.replace(path.lstrip("/"), path.lstrip("/") + "?v=" + info["ETag"])
+            data = text.encode("utf-8")
+
+        if not rel.startswith(ASSET_PREFIX):
+            with open(dst, "wb") as f:
+                f.write(data)
+            continue
+
+        entry = { "ETag": hashlib.sha256(data).hexdigest()[:16], "Gzip": rel.lower().endswith(GZIP_TYPES) }
+        manifest["/" + rel] = entry
+
+        if entry["Gzip"]:
+            # Only the .gz is packed, the web server falls back to it and sets Content-Encoding
+            with open(dst + ".gz", "wb") as f:
+                f.write(gzip.compress(data, compresslevel=9, mtime=0))
+            log(f"{rel}: {len(data)} -> {os.path.getsize(dst + '.gz')} bytes")
+        else:
+            with open(dst, "wb") as f:
+                f.write(data)
+
+    with open(os.path.join(stage_dir, MANIFEST), "w") as f:
+        json.dump(manifest, f, separators=(",", ":"), sort_keys=True)
+
+    log(f"{len(manifest)} asset(s) fingerprinted into {stage_dir}")
+
+stage()
+env.Replace(PROJECT_DATA_DIR=stage_dir)